@@ -0,0 +1,165 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Bindless texture registry: One large, partially bound descriptor array that can be updated after binding. Textures
+// get a stable slot from a free list and shaders index the array with it, so adding and removing textures never touches
+// the set layout, the pipelines or descriptors in use. Writes are batched and applied once per frame. Removed slots
+// are only handed out again once the frames that may still sample them have retired, through the deletion queue.
+
+#pragma once
+
+#include <vector>
+#include <map>
+#include <algorithm>
+#include <compare>
+#include <cstdint>
+#include <volk.h>
+#include "common.h"
+#include "deletionqueue.h"
+
+using TextureHandle = uint32_t;
+constexpr TextureHandle invalidTexture{ UINT32_MAX };
+constexpr uint32_t maxBindlessTextures{ 16384 };
+
+// Samplers are shared by all textures with the same description, the LOD isn't clamped so the mip count doesn't matter
+struct SamplerDesc {
+	VkFilter filter{ VK_FILTER_LINEAR };
+	VkSamplerMipmapMode mipmapMode{ VK_SAMPLER_MIPMAP_MODE_LINEAR };
+	VkSamplerAddressMode addressMode{ VK_SAMPLER_ADDRESS_MODE_REPEAT };
+	float maxAnisotropy{ 8.0f };
+	auto operator<=>(const SamplerDesc&) const = default;
+};
+
+// Not thread safe, all calls must come from the thread that records the frame
+class BindlessRegistry {
+public:
+	// The capacity is clamped to the device's update after bind limits
+	void create(VkDevice device, const VkPhysicalDeviceVulkan12Properties& limits, uint32_t capacity = maxBindlessTextures) {
+		this->device = device;
+		this->capacity = std::min({ capacity, limits.maxDescriptorSetUpdateAfterBindSampledImages, limits.maxDescriptorSetUpdateAfterBindSamplers, limits.maxPerStageDescriptorUpdateAfterBindSampledImages, limits.maxPerStageDescriptorUpdateAfterBindSamplers });
+		const VkDescriptorBindingFlags bindingFlags{ VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT | VK_DESCRIPTOR_BINDING_PARTIALLY_BOUND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_AFTER_BIND_BIT | VK_DESCRIPTOR_BINDING_UPDATE_UNUSED_WHILE_PENDING_BIT };
+		VkDescriptorSetLayoutBindingFlagsCreateInfo bindingFlagsCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO, .bindingCount = 1, .pBindingFlags = &bindingFlags };
+		VkDescriptorSetLayoutBinding binding{ .binding = 0, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = this->capacity, .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT };
+		VkDescriptorSetLayoutCreateInfo layoutCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, .pNext = &bindingFlagsCI, .flags = VK_DESCRIPTOR_SET_LAYOUT_CREATE_UPDATE_AFTER_BIND_POOL_BIT, .bindingCount = 1, .pBindings = &binding };
+		chk(vkCreateDescriptorSetLayout(device, &layoutCI, nullptr, &setLayout));
+		VkDescriptorPoolSize poolSize{ .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = this->capacity };
+		VkDescriptorPoolCreateInfo poolCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, .flags = VK_DESCRIPTOR_POOL_CREATE_UPDATE_AFTER_BIND_BIT, .maxSets = 1, .poolSizeCount = 1, .pPoolSizes = &poolSize };
+		chk(vkCreateDescriptorPool(device, &poolCI, nullptr, &pool));
+		VkDescriptorSetVariableDescriptorCountAllocateInfo variableCountAI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO, .descriptorSetCount = 1, .pDescriptorCounts = &this->capacity };
+		VkDescriptorSetAllocateInfo setAI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, .pNext = &variableCountAI, .descriptorPool = pool, .descriptorSetCount = 1, .pSetLayouts = &setLayout };
+		chk(vkAllocateDescriptorSets(device, &setAI, &set));
+	}
+
+	// Textures must have been removed and their frames retired, the image views are owned by the caller
+	void destroy() {
+		for (auto& [desc, sampler] : samplers) {
+			vkDestroySampler(device, sampler, nullptr);
+		}
+		samplers.clear();
+		vkDestroyDescriptorPool(device, pool, nullptr);
+		vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+	}
+
+	VkSampler sampler(const SamplerDesc& desc) {
+		auto it = samplers.find(desc);
+		if (it != samplers.end()) {
+			return it->second;
+		}
+		VkSamplerCreateInfo samplerCI{
+			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
+			.magFilter = desc.filter,
+			.minFilter = desc.filter,
+			.mipmapMode = desc.mipmapMode,
+			.addressModeU = desc.addressMode,
+			.addressModeV = desc.addressMode,
+			.addressModeW = desc.addressMode,
+			.anisotropyEnable = desc.maxAnisotropy > 1.0f ? VK_TRUE : VK_FALSE,
+			.maxAnisotropy = desc.maxAnisotropy,
+			.maxLod = VK_LOD_CLAMP_NONE,
+		};
+		VkSampler sampler{ VK_NULL_HANDLE };
+		chk(vkCreateSampler(device, &samplerCI, nullptr, &sampler));
+		samplers.emplace(desc, sampler);
+		return sampler;
+	}
+
+	// Returns invalidTexture if all slots are in use, the descriptor is written with the next flush
+	TextureHandle add(VkImageView view, const SamplerDesc& samplerDesc = {}) {
+		TextureHandle handle{ invalidTexture };
+		if (!freeSlots.empty()) {
+			handle = freeSlots.back();
+			freeSlots.pop_back();
+		} else if (slotCount < capacity) {
+			handle = slotCount++;
+		} else {
+			return invalidTexture;
+		}
+		pendingWrites.push_back({ .slot = handle, .info{.sampler = sampler(samplerDesc), .imageView = view, .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL } });
+		liveCount++;
+		return handle;
+	}
+
+	// Work recorded for the current frame must not reference the handle anymore, the slot is reused after the frame retired
+	// The image view can be retired into the same frame of the deletion queue
+	void remove(TextureHandle handle, DeletionQueue& deletions, uint32_t frameIndex) {
+		std::erase_if(pendingWrites, [handle](const PendingWrite& write) { return write.slot == handle; });
+		liveCount--;
+		deletions.push(frameIndex, [this, handle]() { freeSlots.push_back(handle); });
+	}
+
+	// Writes all descriptors added since the last call in one update, consecutive slots share a write
+	void flush() {
+		if (pendingWrites.empty()) {
+			return;
+		}
+		std::sort(pendingWrites.begin(), pendingWrites.end(), [](const PendingWrite& a, const PendingWrite& b) { return a.slot < b.slot; });
+		std::vector<VkDescriptorImageInfo> infos;
+		infos.reserve(pendingWrites.size());
+		std::vector<VkWriteDescriptorSet> writes;
+		for (size_t i = 0; i < pendingWrites.size(); i++) {
+			infos.push_back(pendingWrites[i].info);
+			if (i > 0 && pendingWrites[i].slot == pendingWrites[i - 1].slot + 1) {
+				writes.back().descriptorCount++;
+				continue;
+			}
+			writes.push_back({ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = set, .dstBinding = 0, .dstArrayElement = pendingWrites[i].slot, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER });
+		}
+		// Image infos are only pointed to once the vector doesn't grow anymore
+		size_t first{ 0 };
+		for (auto& write : writes) {
+			write.pImageInfo = &infos[first];
+			first += write.descriptorCount;
+		}
+		vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		writeCount += pendingWrites.size();
+		pendingWrites.clear();
+	}
+
+	VkDescriptorSetLayout layout() const { return setLayout; }
+	VkDescriptorSet descriptorSet() const { return set; }
+	// Highest slot ever handed out plus one, per slot data like the minimum LODs needs this many entries
+	uint32_t slots() const { return slotCount; }
+	uint32_t textureCount() const { return liveCount; }
+	uint32_t maxTextures() const { return capacity; }
+	uint32_t samplerCount() const { return static_cast<uint32_t>(samplers.size()); }
+	uint64_t descriptorWrites() const { return writeCount; }
+
+private:
+	struct PendingWrite {
+		TextureHandle slot{ invalidTexture };
+		VkDescriptorImageInfo info{};
+	};
+
+	VkDevice device{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout setLayout{ VK_NULL_HANDLE };
+	VkDescriptorPool pool{ VK_NULL_HANDLE };
+	VkDescriptorSet set{ VK_NULL_HANDLE };
+	uint32_t capacity{ 0 };
+	uint32_t slotCount{ 0 };
+	uint32_t liveCount{ 0 };
+	uint64_t writeCount{ 0 };
+	std::vector<TextureHandle> freeSlots;
+	std::vector<PendingWrite> pendingWrites;
+	std::map<SamplerDesc, VkSampler> samplers;
+};
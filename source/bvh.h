@@ -0,0 +1,818 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Bounding volume hierarchies for ray queries on the CPU, used for mouse picking. Every mesh gets a BVH over its triangles,
+// built top down with binned SAH and collapsed into four wide nodes, so a ray is tested against four child boxes or a leaf
+// of four triangles at once. The top levels are split on the calling thread, the subtrees below them are built on all
+// threads of the job system. Instances are kept in a binary BVH over their world space bounds, which is refit bottom up
+// when instances move and only rebuilt when instances are added.
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <thread>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include "jobsystem.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define BVH_SSE 1
+#include <immintrin.h>
+#endif
+
+constexpr uint32_t bvhInvalidIndex{ UINT32_MAX };
+
+// Four floats and a mask of four lanes, one SSE register each on x86 and plain arrays elsewhere
+#if defined(BVH_SSE)
+struct Float4 {
+	__m128 v;
+};
+struct Mask4 {
+	__m128 v;
+};
+inline Float4 load4(const float* values) { return { _mm_loadu_ps(values) }; }
+inline Float4 splat4(float value) { return { _mm_set1_ps(value) }; }
+inline void store4(float* values, Float4 a) { _mm_storeu_ps(values, a.v); }
+inline Float4 operator+(Float4 a, Float4 b) { return { _mm_add_ps(a.v, b.v) }; }
+inline Float4 operator-(Float4 a, Float4 b) { return { _mm_sub_ps(a.v, b.v) }; }
+inline Float4 operator*(Float4 a, Float4 b) { return { _mm_mul_ps(a.v, b.v) }; }
+inline Float4 operator/(Float4 a, Float4 b) { return { _mm_div_ps(a.v, b.v) }; }
+inline Float4 min4(Float4 a, Float4 b) { return { _mm_min_ps(a.v, b.v) }; }
+inline Float4 max4(Float4 a, Float4 b) { return { _mm_max_ps(a.v, b.v) }; }
+inline Float4 abs4(Float4 a) { return { _mm_andnot_ps(_mm_set1_ps(-0.0f), a.v) }; }
+inline Mask4 operator<(Float4 a, Float4 b) { return { _mm_cmplt_ps(a.v, b.v) }; }
+inline Mask4 operator<=(Float4 a, Float4 b) { return { _mm_cmple_ps(a.v, b.v) }; }
+inline Mask4 operator&(Mask4 a, Mask4 b) { return { _mm_and_ps(a.v, b.v) }; }
+inline uint32_t maskBits(Mask4 a) { return static_cast<uint32_t>(_mm_movemask_ps(a.v)); }
+#else
+struct Float4 {
+	float v[4];
+};
+struct Mask4 {
+	bool v[4];
+};
+template<typename T, typename Op>
+inline T lanes4(Op op) {
+	T result;
+	for (uint32_t i = 0; i < 4; i++) {
+		result.v[i] = op(i);
+	}
+	return result;
+}
+inline Float4 load4(const float* values) { return lanes4<Float4>([&](uint32_t i) { return values[i]; }); }
+inline Float4 splat4(float value) { return lanes4<Float4>([&](uint32_t) { return value; }); }
+inline void store4(float* values, Float4 a) { std::copy(a.v, a.v + 4, values); }
+inline Float4 operator+(Float4 a, Float4 b) { return lanes4<Float4>([&](uint32_t i) { return a.v[i] + b.v[i]; }); }
+inline Float4 operator-(Float4 a, Float4 b) { return lanes4<Float4>([&](uint32_t i) { return a.v[i] - b.v[i]; }); }
+inline Float4 operator*(Float4 a, Float4 b) { return lanes4<Float4>([&](uint32_t i) { return a.v[i] * b.v[i]; }); }
+inline Float4 operator/(Float4 a, Float4 b) { return lanes4<Float4>([&](uint32_t i) { return a.v[i] / b.v[i]; }); }
+inline Float4 min4(Float4 a, Float4 b) { return lanes4<Float4>([&](uint32_t i) { return std::min(a.v[i], b.v[i]); }); }
+inline Float4 max4(Float4 a, Float4 b) { return lanes4<Float4>([&](uint32_t i) { return std::max(a.v[i], b.v[i]); }); }
+inline Float4 abs4(Float4 a) { return lanes4<Float4>([&](uint32_t i) { return std::abs(a.v[i]); }); }
+inline Mask4 operator<(Float4 a, Float4 b) { return lanes4<Mask4>([&](uint32_t i) { return a.v[i] < b.v[i]; }); }
+inline Mask4 operator<=(Float4 a, Float4 b) { return lanes4<Mask4>([&](uint32_t i) { return a.v[i] <= b.v[i]; }); }
+inline Mask4 operator&(Mask4 a, Mask4 b) { return lanes4<Mask4>([&](uint32_t i) { return a.v[i] && b.v[i]; }); }
+inline uint32_t maskBits(Mask4 a) { return (a.v[0] ? 1u : 0u) | (a.v[1] ? 2u : 0u) | (a.v[2] ? 4u : 0u) | (a.v[3] ? 8u : 0u); }
+#endif
+
+struct Aabb {
+	glm::vec3 min{ std::numeric_limits<float>::max() };
+	glm::vec3 max{ -std::numeric_limits<float>::max() };
+
+	void grow(const glm::vec3& point) {
+		min = glm::min(min, point);
+		max = glm::max(max, point);
+	}
+
+	void grow(const Aabb& other) {
+		min = glm::min(min, other.min);
+		max = glm::max(max, other.max);
+	}
+
+	glm::vec3 center() const { return (min + max) * 0.5f; }
+
+	bool empty() const { return min.x > max.x; }
+
+	// Surface area, the SAH weighs the chance of a ray hitting a box with it
+	float area() const {
+		const glm::vec3 extent{ max - min };
+		return extent.x < 0.0f ? 0.0f : 2.0f * (extent.x * extent.y + extent.y * extent.z + extent.z * extent.x);
+	}
+
+	bool operator==(const Aabb& other) const { return min == other.min && max == other.max; }
+};
+
+// Box around the transformed corners of a box, without transforming all eight of them
+inline Aabb transformBounds(const Aabb& bounds, const glm::mat4& transform) {
+	Aabb result;
+	if (bounds.empty()) {
+		return result;
+	}
+	result.min = result.max = glm::vec3(transform[3]);
+	for (uint32_t column = 0; column < 3; column++) {
+		const glm::vec3 a{ glm::vec3(transform[column]) * bounds.min[column] };
+		const glm::vec3 b{ glm::vec3(transform[column]) * bounds.max[column] };
+		result.min += glm::min(a, b);
+		result.max += glm::max(a, b);
+	}
+	return result;
+}
+
+struct Ray {
+	glm::vec3 origin{ 0.0f };
+	glm::vec3 direction{ 0.0f, 0.0f, 1.0f };
+};
+
+// Closest hit along a ray, t is in units of the ray's direction
+struct RayHit {
+	float t{ std::numeric_limits<float>::max() };
+	uint32_t triangle{ bvhInvalidIndex };
+	uint32_t instance{ bvhInvalidIndex };
+	bool hit() const { return triangle != bvhInvalidIndex; }
+};
+
+// Ray through the center of a pixel, unprojected from the near to the far plane with a depth range of zero to one
+inline Ray screenRay(const glm::vec2& pixel, const glm::vec2& size, const glm::mat4& projection, const glm::mat4& view) {
+	const glm::mat4 inverseViewProjection{ glm::inverse(projection * view) };
+	const glm::vec2 ndc{ (pixel + 0.5f) / size * 2.0f - 1.0f };
+	const glm::vec4 nearPoint{ inverseViewProjection * glm::vec4(ndc.x, ndc.y, 0.0f, 1.0f) };
+	const glm::vec4 farPoint{ inverseViewProjection * glm::vec4(ndc.x, ndc.y, 1.0f, 1.0f) };
+	const glm::vec3 origin{ glm::vec3(nearPoint) / nearPoint.w };
+	return { .origin = origin, .direction = glm::normalize(glm::vec3(farPoint) / farPoint.w - origin) };
+}
+
+// Reciprocal of a ray direction for slab tests, zero components would turn the slab distances into NaNs
+inline glm::vec3 inverseDirection(glm::vec3 direction) {
+	for (uint32_t axis = 0; axis < 3; axis++) {
+		if (std::abs(direction[axis]) < 1e-12f) {
+			direction[axis] = std::copysign(1e-12f, direction[axis]);
+		}
+	}
+	return 1.0f / direction;
+}
+
+// Binary node, leaves have a primitive count and cover a range of the reordered primitives
+struct BvhNode {
+	Aabb bounds;
+	uint32_t left{ 0 };
+	uint32_t right{ 0 };
+	uint32_t first{ 0 };
+	uint32_t count{ 0 };
+	uint32_t parent{ bvhInvalidIndex };
+};
+
+// Top down binned SAH build over primitive bounds, shared by the mesh and the instance BVHs. The primitive order is
+// rearranged so every leaf covers a contiguous range of it
+class BvhBuilder {
+public:
+	BvhBuilder(const std::vector<Aabb>& bounds, std::vector<uint32_t>& primitives, uint32_t maxLeafSize) : bounds(bounds), primitives(primitives), maxLeafSize(maxLeafSize) {
+		centroids.resize(bounds.size());
+		for (size_t i = 0; i < bounds.size(); i++) {
+			centroids[i] = bounds[i].center();
+		}
+	}
+
+	// Without primitives the tree has no nodes at all, as an empty root would look like an inner node
+	std::vector<BvhNode> build(JobSystem* jobs) {
+		std::vector<BvhNode> nodes;
+		if (primitives.empty()) {
+			return nodes;
+		}
+		nodes.reserve(2 * primitives.size() / maxLeafSize + 1);
+		nodes.push_back(makeNode(0, static_cast<uint32_t>(primitives.size()), bvhInvalidIndex));
+		if (jobs == nullptr || jobs->threadCount() == 1 || primitives.size() < parallelMinPrimitives) {
+			buildSubtree(nodes, 0);
+			return nodes;
+		}
+		// The largest pending nodes are split here until there is enough work for every thread
+		std::vector<uint32_t> tasks{ 0 };
+		while (tasks.size() < jobs->threadCount() * 4) {
+			auto largest = std::max_element(tasks.begin(), tasks.end(), [&](uint32_t a, uint32_t b) { return nodes[a].count < nodes[b].count; });
+			const uint32_t node{ *largest };
+			if (nodes[node].count < parallelMinPrimitives || !split(nodes, node)) {
+				break;
+			}
+			*largest = nodes[node].left;
+			tasks.push_back(nodes[node].right);
+		}
+		// Subtrees are built into their own arrays, their ranges of the primitives don't overlap
+		std::vector<std::vector<BvhNode>> subtrees(tasks.size());
+		jobs->parallelFor(static_cast<uint32_t>(tasks.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+			for (uint32_t i = begin; i < end; i++) {
+				subtrees[i].push_back(nodes[tasks[i]]);
+				buildSubtree(subtrees[i], 0);
+			}
+		});
+		// The subtree's root replaces its task node, all other nodes are appended
+		for (size_t i = 0; i < tasks.size(); i++) {
+			const uint32_t offset{ static_cast<uint32_t>(nodes.size()) - 1 };
+			const auto remap = [&](uint32_t index) { return index == 0 ? tasks[i] : index + offset; };
+			for (size_t j = 0; j < subtrees[i].size(); j++) {
+				BvhNode node{ subtrees[i][j] };
+				if (node.count == 0) {
+					node.left = remap(node.left);
+					node.right = remap(node.right);
+				}
+				if (j == 0) {
+					node.parent = nodes[tasks[i]].parent;
+					nodes[tasks[i]] = node;
+				} else {
+					node.parent = remap(node.parent);
+					nodes.push_back(node);
+				}
+			}
+		}
+		return nodes;
+	}
+
+private:
+	static constexpr uint32_t binCount{ 16 };
+	// Below this many primitives a subtree is built by a single thread
+	static constexpr uint32_t parallelMinPrimitives{ 16384 };
+	const std::vector<Aabb>& bounds;
+	std::vector<uint32_t>& primitives;
+	std::vector<glm::vec3> centroids;
+	uint32_t maxLeafSize;
+
+	BvhNode makeNode(uint32_t first, uint32_t count, uint32_t parent) const {
+		BvhNode node{ .bounds = {}, .first = first, .count = count, .parent = parent };
+		for (uint32_t i = first; i < first + count; i++) {
+			node.bounds.grow(bounds[primitives[i]]);
+		}
+		return node;
+	}
+
+	void buildSubtree(std::vector<BvhNode>& nodes, uint32_t root) {
+		std::vector<uint32_t> stack{ root };
+		while (!stack.empty()) {
+			const uint32_t node{ stack.back() };
+			stack.pop_back();
+			if (split(nodes, node)) {
+				stack.push_back(nodes[node].left);
+				stack.push_back(nodes[node].right);
+			}
+		}
+	}
+
+	// Turns a leaf into an inner node with two new leaves, returns false if it's small enough to stay a leaf
+	bool split(std::vector<BvhNode>& nodes, uint32_t index) {
+		const uint32_t first{ nodes[index].first };
+		const uint32_t count{ nodes[index].count };
+		if (count <= maxLeafSize) {
+			return false;
+		}
+		Aabb centroidBounds;
+		for (uint32_t i = first; i < first + count; i++) {
+			centroidBounds.grow(centroids[primitives[i]]);
+		}
+		// Cost of every split plane between the bins on all three axes, the cheapest one wins
+		float bestCost{ std::numeric_limits<float>::max() };
+		uint32_t bestAxis{ 0 };
+		uint32_t bestBin{ 0 };
+		const glm::vec3 extent{ centroidBounds.max - centroidBounds.min };
+		for (uint32_t axis = 0; axis < 3; axis++) {
+			if (extent[axis] <= 0.0f) {
+				continue;
+			}
+			std::array<Aabb, binCount> binBounds{};
+			std::array<uint32_t, binCount> binCounts{};
+			const float scale{ static_cast<float>(binCount) / extent[axis] };
+			for (uint32_t i = first; i < first + count; i++) {
+				const uint32_t bin{ std::min(binCount - 1, static_cast<uint32_t>((centroids[primitives[i]][axis] - centroidBounds.min[axis]) * scale)) };
+				binBounds[bin].grow(bounds[primitives[i]]);
+				binCounts[bin]++;
+			}
+			std::array<float, binCount - 1> leftCosts{};
+			Aabb leftBounds;
+			uint32_t leftCount{ 0 };
+			for (uint32_t bin = 0; bin < binCount - 1; bin++) {
+				leftBounds.grow(binBounds[bin]);
+				leftCount += binCounts[bin];
+				leftCosts[bin] = leftCount == 0 ? -1.0f : leftBounds.area() * static_cast<float>(leftCount);
+			}
+			Aabb rightBounds;
+			uint32_t rightCount{ 0 };
+			for (uint32_t bin = binCount - 1; bin > 0; bin--) {
+				rightBounds.grow(binBounds[bin]);
+				rightCount += binCounts[bin];
+				const float cost{ leftCosts[bin - 1] + rightBounds.area() * static_cast<float>(rightCount) };
+				if (leftCosts[bin - 1] >= 0.0f && rightCount > 0 && cost < bestCost) {
+					bestCost = cost;
+					bestAxis = axis;
+					bestBin = bin - 1;
+				}
+			}
+		}
+		uint32_t* begin{ primitives.data() + first };
+		uint32_t* middle{ begin + count / 2 };
+		if (bestCost < std::numeric_limits<float>::max()) {
+			const float scale{ static_cast<float>(binCount) / extent[bestAxis] };
+			middle = std::partition(begin, begin + count, [&](uint32_t primitive) {
+				return std::min(binCount - 1, static_cast<uint32_t>((centroids[primitive][bestAxis] - centroidBounds.min[bestAxis]) * scale)) <= bestBin;
+			});
+		}
+		// All centroids in one spot can't be separated by a plane, such nodes are split in half
+		const uint32_t leftCount{ static_cast<uint32_t>(middle - begin) };
+		const uint32_t left{ static_cast<uint32_t>(nodes.size()) };
+		nodes.push_back(makeNode(first, leftCount, index));
+		nodes.push_back(makeNode(first + leftCount, count - leftCount, index));
+		nodes[index].left = left;
+		nodes[index].right = left + 1;
+		nodes[index].count = 0;
+		return true;
+	}
+};
+
+// Triangle BVH of one mesh with four wide nodes and leaves of up to four triangles
+class MeshBvh {
+public:
+	// Indices are 16 or 32 bit, every three of them form a triangle
+	void build(const glm::vec3* positions, const void* indexData, uint32_t indexCount, uint32_t indexSize, JobSystem* jobs = nullptr) {
+		const uint32_t triangleCount{ indexCount / 3 };
+		const auto index = [&](uint32_t i) {
+			return indexSize == sizeof(uint16_t) ? static_cast<const uint16_t*>(indexData)[i] : static_cast<const uint32_t*>(indexData)[i];
+		};
+		std::vector<std::array<glm::vec3, 3>> triangles(triangleCount);
+		std::vector<Aabb> triangleBounds(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			for (uint32_t corner = 0; corner < 3; corner++) {
+				triangles[i][corner] = positions[index(i * 3 + corner)];
+				triangleBounds[i].grow(triangles[i][corner]);
+			}
+		}
+		std::vector<uint32_t> order(triangleCount);
+		for (uint32_t i = 0; i < triangleCount; i++) {
+			order[i] = i;
+		}
+		const std::vector<BvhNode> binaryNodes{ BvhBuilder(triangleBounds, order, 4).build(jobs) };
+		nodes.clear();
+		packets.clear();
+		rootBounds = {};
+		if (binaryNodes.empty()) {
+			return;
+		}
+		rootBounds = binaryNodes[0].bounds;
+		collapse(binaryNodes, 0, triangles, order);
+	}
+
+	// Updates hit if the ray hits a triangle closer than hit.t
+	bool intersect(const Ray& ray, RayHit& hit) const {
+		if (nodes.empty()) {
+			return false;
+		}
+		const glm::vec3 inverse{ inverseDirection(ray.direction) };
+		const Float4 originX{ splat4(ray.origin.x) }, originY{ splat4(ray.origin.y) }, originZ{ splat4(ray.origin.z) };
+		const Float4 directionX{ splat4(ray.direction.x) }, directionY{ splat4(ray.direction.y) }, directionZ{ splat4(ray.direction.z) };
+		const Float4 inverseX{ splat4(inverse.x) }, inverseY{ splat4(inverse.y) }, inverseZ{ splat4(inverse.z) };
+		const Float4 zero{ splat4(0.0f) };
+		const Float4 one{ splat4(1.0f) };
+		const Float4 epsilon{ splat4(1e-12f) };
+		bool found{ false };
+		// Children are pushed far to near, so the nearest one is visited first and shortens the ray for the others
+		struct Entry {
+			uint32_t node;
+			float distance;
+		};
+		thread_local std::vector<Entry> stack;
+		stack.clear();
+		stack.push_back({ 0, 0.0f });
+		while (!stack.empty()) {
+			const Entry entry{ stack.back() };
+			stack.pop_back();
+			if (entry.distance >= hit.t) {
+				continue;
+			}
+			const Node& node = nodes[entry.node];
+			const Float4 t0x{ (load4(node.minX) - originX) * inverseX }, t1x{ (load4(node.maxX) - originX) * inverseX };
+			const Float4 t0y{ (load4(node.minY) - originY) * inverseY }, t1y{ (load4(node.maxY) - originY) * inverseY };
+			const Float4 t0z{ (load4(node.minZ) - originZ) * inverseZ }, t1z{ (load4(node.maxZ) - originZ) * inverseZ };
+			const Float4 near{ max4(max4(min4(t0x, t1x), min4(t0y, t1y)), max4(min4(t0z, t1z), zero)) };
+			const Float4 far{ min4(min4(max4(t0x, t1x), max4(t0y, t1y)), min4(max4(t0z, t1z), splat4(hit.t))) };
+			uint32_t mask{ maskBits(near <= far) };
+			float distances[4];
+			store4(distances, near);
+			Entry children[4];
+			uint32_t childCount{ 0 };
+			for (uint32_t lane = 0; lane < 4; lane++) {
+				if ((mask & (1u << lane)) == 0 || node.children[lane] == emptyChild) {
+					continue;
+				}
+				if (node.children[lane] & leafBit) {
+					found |= intersectPacket(packets[node.children[lane] & ~leafBit], originX, originY, originZ, directionX, directionY, directionZ, zero, one, epsilon, hit);
+					continue;
+				}
+				// Insertion sort by descending distance
+				uint32_t slot{ childCount++ };
+				while (slot > 0 && children[slot - 1].distance < distances[lane]) {
+					children[slot] = children[slot - 1];
+					slot--;
+				}
+				children[slot] = { node.children[lane], distances[lane] };
+			}
+			stack.insert(stack.end(), children, children + childCount);
+		}
+		return found;
+	}
+
+	const Aabb& bounds() const { return rootBounds; }
+	uint32_t nodeCount() const { return static_cast<uint32_t>(nodes.size()); }
+	uint32_t packetCount() const { return static_cast<uint32_t>(packets.size()); }
+	size_t memoryBytes() const { return nodes.size() * sizeof(Node) + packets.size() * sizeof(Packet); }
+
+private:
+	// Bounds of the four children in structure of arrays layout, unused children are marked empty
+	struct alignas(16) Node {
+		float minX[4], minY[4], minZ[4];
+		float maxX[4], maxY[4], maxZ[4];
+		uint32_t children[4];
+	};
+	// Four triangles as first vertex and two edges, unused lanes are degenerate and never hit
+	struct alignas(16) Packet {
+		float v0x[4], v0y[4], v0z[4];
+		float e1x[4], e1y[4], e1z[4];
+		float e2x[4], e2y[4], e2z[4];
+		uint32_t triangles[4];
+	};
+	static constexpr uint32_t leafBit{ 0x80000000 };
+	static constexpr uint32_t emptyChild{ UINT32_MAX };
+	std::vector<Node> nodes;
+	std::vector<Packet> packets;
+	Aabb rootBounds;
+
+	// Each wide node takes the children of the binary node and keeps opening the largest inner child until it has four
+	uint32_t collapse(const std::vector<BvhNode>& binaryNodes, uint32_t binaryIndex, const std::vector<std::array<glm::vec3, 3>>& triangles, const std::vector<uint32_t>& order) {
+		const uint32_t index{ static_cast<uint32_t>(nodes.size()) };
+		nodes.push_back({});
+		std::vector<uint32_t> children;
+		if (binaryNodes[binaryIndex].count > 0) {
+			children.push_back(binaryIndex);
+		} else {
+			children = { binaryNodes[binaryIndex].left, binaryNodes[binaryIndex].right };
+		}
+		while (children.size() < 4) {
+			auto largest = children.end();
+			for (auto child = children.begin(); child != children.end(); child++) {
+				if (binaryNodes[*child].count == 0 && (largest == children.end() || binaryNodes[*child].bounds.area() > binaryNodes[*largest].bounds.area())) {
+					largest = child;
+				}
+			}
+			if (largest == children.end()) {
+				break;
+			}
+			const BvhNode& opened = binaryNodes[*largest];
+			*largest = opened.left;
+			children.push_back(opened.right);
+		}
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			uint32_t child{ emptyChild };
+			Aabb childBounds;
+			if (lane < children.size()) {
+				const BvhNode& binaryChild = binaryNodes[children[lane]];
+				childBounds = binaryChild.bounds;
+				child = binaryChild.count > 0 ? (addPacket(binaryChild, triangles, order) | leafBit) : collapse(binaryNodes, children[lane], triangles, order);
+			}
+			Node& node = nodes[index];
+			node.minX[lane] = childBounds.min.x;
+			node.minY[lane] = childBounds.min.y;
+			node.minZ[lane] = childBounds.min.z;
+			node.maxX[lane] = childBounds.max.x;
+			node.maxY[lane] = childBounds.max.y;
+			node.maxZ[lane] = childBounds.max.z;
+			node.children[lane] = child;
+		}
+		return index;
+	}
+
+	uint32_t addPacket(const BvhNode& leaf, const std::vector<std::array<glm::vec3, 3>>& triangles, const std::vector<uint32_t>& order) {
+		Packet packet{};
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			packet.triangles[lane] = bvhInvalidIndex;
+			if (lane >= leaf.count) {
+				continue;
+			}
+			const uint32_t triangle{ order[leaf.first + lane] };
+			const glm::vec3 v0{ triangles[triangle][0] };
+			const glm::vec3 e1{ triangles[triangle][1] - v0 };
+			const glm::vec3 e2{ triangles[triangle][2] - v0 };
+			packet.v0x[lane] = v0.x;
+			packet.v0y[lane] = v0.y;
+			packet.v0z[lane] = v0.z;
+			packet.e1x[lane] = e1.x;
+			packet.e1y[lane] = e1.y;
+			packet.e1z[lane] = e1.z;
+			packet.e2x[lane] = e2.x;
+			packet.e2y[lane] = e2.y;
+			packet.e2z[lane] = e2.z;
+			packet.triangles[lane] = triangle;
+		}
+		packets.push_back(packet);
+		return static_cast<uint32_t>(packets.size()) - 1;
+	}
+
+	// Möller-Trumbore for four triangles at once, triangles are hit from both sides
+	static bool intersectPacket(const Packet& packet, Float4 originX, Float4 originY, Float4 originZ, Float4 directionX, Float4 directionY, Float4 directionZ, Float4 zero, Float4 one, Float4 epsilon, RayHit& hit) {
+		const Float4 e1x{ load4(packet.e1x) }, e1y{ load4(packet.e1y) }, e1z{ load4(packet.e1z) };
+		const Float4 e2x{ load4(packet.e2x) }, e2y{ load4(packet.e2y) }, e2z{ load4(packet.e2z) };
+		const Float4 px{ directionY * e2z - directionZ * e2y }, py{ directionZ * e2x - directionX * e2z }, pz{ directionX * e2y - directionY * e2x };
+		const Float4 determinant{ e1x * px + e1y * py + e1z * pz };
+		const Float4 inverseDeterminant{ one / determinant };
+		const Float4 sx{ originX - load4(packet.v0x) }, sy{ originY - load4(packet.v0y) }, sz{ originZ - load4(packet.v0z) };
+		const Float4 u{ (sx * px + sy * py + sz * pz) * inverseDeterminant };
+		const Float4 qx{ sy * e1z - sz * e1y }, qy{ sz * e1x - sx * e1z }, qz{ sx * e1y - sy * e1x };
+		const Float4 v{ (directionX * qx + directionY * qy + directionZ * qz) * inverseDeterminant };
+		const Float4 t{ (e2x * qx + e2y * qy + e2z * qz) * inverseDeterminant };
+		const uint32_t mask{ maskBits((epsilon < abs4(determinant)) & (zero <= u) & (zero <= v) & (u + v <= one) & (zero < t) & (t < splat4(hit.t))) };
+		if (mask == 0) {
+			return false;
+		}
+		float distances[4];
+		store4(distances, t);
+		for (uint32_t lane = 0; lane < 4; lane++) {
+			if ((mask & (1u << lane)) != 0 && distances[lane] < hit.t) {
+				hit.t = distances[lane];
+				hit.triangle = packet.triangles[lane];
+			}
+		}
+		return true;
+	}
+};
+
+// Meshes and the instances placed in the scene. Instances keep their world to local transform, rays are moved into the
+// mesh's space instead of transforming its triangles
+class SceneBvh {
+public:
+	uint32_t addMesh(const glm::vec3* positions, const void* indexData, uint32_t indexCount, uint32_t indexSize, JobSystem* jobs = nullptr) {
+		meshes.emplace_back().build(positions, indexData, indexCount, indexSize, jobs);
+		return static_cast<uint32_t>(meshes.size()) - 1;
+	}
+
+	// Instances added after the last build only become visible with the next build
+	void setInstance(uint32_t instance, uint32_t mesh, const glm::mat4& transform) {
+		if (instance >= instances.size()) {
+			instances.resize(instance + 1);
+			instanceBounds.resize(instance + 1);
+		}
+		instances[instance].mesh = mesh;
+		moveInstance(instance, transform);
+	}
+
+	// Only the bounds of the instance's leaf and its ancestors change, applied by the next refit. Instances that aren't in
+	// the tree yet have no leaf and wait for the next build
+	void moveInstance(uint32_t instance, const glm::mat4& transform) {
+		instances[instance].worldToLocal = glm::inverse(transform);
+		instanceBounds[instance] = transformBounds(meshes[instances[instance].mesh].bounds(), transform);
+		if (instance < instanceLeaves.size()) {
+			movedInstances.push_back(instance);
+		}
+	}
+
+	void build(JobSystem* jobs = nullptr) {
+		order.resize(instances.size());
+		for (uint32_t i = 0; i < order.size(); i++) {
+			order[i] = i;
+		}
+		nodes = BvhBuilder(instanceBounds, order, 2).build(jobs);
+		instanceLeaves.assign(instances.size(), bvhInvalidIndex);
+		for (uint32_t node = 0; node < nodes.size(); node++) {
+			for (uint32_t i = 0; i < nodes[node].count; i++) {
+				instanceLeaves[order[nodes[node].first + i]] = node;
+			}
+		}
+		movedInstances.clear();
+	}
+
+	// Moved instances update their leaf, then the ancestors until the bounds stop changing. Returns the number of nodes updated
+	uint32_t refit() {
+		uint32_t updated{ 0 };
+		for (uint32_t instance : movedInstances) {
+			uint32_t node{ instanceLeaves[instance] };
+			while (node != bvhInvalidIndex) {
+				Aabb bounds;
+				if (nodes[node].count > 0) {
+					for (uint32_t i = 0; i < nodes[node].count; i++) {
+						bounds.grow(instanceBounds[order[nodes[node].first + i]]);
+					}
+				} else {
+					bounds = nodes[nodes[node].left].bounds;
+					bounds.grow(nodes[nodes[node].right].bounds);
+				}
+				if (bounds == nodes[node].bounds) {
+					break;
+				}
+				nodes[node].bounds = bounds;
+				node = nodes[node].parent;
+				updated++;
+			}
+		}
+		movedInstances.clear();
+		return updated;
+	}
+
+	// Nearest hit over all instances, call refit first if instances moved
+	RayHit intersect(const Ray& ray) const {
+		RayHit hit;
+		if (nodes.empty()) {
+			return hit;
+		}
+		const glm::vec3 inverse{ inverseDirection(ray.direction) };
+		std::vector<uint32_t> stack{ 0 };
+		while (!stack.empty()) {
+			const BvhNode& node = nodes[stack.back()];
+			stack.pop_back();
+			if (!intersectBounds(node.bounds, ray.origin, inverse, hit.t)) {
+				continue;
+			}
+			if (node.count == 0) {
+				stack.push_back(node.left);
+				stack.push_back(node.right);
+				continue;
+			}
+			for (uint32_t i = 0; i < node.count; i++) {
+				const uint32_t instance{ order[node.first + i] };
+				const glm::mat4& worldToLocal = instances[instance].worldToLocal;
+				// An affine transform keeps distances along the ray in the same units, so t can be compared across instances
+				const Ray localRay{ .origin = glm::vec3(worldToLocal * glm::vec4(ray.origin, 1.0f)), .direction = glm::vec3(worldToLocal * glm::vec4(ray.direction, 0.0f)) };
+				if (meshes[instances[instance].mesh].intersect(localRay, hit)) {
+					hit.instance = instance;
+				}
+			}
+		}
+		return hit;
+	}
+
+	uint32_t meshCount() const { return static_cast<uint32_t>(meshes.size()); }
+	uint32_t instanceCount() const { return static_cast<uint32_t>(instances.size()); }
+	const MeshBvh& mesh(uint32_t index) const { return meshes[index]; }
+
+private:
+	struct Instance {
+		glm::mat4 worldToLocal{ 1.0f };
+		uint32_t mesh{ 0 };
+	};
+	std::vector<MeshBvh> meshes;
+	std::vector<Instance> instances;
+	std::vector<Aabb> instanceBounds;
+	std::vector<BvhNode> nodes;
+	std::vector<uint32_t> order;
+	// Leaf that contains each instance, so a refit can start there
+	std::vector<uint32_t> instanceLeaves;
+	std::vector<uint32_t> movedInstances;
+
+	// Empty bounds would pass the slab test, their distances come out infinite in both directions
+	static bool intersectBounds(const Aabb& bounds, const glm::vec3& origin, const glm::vec3& inverse, float maxT) {
+		if (bounds.empty()) {
+			return false;
+		}
+		const glm::vec3 t0{ (bounds.min - origin) * inverse };
+		const glm::vec3 t1{ (bounds.max - origin) * inverse };
+		const glm::vec3 near{ glm::min(t0, t1) };
+		const glm::vec3 far{ glm::max(t0, t1) };
+		return std::max(std::max(near.x, near.y), std::max(near.z, 0.0f)) <= std::min(std::min(far.x, far.y), std::min(far.z, maxT));
+	}
+};
+
+// Sphere with a bumpy surface, roughly the requested number of triangles
+inline void generateBvhBenchMesh(uint32_t triangleCount, std::vector<glm::vec3>& positions, std::vector<uint32_t>& indices) {
+	const uint32_t rings{ std::max(4u, static_cast<uint32_t>(std::sqrt(static_cast<float>(triangleCount) / 4.0f))) };
+	const uint32_t segments{ rings * 2 };
+	for (uint32_t ring = 0; ring <= rings; ring++) {
+		const float theta{ static_cast<float>(ring) / static_cast<float>(rings) * 3.14159265f };
+		for (uint32_t segment = 0; segment <= segments; segment++) {
+			const float phi{ static_cast<float>(segment) / static_cast<float>(segments) * 6.28318531f };
+			const float radius{ 1.0f + 0.05f * std::sin(theta * 23.0f) * std::cos(phi * 17.0f) };
+			positions.push_back(glm::vec3(std::sin(theta) * std::cos(phi), std::cos(theta), std::sin(theta) * std::sin(phi)) * radius);
+		}
+	}
+	for (uint32_t ring = 0; ring < rings; ring++) {
+		for (uint32_t segment = 0; segment < segments; segment++) {
+			const uint32_t a{ ring * (segments + 1) + segment };
+			const uint32_t b{ a + segments + 1 };
+			indices.insert(indices.end(), { a, b, a + 1, a + 1, b, b + 1 });
+		}
+	}
+}
+
+// Build times for increasing thread counts and closest hit query throughput on a dense mesh, checked against brute force,
+// plus build, refit and query times of the instance BVH over a grid of instances of that mesh. Returns false if the BVH
+// doesn't find the same closest hits as brute force
+inline bool benchmarkBvh(uint32_t triangleCount, const std::string& outputPath) {
+	using Clock = std::chrono::steady_clock;
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> indices;
+	generateBvhBenchMesh(triangleCount, positions, indices);
+	const uint32_t triangles{ static_cast<uint32_t>(indices.size() / 3) };
+	std::ofstream out(outputPath);
+	out << "{\n\t\"triangles\": " << triangles << ",\n\t\"build\": [\n";
+	std::cout << "BVH benchmark, " << triangles << " triangles\n";
+	MeshBvh bvh;
+	const uint32_t maxThreads{ std::max(1u, std::thread::hardware_concurrency()) };
+	for (uint32_t threads = 1; threads <= maxThreads; threads = (threads == maxThreads) ? threads + 1 : std::min(threads * 2, maxThreads)) {
+		JobSystem jobs;
+		jobs.start(threads);
+		const auto start = Clock::now();
+		bvh.build(positions.data(), indices.data(), static_cast<uint32_t>(indices.size()), sizeof(uint32_t), &jobs);
+		const double ms{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+		std::cout << "  build, " << threads << " thread(s): " << ms << " ms\n";
+		out << "\t\t{ \"threads\": " << threads << ", \"ms\": " << ms << " }" << (threads == maxThreads ? "\n" : ",\n");
+	}
+	out << "\t],\n\t\"nodes\": " << bvh.nodeCount() << ",\n\t\"packets\": " << bvh.packetCount() << ",\n\t\"memoryBytes\": " << bvh.memoryBytes() << ",\n";
+	// Rays from a sphere around the mesh towards random points near its center, about half of them hit
+	constexpr uint32_t rayCount{ 200000 };
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> distribution{ -1.0f, 1.0f };
+	std::vector<Ray> rays(rayCount);
+	for (auto& ray : rays) {
+		glm::vec3 from{ distribution(random), distribution(random), distribution(random) };
+		from = glm::normalize(from + glm::vec3(1e-3f)) * 3.0f;
+		const glm::vec3 to{ distribution(random) * 1.5f, distribution(random) * 1.5f, distribution(random) * 1.5f };
+		ray = { .origin = from, .direction = glm::normalize(to - from) };
+	}
+	auto start = Clock::now();
+	uint32_t hits{ 0 };
+	for (const auto& ray : rays) {
+		RayHit hit;
+		hits += bvh.intersect(ray, hit) ? 1 : 0;
+	}
+	const double queryMs{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+	const double raysPerSecond{ rayCount / (queryMs / 1000.0) };
+	// Brute force reference for a few rays
+	constexpr uint32_t checkedRays{ 32 };
+	uint32_t mismatches{ 0 };
+	for (uint32_t i = 0; i < checkedRays; i++) {
+		RayHit hit;
+		bvh.intersect(rays[i], hit);
+		float closest{ std::numeric_limits<float>::max() };
+		for (uint32_t triangle = 0; triangle < triangles; triangle++) {
+			const glm::vec3 v0{ positions[indices[triangle * 3]] };
+			const glm::vec3 e1{ positions[indices[triangle * 3 + 1]] - v0 };
+			const glm::vec3 e2{ positions[indices[triangle * 3 + 2]] - v0 };
+			const glm::vec3 p{ glm::cross(rays[i].direction, e2) };
+			const float determinant{ glm::dot(e1, p) };
+			if (std::abs(determinant) < 1e-12f) {
+				continue;
+			}
+			const glm::vec3 s{ rays[i].origin - v0 };
+			const float u{ glm::dot(s, p) / determinant };
+			const glm::vec3 q{ glm::cross(s, e1) };
+			const float v{ glm::dot(rays[i].direction, q) / determinant };
+			const float t{ glm::dot(e2, q) / determinant };
+			if (u >= 0.0f && v >= 0.0f && u + v <= 1.0f && t > 0.0f) {
+				closest = std::min(closest, t);
+			}
+		}
+		if (hit.hit() != (closest < std::numeric_limits<float>::max()) || (hit.hit() && std::abs(hit.t - closest) > 1e-4f)) {
+			mismatches++;
+		}
+	}
+	if (mismatches > 0) {
+		std::cerr << "BVH result does not match brute force for " << mismatches << " of " << checkedRays << " rays\n";
+	}
+	std::cout << "  queries: " << raysPerSecond / 1e6 << " million rays/s, " << hits << " of " << rayCount << " hit\n";
+	out << "\t\"rays\": " << rayCount << ",\n\t\"hits\": " << hits << ",\n\t\"queryMs\": " << queryMs << ",\n\t\"raysPerSecond\": " << raysPerSecond << ",\n\t\"bruteForceMismatches\": " << mismatches << ",\n";
+	// Instances of the mesh on a grid, one percent of them move before every refit
+	constexpr uint32_t gridSize{ 100 };
+	SceneBvh scene;
+	scene.addMesh(positions.data(), indices.data(), static_cast<uint32_t>(indices.size()), sizeof(uint32_t));
+	const auto instanceTransform = [&](uint32_t instance, float angle) {
+		const glm::vec3 position{ (static_cast<float>(instance % gridSize) - gridSize * 0.5f) * 3.0f, (static_cast<float>(instance / gridSize) - gridSize * 0.5f) * 3.0f, 0.0f };
+		return glm::rotate(glm::translate(glm::mat4(1.0f), position), angle, glm::vec3(0.0f, 1.0f, 0.0f));
+	};
+	for (uint32_t i = 0; i < gridSize * gridSize; i++) {
+		scene.setInstance(i, 0, instanceTransform(i, 0.0f));
+	}
+	JobSystem jobs;
+	jobs.start();
+	start = Clock::now();
+	scene.build(&jobs);
+	const double instanceBuildMs{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+	start = Clock::now();
+	for (uint32_t i = 0; i < gridSize * gridSize; i += 100) {
+		scene.moveInstance(i, instanceTransform(i, 1.0f));
+	}
+	const uint32_t refitNodes{ scene.refit() };
+	const double refitMs{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+	// Picking rays straight into the grid
+	constexpr uint32_t pickRays{ 20000 };
+	uint32_t pickHits{ 0 };
+	start = Clock::now();
+	for (uint32_t i = 0; i < pickRays; i++) {
+		const Ray ray{ .origin = glm::vec3(distribution(random) * gridSize * 1.5f, distribution(random) * gridSize * 1.5f, -10.0f), .direction = glm::vec3(0.0f, 0.0f, 1.0f) };
+		pickHits += scene.intersect(ray).hit() ? 1 : 0;
+	}
+	const double pickMs{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+	std::cout << "  " << gridSize * gridSize << " instances: build " << instanceBuildMs << " ms, refit " << refitMs << " ms, " << pickRays / (pickMs / 1000.0) / 1e6 << " million picks/s\n";
+	out << "\t\"instances\": { \"count\": " << gridSize * gridSize << ", \"buildMs\": " << instanceBuildMs << ", \"refitMs\": " << refitMs << ", \"refitNodes\": " << refitNodes
+		<< ", \"pickRays\": " << pickRays << ", \"pickHits\": " << pickHits << ", \"pickMs\": " << pickMs << " }\n}\n";
+	return mismatches == 0;
+}
@@ -0,0 +1,40 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+#pragma once
+
+#include <vulkan/vulkan.h>
+#include <iostream>
+#include <cstdlib>
+#include <cstdint>
+#include <cstring>
+
+static inline void chk(VkResult result) {
+	if (result != VK_SUCCESS) {
+		std::cerr << "Vulkan call returned an error (" << result << ")\n";
+		exit(result);
+	}
+}
+static inline void chk(bool result) {
+	if (!result) {
+		std::cerr << "Call returned an error\n";
+		exit(result);
+	}
+}
+
+// 64 bit FNV-1a variant that consumes eight bytes per step, fast enough to hash source files on every start
+inline uint64_t hashBytes(const uint8_t* data, size_t size) {
+	uint64_t hash{ 14695981039346656037ull };
+	size_t i{ 0 };
+	for (; i + 8 <= size; i += 8) {
+		uint64_t word;
+		memcpy(&word, data + i, sizeof(word));
+		hash = (hash ^ word) * 1099511628211ull;
+		hash ^= hash >> 29;
+	}
+	for (; i < size; i++) {
+		hash = (hash ^ data[i]) * 1099511628211ull;
+	}
+	return hash;
+}
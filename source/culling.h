@@ -0,0 +1,463 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// GPU driven culling: A compute pass tests the bounding sphere of every instance against the view frustum and a
+// hierarchical depth buffer built from the previous frame, compacts the survivors into a per mesh list of visible
+// instances and writes the indirect draws and their count. The CPU only reads back statistics.
+// For the mesh shader path it also writes one task shader dispatch per mesh, which culls the meshlets of each instance.
+// Every instance also picks the LOD of its mesh from the projected size of the simplification error.
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <initializer_list>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+#include <glm/glm.hpp>
+#include "common.h"
+#include "framearena.h"
+#include "deletionqueue.h"
+
+constexpr uint32_t cullFlagFrustum{ 1 };
+constexpr uint32_t cullFlagOcclusion{ 2 };
+constexpr uint32_t maxDepthPyramidLevels{ 16 };
+// A LOD is used once its simplification error covers at most this many pixels
+constexpr float lodErrorPixels{ 1.0f };
+// Switching to a coarser LOD needs the error to be this fraction below the threshold, so instances near it don't flicker between LODs
+constexpr float lodHysteresis{ 0.25f };
+
+// Gribb/Hartmann plane extraction for a 0..1 depth range, planes point inwards and are normalized
+inline std::array<glm::vec4, 6> frustumPlanes(const glm::mat4& viewProjection) {
+	const glm::vec4 rows[4]{
+		{ viewProjection[0][0], viewProjection[1][0], viewProjection[2][0], viewProjection[3][0] },
+		{ viewProjection[0][1], viewProjection[1][1], viewProjection[2][1], viewProjection[3][1] },
+		{ viewProjection[0][2], viewProjection[1][2], viewProjection[2][2], viewProjection[3][2] },
+		{ viewProjection[0][3], viewProjection[1][3], viewProjection[2][3], viewProjection[3][3] }
+	};
+	std::array<glm::vec4, 6> planes{ rows[3] + rows[0], rows[3] - rows[0], rows[3] + rows[1], rows[3] - rows[1], rows[2], rows[3] - rows[2] };
+	for (auto& plane : planes) {
+		plane /= glm::length(glm::vec3(plane));
+	}
+	return planes;
+}
+
+// One LOD of an indexed mesh, its visible instances get consecutive slots starting at instanceOffset in the visible instance list,
+// which must be the number of instances that use the entries before it. The LODs of a mesh are consecutive entries
+// and instances refer to the first one, so every LOD has room for all instances of the mesh
+struct MeshDraw {
+	uint32_t indexCount{ 0 };
+	uint32_t firstIndex{ 0 };
+	int32_t vertexOffset{ 0 };
+	uint32_t instanceOffset{ 0 };
+	// Range in the meshlet buffer, only used by the mesh shader path
+	uint32_t meshletOffset{ 0 };
+	uint32_t meshletCount{ 0 };
+	// Simplification error in model space, grows along the LOD chain
+	float lodError{ 0.0f };
+	// Number of LODs of the mesh
+	uint32_t lodCount{ 1 };
+	// Bounding sphere in model space, xyz = center, w = radius
+	glm::vec4 bounds{ 0.0f };
+	// Dequantization of packed vertex positions, the shaders calculate normalized position * scale + offset (1 and 0 for float vertices)
+	glm::vec4 positionScale{ 1.0f, 1.0f, 1.0f, 0.0f };
+	glm::vec3 positionOffset{ 0.0f };
+	// VertexFormat of the mesh's vertices
+	uint32_t vertexFormat{ 0 };
+	// Material color, same for all LODs
+	glm::vec4 diffuse{ 1.0f };
+};
+static_assert(sizeof(MeshDraw) == 96);
+
+// VkDrawMeshTasksIndirectCommandEXT followed by the number of visible instances, which the task shader reads back
+struct MeshTaskDraw {
+	uint32_t groupCountX{ 0 };
+	uint32_t groupCountY{ 0 };
+	uint32_t groupCountZ{ 0 };
+	uint32_t instanceCount{ 0 };
+};
+
+// Written by the cull pass, drawCount doubles as the count buffer for the indirect draw
+struct CullCounters {
+	uint32_t drawCount{ 0 };
+	uint32_t tested{ 0 };
+	uint32_t frustumCulled{ 0 };
+	uint32_t occlusionCulled{ 0 };
+	uint32_t visible{ 0 };
+	// Triangles of the visible instances at their LOD, before any meshlet culling
+	uint32_t triangles{ 0 };
+	uint32_t padding[2]{};
+};
+static_assert(sizeof(CullCounters) == 32);
+
+class GpuCulling {
+public:
+	void create(VkDevice device, VmaAllocator allocator, VkPipelineCache pipelineCache, VkShaderModule shaderModule, const std::vector<MeshDraw>& meshes, VkDeviceAddress instances, uint32_t instanceCount, uint32_t framesInFlight, uint32_t flags = cullFlagFrustum | cullFlagOcclusion, bool meshShading = false) {
+		this->device = device;
+		this->allocator = allocator;
+		this->instances = instances;
+		this->instanceCount = instanceCount;
+		this->flags = flags;
+		// Stages that consume the cull pass output, the mesh shader stages may only be used if the feature is enabled
+		drawStages = VK_PIPELINE_STAGE_2_DRAW_INDIRECT_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+		if (meshShading) {
+			drawStages |= VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT;
+		}
+		meshCount = static_cast<uint32_t>(meshes.size());
+		uint32_t maxLods{ 1 };
+		for (auto& mesh : meshes) {
+			maxLods = std::max(maxLods, mesh.lodCount);
+		}
+		// GPU side buffers, shared by all frames in flight as the queue executes the passes in order
+		meshBuffer = createBuffer(meshes.size() * sizeof(MeshDraw), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, true);
+		memcpy(meshBuffer.mapped, meshes.data(), meshes.size() * sizeof(MeshDraw));
+		// Every instance uses exactly one mesh, so the slot ranges of all LODs add up to at most the instance count times the longest chain
+		visibleBuffer = createBuffer(instanceCount * maxLods * sizeof(uint32_t), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, false);
+		// LOD of every instance in the previous frame for the hysteresis, starts out undefined which the selection clamps into range
+		lodBuffer = createBuffer(instanceCount * sizeof(uint32_t), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT, false);
+		counterBuffer = createBuffer(sizeof(CullCounters) + meshes.size() * sizeof(uint32_t), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_SRC_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT, false);
+		drawBuffer = createBuffer(meshes.size() * sizeof(VkDrawIndexedIndirectCommand), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, false);
+		meshTaskBuffer = createBuffer(meshes.size() * sizeof(MeshTaskDraw), VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_INDIRECT_BUFFER_BIT, false);
+		frames.resize(framesInFlight);
+		for (auto& frame : frames) {
+			frame.readback = createBuffer(sizeof(CullCounters), VK_BUFFER_USAGE_TRANSFER_DST_BIT, true, true);
+		}
+		// Binding 1 is the whole depth pyramid for the occlusion test, 2 and 3 are the source and destination of one reduction step
+		std::array<VkDescriptorSetLayoutBinding, 3> bindings{
+			VkDescriptorSetLayoutBinding{ .binding = 1, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 2, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT },
+			VkDescriptorSetLayoutBinding{ .binding = 3, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = 1, .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT }
+		};
+		VkDescriptorSetLayoutCreateInfo setLayoutCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, .bindingCount = static_cast<uint32_t>(bindings.size()), .pBindings = bindings.data() };
+		chk(vkCreateDescriptorSetLayout(device, &setLayoutCI, nullptr, &setLayout));
+		VkPushConstantRange pushConstantRange{ .stageFlags = VK_SHADER_STAGE_COMPUTE_BIT, .size = sizeof(VkDeviceAddress) };
+		VkPipelineLayoutCreateInfo pipelineLayoutCI{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, .setLayoutCount = 1, .pSetLayouts = &setLayout, .pushConstantRangeCount = 1, .pPushConstantRanges = &pushConstantRange };
+		chk(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
+		const std::array<const char*, 3> entryPoints{ "cullInstances", "buildDraws", "reduceDepth" };
+		std::array<VkComputePipelineCreateInfo, 3> pipelineCIs{};
+		for (size_t i = 0; i < entryPoints.size(); i++) {
+			pipelineCIs[i] = {
+				.sType = VK_STRUCTURE_TYPE_COMPUTE_PIPELINE_CREATE_INFO,
+				.stage{.sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_COMPUTE_BIT, .module = shaderModule, .pName = entryPoints[i] },
+				.layout = pipelineLayout
+			};
+		}
+		std::array<VkPipeline, 3> pipelines{};
+		chk(vkCreateComputePipelines(device, pipelineCache, static_cast<uint32_t>(pipelineCIs.size()), pipelineCIs.data(), nullptr, pipelines.data()));
+		cullPipeline = pipelines[0];
+		drawPipeline = pipelines[1];
+		reducePipeline = pipelines[2];
+	}
+
+	void destroy() {
+		destroyPyramid();
+		vkDestroyPipeline(device, cullPipeline, nullptr);
+		vkDestroyPipeline(device, drawPipeline, nullptr);
+		vkDestroyPipeline(device, reducePipeline, nullptr);
+		vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
+		vkDestroyDescriptorSetLayout(device, setLayout, nullptr);
+		for (auto& frame : frames) {
+			vmaDestroyBuffer(allocator, frame.readback.buffer, frame.readback.allocation);
+		}
+		for (auto* buffer : { &meshBuffer, &visibleBuffer, &lodBuffer, &counterBuffer, &drawBuffer, &meshTaskBuffer }) {
+			vmaDestroyBuffer(allocator, buffer->buffer, buffer->allocation);
+		}
+	}
+
+	// (Re)creates the depth pyramid for a new depth buffer, the pyramid's first level has half the resolution of the depth buffer
+	// Frames in flight may still use the old pyramid, so it's retired into the deletion queue. Occlusion culling is skipped
+	// until the pyramid has been built from the new depth buffer
+	void resize(VkImageView depthView, VkExtent2D extent, DeletionQueue& deletions, uint32_t frameIndex) {
+		if (pyramid != VK_NULL_HANDLE) {
+			deletions.push(frameIndex, [device = device, allocator = allocator, pool = descriptorPool, levelViews = pyramidLevelViews, view = pyramidView, image = pyramid, allocation = pyramidAllocation]() {
+				vkDestroyDescriptorPool(device, pool, nullptr);
+				for (auto levelView : levelViews) {
+					vkDestroyImageView(device, levelView, nullptr);
+				}
+				vkDestroyImageView(device, view, nullptr);
+				vmaDestroyImage(allocator, image, allocation);
+			});
+			pyramidLevelViews.clear();
+			pyramid = VK_NULL_HANDLE;
+		}
+		viewportHeight = static_cast<float>(extent.height);
+		pyramidExtent = { .width = std::max(1u, extent.width / 2), .height = std::max(1u, extent.height / 2) };
+		pyramidLevels = 1;
+		while (pyramidLevels < maxDepthPyramidLevels && std::max(pyramidExtent.width, pyramidExtent.height) >> pyramidLevels > 0) {
+			pyramidLevels++;
+		}
+		VkImageCreateInfo imageCI{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = VK_FORMAT_R32_SFLOAT,
+			.extent{.width = pyramidExtent.width, .height = pyramidExtent.height, .depth = 1 },
+			.mipLevels = pyramidLevels,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_SAMPLED_BIT | VK_IMAGE_USAGE_STORAGE_BIT,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+		VmaAllocationCreateInfo allocCI{ .usage = VMA_MEMORY_USAGE_AUTO };
+		chk(vmaCreateImage(allocator, &imageCI, &allocCI, &pyramid, &pyramidAllocation, nullptr));
+		VkImageViewCreateInfo viewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = pyramid, .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = imageCI.format, .subresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = pyramidLevels, .layerCount = 1 } };
+		chk(vkCreateImageView(device, &viewCI, nullptr, &pyramidView));
+		pyramidLevelViews.resize(pyramidLevels);
+		for (uint32_t level = 0; level < pyramidLevels; level++) {
+			viewCI.subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = level, .levelCount = 1, .layerCount = 1 };
+			chk(vkCreateImageView(device, &viewCI, nullptr, &pyramidLevelViews[level]));
+		}
+		// One set per reduction step, all of them also contain the full pyramid so the cull pass can use the first
+		std::array<VkDescriptorPoolSize, 2> poolSizes{
+			VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .descriptorCount = pyramidLevels * 2 },
+			VkDescriptorPoolSize{ .type = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .descriptorCount = pyramidLevels }
+		};
+		VkDescriptorPoolCreateInfo poolCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, .maxSets = pyramidLevels, .poolSizeCount = static_cast<uint32_t>(poolSizes.size()), .pPoolSizes = poolSizes.data() };
+		chk(vkCreateDescriptorPool(device, &poolCI, nullptr, &descriptorPool));
+		std::vector<VkDescriptorSetLayout> setLayouts(pyramidLevels, setLayout);
+		VkDescriptorSetAllocateInfo setAI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, .descriptorPool = descriptorPool, .descriptorSetCount = pyramidLevels, .pSetLayouts = setLayouts.data() };
+		descriptorSets.resize(pyramidLevels);
+		chk(vkAllocateDescriptorSets(device, &setAI, descriptorSets.data()));
+		for (uint32_t level = 0; level < pyramidLevels; level++) {
+			const VkDescriptorImageInfo pyramidInfo{ .imageView = pyramidView, .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+			const VkDescriptorImageInfo sourceInfo{ .imageView = level == 0 ? depthView : pyramidLevelViews[level - 1], .imageLayout = level == 0 ? VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL : VK_IMAGE_LAYOUT_GENERAL };
+			const VkDescriptorImageInfo targetInfo{ .imageView = pyramidLevelViews[level], .imageLayout = VK_IMAGE_LAYOUT_GENERAL };
+			std::array<VkWriteDescriptorSet, 3> writes{
+				VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSets[level], .dstBinding = 1, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .pImageInfo = &pyramidInfo },
+				VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSets[level], .dstBinding = 2, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE, .pImageInfo = &sourceInfo },
+				VkWriteDescriptorSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSets[level], .dstBinding = 3, .descriptorCount = 1, .descriptorType = VK_DESCRIPTOR_TYPE_STORAGE_IMAGE, .pImageInfo = &targetInfo }
+			};
+			vkUpdateDescriptorSets(device, static_cast<uint32_t>(writes.size()), writes.data(), 0, nullptr);
+		}
+		pyramidValid = false;
+	}
+
+	// Records the cull pass, must be outside of a render pass and after the instance data for this frame has been updated
+	void cull(VkCommandBuffer cb, uint32_t frameIndex, FrameArena& arena, const glm::mat4& projection, const glm::mat4& view) {
+		const glm::mat4 viewProjection{ projection * view };
+		CullData cullData{
+			.prevViewProjection = prevViewProjection,
+			.cameraPos = glm::inverse(view)[3],
+			.instances = instances,
+			.meshes = meshBuffer.address,
+			.counters = counterBuffer.address,
+			.meshCounts = counterBuffer.address + sizeof(CullCounters),
+			.visibleInstances = visibleBuffer.address,
+			.draws = drawBuffer.address,
+			.meshTasks = meshTaskBuffer.address,
+			.instanceLods = lodBuffer.address,
+			.instanceCount = instanceCount,
+			.meshCount = meshCount,
+			.flags = flags & (pyramidValid ? (cullFlagFrustum | cullFlagOcclusion) : cullFlagFrustum),
+			.hizLevels = pyramidLevels,
+			.hizSize = glm::vec2(pyramidExtent.width, pyramidExtent.height),
+			// Pixels covered by one unit at a distance of one unit
+			.lodScale = projection[1][1] * viewportHeight * 0.5f,
+			.lodErrorPixels = lodErrorPixels,
+			.lodHysteresis = lodHysteresis
+		};
+		const std::array<glm::vec4, 6> planes{ frustumPlanes(viewProjection) };
+		std::copy(planes.begin(), planes.end(), cullData.frustumPlanes);
+		prevViewProjection = viewProjection;
+		const ArenaAllocation cullDataAlloc{ arena.push(cullData) };
+		chk(static_cast<bool>(cullDataAlloc));
+		// Previous frames may still draw from the lists that are about to be rewritten
+		VkMemoryBarrier2 barrier{
+			.sType = VK_STRUCTURE_TYPE_MEMORY_BARRIER_2,
+			.srcStageMask = drawStages | VK_PIPELINE_STAGE_2_COPY_BIT,
+			.srcAccessMask = VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_CLEAR_BIT | VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT
+		};
+		VkDependencyInfo dependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .memoryBarrierCount = 1, .pMemoryBarriers = &barrier };
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+		vkCmdFillBuffer(cb, counterBuffer.buffer, 0, VK_WHOLE_SIZE, 0);
+		setBarrier(barrier, VK_PIPELINE_STAGE_2_CLEAR_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, cullPipeline);
+		vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[0], 0, nullptr);
+		vkCmdPushConstants(cb, pipelineLayout, VK_SHADER_STAGE_COMPUTE_BIT, 0, sizeof(VkDeviceAddress), &cullDataAlloc.address);
+		vkCmdDispatch(cb, (instanceCount + 63) / 64, 1, 1);
+		setBarrier(barrier, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT);
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, drawPipeline);
+		vkCmdDispatch(cb, (meshCount + 63) / 64, 1, 1);
+		setBarrier(barrier, VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, drawStages | VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_INDIRECT_COMMAND_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_READ_BIT | VK_ACCESS_2_TRANSFER_READ_BIT);
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+		// Statistics are read on the CPU once the frame timeline reached the frame's value
+		VkBufferCopy copy{ .size = sizeof(CullCounters) };
+		vkCmdCopyBuffer(cb, counterBuffer.buffer, frames[frameIndex].readback.buffer, 1, &copy);
+		setBarrier(barrier, VK_PIPELINE_STAGE_2_COPY_BIT, VK_ACCESS_2_TRANSFER_WRITE_BIT, VK_PIPELINE_STAGE_2_HOST_BIT, VK_ACCESS_2_HOST_READ_BIT);
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+	}
+
+	// Draws the visible instances, vertex and index buffers must be bound and the vertex shader fetch instance indices from visibleAddress()
+	void draw(VkCommandBuffer cb) const {
+		vkCmdDrawIndexedIndirectCount(cb, drawBuffer.buffer, 0, counterBuffer.buffer, 0, meshCount, sizeof(VkDrawIndexedIndirectCommand));
+	}
+
+	// Launches the task shaders for the visible instances of every mesh, the mesh index is pushed right after the shader data address
+	// Meshes without visible instances have a dispatch of zero groups, which is a no-op
+	void drawMeshTasks(VkCommandBuffer cb, VkPipelineLayout layout) const {
+		for (uint32_t meshIndex = 0; meshIndex < meshCount; meshIndex++) {
+			vkCmdPushConstants(cb, layout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, sizeof(VkDeviceAddress), sizeof(uint32_t), &meshIndex);
+			vkCmdDrawMeshTasksIndirectEXT(cb, meshTaskBuffer.buffer, meshIndex * sizeof(MeshTaskDraw), 1, sizeof(MeshTaskDraw));
+		}
+	}
+
+	// Reduces this frame's depth buffer into the pyramid used for the next frame's occlusion test, records after rendering
+	// The depth image must be readable from compute and the pyramid writable in the general layout, see the render graph
+	void buildDepthPyramid(VkCommandBuffer cb) {
+		if (!(flags & cullFlagOcclusion)) {
+			return;
+		}
+		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_COMPUTE, reducePipeline);
+		// Each level only depends on the one before, so the barriers are limited to the level that was just written
+		VkImageMemoryBarrier2 levelBarrier{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+			.srcStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT,
+			.dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.newLayout = VK_IMAGE_LAYOUT_GENERAL,
+			.image = pyramid
+		};
+		VkDependencyInfo dependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &levelBarrier };
+		for (uint32_t level = 0; level < pyramidLevels; level++) {
+			const uint32_t width{ std::max(1u, pyramidExtent.width >> level) };
+			const uint32_t height{ std::max(1u, pyramidExtent.height >> level) };
+			vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_COMPUTE, pipelineLayout, 0, 1, &descriptorSets[level], 0, nullptr);
+			vkCmdDispatch(cb, (width + 7) / 8, (height + 7) / 8, 1);
+			levelBarrier.subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = level, .levelCount = 1, .layerCount = 1 };
+			vkCmdPipelineBarrier2(cb, &dependencyInfo);
+		}
+		pyramidValid = true;
+	}
+
+	// Counters of the frame that last used this frame index, only valid after the frame timeline has been waited on for its value
+	CullCounters stats(uint32_t frameIndex) const {
+		CullCounters counters{};
+		chk(vmaInvalidateAllocation(allocator, frames[frameIndex].readback.allocation, 0, VK_WHOLE_SIZE));
+		memcpy(&counters, frames[frameIndex].readback.mapped, sizeof(CullCounters));
+		return counters;
+	}
+
+	// Indices of the visible instances, grouped by mesh and LOD
+	VkDeviceAddress visibleAddress() const { return visibleBuffer.address; }
+	VkDeviceAddress meshesAddress() const { return meshBuffer.address; }
+	VkDeviceAddress meshTasksAddress() const { return meshTaskBuffer.address; }
+	uint32_t cullFlags() const { return flags; }
+	// The pyramid persists between frames, it only holds usable data once it has been built for the current depth buffer
+	VkImage pyramidImage() const { return pyramid; }
+	uint32_t pyramidLevelCount() const { return pyramidLevels; }
+	bool pyramidReady() const { return pyramidValid; }
+
+private:
+	// Matches CullData in the shader
+	struct CullData {
+		glm::vec4 frustumPlanes[6];
+		glm::mat4 prevViewProjection;
+		glm::vec4 cameraPos{ 0.0f };
+		VkDeviceAddress instances{ 0 };
+		VkDeviceAddress meshes{ 0 };
+		VkDeviceAddress counters{ 0 };
+		VkDeviceAddress meshCounts{ 0 };
+		VkDeviceAddress visibleInstances{ 0 };
+		VkDeviceAddress draws{ 0 };
+		VkDeviceAddress meshTasks{ 0 };
+		VkDeviceAddress instanceLods{ 0 };
+		uint32_t instanceCount{ 0 };
+		uint32_t meshCount{ 0 };
+		uint32_t flags{ 0 };
+		uint32_t hizLevels{ 0 };
+		glm::vec2 hizSize{ 0.0f };
+		float lodScale{ 0.0f };
+		float lodErrorPixels{ 0.0f };
+		float lodHysteresis{ 0.0f };
+	};
+	struct Buffer {
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		VmaAllocation allocation{ VK_NULL_HANDLE };
+		VkDeviceAddress address{ 0 };
+		void* mapped{ nullptr };
+	};
+	struct Frame {
+		Buffer readback;
+	};
+
+	VkDevice device{ VK_NULL_HANDLE };
+	VmaAllocator allocator{ VK_NULL_HANDLE };
+	VkDescriptorSetLayout setLayout{ VK_NULL_HANDLE };
+	VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
+	VkPipeline cullPipeline{ VK_NULL_HANDLE };
+	VkPipeline drawPipeline{ VK_NULL_HANDLE };
+	VkPipeline reducePipeline{ VK_NULL_HANDLE };
+	VkDeviceAddress instances{ 0 };
+	uint32_t instanceCount{ 0 };
+	uint32_t meshCount{ 0 };
+	uint32_t flags{ 0 };
+	VkPipelineStageFlags2 drawStages{ 0 };
+	Buffer meshBuffer;
+	Buffer visibleBuffer;
+	Buffer lodBuffer;
+	Buffer counterBuffer;
+	Buffer drawBuffer;
+	Buffer meshTaskBuffer;
+	std::vector<Frame> frames;
+	glm::mat4 prevViewProjection{ 1.0f };
+	// Max depth pyramid of the previous frame
+	VkImage pyramid{ VK_NULL_HANDLE };
+	VmaAllocation pyramidAllocation{ VK_NULL_HANDLE };
+	VkImageView pyramidView{ VK_NULL_HANDLE };
+	std::vector<VkImageView> pyramidLevelViews;
+	VkExtent2D pyramidExtent{};
+	uint32_t pyramidLevels{ 0 };
+	bool pyramidValid{ false };
+	float viewportHeight{ 1.0f };
+	VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
+	std::vector<VkDescriptorSet> descriptorSets;
+
+	Buffer createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, bool hostVisible, bool hostRead = false) {
+		Buffer result{};
+		VkBufferCreateInfo bufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = size, .usage = usage };
+		VmaAllocationCreateInfo allocCI{ .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE };
+		if (hostVisible) {
+			allocCI.flags = (hostRead ? VMA_ALLOCATION_CREATE_HOST_ACCESS_RANDOM_BIT : VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT) | VMA_ALLOCATION_CREATE_MAPPED_BIT;
+			allocCI.usage = VMA_MEMORY_USAGE_AUTO;
+		}
+		VmaAllocationInfo allocInfo{};
+		chk(vmaCreateBuffer(allocator, &bufferCI, &allocCI, &result.buffer, &result.allocation, &allocInfo));
+		result.mapped = allocInfo.pMappedData;
+		if (usage & VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT) {
+			VkBufferDeviceAddressInfo bdaInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = result.buffer };
+			result.address = vkGetBufferDeviceAddress(device, &bdaInfo);
+		}
+		return result;
+	}
+
+	void destroyPyramid() {
+		if (pyramid == VK_NULL_HANDLE) {
+			return;
+		}
+		vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+		for (auto view : pyramidLevelViews) {
+			vkDestroyImageView(device, view, nullptr);
+		}
+		pyramidLevelViews.clear();
+		vkDestroyImageView(device, pyramidView, nullptr);
+		vmaDestroyImage(allocator, pyramid, pyramidAllocation);
+		pyramid = VK_NULL_HANDLE;
+	}
+
+	static void setBarrier(VkMemoryBarrier2& barrier, VkPipelineStageFlags2 srcStage, VkAccessFlags2 srcAccess, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+		barrier.srcStageMask = srcStage;
+		barrier.srcAccessMask = srcAccess;
+		barrier.dstStageMask = dstStage;
+		barrier.dstAccessMask = dstAccess;
+	}
+};
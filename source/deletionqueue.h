@@ -0,0 +1,52 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Deferred destruction: Objects that frames still in flight may use are retired into the current frame's list instead of
+// being destroyed after a device wait. The list runs when the frame index comes around again and the frame timeline has
+// been waited on for its value, as that value is only reached once all earlier submissions have completed too, nothing can
+// reference them anymore at that point.
+
+#pragma once
+
+#include <vector>
+#include <functional>
+#include <cstdint>
+
+class DeletionQueue {
+public:
+	void create(uint32_t framesInFlight) {
+		frames.resize(framesInFlight);
+	}
+
+	// Work recorded for the current frame must not use the object anymore
+	void push(uint32_t frameIndex, std::function<void()>&& destroy) {
+		frames[frameIndex].push_back(std::move(destroy));
+	}
+
+	// Call after the frame timeline has been waited on for the frame's value
+	void flush(uint32_t frameIndex) {
+		for (auto& destroy : frames[frameIndex]) {
+			destroy();
+		}
+		frames[frameIndex].clear();
+	}
+
+	// The device must be idle
+	void flushAll() {
+		for (uint32_t i = 0; i < frames.size(); i++) {
+			flush(i);
+		}
+	}
+
+	size_t pending() const {
+		size_t count{ 0 };
+		for (auto& frame : frames) {
+			count += frame.size();
+		}
+		return count;
+	}
+
+private:
+	std::vector<std::vector<std::function<void()>>> frames;
+};
@@ -0,0 +1,116 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Linear allocator for data that only lives for one frame: A single persistently mapped buffer with a device address
+// is split into one region per frame in flight. Allocations bump an offset in the current frame's region and the
+// whole region is released at once when the frame begins again, after the frame timeline reached its value.
+
+#pragma once
+
+#include <vector>
+#include <atomic>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+#include "common.h"
+
+struct ArenaAllocation {
+	void* data{ nullptr };
+	VkDeviceAddress address{ 0 };
+	explicit operator bool() const { return data != nullptr; }
+};
+
+class FrameArena {
+public:
+	void create(VmaAllocator allocator, VkDevice device, VkDeviceSize regionSize, uint32_t framesInFlight) {
+		this->allocator = allocator;
+		this->regionSize = (regionSize + regionAlignment - 1) & ~(regionAlignment - 1);
+		// Regions hold atomics, which can't be moved, so the vector is built at its final size
+		regions = std::vector<Region>(framesInFlight);
+		VkBufferCreateInfo bufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = this->regionSize * framesInFlight, .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT };
+		// Prefers device local memory the CPU can write to directly (resizable BAR), falls back to host memory
+		VmaAllocationCreateInfo allocCI{ .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE };
+		VmaAllocationInfo allocInfo{};
+		chk(vmaCreateBuffer(allocator, &bufferCI, &allocCI, &buffer, &allocation, &allocInfo));
+		mapped = static_cast<uint8_t*>(allocInfo.pMappedData);
+		VkBufferDeviceAddressInfo bdaInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer };
+		deviceAddress = vkGetBufferDeviceAddress(device, &bdaInfo);
+	}
+
+	void destroy() {
+		vmaDestroyBuffer(allocator, buffer, allocation);
+	}
+
+	// Releases everything allocated the last time this frame index was used, the frame timeline must have been waited on for its value
+	void begin(uint32_t frameIndex) {
+		current = frameIndex;
+		regions[current].head.store(0, std::memory_order_relaxed);
+		regions[current].overflowed = false;
+	}
+
+	// Thread safe, returns an empty allocation if the frame's region is exhausted
+	ArenaAllocation allocate(VkDeviceSize size, VkDeviceSize alignment = 16) {
+		Region& region = regions[current];
+		VkDeviceSize head{ region.head.load(std::memory_order_relaxed) };
+		VkDeviceSize offset{ 0 };
+		do {
+			offset = (head + alignment - 1) & ~(alignment - 1);
+			if (offset + size > regionSize) {
+				if (!region.overflowed.exchange(true)) {
+					overflowCount.fetch_add(1, std::memory_order_relaxed);
+					std::cerr << "Frame arena overflow: " << size << " bytes requested, " << regionSize - head << " of " << regionSize << " left\n";
+				}
+				return {};
+			}
+		} while (!region.head.compare_exchange_weak(head, offset + size, std::memory_order_relaxed));
+		const VkDeviceSize bufferOffset{ current * regionSize + offset };
+		return { .data = mapped + bufferOffset, .address = deviceAddress + bufferOffset };
+	}
+
+	template<typename T>
+	ArenaAllocation push(const T& value, VkDeviceSize alignment = 16) {
+		ArenaAllocation result{ allocate(sizeof(T), alignment) };
+		if (result) {
+			memcpy(result.data, &value, sizeof(T));
+		}
+		return result;
+	}
+
+	// Makes this frame's writes visible to the device, needed if the memory isn't host coherent. Call before submitting the frame
+	void end() {
+		const VkDeviceSize used{ regions[current].head.load(std::memory_order_relaxed) };
+		highWater = std::max(highWater, used);
+		if (used > 0) {
+			chk(vmaFlushAllocation(allocator, allocation, current * regionSize, used));
+		}
+	}
+
+	VkDeviceSize capacity() const { return regionSize; }
+	VmaAllocation memory() const { return allocation; }
+	// Largest amount of memory a single frame has used so far
+	VkDeviceSize highWaterMark() const { return highWater; }
+	// Number of frames in which at least one allocation failed
+	uint32_t overflows() const { return overflowCount.load(std::memory_order_relaxed); }
+
+private:
+	static constexpr VkDeviceSize regionAlignment{ 256 };
+	struct Region {
+		std::atomic<VkDeviceSize> head{ 0 };
+		std::atomic<bool> overflowed{ false };
+	};
+
+	VmaAllocator allocator{ VK_NULL_HANDLE };
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VmaAllocation allocation{ VK_NULL_HANDLE };
+	VkDeviceAddress deviceAddress{ 0 };
+	uint8_t* mapped{ nullptr };
+	VkDeviceSize regionSize{ 0 };
+	std::vector<Region> regions;
+	uint32_t current{ 0 };
+	VkDeviceSize highWater{ 0 };
+	std::atomic<uint32_t> overflowCount{ 0 };
+};
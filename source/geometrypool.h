@@ -0,0 +1,141 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Shared geometry buffers: All meshes live in one device local vertex buffer and one index buffer, so a single bind and a
+// single indirect draw cover every mesh. Ranges are handed out by VMA virtual blocks in units of vertices and indices, the
+// draw's vertexOffset and firstIndex select the mesh. Indices are relative to the mesh's first vertex, so 16 bit indices
+// work as long as no single mesh has more vertices than they can address. Freed ranges go back to the blocks once the
+// frames that may still draw from them have finished.
+
+#pragma once
+
+#include <cstdint>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+#include "common.h"
+#include "deletionqueue.h"
+#include "memory.h"
+#include "upload.h"
+
+struct GeometryRange {
+	VmaVirtualAllocation vertices{ VK_NULL_HANDLE };
+	VmaVirtualAllocation indices{ VK_NULL_HANDLE };
+	int32_t vertexOffset{ 0 };
+	uint32_t firstIndex{ 0 };
+	uint32_t vertexCount{ 0 };
+	uint32_t indexCount{ 0 };
+};
+
+class GeometryPool {
+public:
+	void create(VkDevice device, GpuMemory& memory, uint32_t vertexStride, uint32_t indexSize, uint32_t vertexCapacity, uint32_t indexCapacity, VkBufferUsageFlags extraVertexUsage = 0) {
+		this->memory = &memory;
+		this->vertexStride = vertexStride;
+		this->indexSize = indexSize;
+		this->vertexCapacity = vertexCapacity;
+		this->indexCapacity = indexCapacity;
+		VmaAllocationCreateInfo allocCI{ .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE };
+		VkBufferCreateInfo vertexCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = static_cast<VkDeviceSize>(vertexCapacity) * vertexStride, .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | extraVertexUsage };
+		chk(memory.createBuffer(MemoryCategory::Geometry, vertexCI, allocCI, vertexBuffer, vertexAllocation));
+		VkBufferCreateInfo indexCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = static_cast<VkDeviceSize>(indexCapacity) * indexSize, .usage = VK_BUFFER_USAGE_INDEX_BUFFER_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+		chk(memory.createBuffer(MemoryCategory::Geometry, indexCI, allocCI, indexBuffer, indexAllocation));
+		VkBufferDeviceAddressInfo bdaInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = vertexBuffer };
+		vertexDeviceAddress = vkGetBufferDeviceAddress(device, &bdaInfo);
+		VmaVirtualBlockCreateInfo vertexBlockCI{ .size = vertexCapacity };
+		chk(vmaCreateVirtualBlock(&vertexBlockCI, &vertexBlock));
+		VmaVirtualBlockCreateInfo indexBlockCI{ .size = indexCapacity };
+		chk(vmaCreateVirtualBlock(&indexBlockCI, &indexBlock));
+	}
+
+	// Ranges still allocated at this point are simply dropped
+	void destroy() {
+		vmaClearVirtualBlock(vertexBlock);
+		vmaDestroyVirtualBlock(vertexBlock);
+		vmaClearVirtualBlock(indexBlock);
+		vmaDestroyVirtualBlock(indexBlock);
+		memory->destroyBuffer(vertexBuffer, vertexAllocation);
+		memory->destroyBuffer(indexBuffer, indexAllocation);
+	}
+
+	// Returns false if either buffer has no free range that is large enough
+	bool allocate(uint32_t vertexCount, uint32_t indexCount, GeometryRange& range) {
+		VmaVirtualAllocationCreateInfo vertexAllocCI{ .size = vertexCount };
+		VmaVirtualAllocationCreateInfo indexAllocCI{ .size = indexCount };
+		VkDeviceSize vertexOffset{ 0 };
+		VkDeviceSize firstIndex{ 0 };
+		if (vmaVirtualAllocate(vertexBlock, &vertexAllocCI, &range.vertices, &vertexOffset) != VK_SUCCESS) {
+			return false;
+		}
+		if (vmaVirtualAllocate(indexBlock, &indexAllocCI, &range.indices, &firstIndex) != VK_SUCCESS) {
+			vmaVirtualFree(vertexBlock, range.vertices);
+			return false;
+		}
+		range.vertexOffset = static_cast<int32_t>(vertexOffset);
+		range.firstIndex = static_cast<uint32_t>(firstIndex);
+		range.vertexCount = vertexCount;
+		range.indexCount = indexCount;
+		allocations++;
+		return true;
+	}
+
+	// Frames in flight may still draw from the range, so it's only reused once the current frame has finished
+	void free(const GeometryRange& range, DeletionQueue& deletions, uint32_t frameIndex) {
+		deletions.push(frameIndex, [this, range]() {
+			vmaVirtualFree(vertexBlock, range.vertices);
+			vmaVirtualFree(indexBlock, range.indices);
+			allocations--;
+		});
+	}
+
+	// Staging memory for the vertices and indices of a range, the copies are part of the upload manager's current batch
+	void* uploadVertices(UploadManager& uploads, const GeometryRange& range, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+		return uploads.uploadBuffer(vertexBuffer, static_cast<VkDeviceSize>(range.vertexOffset) * vertexStride, static_cast<VkDeviceSize>(range.vertexCount) * vertexStride, dstStage, dstAccess);
+	}
+
+	void* uploadIndices(UploadManager& uploads, const GeometryRange& range) {
+		return uploads.uploadBuffer(indexBuffer, static_cast<VkDeviceSize>(range.firstIndex) * indexSize, static_cast<VkDeviceSize>(range.indexCount) * indexSize, VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VK_ACCESS_2_INDEX_READ_BIT);
+	}
+
+	void bind(VkCommandBuffer cb) const {
+		VkDeviceSize offset{ 0 };
+		vkCmdBindVertexBuffers(cb, 0, 1, &vertexBuffer, &offset);
+		vkCmdBindIndexBuffer(cb, indexBuffer, 0, indexType());
+	}
+
+	VkIndexType indexType() const { return indexSize == sizeof(uint16_t) ? VK_INDEX_TYPE_UINT16 : VK_INDEX_TYPE_UINT32; }
+	uint32_t indexBytes() const { return indexSize; }
+	// Read by the mesh shaders, which fetch vertices themselves
+	VkDeviceAddress vertexAddress() const { return vertexDeviceAddress; }
+	uint32_t vertexCapacityCount() const { return vertexCapacity; }
+	uint32_t indexCapacityCount() const { return indexCapacity; }
+	uint32_t allocationCount() const { return allocations; }
+
+	// Vertices and indices currently handed out
+	VkDeviceSize verticesUsed() const {
+		VmaStatistics stats{};
+		vmaGetVirtualBlockStatistics(vertexBlock, &stats);
+		return stats.allocationBytes;
+	}
+
+	VkDeviceSize indicesUsed() const {
+		VmaStatistics stats{};
+		vmaGetVirtualBlockStatistics(indexBlock, &stats);
+		return stats.allocationBytes;
+	}
+
+private:
+	GpuMemory* memory{ nullptr };
+	uint32_t vertexStride{ 0 };
+	uint32_t indexSize{ 0 };
+	uint32_t vertexCapacity{ 0 };
+	uint32_t indexCapacity{ 0 };
+	uint32_t allocations{ 0 };
+	VkBuffer vertexBuffer{ VK_NULL_HANDLE };
+	VmaAllocation vertexAllocation{ VK_NULL_HANDLE };
+	VkBuffer indexBuffer{ VK_NULL_HANDLE };
+	VmaAllocation indexAllocation{ VK_NULL_HANDLE };
+	VkDeviceAddress vertexDeviceAddress{ 0 };
+	VmaVirtualBlock vertexBlock{ VK_NULL_HANDLE };
+	VmaVirtualBlock indexBlock{ VK_NULL_HANDLE };
+};
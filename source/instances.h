@@ -0,0 +1,159 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Per-instance data in a device local buffer that shaders read through its device address. The CPU keeps the
+// authoritative copy, and each frame only the instances changed since the last frame are copied to the GPU.
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+#include <glm/glm.hpp>
+#include "common.h"
+
+constexpr uint32_t instanceFlagSelected{ 1 };
+
+// 64 bytes, so instances never straddle a cache line and consecutive shader invocations read consecutive memory
+struct InstanceData {
+	// Rows of the affine model matrix
+	glm::vec4 transform[3];
+	uint32_t textureIndex{ 0 };
+	uint32_t flags{ 0 };
+	uint32_t meshIndex{ 0 };
+	uint32_t padding{ 0 };
+};
+static_assert(sizeof(InstanceData) == 64);
+
+class InstanceBuffer {
+public:
+	void create(VmaAllocator allocator, VkDevice device, uint32_t capacity, uint32_t framesInFlight, bool meshShading) {
+		this->allocator = allocator;
+		// Stages that read instances, the mesh shader stages may only be used if the feature is enabled
+		readStages = VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT | VK_PIPELINE_STAGE_2_VERTEX_SHADER_BIT;
+		if (meshShading) {
+			readStages |= VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT;
+		}
+		instances.resize(capacity);
+		const VkDeviceSize size{ capacity * sizeof(InstanceData) };
+		VkBufferCreateInfo bufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = size, .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+		VmaAllocationCreateInfo allocCI{ .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE };
+		chk(vmaCreateBuffer(allocator, &bufferCI, &allocCI, &buffer, &allocation, nullptr));
+		VkBufferDeviceAddressInfo bdaInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = buffer };
+		deviceAddress = vkGetBufferDeviceAddress(device, &bdaInfo);
+		// One staging buffer per frame in flight, each mirrors the layout of the device buffer so copy regions use the same offsets
+		staging.resize(framesInFlight);
+		for (auto& frame : staging) {
+			VkBufferCreateInfo stagingCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = size, .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT };
+			VmaAllocationCreateInfo stagingAllocCI{ .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST };
+			VmaAllocationInfo stagingAllocInfo{};
+			chk(vmaCreateBuffer(allocator, &stagingCI, &stagingAllocCI, &frame.buffer, &frame.allocation, &stagingAllocInfo));
+			frame.mapped = static_cast<uint8_t*>(stagingAllocInfo.pMappedData);
+		}
+		markDirty(0, capacity);
+	}
+
+	void destroy() {
+		for (auto& frame : staging) {
+			vmaDestroyBuffer(allocator, frame.buffer, frame.allocation);
+		}
+		vmaDestroyBuffer(allocator, buffer, allocation);
+	}
+
+	uint32_t count() const { return static_cast<uint32_t>(instances.size()); }
+	const InstanceData& operator[](uint32_t index) const { return instances[index]; }
+	VkDeviceAddress address() const { return deviceAddress; }
+
+	// Writable access, marks the instance for upload
+	InstanceData& edit(uint32_t index) {
+		markDirty(index, 1);
+		return instances[index];
+	}
+
+	// Transform rows of the first instance, the transform system writes them in place and marks the instances it changed
+	void* transformRows() { return instances[0].transform; }
+
+	void markDirty(uint32_t first, uint32_t count) {
+		if (!dirty.empty() && dirty.back().second == first) {
+			dirty.back().second += count;
+			return;
+		}
+		dirty.push_back({ first, first + count });
+	}
+
+	// Copies all changed instances into the frame's staging buffer and records the transfer into the frame's command buffer
+	// Must be recorded outside of a render pass, before the cull pass and draws that read the instances
+	void record(VkCommandBuffer cb, uint32_t frameIndex) {
+		if (dirty.empty()) {
+			return;
+		}
+		// Sort and merge, ranges that are almost adjacent are combined since a few extra bytes are cheaper than another region
+		constexpr uint32_t mergeGap{ 4 };
+		std::sort(dirty.begin(), dirty.end());
+		std::vector<VkBufferCopy> regions;
+		uint32_t begin{ dirty[0].first };
+		uint32_t end{ dirty[0].second };
+		const auto addRegion = [&]() {
+			const VkDeviceSize offset{ begin * sizeof(InstanceData) };
+			const VkDeviceSize size{ (end - begin) * sizeof(InstanceData) };
+			memcpy(staging[frameIndex].mapped + offset, &instances[begin], size);
+			regions.push_back({ .srcOffset = offset, .dstOffset = offset, .size = size });
+		};
+		for (size_t i = 1; i < dirty.size(); i++) {
+			if (dirty[i].first <= end + mergeGap) {
+				end = std::max(end, dirty[i].second);
+				continue;
+			}
+			addRegion();
+			begin = dirty[i].first;
+			end = dirty[i].second;
+		}
+		addRegion();
+		dirty.clear();
+		// Previous frames may still be reading the buffer, so the copy waits for their cull passes and geometry shaders
+		VkBufferMemoryBarrier2 barrier{
+			.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+			.srcStageMask = readStages,
+			.srcAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT,
+			.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+			.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.buffer = buffer,
+			.size = VK_WHOLE_SIZE
+		};
+		VkDependencyInfo dependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .bufferMemoryBarrierCount = 1, .pBufferMemoryBarriers = &barrier };
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+		vkCmdCopyBuffer(cb, staging[frameIndex].buffer, buffer, static_cast<uint32_t>(regions.size()), regions.data());
+		barrier.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT;
+		barrier.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT;
+		barrier.dstStageMask = readStages;
+		barrier.dstAccessMask = VK_ACCESS_2_SHADER_STORAGE_READ_BIT;
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+	}
+
+private:
+	struct Staging {
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		VmaAllocation allocation{ VK_NULL_HANDLE };
+		uint8_t* mapped{ nullptr };
+	};
+	VmaAllocator allocator{ VK_NULL_HANDLE };
+	VkBuffer buffer{ VK_NULL_HANDLE };
+	VmaAllocation allocation{ VK_NULL_HANDLE };
+	VkPipelineStageFlags2 readStages{ 0 };
+	VkDeviceAddress deviceAddress{ 0 };
+	std::vector<InstanceData> instances;
+	std::vector<Staging> staging;
+	// Half open instance ranges changed since the last upload
+	std::vector<std::pair<uint32_t, uint32_t>> dirty;
+};
+
+// Affine part of a model matrix as rows, glm matrices are column major
+inline void setTransform(InstanceData& instance, const glm::mat4& model) {
+	for (uint32_t row = 0; row < 3; row++) {
+		instance.transform[row] = glm::vec4(model[0][row], model[1][row], model[2][row], model[3][row]);
+	}
+}
@@ -0,0 +1,152 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Job system for short, CPU bound jobs like command recording: Every worker owns a deque it pushes to and pops from
+// at the back, idle workers steal from the front of other deques. The thread that submits work joins in until all of
+// its jobs have finished, and always runs as thread index 0.
+// Unlike the thread pool, jobs must not block on I/O or the GPU.
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+class JobSystem {
+public:
+	JobSystem() = default;
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+	~JobSystem() { stop(); }
+
+	// Total number of threads including the calling one, zero uses all hardware threads
+	void start(uint32_t threadCount = 0) {
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency());
+		}
+		stopping = false;
+		queues.clear();
+		for (uint32_t i = 0; i < threadCount; i++) {
+			queues.push_back(std::make_unique<Queue>());
+		}
+		for (uint32_t i = 1; i < threadCount; i++) {
+			threads.emplace_back([this, i] { run(i); });
+		}
+	}
+
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+			stopping = true;
+		}
+		wake.notify_all();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		threads.clear();
+	}
+
+	uint32_t threadCount() const { return static_cast<uint32_t>(queues.size()); }
+
+	// Splits [0, count) into batches and runs func(begin, end, threadIndex) for each of them, returns once all batches are done
+	// Batches are dealt round robin, so every thread starts on its own deque and only steals once that runs dry
+	void parallelFor(uint32_t count, uint32_t batchSize, const std::function<void(uint32_t, uint32_t, uint32_t)>& func) {
+		if (count == 0) {
+			return;
+		}
+		batchSize = std::max(1u, batchSize);
+		std::atomic<uint32_t> remaining{ (count + batchSize - 1) / batchSize };
+		uint32_t queueIndex{ 0 };
+		for (uint32_t begin = 0; begin < count; begin += batchSize) {
+			Queue& queue = *queues[queueIndex];
+			{
+				std::lock_guard<std::mutex> lock(queue.mutex);
+				queue.jobs.push_back({ .func = &func, .begin = begin, .end = std::min(count, begin + batchSize), .remaining = &remaining });
+			}
+			queued.fetch_add(1, std::memory_order_release);
+			queueIndex = (queueIndex + 1) % threadCount();
+		}
+		{
+			std::lock_guard<std::mutex> lock(sleepMutex);
+		}
+		wake.notify_all();
+		// The caller works as thread 0 until nothing is left to take, then waits for jobs still running elsewhere
+		while (remaining.load(std::memory_order_acquire) > 0) {
+			if (!runOne(0)) {
+				std::this_thread::yield();
+			}
+		}
+	}
+
+private:
+	struct Job {
+		const std::function<void(uint32_t, uint32_t, uint32_t)>* func{ nullptr };
+		uint32_t begin{ 0 };
+		uint32_t end{ 0 };
+		std::atomic<uint32_t>* remaining{ nullptr };
+	};
+	struct Queue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	std::vector<std::unique_ptr<Queue>> queues;
+	std::vector<std::thread> threads;
+	std::atomic<uint32_t> queued{ 0 };
+	std::atomic<bool> stopping{ false };
+	std::mutex sleepMutex;
+	std::condition_variable wake;
+
+	bool pop(uint32_t queueIndex, bool steal, Job& job) {
+		Queue& queue = *queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (queue.jobs.empty()) {
+			return false;
+		}
+		if (steal) {
+			job = queue.jobs.front();
+			queue.jobs.pop_front();
+		} else {
+			job = queue.jobs.back();
+			queue.jobs.pop_back();
+		}
+		queued.fetch_sub(1, std::memory_order_relaxed);
+		return true;
+	}
+
+	// Runs one job from the thread's own deque, or one stolen from another thread
+	bool runOne(uint32_t threadIndex) {
+		Job job{};
+		bool found{ pop(threadIndex, false, job) };
+		for (uint32_t i = 1; i < threadCount() && !found; i++) {
+			found = pop((threadIndex + i) % threadCount(), true, job);
+		}
+		if (!found) {
+			return false;
+		}
+		(*job.func)(job.begin, job.end, threadIndex);
+		job.remaining->fetch_sub(1, std::memory_order_release);
+		return true;
+	}
+
+	void run(uint32_t threadIndex) {
+		while (true) {
+			if (runOne(threadIndex)) {
+				continue;
+			}
+			std::unique_lock<std::mutex> lock(sleepMutex);
+			wake.wait(lock, [this] { return stopping || queued.load(std::memory_order_acquire) > 0; });
+			if (stopping) {
+				return;
+			}
+		}
+	}
+};
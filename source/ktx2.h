@@ -0,0 +1,371 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// KTX 2 textures: The container is parsed directly as the bundled KTX library only reads KTX 1. Mip levels can be
+// supercompressed with zstd, they are decoded by the streaming workers so decompression runs in parallel. A texture can
+// ship one file per block format (e.g. name.bc7.ktx2 and name.etc2.ktx2), the first one the device can sample is used.
+// Basis Universal payloads (ETC1S with BasisLZ supercompression, UASTC) are out of scope: Transcoding them needs the
+// Basis Universal transcoder, which isn't part of this project. Such files are recognized and rejected, textures ship
+// pre-encoded per block format instead and the format the device supports is picked by choosing between the files.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <array>
+#include <thread>
+#include <atomic>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <filesystem>
+#include <algorithm>
+#include <cstdio>
+#include <cstring>
+#include <cstdint>
+#include <volk.h>
+#include "mappedfile.h"
+#include "threadpool.h"
+#if defined(HAVE_ZSTD)
+#include <zstd.h>
+#endif
+
+constexpr std::array<uint8_t, 12> ktx2Identifier{ 0xAB, 0x4B, 0x54, 0x58, 0x20, 0x32, 0x30, 0xBB, 0x0D, 0x0A, 0x1A, 0x0A };
+constexpr uint32_t ktx2SupercompressionNone{ 0 };
+constexpr uint32_t ktx2SupercompressionBasisLZ{ 1 };
+constexpr uint32_t ktx2SupercompressionZstd{ 2 };
+// Identifier, nine 32 bit header fields and the index of the data format descriptor, key/value and supercompression data
+constexpr size_t ktx2HeaderSize{ 80 };
+// Color model of the basic data format descriptor for UASTC payloads, which have no Vulkan format of their own
+constexpr uint8_t ktx2ColorModelUastc{ 166 };
+
+struct Ktx2Level {
+	size_t offset{ 0 };
+	size_t size{ 0 };
+	size_t uncompressedSize{ 0 };
+};
+
+// Levels are indexed from the largest to the smallest, in the file they are stored the other way round
+struct Ktx2File {
+	VkFormat format{ VK_FORMAT_UNDEFINED };
+	uint32_t width{ 0 };
+	uint32_t height{ 0 };
+	uint32_t supercompression{ ktx2SupercompressionNone };
+	std::vector<Ktx2Level> levels;
+};
+
+// Texel block of the formats textures ship in, returns false for other formats
+inline bool ktx2FormatBlock(VkFormat format, uint32_t& blockWidth, uint32_t& blockHeight, uint32_t& blockBytes) {
+	blockWidth = 1;
+	blockHeight = 1;
+	switch (format) {
+	case VK_FORMAT_R8_UNORM:
+	case VK_FORMAT_R8_SRGB:
+		blockBytes = 1;
+		return true;
+	case VK_FORMAT_R8G8_UNORM:
+	case VK_FORMAT_R8G8_SRGB:
+		blockBytes = 2;
+		return true;
+	case VK_FORMAT_R8G8B8A8_UNORM:
+	case VK_FORMAT_R8G8B8A8_SRGB:
+	case VK_FORMAT_B8G8R8A8_UNORM:
+	case VK_FORMAT_B8G8R8A8_SRGB:
+	case VK_FORMAT_A2B10G10R10_UNORM_PACK32:
+	case VK_FORMAT_B10G11R11_UFLOAT_PACK32:
+	case VK_FORMAT_E5B9G9R9_UFLOAT_PACK32:
+		blockBytes = 4;
+		return true;
+	case VK_FORMAT_R16G16B16A16_UNORM:
+	case VK_FORMAT_R16G16B16A16_SFLOAT:
+		blockBytes = 8;
+		return true;
+	case VK_FORMAT_R32G32B32A32_SFLOAT:
+		blockBytes = 16;
+		return true;
+	default:
+		break;
+	}
+	// Block compressed formats are enumerated in pairs of UNORM and SRGB (or SNORM) variants
+	if (format >= VK_FORMAT_BC1_RGB_UNORM_BLOCK && format <= VK_FORMAT_EAC_R11G11_SNORM_BLOCK) {
+		constexpr std::array<uint8_t, 13> bytes{ 8, 8, 16, 16, 8, 16, 16, 16, 8, 8, 16, 8, 16 };
+		blockWidth = 4;
+		blockHeight = 4;
+		blockBytes = bytes[(format - VK_FORMAT_BC1_RGB_UNORM_BLOCK) / 2];
+		return true;
+	}
+	if (format >= VK_FORMAT_ASTC_4x4_UNORM_BLOCK && format <= VK_FORMAT_ASTC_12x12_SRGB_BLOCK) {
+		constexpr std::array<std::array<uint8_t, 2>, 14> extents{ { { 4, 4 }, { 5, 4 }, { 5, 5 }, { 6, 5 }, { 6, 6 }, { 8, 5 }, { 8, 6 }, { 8, 8 }, { 10, 5 }, { 10, 6 }, { 10, 8 }, { 10, 10 }, { 12, 10 }, { 12, 12 } } };
+		const auto& extent = extents[(format - VK_FORMAT_ASTC_4x4_UNORM_BLOCK) / 2];
+		blockWidth = extent[0];
+		blockHeight = extent[1];
+		blockBytes = 16;
+		return true;
+	}
+	return false;
+}
+
+inline bool ktx2ZstdSupported() {
+#if defined(HAVE_ZSTD)
+	return true;
+#else
+	return false;
+#endif
+}
+
+// 2D textures with one face and layer only, prints why a file can't be used
+inline bool parseKtx2(const uint8_t* data, size_t size, Ktx2File& file, const std::string& name) {
+	const auto fail = [&](const char* reason) {
+		std::cerr << "Can't load KTX 2 texture " << name << ": " << reason << "\n";
+		return false;
+	};
+	if (size < ktx2HeaderSize || memcmp(data, ktx2Identifier.data(), ktx2Identifier.size()) != 0) {
+		return fail("not a KTX 2 file");
+	}
+	std::array<uint32_t, 9> header{};
+	memcpy(header.data(), data + 12, sizeof(header));
+	const uint32_t depth{ header[4] }, layerCount{ header[5] }, faceCount{ header[6] };
+	file.format = static_cast<VkFormat>(header[0]);
+	file.width = header[2];
+	file.height = header[3];
+	file.supercompression = header[8];
+	// A level count of zero asks the loader to generate mips, which isn't done here
+	const uint32_t levelCount{ std::max(1u, header[7]) };
+	if (depth > 1 || layerCount > 1 || faceCount != 1 || file.width == 0 || file.height == 0) {
+		return fail("only 2D textures without layers or faces are supported");
+	}
+	if (file.supercompression == ktx2SupercompressionBasisLZ) {
+		return fail("Basis Universal ETC1S (BasisLZ) payloads need the Basis transcoder, which isn't part of this project");
+	}
+	if (file.format == VK_FORMAT_UNDEFINED) {
+		// The color model is the first byte after the descriptor's total size and the block's vendor, type, version and size
+		uint32_t dfdOffset{ 0 };
+		memcpy(&dfdOffset, data + 48, sizeof(dfdOffset));
+		const bool uastc{ dfdOffset > 0 && static_cast<size_t>(dfdOffset) + 12 < size && data[dfdOffset + 12] == ktx2ColorModelUastc };
+		return fail(uastc ? "Basis Universal UASTC payloads need the Basis transcoder, which isn't part of this project" : "no Vulkan format");
+	}
+	if (file.supercompression != ktx2SupercompressionNone && !(file.supercompression == ktx2SupercompressionZstd && ktx2ZstdSupported())) {
+		return fail("unsupported supercompression scheme");
+	}
+	uint32_t blockWidth{ 0 }, blockHeight{ 0 }, blockBytes{ 0 };
+	if (!ktx2FormatBlock(file.format, blockWidth, blockHeight, blockBytes)) {
+		return fail("unsupported format");
+	}
+	if (size < ktx2HeaderSize + levelCount * 3 * sizeof(uint64_t)) {
+		return fail("truncated level index");
+	}
+	file.levels.resize(levelCount);
+	for (uint32_t level = 0; level < levelCount; level++) {
+		std::array<uint64_t, 3> entry{};
+		memcpy(entry.data(), data + ktx2HeaderSize + level * sizeof(entry), sizeof(entry));
+		if (entry[0] > size || entry[1] > size - entry[0]) {
+			return fail("level data out of bounds");
+		}
+		file.levels[level] = { .offset = static_cast<size_t>(entry[0]), .size = static_cast<size_t>(entry[1]), .uncompressedSize = static_cast<size_t>(entry[2]) };
+		if (file.supercompression == ktx2SupercompressionNone && file.levels[level].uncompressedSize != file.levels[level].size) {
+			return fail("level sizes don't match");
+		}
+		// Decoded levels are copied to staging memory sized for the level's image, a wrong size would under- or overrun it
+		const uint64_t blocksX{ (std::max(1u, file.width >> level) + blockWidth - 1) / blockWidth };
+		const uint64_t blocksY{ (std::max(1u, file.height >> level) + blockHeight - 1) / blockHeight };
+		if (entry[2] != blocksX * blocksY * blockBytes) {
+			return fail("level size doesn't match its format and extent");
+		}
+	}
+	return true;
+}
+
+inline bool readKtx2(const std::string& path, Ktx2File& file) {
+	MappedFile mapping;
+	return mapping.open(path) && parseKtx2(mapping.data(), mapping.size(), file, path);
+}
+
+// Thread safe, target must hold the level's uncompressed size
+inline bool decodeKtx2Level(const uint8_t* data, const Ktx2File& file, uint32_t level, void* target) {
+	const Ktx2Level& info{ file.levels[level] };
+	if (file.supercompression == ktx2SupercompressionNone) {
+		memcpy(target, data + info.offset, info.size);
+		return true;
+	}
+#if defined(HAVE_ZSTD)
+	const size_t result{ ZSTD_decompress(target, info.uncompressedSize, data + info.offset, info.size) };
+	return !ZSTD_isError(result) && result == info.uncompressedSize;
+#else
+	return false;
+#endif
+}
+
+// Picks the first variant of the texture that exists and can be sampled, block formats are preferred in the listed order.
+// This takes the place of transcoding a Basis Universal file to the device's best format, Basis files are rejected when
+// parsed and skipped like variants the device can't sample. Falls back to the KTX 1 file, which returns an empty file description
+inline std::string chooseTextureFile(VkPhysicalDevice physicalDevice, const std::string& stem, Ktx2File& file) {
+	for (const char* suffix : { ".bc7.ktx2", ".astc.ktx2", ".etc2.ktx2", ".bc1.ktx2", ".ktx2" }) {
+		const std::string path{ stem + suffix };
+		if (!std::filesystem::exists(path) || !readKtx2(path, file)) {
+			continue;
+		}
+		VkFormatProperties formatProperties{};
+		vkGetPhysicalDeviceFormatProperties(physicalDevice, file.format, &formatProperties);
+		// Transfer source is needed for evicting levels and defragmentation, which copy textures into new images
+		const VkFormatFeatureFlags required{ VK_FORMAT_FEATURE_SAMPLED_IMAGE_BIT | VK_FORMAT_FEATURE_TRANSFER_SRC_BIT | VK_FORMAT_FEATURE_TRANSFER_DST_BIT };
+		if ((formatProperties.optimalTilingFeatures & required) == required) {
+			return path;
+		}
+	}
+	file = {};
+	return stem + ".ktx";
+}
+
+// Full mip chain of an RGBA8 sRGB texture, levels are zstd compressed if available
+inline size_t writeKtx2(const std::string& path, uint32_t size, const std::vector<std::vector<uint8_t>>& levels) {
+	const bool zstd{ ktx2ZstdSupported() };
+	// Basic data format descriptor for VK_FORMAT_R8G8B8A8_SRGB: Block header followed by one sample per channel
+	std::vector<uint32_t> dfd{ 92, 0, 2 | (88 << 16), 1 | (1 << 8) | (2 << 16), 0, 4, 0 };
+	for (uint32_t channel = 0; channel < 4; channel++) {
+		const uint32_t channelType{ channel < 3 ? channel : 0x1F };
+		dfd.insert(dfd.end(), { (channel * 8) | (7 << 16) | (channelType << 24), 0, 0, 255 });
+	}
+	std::vector<std::vector<uint8_t>> payloads(levels.size());
+	for (size_t i = 0; i < levels.size(); i++) {
+#if defined(HAVE_ZSTD)
+		payloads[i].resize(ZSTD_compressBound(levels[i].size()));
+		payloads[i].resize(ZSTD_compress(payloads[i].data(), payloads[i].size(), levels[i].data(), levels[i].size(), 3));
+#else
+		payloads[i] = levels[i];
+#endif
+	}
+	const uint32_t levelCount{ static_cast<uint32_t>(levels.size()) };
+	const size_t dfdOffset{ ktx2HeaderSize + levelCount * 3 * sizeof(uint64_t) };
+	std::array<uint32_t, 9> header{ VK_FORMAT_R8G8B8A8_SRGB, 1, size, size, 0, 0, 1, levelCount, zstd ? ktx2SupercompressionZstd : ktx2SupercompressionNone };
+	std::array<uint32_t, 4> index{ static_cast<uint32_t>(dfdOffset), static_cast<uint32_t>(dfd.size() * sizeof(uint32_t)), 0, 0 };
+	std::array<uint64_t, 2> sgdIndex{ 0, 0 };
+	// Smallest level first, uncompressed levels are 4 byte aligned
+	std::vector<std::array<uint64_t, 3>> levelIndex(levelCount);
+	size_t offset{ dfdOffset + dfd.size() * sizeof(uint32_t) };
+	for (uint32_t level = levelCount; level-- > 0;) {
+		if (!zstd) {
+			offset = (offset + 3) & ~size_t(3);
+		}
+		levelIndex[level] = { offset, payloads[level].size(), levels[level].size() };
+		offset += payloads[level].size();
+	}
+	std::ofstream out(path, std::ios::binary);
+	out.write(reinterpret_cast<const char*>(ktx2Identifier.data()), ktx2Identifier.size());
+	out.write(reinterpret_cast<const char*>(header.data()), sizeof(header));
+	out.write(reinterpret_cast<const char*>(index.data()), sizeof(index));
+	out.write(reinterpret_cast<const char*>(sgdIndex.data()), sizeof(sgdIndex));
+	out.write(reinterpret_cast<const char*>(levelIndex.data()), levelIndex.size() * sizeof(levelIndex[0]));
+	out.write(reinterpret_cast<const char*>(dfd.data()), dfd.size() * sizeof(uint32_t));
+	for (uint32_t level = levelCount; level-- > 0;) {
+		const size_t position{ static_cast<size_t>(out.tellp()) };
+		for (size_t i = position; i < levelIndex[level][0]; i++) {
+			out.put(0);
+		}
+		out.write(reinterpret_cast<const char*>(payloads[level].data()), payloads[level].size());
+	}
+	return offset;
+}
+
+// Smooth gradients with some noise, compresses roughly like a real albedo texture
+inline std::vector<std::vector<uint8_t>> syntheticMipChain(uint32_t size, uint32_t seed) {
+	std::vector<std::vector<uint8_t>> levels;
+	levels.emplace_back(size * size * 4);
+	uint32_t state{ seed * 747796405u + 2891336453u };
+	for (uint32_t y = 0; y < size; y++) {
+		for (uint32_t x = 0; x < size; x++) {
+			state = state * 1664525u + 1013904223u;
+			uint8_t* texel{ &levels[0][(y * size + x) * 4] };
+			texel[0] = static_cast<uint8_t>((x * 255 / size + (state >> 28)) & 0xFF);
+			texel[1] = static_cast<uint8_t>((y * 255 / size + (state >> 29)) & 0xFF);
+			texel[2] = static_cast<uint8_t>(((x ^ y) >> 3) * 8 + seed * 32);
+			texel[3] = 255;
+		}
+	}
+	for (uint32_t levelSize = size / 2; levelSize > 0; levelSize /= 2) {
+		const std::vector<uint8_t>& source{ levels.back() };
+		std::vector<uint8_t> level(levelSize * levelSize * 4);
+		for (uint32_t y = 0; y < levelSize; y++) {
+			for (uint32_t x = 0; x < levelSize; x++) {
+				for (uint32_t c = 0; c < 4; c++) {
+					const size_t row{ levelSize * 2 * 4 };
+					const size_t base{ y * 2 * row + x * 2 * 4 + c };
+					level[(y * levelSize + x) * 4 + c] = static_cast<uint8_t>((source[base] + source[base + 4] + source[base + row] + source[base + row + 4] + 2) / 4);
+				}
+			}
+		}
+		levels.push_back(std::move(level));
+	}
+	return levels;
+}
+
+// Decodes all levels of a set of synthetic textures with an increasing number of worker threads, one job per level
+inline void benchmarkKtx2(uint32_t size, const std::string& outputPath) {
+	using Clock = std::chrono::steady_clock;
+	constexpr uint32_t textureCount{ 8 };
+	size_t rawBytes{ 0 };
+	size_t diskBytes{ 0 };
+	std::vector<std::string> paths;
+	for (uint32_t i = 0; i < textureCount; i++) {
+		const auto levels{ syntheticMipChain(size, i) };
+		for (auto& level : levels) {
+			rawBytes += level.size();
+		}
+		paths.push_back("ktx2_bench_" + std::to_string(i) + ".ktx2");
+		diskBytes += writeKtx2(paths.back(), size, levels);
+	}
+	std::vector<MappedFile> mappings(textureCount);
+	std::vector<Ktx2File> files(textureCount);
+	for (uint32_t i = 0; i < textureCount; i++) {
+		if (!mappings[i].open(paths[i]) || !parseKtx2(mappings[i].data(), mappings[i].size(), files[i], paths[i])) {
+			return;
+		}
+	}
+	std::ofstream out(outputPath);
+	out << "{\n\t\"textures\": " << textureCount << ",\n\t\"size\": " << size << ",\n\t\"zstd\": " << (ktx2ZstdSupported() ? "true" : "false")
+		<< ",\n\t\"rawBytes\": " << rawBytes << ",\n\t\"diskBytes\": " << diskBytes << ",\n\t\"compressionRatio\": " << (double)rawBytes / diskBytes << ",\n\t\"decode\": [\n";
+	std::cout << "KTX 2 decode benchmark, " << textureCount << " textures of " << size << "x" << size << ", " << rawBytes / (1024.0 * 1024.0) << " MB raw, "
+		<< diskBytes / (1024.0 * 1024.0) << " MB on disk\n";
+	const uint32_t maxThreads{ std::max(1u, std::thread::hardware_concurrency()) };
+	for (uint32_t threads = 1; threads <= maxThreads; threads = (threads == maxThreads) ? threads + 1 : std::min(threads * 2, maxThreads)) {
+		ThreadPool pool;
+		pool.start(threads);
+		std::vector<std::vector<uint8_t>> targets;
+		for (auto& file : files) {
+			for (auto& level : file.levels) {
+				targets.emplace_back(level.uncompressedSize);
+			}
+		}
+		std::atomic<uint32_t> remaining{ static_cast<uint32_t>(targets.size()) };
+		std::atomic<bool> failed{ false };
+		const auto start = Clock::now();
+		// Largest levels first, so small ones fill the gaps at the end
+		for (uint32_t level = 0; level < files[0].levels.size(); level++) {
+			for (uint32_t i = 0; i < textureCount; i++) {
+				uint8_t* destination{ targets[i * files[i].levels.size() + level].data() };
+				pool.enqueue([&, i, level, destination] {
+					if (!decodeKtx2Level(mappings[i].data(), files[i], level, destination)) {
+						failed = true;
+					}
+					remaining--;
+				});
+			}
+		}
+		while (remaining > 0) {
+			std::this_thread::yield();
+		}
+		const double ms{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+		pool.stop();
+		if (failed) {
+			std::cerr << "KTX 2 level could not be decoded\n";
+		}
+		const double mbPerSecond{ rawBytes / (1024.0 * 1024.0) / (ms / 1000.0) };
+		std::cout << "  " << threads << " thread(s): " << ms << " ms, " << mbPerSecond << " MB/s\n";
+		out << "\t\t{ \"threads\": " << threads << ", \"ms\": " << ms << ", \"mbPerSecond\": " << mbPerSecond << " }" << (threads == maxThreads ? "\n" : ",\n");
+	}
+	out << "\t]\n}\n";
+	mappings.clear();
+	for (auto& path : paths) {
+		std::remove(path.c_str());
+	}
+}
@@ -11,6 +11,15 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <chrono>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <thread>
+#include <atomic>
+#include <bit>
+#include <charconv>
+#include <filesystem>
 #define VMA_IMPLEMENTATION
 #include <vk_mem_alloc.h>
 #define GLM_FORCE_RADIANS
@@ -24,83 +33,502 @@
 #include <ktxvulkan.h>
 #define TINYOBJLOADER_IMPLEMENTATION
 #include <tiny_obj_loader.h>
+#include "common.h"
+#include "mesh.h"
+#include "meshlets.h"
+#include "simplify.h"
+#include "vertexformat.h"
+#include "meshcache.h"
+#include "objloader.h"
+#include "upload.h"
+#include "ktx2.h"
+#include "texturestreamer.h"
+#include "shadercache.h"
+#include "instances.h"
+#include "culling.h"
+#include "jobsystem.h"
+#include "recorder.h"
+#include "framearena.h"
+#include "profiler.h"
+#include "presentpacing.h"
+#include "deletionqueue.h"
+#include "bindless.h"
+#include "memory.h"
+#include "rendergraph.h"
+#include "geometrypool.h"
+#include "triplebuffer.h"
+#include "transforms.h"
+#include "bvh.h"
 
-static inline void chk(VkResult result) {
-	if (result != VK_SUCCESS) {
-		std::cerr << "Vulkan call returned an error (" << result << ")\n";
-		exit(result);
-	}
-}
-static inline void chk(bool result) {
-	if (!result) {
-		std::cerr << "Call returned an error\n";
-		exit(result);
-	}
-}
-
-constexpr uint32_t maxFramesInFlight{ 2 };
+// Frames the CPU may record ahead of the GPU, more hide CPU spikes at the cost of latency
+constexpr uint32_t maxFramesInFlight{ 4 };
+uint32_t framesInFlight{ 2 };
 uint32_t imageIndex{ 0 };
 uint32_t frameIndex{ 0 };
 VkInstance instance{ VK_NULL_HANDLE };
 VkDevice device{ VK_NULL_HANDLE };
 VkQueue queue{ VK_NULL_HANDLE };
+VkQueue transferQueue{ VK_NULL_HANDLE };
+UploadManager uploads;
+TextureStreamer textureStreamer;
 VkSurfaceKHR surface{ VK_NULL_HANDLE };
 VkSwapchainKHR swapchain{ VK_NULL_HANDLE };
-VkCommandPool commandPool{ VK_NULL_HANDLE };
+// Requested present mode and swapchain image count (0 uses the surface's minimum), unsupported modes fall back to the closest one
+VkPresentModeKHR presentMode{ VK_PRESENT_MODE_FIFO_KHR };
+uint32_t swapchainImageCount{ 0 };
+// Presents are timed with VK_KHR_present_id and VK_KHR_present_wait if available, the loop can also wait until at most
+// this many presents are queued before it samples input for the next frame (0 disables pacing)
+bool presentTiming{ false };
+uint32_t presentWait{ 0 };
+PresentPacer presentPacer;
+// One pool per frame in flight, reset as a whole once the frame's timeline value has been reached
+std::vector<VkCommandPool> commandPools;
 VkPipeline pipeline{ VK_NULL_HANDLE };
 VkPipelineLayout pipelineLayout{ VK_NULL_HANDLE };
-VkImage depthImage;
 VmaAllocator allocator{ VK_NULL_HANDLE };
-VmaAllocation depthImageAllocation;
-VkImageView depthImageView;
+// Owns the depth buffer, which only lives within a frame, and records the barriers between passes
+RenderGraph renderGraph;
+bool dumpRenderGraph{ false };
 std::vector<VkImage> swapchainImages;
 std::vector<VkImageView> swapchainImageViews;
-std::array<VkCommandBuffer, maxFramesInFlight> commandBuffers;
-std::array<VkFence, maxFramesInFlight> fences;
-std::array<VkSemaphore, maxFramesInFlight> presentSemaphores;
+// Headless mode renders into offscreen images owned by VMA instead of a swapchain
+bool headless{ false };
+std::vector<VmaAllocation> offscreenImageAllocations;
+VkExtent2D renderExtent{ .width = 1280, .height = 720 };
+std::vector<VkCommandBuffer> commandBuffers;
+// Every submitted frame signals the next value of the timeline, a frame slot is reused once the value of its last submission is reached
+VkSemaphore frameTimeline{ VK_NULL_HANDLE };
+uint64_t frameTimelineValue{ 0 };
+std::vector<uint64_t> frameTimelineValues;
+std::vector<VkSemaphore> presentSemaphores;
 std::vector<VkSemaphore> renderSemaphores;
-VmaAllocation vBufferAllocation{ VK_NULL_HANDLE };
-VkBuffer vBuffer{ VK_NULL_HANDLE };
+// Vertices and indices of all meshes
+GeometryPool geometryPool;
+// First draw entry of every mesh, instances use the meshes round robin
+std::vector<uint32_t> meshFirstDraws;
 struct ShaderData {
 	glm::mat4 projection;
 	glm::mat4 view;
-	glm::mat4 model[3];
 	glm::vec4 lightPos{ 0.0f, -10.0f, 10.0f, 0.0f };
-	uint32_t selected{1};
+	std::array<glm::vec4, 6> frustumPlanes{};
+	glm::vec4 cameraPos{ 0.0f };
+	VkDeviceAddress instances{ 0 };
+	VkDeviceAddress visibleInstances{ 0 };
+	VkDeviceAddress meshes{ 0 };
+	VkDeviceAddress meshTasks{ 0 };
+	VkDeviceAddress meshlets{ 0 };
+	VkDeviceAddress meshletVertices{ 0 };
+	VkDeviceAddress meshletTriangles{ 0 };
+	VkDeviceAddress vertices{ 0 };
+	// Indexed with the texture handle
+	VkDeviceAddress textureMinLods{ 0 };
+	uint32_t cullFlags{ 0 };
 } shaderData{};
-struct ShaderDataBuffer {
-	VmaAllocation allocation{ VK_NULL_HANDLE };
-	VkBuffer buffer{ VK_NULL_HANDLE };
-	VkDeviceAddress deviceAddress{};
-	void* mapped{ nullptr };
-};
-std::array<ShaderDataBuffer, maxFramesInFlight> shaderDataBuffers;
+// Transient per-frame data like the shader data is allocated from here and released once the frame's timeline value has been reached
+FrameArena frameArena;
+constexpr VkDeviceSize frameArenaSize{ 4 * 1024 * 1024 };
+// Objects replaced while frames are in flight, like the swapchain and its attachments, are destroyed once those frames are done
+DeletionQueue deletionQueue;
+// Set on resize and by out of date or suboptimal results, the swapchain is then recreated at the start of the next frame
+std::atomic<bool> swapchainDirty{ false };
+uint32_t swapchainRecreations{ 0 };
 struct Texture {
 	VmaAllocation allocation{ VK_NULL_HANDLE };
 	VkImage image{ VK_NULL_HANDLE };	
 	VkImageView view{ VK_NULL_HANDLE };
-	VkSampler sampler{ VK_NULL_HANDLE };
+	TextureHandle handle{ invalidTexture };
+	VkImageCreateInfo createInfo{};
+	// Finest levels of the file that were evicted, the image's first level is this level of the file
+	uint32_t droppedLevels{ 0 };
 };
 std::array<Texture, 3> textures{};
-VkDescriptorPool descriptorPool{ VK_NULL_HANDLE };
-VkDescriptorSetLayout descriptorSetLayoutTex{ VK_NULL_HANDLE };
-VkDescriptorSet descriptorSetTex{ VK_NULL_HANDLE };
+// Copies from textures that were moved by defragmentation or lost levels to eviction, recorded at the start of the next frame
+struct TextureCopy {
+	VkImage source{ VK_NULL_HANDLE };
+	VkImage destination{ VK_NULL_HANDLE };
+	uint32_t sourceLevel{ 0 };
+	uint32_t levelCount{ 0 };
+	VkExtent2D extent{};
+};
+std::vector<TextureCopy> textureCopies;
+uint32_t instanceCount{ 3 };
+InstanceBuffer instanceBuffer;
+// Every instance is a root node, node i writes the transform of instance i
+TransformSystem sceneTransforms;
+uint32_t selectedInstance{ 1 };
+GpuCulling culling;
+uint32_t cullFlags{ cullFlagFrustum | cullFlagOcclusion };
+// Draws are recorded into secondary command buffers on all threads of the job system
+JobSystem jobs;
+ParallelRecorder recorder;
+uint32_t recordThreads{ 0 };
+// Issues one draw per instance from the CPU instead of the indirect draws written by the cull pass
+bool directDraws{ false };
+// Task and mesh shaders with per meshlet culling replace the vertex pipeline if the device supports VK_EXT_mesh_shader
+bool useMeshShader{ true };
+bool meshShading{ false };
+// Instances draw a simplified LOD of the mesh once its error projects to less than a pixel
+bool useLods{ true };
+VkPipeline meshPipeline{ VK_NULL_HANDLE };
+VkPipelineLayout meshPipelineLayout{ VK_NULL_HANDLE };
+VmaAllocation meshletBufferAllocation{ VK_NULL_HANDLE };
+VkBuffer meshletBuffer{ VK_NULL_HANDLE };
+// All textures are accessed through one bindless descriptor array, instances store their texture's handle
+BindlessRegistry bindless;
+// Benchmark: Removes and adds this many textures every frame to measure slot recycling and descriptor updates
+uint32_t textureChurn{ 0 };
+std::vector<TextureHandle> churnHandles;
+// Allocations are accounted per category and checked against the heap budgets, --memory-budget caps them to simulate a smaller GPU
+GpuMemory gpuMemory;
+VkDeviceSize memoryBudgetLimit{ 0 };
+// Written every this many frames and on exit if --memory-stats is given
+std::string memoryStatsFile{};
+constexpr uint32_t memoryStatsInterval{ 600 };
+// Defragmentation starts when this share of the free memory is split off the largest free range, --defragment forces one run
+constexpr float defragmentThreshold{ 0.25f };
+constexpr uint32_t defragmentCheckInterval{ 300 };
+bool forceDefragment{ false };
 Slang::ComPtr<slang::IGlobalSession> slangGlobalSession;
 glm::vec3 camPos{ 0.0f, 0.0f, -6.0f };
-glm::vec3 objectRotations[3]{};
+std::vector<glm::vec3> objectRotations;
 sf::Vector2i lastMousePos{};
-struct Vertex {
-	glm::vec3 pos;
-	glm::vec3 normal;
-	glm::vec2 uv;
+// Mesh triangles and instance bounds for mouse picking, owned by the main thread and kept in sync with its input rotations
+SceneBvh sceneBvh;
+// The main thread handles window events and input and publishes what it changed as a snapshot, the render thread builds
+// each frame from the latest one. Neither waits for the other, so a slow frame timeline wait or present doesn't delay input
+struct FrameInput {
+	uint64_t sequence{ 0 };
+	glm::vec3 camPos{ 0.0f };
+	uint32_t selectedInstance{ 0 };
+	// Rotations changed since the last snapshot the render thread picked up, so edits in replaced snapshots aren't lost
+	std::vector<std::pair<uint32_t, glm::vec3>> rotations;
+	sf::Vector2u windowSize{};
+	// When the input was sampled, the start of input to present latency
+	std::chrono::steady_clock::time_point time{};
 };
+TripleBuffer<FrameInput> frameInputs;
+// Sequence of the last snapshot the render thread picked up
+std::atomic<uint64_t> consumedInput{ 0 };
+// Cleared by the main thread when the window is closed and by the render thread once a benchmark has finished
+std::atomic<bool> running{ true };
+// Upper bound for how long the main thread waits for events before publishing the next snapshot
+constexpr std::chrono::milliseconds inputInterval{ 1 };
+// Benchmark: Runs a fixed number of frames with deterministic animation and writes timings as JSON
+uint32_t benchFrames{ 0 };
+std::string benchOutput{ "bench.json" };
+bool useMeshCache{ true };
+std::string meshFile{ "assets/suzanne.obj" };
+// Benchmark: Generates a scene with this many distinct meshes instead of loading the mesh file
+uint32_t syntheticMeshes{ 0 };
+// Packed formats cut vertex memory and fetch bandwidth by half or more, the mesh cache stores the encoded vertices
+VertexFormat vertexFormat{ VertexFormat::Float };
+bool useTransferQueue{ true };
+bool useShaderCache{ true };
+using BenchClock = std::chrono::steady_clock;
+std::vector<double> benchFrameTimes;
+std::vector<double> benchSubmitLatencies;
+std::vector<BenchClock::time_point> benchSubmitTimes;
+std::vector<double> benchGpuTimes;
+std::vector<double> benchInputLatencies;
+// Age of the input snapshots when the render thread picks them up, and the time between two snapshots of the main thread
+std::vector<double> benchInputAges;
+std::vector<double> benchInputIntervals;
+uint32_t benchInputsReplaced{ 0 };
+// Profiling: --profile prints a rolling summary, --profile-trace also writes a Chrome trace on exit
+bool profile{ false };
+std::string profileTrace{};
+std::vector<CullCounters> benchCullStats;
+std::vector<double> benchRecordTimes;
+std::vector<double> benchTransformTimes;
+
+static double percentile(std::vector<double> values, double p) {
+	if (values.empty()) {
+		return 0.0;
+	}
+	std::sort(values.begin(), values.end());
+	const size_t index = std::min(values.size() - 1, static_cast<size_t>(p * (values.size() - 1) + 0.5));
+	return values[index];
+}
+
+// Instances are laid out on a grid, with at least three per row so the default scene keeps its layout
+static glm::vec3 instancePosition(uint32_t index) {
+	const uint32_t columns{ std::max(3u, static_cast<uint32_t>(std::ceil(std::sqrt(static_cast<float>(instanceCount))))) };
+	const uint32_t rows{ (instanceCount + columns - 1) / columns };
+	return glm::vec3(((float)(index % columns) - (float)(columns - 1) * 0.5f) * 3.0f, ((float)(index / columns) - (float)(rows - 1) * 0.5f) * 3.0f, 0.0f);
+}
+
+static glm::mat4 instanceTransform(uint32_t index, const glm::vec3& rotation) {
+	return glm::translate(glm::mat4(1.0f), instancePosition(index)) * glm::mat4_cast(glm::quat(rotation));
+}
+
+// Used for rendering and for unprojecting mouse clicks, so picking matches what's on screen
+static glm::mat4 cameraProjection(float width, float height) {
+	return glm::perspective(glm::radians(45.0f), width / height, 0.1f, 32.0f);
+}
+
+static glm::mat4 cameraView(const glm::vec3& position) {
+	return glm::translate(glm::mat4(1.0f), position);
+}
+
+static void updateInstance(uint32_t index) {
+	// The transform is written by the transform system, only the other attributes are set here
+	InstanceData& instance = instanceBuffer.edit(index);
+	instance.textureIndex = textures[index % textures.size()].handle;
+	instance.meshIndex = meshFirstDraws[index % meshFirstDraws.size()];
+	instance.flags = (index == selectedInstance) ? instanceFlagSelected : 0;
+}
+
+// Replaces a texture's image with a copy that starts at its given level. The new image is either bound to memory handed out by
+// defragmentation or allocated, the old one is retired with the current frame. Instances get the new handle, as the old
+// descriptor may still be in use by frames in flight. Returns false and keeps the texture as it is if no bindless slot is free
+static bool relocateTexture(Texture& texture, uint32_t dropLevels, VmaAllocation destination) {
+	Texture moved{ texture };
+	moved.createInfo.mipLevels -= dropLevels;
+	moved.createInfo.extent = { .width = std::max(1u, texture.createInfo.extent.width >> dropLevels), .height = std::max(1u, texture.createInfo.extent.height >> dropLevels), .depth = 1 };
+	moved.droppedLevels += dropLevels;
+	if (destination != VK_NULL_HANDLE) {
+		chk(vkCreateImage(device, &moved.createInfo, nullptr, &moved.image));
+		chk(vmaBindImageMemory(allocator, destination, moved.image));
+	} else {
+		VmaAllocationCreateInfo allocCI{ .usage = VMA_MEMORY_USAGE_AUTO };
+		chk(gpuMemory.createImage(MemoryCategory::Textures, moved.createInfo, allocCI, moved.image, moved.allocation));
+	}
+	VkImageViewCreateInfo viewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = moved.image, .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = moved.createInfo.format, .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = moved.createInfo.mipLevels, .layerCount = 1 } };
+	chk(vkCreateImageView(device, &viewCI, nullptr, &moved.view));
+	moved.handle = bindless.add(moved.view);
+	if (moved.handle == invalidTexture) {
+		vkDestroyImageView(device, moved.view, nullptr);
+		if (destination != VK_NULL_HANDLE) {
+			vkDestroyImage(device, moved.image, nullptr);
+		} else {
+			gpuMemory.destroyImage(moved.image, moved.allocation);
+		}
+		return false;
+	}
+	textureCopies.push_back({ .source = texture.image, .destination = moved.image, .sourceLevel = dropLevels, .levelCount = moved.createInfo.mipLevels, .extent = {.width = moved.createInfo.extent.width, .height = moved.createInfo.extent.height } });
+	// A moved allocation now belongs to the new image, defragmentation frees the old memory when its pass ends
+	deletionQueue.push(frameIndex, [image = texture.image, view = texture.view, allocation = destination != VK_NULL_HANDLE ? VK_NULL_HANDLE : texture.allocation]() {
+		vkDestroyImageView(device, view, nullptr);
+		if (allocation != VK_NULL_HANDLE) {
+			gpuMemory.destroyImage(image, allocation);
+		} else {
+			vkDestroyImage(device, image, nullptr);
+		}
+	});
+	bindless.remove(texture.handle, deletionQueue, frameIndex);
+	texture = moved;
+	// Every instance is rewritten, which keeps the upload a single range
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		updateInstance(i);
+	}
+	return true;
+}
+
+// Eviction hook: Drops the finest level of the largest textures until the requested amount is released. A texture is relocated
+// at most once per call, its new image only gets its contents with the copy recorded for this frame
+static VkDeviceSize evictTextureLevels(VkDeviceSize overBudget) {
+	// Levels are still streamed into the images before that
+	if (textureStreamer.fullyResidentMs() < 0.0) {
+		return 0;
+	}
+	VkDeviceSize released{ 0 };
+	while (released < overBudget) {
+		Texture* largest{ nullptr };
+		VkDeviceSize largestSize{ 0 };
+		for (auto& texture : textures) {
+			if (std::any_of(textureCopies.begin(), textureCopies.end(), [&](const TextureCopy& copy) { return copy.destination == texture.image; })) {
+				continue;
+			}
+			VmaAllocationInfo allocInfo{};
+			vmaGetAllocationInfo(allocator, texture.allocation, &allocInfo);
+			if (texture.createInfo.mipLevels > 1 && allocInfo.size > largestSize) {
+				largest = &texture;
+				largestSize = allocInfo.size;
+			}
+		}
+		if (!largest) {
+			break;
+		}
+		if (!relocateTexture(*largest, 1, VK_NULL_HANDLE)) {
+			break;
+		}
+		// The first level takes three quarters of a full mip chain
+		released += largestSize * 3 / 4;
+	}
+	if (released > 0) {
+		std::cout << "Over memory budget by " << overBudget / 1024 << " KB, evicted texture levels releasing about " << released / 1024 << " KB\n";
+	}
+	return released;
+}
+
+// Copies all levels of relocated textures, old and new image are both retired or used by this frame only after this
+static void recordTextureCopies(VkCommandBuffer cb) {
+	if (textureCopies.empty()) {
+		return;
+	}
+	std::vector<VkImageMemoryBarrier2> barriers;
+	for (auto& copy : textureCopies) {
+		barriers.push_back({ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2, .srcStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, .srcAccessMask = VK_ACCESS_2_NONE, .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT, .dstAccessMask = VK_ACCESS_2_TRANSFER_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, .newLayout = VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, .image = copy.source, .subresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = copy.sourceLevel, .levelCount = copy.levelCount, .layerCount = 1 } });
+		barriers.push_back({ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2, .srcStageMask = VK_PIPELINE_STAGE_2_NONE, .srcAccessMask = VK_ACCESS_2_NONE, .dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT, .dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED, .newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, .image = copy.destination, .subresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = copy.levelCount, .layerCount = 1 } });
+	}
+	VkDependencyInfo dependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()), .pImageMemoryBarriers = barriers.data() };
+	vkCmdPipelineBarrier2(cb, &dependencyInfo);
+	barriers.clear();
+	for (auto& copy : textureCopies) {
+		std::vector<VkImageCopy> regions;
+		for (uint32_t level = 0; level < copy.levelCount; level++) {
+			regions.push_back({
+				.srcSubresource{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = copy.sourceLevel + level, .layerCount = 1 },
+				.dstSubresource{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level, .layerCount = 1 },
+				.extent{.width = std::max(1u, copy.extent.width >> level), .height = std::max(1u, copy.extent.height >> level), .depth = 1 }
+			});
+		}
+		vkCmdCopyImage(cb, copy.source, VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL, copy.destination, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(regions.size()), regions.data());
+		barriers.push_back({ .sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2, .srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT, .srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT, .dstStageMask = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, .dstAccessMask = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT,
+			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, .newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL, .image = copy.destination, .subresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = copy.levelCount, .layerCount = 1 } });
+	}
+	dependencyInfo.imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size());
+	dependencyInfo.pImageMemoryBarriers = barriers.data();
+	vkCmdPipelineBarrier2(cb, &dependencyInfo);
+	textureCopies.clear();
+}
+
+static void writeTimings(std::ofstream& out, const char* name, const std::vector<double>& values, bool last) {
+	const double mean = values.empty() ? 0.0 : std::accumulate(values.begin(), values.end(), 0.0) / values.size();
+	out << "\t\"" << name << "\": { \"samples\": " << values.size()
+		<< ", \"mean\": " << mean
+		<< ", \"p50\": " << percentile(values, 0.50)
+		<< ", \"p95\": " << percentile(values, 0.95)
+		<< ", \"p99\": " << percentile(values, 0.99)
+		<< ", \"max\": " << (values.empty() ? 0.0 : *std::max_element(values.begin(), values.end()))
+		<< " }" << (last ? "\n" : ",\n");
+}
 
 int main(int argc, char* argv[])
 {
+	const char* usage{ "Usage: HowToVulkan [device index] [--headless] [--bench frames] [--bench-output file] [--no-mesh-cache] [--mesh file] [--synthetic-meshes count] [--vertex-format float|packed16|packed12] [--no-transfer-queue] [--no-shader-cache] [--instances count] [--no-culling] [--no-occlusion] [--direct-draws] [--no-mesh-shader] [--no-lod] [--present-mode fifo|fifo-relaxed|mailbox|immediate] [--swapchain-images count] [--frames-in-flight count] [--present-wait frames] [--texture-churn count] [--memory-budget MB] [--memory-stats file] [--defragment] [--dump-render-graph] [--record-threads count] [--profile] [--profile-trace file] [--bench-objloader triangles] [--bench-ktx2 size] [--bench-transforms nodes] [--bench-bvh triangles]\n" };
+	uint32_t deviceIndex{ 0 };
+	// CPU only benchmarks run without Vulkan once all arguments are parsed, so e.g. --bench-output can come after them
+	uint32_t benchObjLoaderTriangles{ 0 };
+	uint32_t benchKtx2Size{ 0 };
+	uint32_t benchTransformNodes{ 0 };
+	uint32_t benchBvhTriangles{ 0 };
+	for (auto i = 1; i < argc; i++) {
+		const std::string arg{ argv[i] };
+		if (arg == "--headless") {
+			headless = true;
+		} else if (arg == "--bench" && i + 1 < argc) {
+			benchFrames = std::stoi(argv[++i]);
+		} else if (arg == "--bench-output" && i + 1 < argc) {
+			benchOutput = argv[++i];
+		} else if (arg == "--no-mesh-cache") {
+			useMeshCache = false;
+		} else if (arg == "--mesh" && i + 1 < argc) {
+			meshFile = argv[++i];
+		} else if (arg == "--synthetic-meshes" && i + 1 < argc) {
+			syntheticMeshes = std::max(1, std::stoi(argv[++i]));
+		} else if (arg == "--vertex-format" && i + 1 < argc) {
+			if (!parseVertexFormat(argv[++i], vertexFormat)) {
+				std::cerr << "Unknown vertex format " << argv[i] << "\n";
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--no-transfer-queue") {
+			useTransferQueue = false;
+		} else if (arg == "--no-shader-cache") {
+			useShaderCache = false;
+		} else if (arg == "--instances" && i + 1 < argc) {
+			instanceCount = std::max(1, std::stoi(argv[++i]));
+		} else if (arg == "--no-culling") {
+			cullFlags = 0;
+		} else if (arg == "--no-occlusion") {
+			cullFlags &= ~cullFlagOcclusion;
+		} else if (arg == "--direct-draws") {
+			directDraws = true;
+		} else if (arg == "--no-mesh-shader") {
+			useMeshShader = false;
+		} else if (arg == "--no-lod") {
+			useLods = false;
+		} else if (arg == "--present-mode" && i + 1 < argc) {
+			if (!parsePresentMode(argv[++i], presentMode)) {
+				std::cerr << "Unknown present mode " << argv[i] << "\n";
+				return EXIT_FAILURE;
+			}
+		} else if (arg == "--swapchain-images" && i + 1 < argc) {
+			swapchainImageCount = std::max(0, std::stoi(argv[++i]));
+		} else if (arg == "--frames-in-flight" && i + 1 < argc) {
+			framesInFlight = std::clamp(std::stoi(argv[++i]), 1, static_cast<int>(maxFramesInFlight));
+		} else if (arg == "--present-wait" && i + 1 < argc) {
+			presentWait = std::max(0, std::stoi(argv[++i]));
+		} else if (arg == "--texture-churn" && i + 1 < argc) {
+			textureChurn = std::max(0, std::stoi(argv[++i]));
+		} else if (arg == "--memory-budget" && i + 1 < argc) {
+			memoryBudgetLimit = static_cast<VkDeviceSize>(std::max(0, std::stoi(argv[++i]))) * 1024 * 1024;
+		} else if (arg == "--memory-stats" && i + 1 < argc) {
+			memoryStatsFile = argv[++i];
+		} else if (arg == "--defragment") {
+			forceDefragment = true;
+		} else if (arg == "--dump-render-graph") {
+			dumpRenderGraph = true;
+		} else if (arg == "--record-threads" && i + 1 < argc) {
+			recordThreads = std::stoi(argv[++i]);
+		} else if (arg == "--profile") {
+			profile = true;
+		} else if (arg == "--profile-trace" && i + 1 < argc) {
+			profile = true;
+			profileTrace = argv[++i];
+		} else if (arg == "--bench-ktx2" && i + 1 < argc) {
+			benchKtx2Size = std::bit_floor(static_cast<uint32_t>(std::max(1, std::stoi(argv[++i]))));
+		} else if (arg == "--bench-transforms" && i + 1 < argc) {
+			benchTransformNodes = static_cast<uint32_t>(std::max(1, std::stoi(argv[++i])));
+		} else if (arg == "--bench-bvh" && i + 1 < argc) {
+			benchBvhTriangles = static_cast<uint32_t>(std::max(1, std::stoi(argv[++i])));
+		} else if (arg == "--bench-objloader" && i + 1 < argc) {
+			benchObjLoaderTriangles = static_cast<uint32_t>(std::max(1, std::stoi(argv[++i])));
+		} else {
+			const auto [end, error] = std::from_chars(arg.data(), arg.data() + arg.size(), deviceIndex);
+			if (error != std::errc{} || end != arg.data() + arg.size()) {
+				std::cerr << "Unknown argument " << arg << "\n" << usage;
+				return EXIT_FAILURE;
+			}
+		}
+	}
+	if (benchObjLoaderTriangles > 0) {
+		benchmarkObjLoader(benchObjLoaderTriangles, benchOutput);
+		return 0;
+	}
+	// Decodes synthetic KTX 2 textures of the given size
+	if (benchKtx2Size > 0) {
+		benchmarkKtx2(benchKtx2Size, benchOutput);
+		return 0;
+	}
+	// Compares the transform system's kernels against per instance glm math
+	if (benchTransformNodes > 0) {
+		return benchmarkTransforms(benchTransformNodes, benchOutput) ? 0 : EXIT_FAILURE;
+	}
+	// Builds and queries picking BVHs for a synthetic mesh
+	if (benchBvhTriangles > 0) {
+		return benchmarkBvh(benchBvhTriangles, benchOutput) ? 0 : EXIT_FAILURE;
+	}
+	// Without a window there is nothing to close, so headless always runs a fixed number of frames
+	if (headless && benchFrames == 0) {
+		benchFrames = 1;
+	}
+	// The cull pass still runs to fill the visible instance list, with all tests disabled it contains every instance exactly once
+	// Direct draws index the visible list of the full mesh, so all instances have to stay at the first LOD
+	if (directDraws) {
+		cullFlags = 0;
+		useLods = false;
+	}
+	const auto startupStart = BenchClock::now();
 	volkInitialize();
 	// Instance
 	VkApplicationInfo appInfo{ .sType = VK_STRUCTURE_TYPE_APPLICATION_INFO, .pApplicationName = "How to Vulkan", .apiVersion = VK_API_VERSION_1_3 };
-	const std::vector<const char*> instanceExtensions{ sf::Vulkan::getGraphicsRequiredInstanceExtensions() };
+	std::vector<const char*> instanceExtensions{};
+	if (!headless) {
+		instanceExtensions = sf::Vulkan::getGraphicsRequiredInstanceExtensions();
+	}
 	VkInstanceCreateInfo instanceCI{
 		.sType = VK_STRUCTURE_TYPE_INSTANCE_CREATE_INFO,
 		.pApplicationInfo = &appInfo,
@@ -114,12 +542,9 @@ int main(int argc, char* argv[])
 	chk(vkEnumeratePhysicalDevices(instance, &deviceCount, nullptr));
 	std::vector<VkPhysicalDevice> devices(deviceCount);
 	chk(vkEnumeratePhysicalDevices(instance, &deviceCount, devices.data()));
-	uint32_t deviceIndex{ 0 };
-	if (argc > 1) {
-		deviceIndex = std::stoi(argv[1]);
-		assert(deviceIndex < deviceCount);
-	}
-	VkPhysicalDeviceProperties2 deviceProperties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2 };
+	assert(deviceIndex < deviceCount);
+	VkPhysicalDeviceVulkan12Properties vk12Properties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_PROPERTIES };
+	VkPhysicalDeviceProperties2 deviceProperties{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PROPERTIES_2, .pNext = &vk12Properties };
 	vkGetPhysicalDeviceProperties2(devices[deviceIndex], &deviceProperties);
 	std::cout << "Selected device: " << deviceProperties.properties.deviceName << "\n";
 	// Find a queue family for graphics
@@ -134,39 +559,127 @@ int main(int argc, char* argv[])
 			break;
 		}
 	}
+	// A transfer only queue family maps to the GPU's copy engines, uploads on it run in parallel to rendering
+	uint32_t transferFamily{ queueFamily };
+	for (size_t i = 0; i < queueFamilies.size() && useTransferQueue; i++) {
+		if ((queueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[i].queueFlags & (VK_QUEUE_GRAPHICS_BIT | VK_QUEUE_COMPUTE_BIT))) {
+			transferFamily = i;
+			break;
+		}
+	}
+	uint32_t extensionCount{ 0 };
+	chk(vkEnumerateDeviceExtensionProperties(devices[deviceIndex], nullptr, &extensionCount, nullptr));
+	std::vector<VkExtensionProperties> extensions(extensionCount);
+	chk(vkEnumerateDeviceExtensionProperties(devices[deviceIndex], nullptr, &extensionCount, extensions.data()));
+	const auto hasExtension = [&](const char* name) {
+		return std::any_of(extensions.begin(), extensions.end(), [name](const VkExtensionProperties& extension) { return strcmp(extension.extensionName, name) == 0; });
+	};
+	// Mesh shading is optional, the vertex pipeline is used if the device doesn't support it. Direct draws only exist for the vertex pipeline
+	VkPhysicalDeviceMeshShaderFeaturesEXT meshShaderFeatures{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT };
+	if (useMeshShader && !directDraws && hasExtension(VK_EXT_MESH_SHADER_EXTENSION_NAME)) {
+		VkPhysicalDeviceFeatures2 features2{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &meshShaderFeatures };
+		vkGetPhysicalDeviceFeatures2(devices[deviceIndex], &features2);
+		meshShading = meshShaderFeatures.taskShader && meshShaderFeatures.meshShader;
+	}
+	std::cout << (meshShading ? "Rendering with task and mesh shaders\n" : "Rendering with the vertex pipeline\n");
+	// Only enable what's used, the query also reported the optional mesh shader features
+	meshShaderFeatures = { .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_MESH_SHADER_FEATURES_EXT, .taskShader = VK_TRUE, .meshShader = VK_TRUE };
+	// Present timing needs both extensions, without them the frame loop only paces on its frame timeline
+	VkPhysicalDevicePresentIdFeaturesKHR presentIdFeatures{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_ID_FEATURES_KHR };
+	VkPhysicalDevicePresentWaitFeaturesKHR presentWaitFeatures{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_PRESENT_WAIT_FEATURES_KHR, .pNext = &presentIdFeatures };
+	if (!headless && hasExtension(VK_KHR_PRESENT_ID_EXTENSION_NAME) && hasExtension(VK_KHR_PRESENT_WAIT_EXTENSION_NAME)) {
+		VkPhysicalDeviceFeatures2 features2{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_FEATURES_2, .pNext = &presentWaitFeatures };
+		vkGetPhysicalDeviceFeatures2(devices[deviceIndex], &features2);
+		presentTiming = presentIdFeatures.presentId && presentWaitFeatures.presentWait;
+	}
+	if (!headless && !presentTiming) {
+		std::cout << "VK_KHR_present_wait not supported, input to present latency is not measured\n";
+		presentWait = 0;
+	}
+	// Optional feature structures are chained in front of the core ones
+	void* featureChain{ meshShading ? &meshShaderFeatures : nullptr };
+	if (presentTiming) {
+		presentIdFeatures.pNext = featureChain;
+		featureChain = &presentWaitFeatures;
+	}
 	// Logical device
 	const float qfpriorities{ 1.0f };
-	VkDeviceQueueCreateInfo queueCI{ .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, .queueFamilyIndex = queueFamily, .queueCount = 1, .pQueuePriorities = &qfpriorities };
-	VkPhysicalDeviceVulkan12Features enabledVk12Features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, .descriptorIndexing = true, .descriptorBindingVariableDescriptorCount = true, .runtimeDescriptorArray = true, .bufferDeviceAddress = true };
+	std::vector<VkDeviceQueueCreateInfo> queueCIs{ { .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, .queueFamilyIndex = queueFamily, .queueCount = 1, .pQueuePriorities = &qfpriorities } };
+	if (transferFamily != queueFamily) {
+		queueCIs.push_back({ .sType = VK_STRUCTURE_TYPE_DEVICE_QUEUE_CREATE_INFO, .queueFamilyIndex = transferFamily, .queueCount = 1, .pQueuePriorities = &qfpriorities });
+	}
+	VkPhysicalDeviceVulkan12Features enabledVk12Features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_2_FEATURES, .pNext = featureChain, .drawIndirectCount = true, .descriptorIndexing = true, .shaderSampledImageArrayNonUniformIndexing = true, .descriptorBindingSampledImageUpdateAfterBind = true, .descriptorBindingUpdateUnusedWhilePending = true, .descriptorBindingPartiallyBound = true, .descriptorBindingVariableDescriptorCount = true, .runtimeDescriptorArray = true, .timelineSemaphore = true, .bufferDeviceAddress = true };
 	VkPhysicalDeviceVulkan13Features enabledVk13Features{ .sType = VK_STRUCTURE_TYPE_PHYSICAL_DEVICE_VULKAN_1_3_FEATURES, .pNext = &enabledVk12Features, .synchronization2 = true, .dynamicRendering = true };
-	const std::vector<const char*> deviceExtensions{ VK_KHR_SWAPCHAIN_EXTENSION_NAME };
+	std::vector<const char*> deviceExtensions{};
+	if (!headless) {
+		deviceExtensions.push_back(VK_KHR_SWAPCHAIN_EXTENSION_NAME);
+	}
+	if (meshShading) {
+		deviceExtensions.push_back(VK_EXT_MESH_SHADER_EXTENSION_NAME);
+	}
+	if (presentTiming) {
+		deviceExtensions.push_back(VK_KHR_PRESENT_ID_EXTENSION_NAME);
+		deviceExtensions.push_back(VK_KHR_PRESENT_WAIT_EXTENSION_NAME);
+	}
+	// Without it VMA estimates the budgets from its own allocations and the heap sizes
+	const bool memoryBudget{ hasExtension(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME) };
+	if (memoryBudget) {
+		deviceExtensions.push_back(VK_EXT_MEMORY_BUDGET_EXTENSION_NAME);
+	}
 	const VkPhysicalDeviceFeatures enabledVk10Features{ .samplerAnisotropy = VK_TRUE };
 	VkDeviceCreateInfo deviceCI{
 		.sType = VK_STRUCTURE_TYPE_DEVICE_CREATE_INFO,
 		.pNext = &enabledVk13Features,
-		.queueCreateInfoCount = 1,
-		.pQueueCreateInfos = &queueCI,
+		.queueCreateInfoCount = static_cast<uint32_t>(queueCIs.size()),
+		.pQueueCreateInfos = queueCIs.data(),
 		.enabledExtensionCount = static_cast<uint32_t>(deviceExtensions.size()),
 		.ppEnabledExtensionNames = deviceExtensions.data(),
 		.pEnabledFeatures = &enabledVk10Features
 	};
 	chk(vkCreateDevice(devices[deviceIndex], &deviceCI, nullptr, &device));
 	vkGetDeviceQueue(device, queueFamily, 0, &queue);
+	vkGetDeviceQueue(device, transferFamily, 0, &transferQueue);
 	// VMA
 	VmaVulkanFunctions vkFunctions{ .vkGetInstanceProcAddr = vkGetInstanceProcAddr, .vkGetDeviceProcAddr = vkGetDeviceProcAddr, .vkCreateImage = vkCreateImage };
-	VmaAllocatorCreateInfo allocatorCI{ .flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT, .physicalDevice = devices[deviceIndex], .device = device, .pVulkanFunctions = &vkFunctions, .instance = instance };
+	VmaAllocatorCreateInfo allocatorCI{ .flags = VMA_ALLOCATOR_CREATE_BUFFER_DEVICE_ADDRESS_BIT | (memoryBudget ? VMA_ALLOCATOR_CREATE_EXT_MEMORY_BUDGET_BIT : 0u), .physicalDevice = devices[deviceIndex], .device = device, .pVulkanFunctions = &vkFunctions, .instance = instance, .vulkanApiVersion = VK_API_VERSION_1_3 };
 	chk(vmaCreateAllocator(&allocatorCI, &allocator));
+	gpuMemory.create(allocator, memoryBudgetLimit);
+	gpuMemory.setEvictionHook(evictTextureLevels);
+	// Uploads
+	uploads.create(device, allocator, queue, queueFamily, transferQueue, transferFamily);
+	gpuMemory.track(MemoryCategory::Transient, uploads.ringMemory());
+	if (uploads.ownershipTransfer()) {
+		std::cout << "Using dedicated transfer queue family " << transferFamily << " for uploads\n";
+	}
 	// Window and surface
-	auto window = sf::RenderWindow(sf::VideoMode({ 1280, 720u }), "How to Vulkan");
-	chk(window.createVulkanSurface(instance, surface));
+	sf::RenderWindow window;
 	VkSurfaceCapabilitiesKHR surfaceCaps{};
-	chk(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(devices[deviceIndex], surface, &surfaceCaps));
+	if (!headless) {
+		window.create(sf::VideoMode({ renderExtent.width, renderExtent.height }), "How to Vulkan");
+		chk(window.createVulkanSurface(instance, surface));
+		chk(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(devices[deviceIndex], surface, &surfaceCaps));
+		renderExtent = { .width = window.getSize().x, .height = window.getSize().y };
+		uint32_t presentModeCount{ 0 };
+		chk(vkGetPhysicalDeviceSurfacePresentModesKHR(devices[deviceIndex], surface, &presentModeCount, nullptr));
+		std::vector<VkPresentModeKHR> presentModes(presentModeCount);
+		chk(vkGetPhysicalDeviceSurfacePresentModesKHR(devices[deviceIndex], surface, &presentModeCount, presentModes.data()));
+		const VkPresentModeKHR requestedMode{ presentMode };
+		presentMode = choosePresentMode(requestedMode, presentModes);
+		if (presentMode != requestedMode) {
+			std::cout << "Present mode " << presentModeName(requestedMode) << " not supported, using " << presentModeName(presentMode) << "\n";
+		}
+		// A max image count of zero means there is no upper limit
+		swapchainImageCount = std::max(swapchainImageCount, surfaceCaps.minImageCount);
+		if (surfaceCaps.maxImageCount > 0) {
+			swapchainImageCount = std::min(swapchainImageCount, surfaceCaps.maxImageCount);
+		}
+	}
 	// Swap chain
 	const VkFormat imageFormat{ VK_FORMAT_B8G8R8A8_SRGB };
 	VkSwapchainCreateInfoKHR swapchainCI{
 		.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR,
 		.surface = surface,
-		.minImageCount = surfaceCaps.minImageCount,
+		.minImageCount = swapchainImageCount,
 		.imageFormat = imageFormat,
 		.imageColorSpace = VK_COLORSPACE_SRGB_NONLINEAR_KHR,
 		.imageExtent{.width = surfaceCaps.currentExtent.width, .height = surfaceCaps.currentExtent.height },
@@ -174,229 +687,407 @@ int main(int argc, char* argv[])
 		.imageUsage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT,
 		.preTransform = VK_SURFACE_TRANSFORM_IDENTITY_BIT_KHR,
 		.compositeAlpha = VK_COMPOSITE_ALPHA_OPAQUE_BIT_KHR,
-		.presentMode = VK_PRESENT_MODE_FIFO_KHR
+		.presentMode = presentMode
 	};
-	chk(vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapchain));
 	uint32_t imageCount{ 0 };
-	vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
-	swapchainImages.resize(imageCount);
-	vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchainImages.data());
+	if (!headless) {
+		chk(vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapchain));
+		vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
+		swapchainImages.resize(imageCount);
+		vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchainImages.data());
+		std::cout << "Presenting with " << presentModeName(presentMode) << ", " << imageCount << " swapchain images and " << framesInFlight << " frames in flight\n";
+		if (presentTiming) {
+			presentPacer.start(device, swapchain);
+		}
+	} else {
+		// Offscreen color images, one per frame in flight, that take the place of the swapchain images
+		imageCount = framesInFlight;
+		swapchainImages.resize(imageCount);
+		offscreenImageAllocations.resize(imageCount);
+		VkImageCreateInfo offscreenImageCI{
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = imageFormat,
+			.extent{.width = renderExtent.width, .height = renderExtent.height, .depth = 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = VK_IMAGE_USAGE_COLOR_ATTACHMENT_BIT | VK_IMAGE_USAGE_TRANSFER_SRC_BIT,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+		};
+		VmaAllocationCreateInfo offscreenAllocCI{ .usage = VMA_MEMORY_USAGE_AUTO };
+		for (auto i = 0; i < imageCount; i++) {
+			chk(gpuMemory.createImage(MemoryCategory::Attachments, offscreenImageCI, offscreenAllocCI, swapchainImages[i], offscreenImageAllocations[i]));
+		}
+	}
 	swapchainImageViews.resize(imageCount);
 	for (auto i = 0; i < imageCount; i++) {
 		VkImageViewCreateInfo viewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = swapchainImages[i], .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = imageFormat, .subresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 } };
 		chk(vkCreateImageView(device, &viewCI, nullptr, &swapchainImageViews[i]));
 	}
-	// Depth attachment
+	// Depth attachment, created by the render graph
 	const VkFormat depthFormat{ VK_FORMAT_D24_UNORM_S8_UINT };
-	VkImageCreateInfo depthImageCI{
-		.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
-		.imageType = VK_IMAGE_TYPE_2D,
-		.format = depthFormat,
-		.extent{.width = window.getSize().x, .height = window.getSize().y, .depth = 1 },
-		.mipLevels = 1,
-		.arrayLayers = 1,
-		.samples = VK_SAMPLE_COUNT_1_BIT,
-		.tiling = VK_IMAGE_TILING_OPTIMAL,
-		.usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
-		.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-	};
-	VmaAllocationCreateInfo allocCI{ .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, .usage = VMA_MEMORY_USAGE_AUTO };
-	vmaCreateImage(allocator, &depthImageCI, &allocCI, &depthImage, &depthImageAllocation, nullptr);
-	VkImageViewCreateInfo depthViewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = depthImage, .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = depthFormat, .subresourceRange{.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT, .levelCount = 1, .layerCount = 1 } };
-	chk(vkCreateImageView(device, &depthViewCI, nullptr, &depthImageView));
+	renderGraph.create(device, allocator, gpuMemory);
+	renderGraph.setDump(dumpRenderGraph);
+	// Also builds the mesh LODs at load time
+	jobs.start(recordThreads);
 	// Mesh data
-	tinyobj::attrib_t attrib;
-	std::vector<tinyobj::shape_t> shapes;
-	std::vector<tinyobj::material_t> materials;
-	chk(tinyobj::LoadObj(&attrib, &shapes, &materials, nullptr, nullptr, "assets/suzanne.obj"));
-	const VkDeviceSize indexCount{ shapes[0].mesh.indices.size() };
-	std::vector<Vertex> vertices{};
-	std::vector<uint16_t> indices{};
-	// Load vertex and index data
-	for (auto& index : shapes[0].mesh.indices) {
-		Vertex v{
-			.pos = { attrib.vertices[index.vertex_index * 3], -attrib.vertices[index.vertex_index * 3 + 1], attrib.vertices[index.vertex_index * 3 + 2] },
-			.normal = { attrib.normals[index.normal_index * 3], -attrib.normals[index.normal_index * 3 + 1], attrib.normals[index.normal_index * 3 + 2] },
-			.uv = { attrib.texcoords[index.texcoord_index * 2], 1.0 - attrib.texcoords[index.texcoord_index * 2 + 1] } 
+	// Vertex layout, shared by the mesh cache and the pipeline
+	VkVertexInputBindingDescription vertexBinding{ .binding = 0, .stride = vertexFormatStride(vertexFormat), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX };
+	const std::vector<VkVertexInputAttributeDescription> vertexAttributes{ vertexFormatAttributes(vertexFormat) };
+	MeshCacheLayout vertexLayout{ .stride = vertexBinding.stride, .attributeCount = static_cast<uint32_t>(vertexAttributes.size()) };
+	for (auto i = 0; i < vertexAttributes.size(); i++) {
+		vertexLayout.attributes[i] = { .location = vertexAttributes[i].location, .format = static_cast<uint32_t>(vertexAttributes[i].format), .offset = vertexAttributes[i].offset };
+	}
+	const auto meshLoadStart = BenchClock::now();
+	if (syntheticMeshes > 0) {
+		meshFile = "synthetic_scene.obj";
+		writeSyntheticScene(meshFile, syntheticMeshes);
+	}
+	const std::string meshCacheFile{ meshFile.substr(0, meshFile.find_last_of('.')) + ".meshcache" };
+	// A valid cache is memory mapped and copied straight to the buffers, otherwise the OBJ is parsed and the cache (re)written
+	MappedFile meshCacheMapping;
+	MeshCacheHeader meshHeader{};
+	const bool meshFromCache{ useMeshCache && loadMeshCache(meshCacheFile, meshFile, vertexLayout, meshCacheMapping, meshHeader) };
+	// Every object and material of the OBJ is a mesh of its own, their vertices and indices are stored back to back
+	std::vector<MeshCacheMesh> meshes{};
+	std::string materialLibrary{};
+	std::vector<uint8_t> encodedVertices{};
+	std::vector<uint32_t> indices{};
+	std::vector<uint16_t> indices16{};
+	const void* vertexData{ nullptr };
+	const void* indexData{ nullptr };
+	if (meshFromCache) {
+		const MeshCacheMesh* cachedMeshes{ meshCacheMeshes(meshCacheMapping, meshHeader) };
+		meshes.assign(cachedMeshes, cachedMeshes + meshHeader.meshCount);
+		materialLibrary = meshHeader.materialLibrary;
+		vertexData = meshCacheMapping.data() + meshHeader.vertexOffset;
+		indexData = meshCacheMapping.data() + meshHeader.indexOffset;
+	} else {
+		// Load vertex and index data, parsed on all cores
+		std::vector<Vertex> objVertices{};
+		std::vector<uint32_t> objIndices{};
+		ObjScene objScene{};
+		chk(loadObjParallel(meshFile, objVertices, objIndices, objScene));
+		materialLibrary = objScene.materialLibrary;
+		// Scenes with several meshes process one mesh per job, a single mesh builds its LOD levels in parallel instead
+		struct ProcessedMesh {
+			std::vector<Vertex> vertices;
+			std::vector<uint32_t> indices;
+			MeshStats stats;
+			std::vector<MeshLod> lods;
 		};
-		vertices.push_back(v);
-		indices.push_back(indices.size());
-	}
-	VkDeviceSize vBufSize{ sizeof(Vertex) * vertices.size() };
-	VkDeviceSize iBufSize{ sizeof(uint16_t) * indices.size() };
-	VkBufferCreateInfo bufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = vBufSize + iBufSize, .usage = VK_BUFFER_USAGE_VERTEX_BUFFER_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT };
-	VmaAllocationCreateInfo bufferAllocCI{ .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, .usage = VMA_MEMORY_USAGE_AUTO };
-	chk(vmaCreateBuffer(allocator, &bufferCI, &bufferAllocCI, &vBuffer, &vBufferAllocation, nullptr));
-	void* bufferPtr{ nullptr };
-	vmaMapMemory(allocator, vBufferAllocation, &bufferPtr);
-	memcpy(bufferPtr, vertices.data(), vBufSize);
-	memcpy(((char*)bufferPtr) + vBufSize, indices.data(), iBufSize);
-	vmaUnmapMemory(allocator, vBufferAllocation);
-	// Shader data buffers
-	for (auto i = 0; i < maxFramesInFlight; i++) {
-		VkBufferCreateInfo uBufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = sizeof(ShaderData), .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT };
-		VmaAllocationCreateInfo uBufferAllocCI{ .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_HOST_ACCESS_ALLOW_TRANSFER_INSTEAD_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, .usage = VMA_MEMORY_USAGE_AUTO };
-		chk(vmaCreateBuffer(allocator, &uBufferCI, &uBufferAllocCI, &shaderDataBuffers[i].buffer, &shaderDataBuffers[i].allocation, nullptr));
-		vmaMapMemory(allocator, shaderDataBuffers[i].allocation, &shaderDataBuffers[i].mapped);
-		VkBufferDeviceAddressInfo uBufferBdaInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = shaderDataBuffers[i].buffer };
-		shaderDataBuffers[i].deviceAddress = vkGetBufferDeviceAddress(device, &uBufferBdaInfo);
-	}
-	// Sync objects
+		std::vector<ProcessedMesh> processedMeshes(objScene.groups.size());
+		const auto processMesh = [&](uint32_t g, JobSystem* lodJobs) {
+			const ObjGroup& group = objScene.groups[g];
+			ProcessedMesh& processed = processedMeshes[g];
+			processed.vertices.assign(objVertices.begin() + group.firstIndex, objVertices.begin() + group.firstIndex + group.indexCount);
+			processed.indices.resize(group.indexCount);
+			std::iota(processed.indices.begin(), processed.indices.end(), 0);
+			// Weld duplicate vertices and reorder for the post-transform cache and overdraw
+			processed.stats = optimizeMesh(processed.vertices, processed.indices);
+			// Simplified LODs are appended to the indices and share the vertices of the full mesh
+			processed.lods = buildLods(processed.vertices, processed.indices, lodJobs);
+		};
+		const bool singleMesh{ objScene.groups.size() == 1 };
+		if (singleMesh) {
+			processMesh(0, &jobs);
+		} else {
+			jobs.parallelFor(static_cast<uint32_t>(objScene.groups.size()), 1, [&](uint32_t begin, uint32_t end, uint32_t) {
+				for (uint32_t g = begin; g < end; g++) {
+					processMesh(g, nullptr);
+				}
+			});
+		}
+		if (singleMesh) {
+			printMeshStats(processedMeshes[0].stats, processedMeshes[0].lods[0].indexCount);
+			printLods(processedMeshes[0].lods);
+		}
+		// Meshes are appended in the order of the OBJ, so the output doesn't depend on which job finished first
+		uint64_t maxMeshVertices{ 0 };
+		for (size_t g = 0; g < objScene.groups.size(); g++) {
+			const ObjGroup& group = objScene.groups[g];
+			const std::vector<Vertex>& vertices = processedMeshes[g].vertices;
+			const std::vector<uint32_t>& meshIndices = processedMeshes[g].indices;
+			const std::vector<MeshLod>& lods = processedMeshes[g].lods;
+			MeshCacheMesh mesh{ .firstVertex = encodedVertices.size() / vertexBinding.stride, .vertexCount = vertices.size(), .firstIndex = indices.size(), .indexCount = meshIndices.size(), .lodCount = static_cast<uint32_t>(std::min<size_t>(lods.size(), meshCacheMaxLods)) };
+			for (uint32_t i = 0; i < mesh.lodCount; i++) {
+				mesh.lods[i] = { .firstIndex = lods[i].firstIndex, .indexCount = lods[i].indexCount, .error = lods[i].error };
+			}
+			group.material.copy(mesh.material, meshCacheMaxName - 1);
+			// Quantization only changes the vertices, so simplification above still works with the full precision data
+			const std::vector<uint8_t> encoded{ encodeVertices(vertices, vertexFormat, mesh.encoding) };
+			encodedVertices.insert(encodedVertices.end(), encoded.begin(), encoded.end());
+			indices.insert(indices.end(), meshIndices.begin(), meshIndices.end());
+			maxMeshVertices = std::max<uint64_t>(maxMeshVertices, vertices.size());
+			meshes.push_back(mesh);
+		}
+		// 16 bit indices are enough for most meshes and halve index fetch bandwidth. Indices are relative to their mesh, so only the largest mesh decides
+		meshHeader.vertexCount = encodedVertices.size() / vertexBinding.stride;
+		meshHeader.indexCount = indices.size();
+		meshHeader.indexSize = maxMeshVertices <= UINT16_MAX ? sizeof(uint16_t) : sizeof(uint32_t);
+		vertexData = encodedVertices.data();
+		indexData = indices.data();
+		if (meshHeader.indexSize == sizeof(uint16_t)) {
+			indices16.assign(indices.begin(), indices.end());
+			indexData = indices16.data();
+		}
+		if (useMeshCache && !writeMeshCache(meshCacheFile, meshFile, vertexLayout, materialLibrary, meshes.data(), static_cast<uint32_t>(meshes.size()), vertexData, meshHeader.vertexCount, indexData, meshHeader.indexCount, meshHeader.indexSize)) {
+			std::cerr << "Could not write mesh cache " << meshCacheFile << "\n";
+		}
+	}
+	chk(!meshes.empty());
+	// Materials are resolved by name, meshes without a known material are white
+	std::unordered_map<std::string, glm::vec3> materialColors{};
+	if (!materialLibrary.empty() && !loadObjMaterials((std::filesystem::path(meshFile).parent_path() / materialLibrary).string(), materialColors)) {
+		std::cerr << "Could not load material library " << materialLibrary << "\n";
+	}
+	// Quantization errors are reported for the worst mesh
+	VertexEncoding vertexEncoding{ meshes[0].encoding };
+	for (auto& mesh : meshes) {
+		vertexEncoding.positionError = std::max(vertexEncoding.positionError, mesh.encoding.positionError);
+		vertexEncoding.normalErrorDegrees = std::max(vertexEncoding.normalErrorDegrees, mesh.encoding.normalErrorDegrees);
+		vertexEncoding.uvError = std::max(vertexEncoding.uvError, mesh.encoding.uvError);
+	}
+	printVertexEncoding(vertexEncoding, meshHeader.vertexCount);
+	// All meshes share one vertex and one index buffer, with some room for meshes added later
+	const VkPipelineStageFlags2 meshletStages{ meshShading ? VK_PIPELINE_STAGE_2_TASK_SHADER_BIT_EXT | VK_PIPELINE_STAGE_2_MESH_SHADER_BIT_EXT : VK_PIPELINE_STAGE_2_NONE };
+	geometryPool.create(device, gpuMemory, vertexBinding.stride, meshHeader.indexSize, static_cast<uint32_t>(meshHeader.vertexCount + meshHeader.vertexCount / 4), static_cast<uint32_t>(meshHeader.indexCount + meshHeader.indexCount / 4));
+	// Index count of the full meshes, the index buffer also contains the LODs
+	VkDeviceSize indexCount{ 0 };
+	std::vector<MeshDraw> meshDraws{};
+	MeshletData meshletData{};
+	MeshletStats meshletStats{};
+	const uint32_t meshCount{ static_cast<uint32_t>(meshes.size()) };
+	uint32_t instanceSlots{ 0 };
+	for (uint32_t m = 0; m < meshCount; m++) {
+		const MeshCacheMesh& mesh = meshes[m];
+		GeometryRange range{};
+		chk(geometryPool.allocate(static_cast<uint32_t>(mesh.vertexCount), static_cast<uint32_t>(mesh.indexCount), range));
+		const uint8_t* meshVertices{ static_cast<const uint8_t*>(vertexData) + mesh.firstVertex * vertexBinding.stride };
+		const uint8_t* meshIndices{ static_cast<const uint8_t*>(indexData) + mesh.firstIndex * meshHeader.indexSize };
+		memcpy(geometryPool.uploadVertices(uploads, range, VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | meshletStages, VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | (meshShading ? VK_ACCESS_2_SHADER_STORAGE_READ_BIT : VK_ACCESS_2_NONE)), meshVertices, mesh.vertexCount * vertexBinding.stride);
+		memcpy(geometryPool.uploadIndices(uploads, range), meshIndices, mesh.indexCount * meshHeader.indexSize);
+		// Bounds and meshlets are calculated from the dequantized positions, so they match what the GPU renders
+		const std::vector<glm::vec3> positions{ decodePositions(meshVertices, mesh.vertexCount, mesh.encoding) };
+		const glm::vec4 meshBounds{ calculateBoundingSphere(positions.data(), positions.size(), sizeof(glm::vec3)) };
+		// Picking tests against the full detail triangles, whatever LOD is on screen
+		sceneBvh.addMesh(positions.data(), meshIndices + mesh.lods[0].firstIndex * meshHeader.indexSize, mesh.lods[0].indexCount, meshHeader.indexSize, &jobs);
+		const auto material = materialColors.find(mesh.material);
+		// One draw entry per LOD, each with room for all instances of the mesh in the visible list
+		const uint32_t meshInstances{ instanceCount / meshCount + (m < instanceCount % meshCount ? 1 : 0) };
+		const uint32_t lodCount{ useLods ? mesh.lodCount : 1 };
+		meshFirstDraws.push_back(static_cast<uint32_t>(meshDraws.size()));
+		indexCount += mesh.lods[0].indexCount;
+		for (uint32_t i = 0; i < lodCount; i++) {
+			MeshDraw& meshDraw = meshDraws.emplace_back(MeshDraw{
+				.indexCount = mesh.lods[i].indexCount,
+				.firstIndex = range.firstIndex + mesh.lods[i].firstIndex,
+				.vertexOffset = range.vertexOffset,
+				.instanceOffset = instanceSlots,
+				.lodError = mesh.lods[i].error,
+				.lodCount = lodCount,
+				.bounds = meshBounds,
+				.positionScale = glm::vec4(mesh.encoding.positionScale, 0.0f),
+				.positionOffset = mesh.encoding.positionOffset,
+				.vertexFormat = static_cast<uint32_t>(mesh.encoding.format),
+				.diffuse = material != materialColors.end() ? glm::vec4(material->second, 1.0f) : glm::vec4(1.0f)
+			});
+			instanceSlots += meshInstances;
+			// Meshlets are built from the optimized indices of every LOD, so they inherit their vertex locality
+			if (meshShading) {
+				meshDraw.meshletOffset = static_cast<uint32_t>(meshletData.meshlets.size());
+				buildMeshlets(meshletData, positions.data(), positions.size(), sizeof(glm::vec3), meshIndices + mesh.lods[i].firstIndex * meshHeader.indexSize, meshDraw.indexCount, meshHeader.indexSize);
+				meshDraw.meshletCount = static_cast<uint32_t>(meshletData.meshlets.size()) - meshDraw.meshletOffset;
+			}
+		}
+	}
+	std::cout << "Scene: " << meshCount << " meshes, " << materialColors.size() << " materials, " << meshHeader.vertexCount << " vertices, " << indexCount / 3 << " triangles\n";
+	if (meshShading) {
+		meshletStats = calculateMeshletStats(meshletData);
+		printMeshletStats(meshletStats, meshHeader.vertexCount);
+	}
+	VmaAllocationCreateInfo bufferAllocCI{ .usage = VMA_MEMORY_USAGE_AUTO_PREFER_DEVICE };
+	if (meshShading) {
+		// Meshlets, their vertex indices and their triangles back to back in one buffer
+		const VkDeviceSize meshletsSize{ meshletData.meshlets.size() * sizeof(Meshlet) };
+		const VkDeviceSize meshletVerticesSize{ meshletData.vertices.size() * sizeof(uint32_t) };
+		const VkDeviceSize meshletTrianglesSize{ meshletData.triangles.size() * sizeof(uint32_t) };
+		VkBufferCreateInfo meshletBufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = meshletsSize + meshletVerticesSize + meshletTrianglesSize, .usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT };
+		chk(gpuMemory.createBuffer(MemoryCategory::Geometry, meshletBufferCI, bufferAllocCI, meshletBuffer, meshletBufferAllocation));
+		memcpy(uploads.uploadBuffer(meshletBuffer, 0, meshletsSize, meshletStages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT), meshletData.meshlets.data(), meshletsSize);
+		memcpy(uploads.uploadBuffer(meshletBuffer, meshletsSize, meshletVerticesSize, meshletStages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT), meshletData.vertices.data(), meshletVerticesSize);
+		memcpy(uploads.uploadBuffer(meshletBuffer, meshletsSize + meshletVerticesSize, meshletTrianglesSize, meshletStages, VK_ACCESS_2_SHADER_STORAGE_READ_BIT), meshletData.triangles.data(), meshletTrianglesSize);
+		VkBufferDeviceAddressInfo meshletBdaInfo{ .sType = VK_STRUCTURE_TYPE_BUFFER_DEVICE_ADDRESS_INFO, .buffer = meshletBuffer };
+		shaderData.meshlets = vkGetBufferDeviceAddress(device, &meshletBdaInfo);
+		shaderData.meshletVertices = shaderData.meshlets + meshletsSize;
+		shaderData.meshletTriangles = shaderData.meshletVertices + meshletVerticesSize;
+		shaderData.vertices = geometryPool.vertexAddress();
+	}
+	meshCacheMapping.close();
+	const double meshLoadMs{ std::chrono::duration<double, std::milli>(BenchClock::now() - meshLoadStart).count() };
+	std::cout << "Mesh loaded from " << (meshFromCache ? meshCacheFile : meshFile) << " in " << meshLoadMs << " ms\n";
+	// Per-frame transient data
+	frameArena.create(allocator, device, frameArenaSize, framesInFlight);
+	gpuMemory.track(MemoryCategory::Transient, frameArena.memory());
+	deletionQueue.create(framesInFlight);
+	// Instance data
+	instanceBuffer.create(allocator, device, instanceCount, framesInFlight, meshShading);
+	objectRotations.resize(instanceCount, glm::vec3(0.0f));
+	sceneTransforms.reserve(instanceCount);
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		sceneTransforms.add(TransformSystem::noParent, instancePosition(i), glm::quat(objectRotations[i]));
+		sceneBvh.setInstance(i, i % meshCount, instanceTransform(i, objectRotations[i]));
+	}
+	sceneBvh.build(&jobs);
+	selectedInstance = std::min(selectedInstance, instanceCount - 1);
+	shaderData.instances = instanceBuffer.address();
+	// Profiler, GPU zones use timestamp queries on the graphics queue
+	profiler.create(device, deviceProperties.properties.limits.timestampPeriod, queueFamilies[queueFamily].timestampValidBits, framesInFlight);
+	profiler.setThreadName("Main");
+	profiler.setEnabled(profile);
+	if (profile) {
+		profiler.setSummaryInterval(benchFrames > 0 ? benchFrames : 300);
+	}
+	if (!profileTrace.empty()) {
+		profiler.startCapture();
+	}
+	// Sync objects, presentation only works with binary semaphores so acquire and present keep using those
 	VkSemaphoreCreateInfo semaphoreCI{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO };
-	VkFenceCreateInfo fenceCI{ .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO, .flags = VK_FENCE_CREATE_SIGNALED_BIT };
-	for (auto i = 0; i < maxFramesInFlight; i++) {
-		chk(vkCreateFence(device, &fenceCI, nullptr, &fences[i]));
+	VkSemaphoreTypeCreateInfo timelineCI{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO, .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE, .initialValue = 0 };
+	VkSemaphoreCreateInfo timelineSemaphoreCI{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &timelineCI };
+	chk(vkCreateSemaphore(device, &timelineSemaphoreCI, nullptr, &frameTimeline));
+	frameTimelineValues.resize(framesInFlight, 0);
+	presentSemaphores.resize(framesInFlight);
+	for (auto i = 0; i < framesInFlight; i++) {
 		chk(vkCreateSemaphore(device, &semaphoreCI, nullptr, &presentSemaphores[i]));
 	}
 	renderSemaphores.resize(swapchainImages.size());
 	for (auto& semaphore : renderSemaphores) {
 		chk(vkCreateSemaphore(device, &semaphoreCI, nullptr, &semaphore));
 	}
-	// Command pool
-	VkCommandPoolCreateInfo commandPoolCI{ .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT, .queueFamilyIndex = queueFamily };
-	chk(vkCreateCommandPool(device, &commandPoolCI, nullptr, &commandPool));
-	VkCommandBufferAllocateInfo cbAllocCI{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, .commandPool = commandPool, .commandBufferCount = maxFramesInFlight };
-	chk(vkAllocateCommandBuffers(device, &cbAllocCI, commandBuffers.data()));
-	// Texture images
-	std::vector<VkDescriptorImageInfo> textureDescriptors{};
+	// Command pools
+	VkCommandPoolCreateInfo commandPoolCI{ .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, .queueFamilyIndex = queueFamily };
+	commandPools.resize(framesInFlight);
+	commandBuffers.resize(framesInFlight);
+	benchSubmitTimes.resize(framesInFlight);
+	for (auto i = 0; i < framesInFlight; i++) {
+		chk(vkCreateCommandPool(device, &commandPoolCI, nullptr, &commandPools[i]));
+		VkCommandBufferAllocateInfo cbAllocCI{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, .commandPool = commandPools[i], .commandBufferCount = 1 };
+		chk(vkAllocateCommandBuffers(device, &cbAllocCI, &commandBuffers[i]));
+	}
+	recorder.create(device, queueFamily, framesInFlight, jobs);
+	std::cout << "Recording draws on " << recorder.threadCount() << " threads\n";
+	// Texture images, only the KTX headers are read here and the image data is streamed in by worker threads
+	const auto textureSetupStart = BenchClock::now();
+	textureStreamer.create(uploads);
+	bindless.create(device, vk12Properties);
+	std::vector<std::string> textureFiles;
 	for (auto i = 0; i < textures.size(); i++) {
+		// A KTX 2 variant in a format the device can sample is preferred, the KTX 1 file is the fallback
+		Ktx2File ktx2File;
+		const std::string filename{ chooseTextureFile(devices[deviceIndex], "assets/suzanne" + std::to_string(i), ktx2File) };
+		textureFiles.push_back(filename);
 		ktxTexture* ktxTexture{ nullptr };
-		std::string filename = "assets/suzanne" + std::to_string(i) + ".ktx";
-		ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_LOAD_IMAGE_DATA_BIT, &ktxTexture);
+		if (ktx2File.levels.empty()) {
+			ktxTexture_CreateFromNamedFile(filename.c_str(), KTX_TEXTURE_CREATE_NO_FLAGS, &ktxTexture);
+		}
+		const uint32_t levelCount{ ktxTexture ? ktxTexture->numLevels : static_cast<uint32_t>(ktx2File.levels.size()) };
 		VkImageCreateInfo texImgCI{
 			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
 			.imageType = VK_IMAGE_TYPE_2D,
-			.format = ktxTexture_GetVkFormat(ktxTexture),
-			.extent = {.width = ktxTexture->baseWidth, .height = ktxTexture->baseWidth, .depth = 1 },
-			.mipLevels = ktxTexture->numLevels,
+			.format = ktxTexture ? ktxTexture_GetVkFormat(ktxTexture) : ktx2File.format,
+			.extent = {.width = ktxTexture ? ktxTexture->baseWidth : ktx2File.width, .height = ktxTexture ? ktxTexture->baseHeight : ktx2File.height, .depth = 1 },
+			.mipLevels = levelCount,
 			.arrayLayers = 1,
 			.samples = VK_SAMPLE_COUNT_1_BIT,
 			.tiling = VK_IMAGE_TILING_OPTIMAL,
-			.usage = VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
+			// Eviction and defragmentation copy textures into new images
+			.usage = VK_IMAGE_USAGE_TRANSFER_SRC_BIT | VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT,
 			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
 		};
 		VmaAllocationCreateInfo texImageAllocCI{ .usage = VMA_MEMORY_USAGE_AUTO };
-		chk(vmaCreateImage(allocator, &texImgCI, &texImageAllocCI, &textures[i].image, &textures[i].allocation, nullptr));
-		VkImageViewCreateInfo texVewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = textures[i].image, .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = texImgCI.format, .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = ktxTexture->numLevels, .layerCount = 1 } };
+		chk(gpuMemory.createImage(MemoryCategory::Textures, texImgCI, texImageAllocCI, textures[i].image, textures[i].allocation));
+		textures[i].createInfo = texImgCI;
+		VkImageViewCreateInfo texVewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = textures[i].image, .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = texImgCI.format, .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = levelCount, .layerCount = 1 } };
 		chk(vkCreateImageView(device, &texVewCI, nullptr, &textures[i].view));
-		// Upload
-		VkBuffer imgSrcBuffer{};
-		VmaAllocation imgSrcAllocation{};
-		VkBufferCreateInfo imgSrcBufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = (uint32_t)ktxTexture->dataSize, .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT };
-		VmaAllocationCreateInfo imgSrcAllocCI{ .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, .usage = VMA_MEMORY_USAGE_AUTO };
-		chk(vmaCreateBuffer(allocator, &imgSrcBufferCI, &imgSrcAllocCI, &imgSrcBuffer, &imgSrcAllocation, nullptr));
-		void* imgSrcBufferPtr{ nullptr };
-		vmaMapMemory(allocator, imgSrcAllocation, &imgSrcBufferPtr);
-		memcpy(imgSrcBufferPtr, ktxTexture->pData, ktxTexture->dataSize);
-		VkFenceCreateInfo fenceOneTimeCI{ .sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO };
-		VkFence fenceOneTime{};
-		chk(vkCreateFence(device, &fenceOneTimeCI, nullptr, &fenceOneTime));
-		VkCommandBuffer cbOneTime{};
-		VkCommandBufferAllocateInfo cbOneTimeAI{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, .commandPool = commandPool, .commandBufferCount = 1 };
-		chk(vkAllocateCommandBuffers(device, &cbOneTimeAI, &cbOneTime));
-		VkCommandBufferBeginInfo cbOneTimeBI{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
-		vkBeginCommandBuffer(cbOneTime, &cbOneTimeBI);
-		VkImageMemoryBarrier2 barrierTexImage{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-			.srcStageMask = VK_PIPELINE_STAGE_2_NONE,
-			.srcAccessMask = VK_ACCESS_2_NONE,
-			.dstStageMask = VK_PIPELINE_STAGE_2_TRANSFER_BIT,
-			.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-			.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			.image = textures[i].image,
-			.subresourceRange = { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = ktxTexture->numLevels, .layerCount = 1 }
-		};
-		VkDependencyInfo barrierTexInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrierTexImage };
-		vkCmdPipelineBarrier2(cbOneTime, &barrierTexInfo);
-		std::vector<VkBufferImageCopy> copyRegions{};
-		for (auto j = 0; j < ktxTexture->numLevels; j++) {
-			ktx_size_t mipOffset{0};
-			KTX_error_code ret = ktxTexture_GetImageOffset(ktxTexture, j, 0, 0, &mipOffset);
-			copyRegions.push_back({
-				.bufferOffset = mipOffset,
-				.imageSubresource{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = (uint32_t)j, .layerCount = 1},
-				.imageExtent{.width = ktxTexture->baseWidth >> j, .height = ktxTexture->baseHeight >> j, .depth = 1 },
-			});
+		if (ktxTexture) {
+			chk(textureStreamer.add(filename, ktxTexture, textures[i].image));
+			ktxTexture_Destroy(ktxTexture);
+		} else {
+			chk(textureStreamer.add(filename, ktx2File, textures[i].image));
 		}
-		vkCmdCopyBufferToImage(cbOneTime, imgSrcBuffer, textures[i].image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copyRegions.size()), copyRegions.data());
-		VkImageMemoryBarrier2 barrierTexRead{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-			.srcStageMask = VK_PIPELINE_STAGE_TRANSFER_BIT,
-			.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT,
-			.dstAccessMask = VK_ACCESS_SHADER_READ_BIT,
-			.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-			.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
-			.image = textures[i].image,
-			.subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = ktxTexture->numLevels, .layerCount = 1 }
-		};
-		barrierTexInfo.pImageMemoryBarriers = &barrierTexRead;
-		vkCmdPipelineBarrier2(cbOneTime, &barrierTexInfo);
-		vkEndCommandBuffer(cbOneTime);
-		VkSubmitInfo oneTimeSI{ .sType = VK_STRUCTURE_TYPE_SUBMIT_INFO, .commandBufferCount = 1, .pCommandBuffers = &cbOneTime };
-		chk(vkQueueSubmit(queue, 1, &oneTimeSI, fenceOneTime));
-		chk(vkWaitForFences(device, 1, &fenceOneTime, VK_TRUE, UINT64_MAX));
-		vkDestroyFence(device, fenceOneTime, nullptr);
-		vmaUnmapMemory(allocator, imgSrcAllocation);
-		vmaDestroyBuffer(allocator, imgSrcBuffer, imgSrcAllocation);
-		// Sampler
-		VkSamplerCreateInfo samplerCI{
-			.sType = VK_STRUCTURE_TYPE_SAMPLER_CREATE_INFO,
-			.magFilter = VK_FILTER_LINEAR,
-			.minFilter = VK_FILTER_LINEAR,
-			.mipmapMode = VK_SAMPLER_MIPMAP_MODE_LINEAR,
-			.anisotropyEnable = VK_TRUE,
-			.maxAnisotropy = 8.0f,
-			.maxLod = (float)ktxTexture->numLevels,
-		};
-		chk(vkCreateSampler(device, &samplerCI, nullptr, &textures[i].sampler));
-		ktxTexture_Destroy(ktxTexture);
-		textureDescriptors.push_back({ .sampler = textures[i].sampler, .imageView = textures[i].view, .imageLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL });
-	}
-	// Descriptor (indexing)
-	VkDescriptorBindingFlags descVariableFlag{ VK_DESCRIPTOR_BINDING_VARIABLE_DESCRIPTOR_COUNT_BIT };
-	VkDescriptorSetLayoutBindingFlagsCreateInfo descBindingFlags{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_BINDING_FLAGS_CREATE_INFO, .bindingCount = 1, .pBindingFlags = &descVariableFlag };
-	VkDescriptorSetLayoutBinding descLayoutBindingTex{ .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = static_cast<uint32_t>(textures.size()), .stageFlags = VK_SHADER_STAGE_FRAGMENT_BIT };
-	VkDescriptorSetLayoutCreateInfo descLayoutTexCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_LAYOUT_CREATE_INFO, .pNext = &descBindingFlags, .bindingCount = 1, .pBindings = &descLayoutBindingTex };
-	chk(vkCreateDescriptorSetLayout(device, &descLayoutTexCI, nullptr, &descriptorSetLayoutTex));
-	VkDescriptorPoolSize poolSize{ .type = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .descriptorCount = static_cast<uint32_t>(textures.size()) };
-	VkDescriptorPoolCreateInfo descPoolCI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_POOL_CREATE_INFO, .maxSets = 1, .poolSizeCount = 1, .pPoolSizes = &poolSize };
-	chk(vkCreateDescriptorPool(device, &descPoolCI, nullptr, &descriptorPool));
-	uint32_t variableDescCount{ static_cast<uint32_t>(textures.size()) };
-	VkDescriptorSetVariableDescriptorCountAllocateInfo variableDescCountAI{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_VARIABLE_DESCRIPTOR_COUNT_ALLOCATE_INFO_EXT, .descriptorSetCount = 1, .pDescriptorCounts = &variableDescCount};
-	VkDescriptorSetAllocateInfo texDescSetAlloc{ .sType = VK_STRUCTURE_TYPE_DESCRIPTOR_SET_ALLOCATE_INFO, .pNext = &variableDescCountAI, .descriptorPool = descriptorPool, .descriptorSetCount = 1, .pSetLayouts = &descriptorSetLayoutTex };
-	chk(vkAllocateDescriptorSets(device, &texDescSetAlloc, &descriptorSetTex));
-	VkWriteDescriptorSet writeDescSet{ .sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET, .dstSet = descriptorSetTex, .dstBinding = 0, .descriptorCount = static_cast<uint32_t>(textureDescriptors.size()), .descriptorType = VK_DESCRIPTOR_TYPE_COMBINED_IMAGE_SAMPLER, .pImageInfo = textureDescriptors.data() };
-	vkUpdateDescriptorSets(device, 1, &writeDescSet, 0, nullptr);
-	// Initialize Slang shader compiler
-	slang::createGlobalSession(slangGlobalSession.writeRef());
-	auto slangTargets{ std::to_array<slang::TargetDesc>({ {.format{SLANG_SPIRV}, .profile{slangGlobalSession->findProfile("spirv_1_4")} } }) };
-	auto slangOptions{ std::to_array<slang::CompilerOptionEntry>({ { slang::CompilerOptionName::EmitSpirvDirectly, {slang::CompilerOptionValueKind::Int, 1} } }) };
-	slang::SessionDesc slangSessionDesc{ .targets{slangTargets.data()}, .targetCount{SlangInt(slangTargets.size())}, .defaultMatrixLayoutMode = SLANG_MATRIX_LAYOUT_COLUMN_MAJOR, .compilerOptionEntries{slangOptions.data()}, .compilerOptionEntryCount{uint32_t(slangOptions.size())} };
-	// Load shader
+		textures[i].handle = bindless.add(textures[i].view);
+	}
+	bindless.flush();
+	// Instances reference their texture by handle, so they're written once the textures have been registered
+	for (uint32_t i = 0; i < instanceCount; i++) {
+		updateInstance(i);
+	}
+	// Also submits the mesh upload
+	textureStreamer.start();
+	const double textureSetupMs = std::chrono::duration<double, std::milli>(BenchClock::now() - textureSetupStart).count();
+	std::cout << "Texture setup took " << textureSetupMs << " ms, image data is streamed in the background\n";
+	// Shader, the generated SPIR-V is cached so warm starts don't need a Slang session at all
+	const auto shaderStart = BenchClock::now();
+	const char* slangProfile{ "spirv_1_4" };
+	// Must describe every option passed to Slang below, so changing one invalidates the cache
+	const std::string slangDesc{ std::string(spGetBuildTagString()) + ";" + slangProfile + ";EmitSpirvDirectly=1;ColumnMajor" };
 	Slang::ComPtr<slang::ISession> slangSession;
-	slangGlobalSession->createSession(slangSessionDesc, slangSession.writeRef());
-	Slang::ComPtr<slang::IModule> slangModule{ slangSession->loadModuleFromSource("triangle", "assets/shader.slang", nullptr, nullptr) };
-	Slang::ComPtr<ISlangBlob> spirv;
-	slangModule->getTargetCode(0, spirv.writeRef());
-	VkShaderModuleCreateInfo shaderModuleCI{ .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, .codeSize = spirv->getBufferSize(), .pCode = (uint32_t*)spirv->getBufferPointer() };
-	VkShaderModule shaderModule{};
-	vkCreateShaderModule(device, &shaderModuleCI, nullptr, &shaderModule);
-	// Pipeline
+	// The first source is compiled, the others are the files it includes. Returns true if the SPIR-V came from the cache
+	const auto loadShader = [&](const char* moduleName, const std::vector<std::string>& sources, const std::string& cacheFile, VkShaderModule& shaderModule) {
+		uint64_t shaderKey{ 0 };
+		std::vector<uint32_t> spirv;
+		const bool fromCache{ useShaderCache && spirvCacheKey(sources, slangDesc, shaderKey) && loadSpirvCache(cacheFile, shaderKey, spirv) };
+		if (!fromCache) {
+			// Initialize Slang shader compiler on first use
+			if (!slangSession) {
+				slang::createGlobalSession(slangGlobalSession.writeRef());
+				auto slangTargets{ std::to_array<slang::TargetDesc>({ {.format{SLANG_SPIRV}, .profile{slangGlobalSession->findProfile(slangProfile)} } }) };
+				auto slangOptions{ std::to_array<slang::CompilerOptionEntry>({ { slang::CompilerOptionName::EmitSpirvDirectly, {slang::CompilerOptionValueKind::Int, 1} } }) };
+				slang::SessionDesc slangSessionDesc{ .targets{slangTargets.data()}, .targetCount{SlangInt(slangTargets.size())}, .defaultMatrixLayoutMode = SLANG_MATRIX_LAYOUT_COLUMN_MAJOR, .compilerOptionEntries{slangOptions.data()}, .compilerOptionEntryCount{uint32_t(slangOptions.size())} };
+				slangGlobalSession->createSession(slangSessionDesc, slangSession.writeRef());
+			}
+			// Load shader
+			Slang::ComPtr<slang::IModule> slangModule{ slangSession->loadModuleFromSource(moduleName, sources[0].c_str(), nullptr, nullptr) };
+			Slang::ComPtr<ISlangBlob> spirvBlob;
+			slangModule->getTargetCode(0, spirvBlob.writeRef());
+			spirv.resize(spirvBlob->getBufferSize() / sizeof(uint32_t));
+			memcpy(spirv.data(), spirvBlob->getBufferPointer(), spirvBlob->getBufferSize());
+			if (useShaderCache && shaderKey != 0 && !writeSpirvCache(cacheFile, shaderKey, spirv.data(), spirv.size() * sizeof(uint32_t))) {
+				std::cerr << "Could not write shader cache " << cacheFile << "\n";
+			}
+		}
+		VkShaderModuleCreateInfo shaderModuleCI{ .sType = VK_STRUCTURE_TYPE_SHADER_MODULE_CREATE_INFO, .codeSize = spirv.size() * sizeof(uint32_t), .pCode = spirv.data() };
+		chk(vkCreateShaderModule(device, &shaderModuleCI, nullptr, &shaderModule));
+		return fromCache;
+	};
+	VkShaderModule shaderModule{ VK_NULL_HANDLE };
+	bool shaderFromCache{ loadShader("triangle", { "assets/shader.slang" }, "assets/shader.spvcache", shaderModule) };
+	// Task and mesh shaders live in a separate module, as SPIR-V using mesh shading may only be loaded if the device supports it
+	VkShaderModule meshletShaderModule{ VK_NULL_HANDLE };
+	if (meshShading) {
+		shaderFromCache &= loadShader("meshlet", { "assets/meshlet.slang", "assets/shader.slang" }, "assets/meshlet.spvcache", meshletShaderModule);
+	}
+	const double shaderMs = std::chrono::duration<double, std::milli>(BenchClock::now() - shaderStart).count();
+	// Pipeline, the driver's pipeline cache is persisted so warm starts skip the backend compile
+	const auto pipelineStart = BenchClock::now();
+	const std::string pipelineCacheFile{ "assets/pipeline.cache" };
+	bool pipelineFromCache{ false };
+	size_t pipelineCacheSize{ 0 };
+	VkPipelineCache pipelineCache{ VK_NULL_HANDLE };
+	if (useShaderCache) {
+		pipelineCache = loadPipelineCache(device, deviceProperties.properties, pipelineCacheFile, pipelineFromCache, pipelineCacheSize);
+	}
 	VkPushConstantRange pushConstantRange{ .stageFlags = VK_SHADER_STAGE_VERTEX_BIT, .size = sizeof(VkDeviceAddress) };
-	VkPipelineLayoutCreateInfo pipelineLayoutCI{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, .setLayoutCount = 1, .pSetLayouts = &descriptorSetLayoutTex, .pushConstantRangeCount = 1, .pPushConstantRanges = &pushConstantRange };
+	const VkDescriptorSetLayout bindlessLayout{ bindless.layout() };
+	VkPipelineLayoutCreateInfo pipelineLayoutCI{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, .setLayoutCount = 1, .pSetLayouts = &bindlessLayout, .pushConstantRangeCount = 1, .pPushConstantRanges = &pushConstantRange };
 	chk(vkCreatePipelineLayout(device, &pipelineLayoutCI, nullptr, &pipelineLayout));
 	std::vector<VkPipelineShaderStageCreateInfo> shaderStages{
 		{ .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_VERTEX_BIT, .module = shaderModule, .pName = "main"},
 		{ .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_FRAGMENT_BIT, .module = shaderModule, .pName = "main" }
 	};
-	VkVertexInputBindingDescription vertexBinding{ .binding = 0, .stride = sizeof(Vertex), .inputRate = VK_VERTEX_INPUT_RATE_VERTEX };
-	std::vector<VkVertexInputAttributeDescription> vertexAttributes{
-		{ .location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT },
-		{ .location = 1, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(Vertex, normal) },
-		{ .location = 2, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(Vertex, uv) },
-	};
 	VkPipelineVertexInputStateCreateInfo vertexInputState{
 		.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO,
 		.vertexBindingDescriptionCount = 1,
@@ -429,209 +1120,694 @@ int main(int argc, char* argv[])
 		.pDynamicState = &dynamicState,
 		.layout = pipelineLayout
 	};
-	chk(vkCreateGraphicsPipelines(device, VK_NULL_HANDLE, 1, &pipelineCI, nullptr, &pipeline));
+	chk(vkCreateGraphicsPipelines(device, pipelineCache, 1, &pipelineCI, nullptr, &pipeline));
+	// Mesh shader pipeline, same state without vertex input and input assembly. The task shader also gets the mesh index pushed
+	if (meshShading) {
+		VkPushConstantRange meshPushConstantRange{ .stageFlags = VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, .size = sizeof(VkDeviceAddress) * 2 };
+		VkPipelineLayoutCreateInfo meshPipelineLayoutCI{ .sType = VK_STRUCTURE_TYPE_PIPELINE_LAYOUT_CREATE_INFO, .setLayoutCount = 1, .pSetLayouts = &bindlessLayout, .pushConstantRangeCount = 1, .pPushConstantRanges = &meshPushConstantRange };
+		chk(vkCreatePipelineLayout(device, &meshPipelineLayoutCI, nullptr, &meshPipelineLayout));
+		std::vector<VkPipelineShaderStageCreateInfo> meshShaderStages{
+			{ .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_TASK_BIT_EXT, .module = meshletShaderModule, .pName = "taskMain" },
+			{ .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_MESH_BIT_EXT, .module = meshletShaderModule, .pName = "meshMain" },
+			{ .sType = VK_STRUCTURE_TYPE_PIPELINE_SHADER_STAGE_CREATE_INFO, .stage = VK_SHADER_STAGE_FRAGMENT_BIT, .module = shaderModule, .pName = "main" }
+		};
+		VkGraphicsPipelineCreateInfo meshPipelineCI{ pipelineCI };
+		meshPipelineCI.stageCount = static_cast<uint32_t>(meshShaderStages.size());
+		meshPipelineCI.pStages = meshShaderStages.data();
+		meshPipelineCI.pVertexInputState = nullptr;
+		meshPipelineCI.pInputAssemblyState = nullptr;
+		meshPipelineCI.layout = meshPipelineLayout;
+		chk(vkCreateGraphicsPipelines(device, pipelineCache, 1, &meshPipelineCI, nullptr, &meshPipeline));
+	}
+	// Culling compute pipelines, from the same shader module
+	culling.create(device, allocator, pipelineCache, shaderModule, meshDraws, instanceBuffer.address(), instanceCount, framesInFlight, cullFlags, meshShading);
+	shaderData.visibleInstances = culling.visibleAddress();
+	shaderData.meshes = culling.meshesAddress();
+	shaderData.meshTasks = culling.meshTasksAddress();
+	shaderData.cullFlags = cullFlags;
+	// A loaded cache can still miss pipelines, e.g. the mesh shading or culling variants of other settings
+	if (pipelineCache != VK_NULL_HANDLE && !writePipelineCache(device, deviceProperties.properties, pipelineCache, pipelineCacheFile, pipelineCacheSize)) {
+		std::cerr << "Could not write pipeline cache " << pipelineCacheFile << "\n";
+	}
+	const double pipelineMs = std::chrono::duration<double, std::milli>(BenchClock::now() - pipelineStart).count();
+	std::cout << "Shader " << (shaderFromCache ? "loaded from cache" : "compiled") << " in " << shaderMs << " ms, pipeline created " << (pipelineFromCache ? "from cache" : "without cache") << " in " << pipelineMs << " ms\n";
+	double firstFrameMs{ 0.0 };
 	// Render loop
-	sf::Clock clock;
-	while (window.isOpen()) {
-		// Sync
-		chk(vkWaitForFences(device, 1, &fences[frameIndex], true, UINT64_MAX));
-		chk(vkResetFences(device, 1, &fences[frameIndex]));
-		vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, presentSemaphores[frameIndex], VK_NULL_HANDLE, &imageIndex);
-		// Update shader data
-		shaderData.projection = glm::perspective(glm::radians(45.0f), (float)window.getSize().x / (float)window.getSize().y, 0.1f, 32.0f);
-		shaderData.view = glm::translate(glm::mat4(1.0f), camPos);
-		for (auto i = 0; i < 3; i++) {
-			auto instancePos = glm::vec3((float)(i - 1) * 3.0f, 0.0f, 0.0f);
-			shaderData.model[i] = glm::translate(glm::mat4(1.0f), instancePos) * glm::mat4_cast(glm::quat(objectRotations[i]));
-		}		
-		memcpy(shaderDataBuffers[frameIndex].mapped, &shaderData, sizeof(ShaderData));
-		// Build command buffer
-		auto cb = commandBuffers[frameIndex];
-		vkResetCommandBuffer(cb, 0);
-		VkCommandBufferBeginInfo cbBI { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
-		vkBeginCommandBuffer(cb, &cbBI);
-		std::array<VkImageMemoryBarrier2, 2> outputBarriers{
-			VkImageMemoryBarrier2{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-				.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-				.srcAccessMask = 0,
-				.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-				.dstAccessMask = VK_ACCESS_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-				.newLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
-				.image = swapchainImages[imageIndex],
-				.subresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 }
-			},
-			VkImageMemoryBarrier2{
-				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-				.srcStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-				.srcAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-				.dstStageMask = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_LATE_FRAGMENT_TESTS_BIT,
-				.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT,
-				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
-				.newLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
-				.image = depthImage,
-				.subresourceRange{.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT, .levelCount = 1, .layerCount = 1 }
+	uint32_t frameCount{ 0 };
+	const auto benchStart = BenchClock::now();
+	// Main thread input state, the render thread only sees it through the published snapshots
+	std::vector<glm::vec3> inputRotations{ objectRotations };
+	glm::vec3 inputCamPos{ camPos };
+	uint32_t inputSelection{ selectedInstance };
+	// Instances with edited rotations and the sequence of the first snapshot that carries their latest edit
+	std::unordered_map<uint32_t, uint64_t> editedRotations;
+	uint64_t inputSequence{ 0 };
+	// Input is applied per event, so it doesn't depend on how often snapshots are published. Resizes only mark the swapchain
+	// for recreation, so a drag resize recreates it at most once per frame
+	const auto processEvent = [&](const sf::Event& event) {
+		if (event.is<sf::Event::Closed>()) {
+			running = false;
+		}
+		if (const auto* mouseMoved = event.getIf<sf::Event::MouseMoved>()) {
+			if (sf::Mouse::isButtonPressed(sf::Mouse::Button::Left)) {
+				auto delta = lastMousePos - mouseMoved->position;
+				inputRotations[inputSelection].x += (float)delta.y * 0.008f;
+				inputRotations[inputSelection].y -= (float)delta.x * 0.008f;
+				editedRotations[inputSelection] = inputSequence + 1;
+				sceneBvh.moveInstance(inputSelection, instanceTransform(inputSelection, inputRotations[inputSelection]));
 			}
-		};
-		VkDependencyInfo barrierDependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = 2, .pImageMemoryBarriers = outputBarriers.data() };
-		vkCmdPipelineBarrier2(cb, &barrierDependencyInfo);
-		VkRenderingAttachmentInfo colorAttachmentInfo{
-			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-			.imageView = swapchainImageViews[imageIndex],
-			.imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
-			.clearValue{.color{ 0.0f, 0.0f, 0.0f, 1.0f }}
-		};
-		VkRenderingAttachmentInfo depthAttachmentInfo{
-			.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
-			.imageView = depthImageView,
-			.imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
-			.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
-			.storeOp = VK_ATTACHMENT_STORE_OP_DONT_CARE,
-			.clearValue = {.depthStencil = {1.0f,  0}}
-		};
-		VkRenderingInfo renderingInfo{
-			.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
-			.renderArea{.extent{.width = window.getSize().x, .height = window.getSize().y }},
-			.layerCount = 1,
-			.colorAttachmentCount = 1,
-			.pColorAttachments = &colorAttachmentInfo,
-			.pDepthAttachment = &depthAttachmentInfo
-		};
-		vkCmdBeginRendering(cb, &renderingInfo);
-		VkViewport vp{ .width = static_cast<float>(window.getSize().x), .height = static_cast<float>(window.getSize().y), .minDepth = 0.0f, .maxDepth = 1.0f};
-		vkCmdSetViewport(cb, 0, 1, &vp);
-		VkRect2D scissor{ .extent{ .width = window.getSize().x, .height = window.getSize().y } };
-		vkCmdBindPipeline(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
-		vkCmdSetScissor(cb, 0, 1, &scissor);
-		vkCmdBindDescriptorSets(cb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &descriptorSetTex, 0, nullptr);
-		VkDeviceSize vOffset{ 0 };
-		vkCmdBindVertexBuffers(cb, 0, 1, &vBuffer, &vOffset);
-		vkCmdBindIndexBuffer(cb, vBuffer, vBufSize, VK_INDEX_TYPE_UINT16);
-		vkCmdPushConstants(cb, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VkDeviceAddress), &shaderDataBuffers[frameIndex].deviceAddress);
-		vkCmdDrawIndexed(cb, indexCount, 3, 0, 0, 0);
-		vkCmdEndRendering(cb);
-		VkImageMemoryBarrier2 barrierPresent{
-			.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
-			.srcStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.srcAccessMask = VK_ACCESS_COLOR_ATTACHMENT_WRITE_BIT,
-			.dstStageMask = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT,
-			.dstAccessMask = 0,
-			.oldLayout = VK_IMAGE_LAYOUT_COLOR_ATTACHMENT_OPTIMAL,
-			.newLayout = VK_IMAGE_LAYOUT_PRESENT_SRC_KHR,
-			.image = swapchainImages[imageIndex],
-			.subresourceRange{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1 }
-		};
-		VkDependencyInfo barrierPresentDependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = 1, .pImageMemoryBarriers = &barrierPresent };
-		vkCmdPipelineBarrier2(cb, &barrierPresentDependencyInfo);
-		vkEndCommandBuffer(cb);
-		// Submit to graphics queue
-		VkPipelineStageFlags waitStages = VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT;
-		VkSubmitInfo submitInfo{
-			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO,
-			.waitSemaphoreCount = 1,
-			.pWaitSemaphores = &presentSemaphores[frameIndex],
-			.pWaitDstStageMask = &waitStages,
-			.commandBufferCount = 1,
-			.pCommandBuffers = &cb,
-			.signalSemaphoreCount = 1,
-			.pSignalSemaphores = &renderSemaphores[imageIndex],
-		};
-		chk(vkQueueSubmit(queue, 1, &submitInfo, fences[frameIndex]));
-		frameIndex = (frameIndex + 1) % maxFramesInFlight;
-		VkPresentInfoKHR presentInfo{
-			.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
-			.waitSemaphoreCount = 1,
-			.pWaitSemaphores = &renderSemaphores[imageIndex],
-			.swapchainCount = 1,
-			.pSwapchains = &swapchain,
-			.pImageIndices = &imageIndex
-		};
-		chk(vkQueuePresentKHR(queue, &presentInfo));
-		// Event polling
-		sf::Time elapsed = clock.restart();
-		while (const std::optional event = window.pollEvent()) {
-			if (event->is<sf::Event::Closed>()) {
-				window.close();
-			}
-			if (const auto* mouseMoved = event->getIf<sf::Event::MouseMoved>()) {
-				if (sf::Mouse::isButtonPressed(sf::Mouse::Button::Left)) {
-					auto delta = lastMousePos - mouseMoved->position;
-					objectRotations[shaderData.selected].x += (float)delta.y * 0.0005f * (float)elapsed.asMilliseconds();
-					objectRotations[shaderData.selected].y -= (float)delta.x * 0.0005f * (float)elapsed.asMilliseconds();
+			lastMousePos = mouseMoved->position;
+		}
+		// Clicking an instance selects it, clicks that miss keep the current selection
+		if (const auto* mouseButtonPressed = event.getIf<sf::Event::MouseButtonPressed>()) {
+			lastMousePos = mouseButtonPressed->position;
+			if (mouseButtonPressed->button == sf::Mouse::Button::Left) {
+				const glm::vec2 size{ (float)window.getSize().x, (float)window.getSize().y };
+				sceneBvh.refit();
+				const RayHit hit{ sceneBvh.intersect(screenRay(glm::vec2((float)mouseButtonPressed->position.x, (float)mouseButtonPressed->position.y), size, cameraProjection(size.x, size.y), cameraView(inputCamPos))) };
+				if (hit.hit()) {
+					inputSelection = hit.instance;
+				}
+			}
+		}
+		if (const auto* mouseWheelScrolled = event.getIf<sf::Event::MouseWheelScrolled>()) {
+			inputCamPos.z += (float)mouseWheelScrolled->delta * 0.4f;
+		}
+		if (const auto* keyPressed = event.getIf<sf::Event::KeyPressed>()) {
+			if (keyPressed->code == sf::Keyboard::Key::D) {
+				inputSelection = (inputSelection < instanceCount - 1) ? inputSelection + 1 : 0;
+			}
+			if (keyPressed->code == sf::Keyboard::Key::A) {
+				inputSelection = (inputSelection > 0) ? inputSelection - 1 : instanceCount - 1;
+			}
+		}
+		if (event.is<sf::Event::Resized>()) {
+			swapchainDirty = true;
+		}
+	};
+	// Edits stay in the snapshots until the render thread has picked up one that contains them
+	const auto publishInput = [&]() {
+		const uint64_t consumed{ consumedInput.load(std::memory_order_acquire) };
+		std::erase_if(editedRotations, [consumed](const auto& edit) { return edit.second <= consumed; });
+		FrameInput& input = frameInputs.back();
+		input.sequence = ++inputSequence;
+		input.camPos = inputCamPos;
+		input.selectedInstance = inputSelection;
+		input.rotations.clear();
+		for (auto& [index, sequence] : editedRotations) {
+			input.rotations.push_back({ index, inputRotations[index] });
+		}
+		input.windowSize = headless ? sf::Vector2u{} : window.getSize();
+		input.time = BenchClock::now();
+		if (!frameInputs.publish() && benchFrames > 0) {
+			benchInputsReplaced++;
+		}
+	};
+	// Size of the window as of the last snapshot, for surfaces that take their size from the swapchain
+	sf::Vector2u windowSize{ headless ? sf::Vector2u{} : window.getSize() };
+	// When the input the current frame is built from was sampled, the start of input to present latency
+	auto inputTime = BenchClock::now();
+	// Render thread side, picks up the latest snapshot if the main thread published one since the last frame
+	const auto applyInput = [&]() {
+		if (!frameInputs.consume()) {
+			return;
+		}
+		const FrameInput& input = frameInputs.front();
+		consumedInput.store(input.sequence, std::memory_order_release);
+		camPos = input.camPos;
+		for (auto& [index, rotation] : input.rotations) {
+			objectRotations[index] = rotation;
+			sceneTransforms.setRotation(index, glm::quat(rotation));
+		}
+		if (input.selectedInstance != selectedInstance) {
+			const uint32_t previousSelection{ selectedInstance };
+			selectedInstance = input.selectedInstance;
+			updateInstance(previousSelection);
+			updateInstance(selectedInstance);
+		}
+		windowSize = input.windowSize;
+		inputTime = input.time;
+		if (benchFrames > 0) {
+			benchInputAges.push_back(std::chrono::duration<double, std::milli>(BenchClock::now() - input.time).count());
+		}
+	};
+	// Recreates the swapchain and the attachments that depend on its size without waiting for the device. The old objects
+	// are retired for the current frame, frames in flight still use them. Returns false if the window has no area (minimized)
+	const auto recreateSwapchain = [&]() {
+		// Cleared before the surface is queried, a resize reported by the main thread after this point triggers another recreation
+		swapchainDirty.exchange(false);
+		chk(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(devices[deviceIndex], surface, &surfaceCaps));
+		// A current extent of 0xFFFFFFFF means the surface takes its size from the swapchain
+		VkExtent2D extent{ surfaceCaps.currentExtent };
+		if (extent.width == UINT32_MAX) {
+			extent = { .width = windowSize.x, .height = windowSize.y };
+		}
+		if (extent.width == 0 || extent.height == 0) {
+			swapchainDirty = true;
+			return false;
+		}
+		PROFILE_ZONE("Swapchain recreation");
+		presentPacer.stop();
+		swapchainCI.oldSwapchain = swapchain;
+		swapchainCI.imageExtent = extent;
+		chk(vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapchain));
+		deletionQueue.push(frameIndex, [oldSwapchain = swapchainCI.oldSwapchain, views = swapchainImageViews, semaphores = renderSemaphores]() {
+			for (auto view : views) {
+				vkDestroyImageView(device, view, nullptr);
+			}
+			for (auto semaphore : semaphores) {
+				vkDestroySemaphore(device, semaphore, nullptr);
+			}
+			vkDestroySwapchainKHR(device, oldSwapchain, nullptr);
+		});
+		swapchainCI.oldSwapchain = VK_NULL_HANDLE;
+		vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
+		swapchainImages.resize(imageCount);
+		vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchainImages.data());
+		swapchainImageViews.resize(imageCount);
+		for (auto i = 0; i < imageCount; i++) {
+			VkImageViewCreateInfo viewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = swapchainImages[i], .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = imageFormat, .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1}};
+			chk(vkCreateImageView(device, &viewCI, nullptr, &swapchainImageViews[i]));
+		}
+		// Pending presents of the old swapchain may still wait on its semaphores, and the image count can change
+		renderSemaphores.resize(imageCount);
+		for (auto& semaphore : renderSemaphores) {
+			chk(vkCreateSemaphore(device, &semaphoreCI, nullptr, &semaphore));
+		}
+		if (presentTiming) {
+			presentPacer.start(device, swapchain);
+		}
+		// The render graph creates a depth buffer for the new extent on the next frame
+		renderExtent = extent;
+		swapchainRecreations++;
+		return true;
+	};
+	const VkDescriptorSet textureSet{ bindless.descriptorSet() };
+	// Depth buffer the culling depth pyramid was created for
+	VkImageView pyramidDepthView{ VK_NULL_HANDLE };
+	// Render thread: waits for the frame slot, builds the frame from the latest input snapshot, submits and presents
+	const auto renderLoop = [&]() {
+		profiler.setThreadName("Render");
+		while (running && (benchFrames == 0 || frameCount < benchFrames)) {
+			const auto frameStart = BenchClock::now();
+			// Sync
+			{
+				PROFILE_ZONE("Frame timeline wait");
+				VkSemaphoreWaitInfo waitInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, .semaphoreCount = 1, .pSemaphores = &frameTimeline, .pValues = &frameTimelineValues[frameIndex] };
+				chk(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+			}
+			// Sampled before acquire and input, which would otherwise add their waits to the submit to completion time
+			const auto frameSignaled = BenchClock::now();
+			deletionQueue.flush(frameIndex);
+			if (!headless) {
+				PROFILE_ZONE("Acquire");
+				bool acquired{ !swapchainDirty || recreateSwapchain() };
+				while (acquired) {
+					const VkResult result{ vkAcquireNextImageKHR(device, swapchain, UINT64_MAX, presentSemaphores[frameIndex], VK_NULL_HANDLE, &imageIndex) };
+					if (result != VK_ERROR_OUT_OF_DATE_KHR) {
+						// A suboptimal swapchain can still be presented to, it's recreated at the start of the next frame. The flag is only
+						// ever raised here, clearing it could drop a resize the main thread reported in the meantime
+						if (result == VK_SUBOPTIMAL_KHR) {
+							swapchainDirty = true;
+						} else {
+							chk(result);
+						}
+						break;
+					}
+					acquired = recreateSwapchain();
+				}
+				if (!acquired) {
+					std::this_thread::sleep_for(std::chrono::milliseconds(10));
+					applyInput();
+					continue;
+				}
+			} else {
+				imageIndex = frameIndex;
+			}
+			if (benchFrames > 0 && frameCount >= framesInFlight) {
+				benchSubmitLatencies.push_back(std::chrono::duration<double, std::milli>(frameSignaled - benchSubmitTimes[frameIndex]).count());
+				benchCullStats.push_back(culling.stats(frameIndex));
+			}
+			// Input is picked up as late as possible, once acquire and the timeline wait are done
+			applyInput();
+			// The previous churn's handles are retired with this frame, their slots come back once it has been waited on again
+			if (textureChurn > 0) {
+				PROFILE_ZONE("Texture churn");
+				for (auto handle : churnHandles) {
+					bindless.remove(handle, deletionQueue, frameIndex);
 				}
-				lastMousePos = mouseMoved->position;
+				churnHandles.clear();
+				for (uint32_t i = 0; i < textureChurn; i++) {
+					const TextureHandle handle{ bindless.add(textures[i % textures.size()].view) };
+					if (handle != invalidTexture) {
+						churnHandles.push_back(handle);
+					}
+				}
+			}
+			{
+				PROFILE_ZONE("Memory");
+				gpuMemory.update(frameCount, framesInFlight);
+				// Textures can only be moved once the streamer doesn't write to their images anymore, and not while an eviction's copy is pending
+				if (textureStreamer.fullyResidentMs() >= 0.0 && textureCopies.empty()) {
+					if (forceDefragment || (frameCount % defragmentCheckInterval == 0 && gpuMemory.fragmentation() > defragmentThreshold)) {
+						gpuMemory.beginDefragmentation();
+						forceDefragment = false;
+					}
+					// Only textures can be moved, buffers are referenced by their device address
+					gpuMemory.defragmentStep(deletionQueue, frameIndex, [](VmaAllocation source, VmaAllocation destination) {
+						auto texture = std::find_if(textures.begin(), textures.end(), [source](const Texture& texture) { return texture.allocation == source; });
+						if (texture == textures.end()) {
+							return false;
+						}
+						return relocateTexture(*texture, 0, destination);
+					});
+				}
+				if (!memoryStatsFile.empty() && frameCount % memoryStatsInterval == 0) {
+					gpuMemory.writeStats(memoryStatsFile);
+				}
+			}
+			bindless.flush();
+			{
+				PROFILE_ZONE("Texture streaming");
+				textureStreamer.update();
+			}
+			// Benchmark runs use a fixed time step so every run renders the exact same frames
+			if (benchFrames > 0) {
+				const float t = (float)frameCount / 60.0f;
+				camPos = { 0.0f, 0.0f, -6.0f - sinf(t) };
+				// Only the first three instances move, so the amount of changed instance data stays the same for every instance count
+				for (uint32_t i = 0; i < std::min(instanceCount, 3u); i++) {
+					objectRotations[i] = { t * 0.25f * (float)(i + 1), t * 0.5f, 0.0f };
+					sceneTransforms.setRotation(i, glm::quat(objectRotations[i]));
+				}
+			}
+			// Only moved nodes and their children are recomputed, their rows go straight into the instance data and are uploaded with it
+			{
+				PROFILE_ZONE("Transforms");
+				const auto transformStart = BenchClock::now();
+				for (uint32_t node : sceneTransforms.update(instanceBuffer.transformRows(), sizeof(InstanceData), &jobs)) {
+					instanceBuffer.markDirty(node, 1);
+				}
+				if (benchFrames > 0) {
+					benchTransformTimes.push_back(std::chrono::duration<double, std::milli>(BenchClock::now() - transformStart).count());
+				}
+			}
+			// Update shader data
+			PROFILE_ZONE_BEGIN(updateZone, "Update shader data");
+			shaderData.projection = cameraProjection((float)renderExtent.width, (float)renderExtent.height);
+			shaderData.view = cameraView(camPos);
+			shaderData.frustumPlanes = frustumPlanes(shaderData.projection * shaderData.view);
+			shaderData.cameraPos = glm::inverse(shaderData.view)[3];
+			frameArena.begin(frameIndex);
+			// Slots without a streamed texture are never sampled, so only the live ones are written
+			const ArenaAllocation minLodAlloc{ frameArena.allocate(sizeof(float) * bindless.slots(), sizeof(float)) };
+			chk(static_cast<bool>(minLodAlloc));
+			for (auto i = 0; i < textures.size(); i++) {
+				static_cast<float*>(minLodAlloc.data)[textures[i].handle] = std::max(0.0f, textureStreamer.minLod(i) - static_cast<float>(textures[i].droppedLevels));
 			}
-			if (const auto* mouseWheelScrolled = event->getIf<sf::Event::MouseWheelScrolled>()) {
-				camPos.z += (float)mouseWheelScrolled->delta * 0.025f * (float)elapsed.asMilliseconds();
+			shaderData.textureMinLods = minLodAlloc.address;
+			const ArenaAllocation shaderDataAlloc{ frameArena.push(shaderData) };
+			chk(static_cast<bool>(shaderDataAlloc));
+			PROFILE_ZONE_END(updateZone);
+			// Build command buffer
+			PROFILE_ZONE_BEGIN(recordZone, "Record");
+			auto cb = commandBuffers[frameIndex];
+			chk(vkResetCommandPool(device, commandPools[frameIndex], 0));
+			VkCommandBufferBeginInfo cbBI { .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
+			vkBeginCommandBuffer(cb, &cbBI);
+			profiler.beginGpuFrame(cb, frameIndex);
+			if (benchFrames > 0 && profiler.gpuFrameMs() >= 0.0) {
+				benchGpuTimes.push_back(profiler.gpuFrameMs());
 			}
-			if (const auto* keyPressed = event->getIf<sf::Event::KeyPressed>()) {
-				if (keyPressed->code == sf::Keyboard::Key::D) {
-					shaderData.selected = (shaderData.selected < 2) ? shaderData.selected + 1 : 0;
+			// Secondary command buffers don't inherit any state, so every one of them binds everything it needs
+			VkViewport vp{ .width = static_cast<float>(renderExtent.width), .height = static_cast<float>(renderExtent.height), .minDepth = 0.0f, .maxDepth = 1.0f};
+			VkRect2D scissor{ .extent{ .width = renderExtent.width, .height = renderExtent.height } };
+			const auto setupDraws = [&](VkCommandBuffer drawCb) {
+				vkCmdSetViewport(drawCb, 0, 1, &vp);
+				vkCmdSetScissor(drawCb, 0, 1, &scissor);
+				if (meshShading) {
+					vkCmdBindPipeline(drawCb, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipeline);
+					vkCmdBindDescriptorSets(drawCb, VK_PIPELINE_BIND_POINT_GRAPHICS, meshPipelineLayout, 0, 1, &textureSet, 0, nullptr);
+					vkCmdPushConstants(drawCb, meshPipelineLayout, VK_SHADER_STAGE_TASK_BIT_EXT | VK_SHADER_STAGE_MESH_BIT_EXT, 0, sizeof(VkDeviceAddress), &shaderDataAlloc.address);
+					return;
 				}
-				if (keyPressed->code == sf::Keyboard::Key::A) {
-					shaderData.selected = (shaderData.selected > 0) ? shaderData.selected - 1 : 2;
+				vkCmdBindPipeline(drawCb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipeline);
+				vkCmdBindDescriptorSets(drawCb, VK_PIPELINE_BIND_POINT_GRAPHICS, pipelineLayout, 0, 1, &textureSet, 0, nullptr);
+				geometryPool.bind(drawCb);
+				vkCmdPushConstants(drawCb, pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0, sizeof(VkDeviceAddress), &shaderDataAlloc.address);
+			};
+			// Direct draws use the instance index to pick from the visible list, the indirect path is a single draw
+			const auto recordDraws = [&](VkCommandBuffer drawCb, uint32_t begin, uint32_t end) {
+				PROFILE_ZONE("Record draws");
+				if (meshShading) {
+					culling.drawMeshTasks(drawCb, meshPipelineLayout);
+					return;
 				}
+				if (!directDraws) {
+					culling.draw(drawCb);
+					return;
+				}
+				// Slots of the visible list belong to the mesh whose range contains them, without LODs there is one entry per mesh
+				auto meshDraw = std::upper_bound(meshDraws.begin(), meshDraws.end(), begin, [](uint32_t slot, const MeshDraw& draw) { return slot < draw.instanceOffset; }) - 1;
+				for (uint32_t i = begin; i < end; i++) {
+					while (meshDraw + 1 != meshDraws.end() && i >= (meshDraw + 1)->instanceOffset) {
+						meshDraw++;
+					}
+					vkCmdDrawIndexed(drawCb, meshDraw->indexCount, 1, meshDraw->firstIndex, meshDraw->vertexOffset, i);
+				}
+			};
+			const VkCommandBufferInheritanceRenderingInfo inheritanceRenderingInfo{
+				.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_RENDERING_INFO,
+				.colorAttachmentCount = 1,
+				.pColorAttachmentFormats = &imageFormat,
+				.depthAttachmentFormat = depthFormat,
+				.rasterizationSamples = VK_SAMPLE_COUNT_1_BIT
+			};
+			const auto recordStart = BenchClock::now();
+			const auto drawCbs = recorder.record(frameIndex, inheritanceRenderingInfo, directDraws ? instanceCount : 1, 256, setupDraws, recordDraws);
+			if (benchFrames > 0) {
+				benchRecordTimes.push_back(std::chrono::duration<double, std::milli>(BenchClock::now() - recordStart).count());
+			}
+			// Passes in execution order with the images they use, the graph derives all barriers between them
+			renderGraph.begin();
+			const RGState outputFinal{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, headless ? VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL : VK_IMAGE_LAYOUT_PRESENT_SRC_KHR };
+			const RGResource colorTarget{ renderGraph.importImage("Color target", swapchainImages[imageIndex], VK_IMAGE_ASPECT_COLOR_BIT, { VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_NONE, VK_IMAGE_LAYOUT_UNDEFINED }, outputFinal) };
+			// Sampled by the depth pyramid reduction for occlusion culling
+			const RGResource depthTarget{ renderGraph.createImage("Depth target", { .format = depthFormat, .extent = renderExtent, .usage = VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, .aspect = VK_IMAGE_ASPECT_DEPTH_BIT | VK_IMAGE_ASPECT_STENCIL_BIT }) };
+			const RGResource depthPyramid{ renderGraph.importHistory("Depth pyramid", culling.pyramidImage(), VK_IMAGE_ASPECT_COLOR_BIT, culling.pyramidLevelCount(), culling.pyramidReady()) };
+			const RGPass copyPass{ renderGraph.addPass("Texture copies", [](VkCommandBuffer cb) { recordTextureCopies(cb); }) };
+			renderGraph.sideEffects(copyPass);
+			const RGPass uploadPass{ renderGraph.addPass("Instance upload", [&](VkCommandBuffer cb) { instanceBuffer.record(cb, frameIndex); }) };
+			renderGraph.sideEffects(uploadPass);
+			// Visibility is decided on the GPU, the draws below only consume its output
+			const RGPass cullPass{ renderGraph.addPass("Culling", [&](VkCommandBuffer cb) { culling.cull(cb, frameIndex, frameArena, shaderData.projection, shaderData.view); }) };
+			renderGraph.sideEffects(cullPass);
+			if (cullFlags & cullFlagOcclusion) {
+				renderGraph.read(cullPass, depthPyramid, rgComputeSampled);
+			}
+			const RGPass scenePass{ renderGraph.addPass("Rendering", [&](VkCommandBuffer cb) {
+				VkRenderingAttachmentInfo colorAttachmentInfo{
+					.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+					.imageView = swapchainImageViews[imageIndex],
+					.imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
+					.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+					.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+					.clearValue{.color{ 0.0f, 0.0f, 0.0f, 1.0f }}
+				};
+				VkRenderingAttachmentInfo depthAttachmentInfo{
+					.sType = VK_STRUCTURE_TYPE_RENDERING_ATTACHMENT_INFO,
+					.imageView = renderGraph.view(depthTarget),
+					.imageLayout = VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL,
+					.loadOp = VK_ATTACHMENT_LOAD_OP_CLEAR,
+					.storeOp = VK_ATTACHMENT_STORE_OP_STORE,
+					.clearValue = {.depthStencil = {1.0f,  0}}
+				};
+				VkRenderingInfo renderingInfo{
+					.sType = VK_STRUCTURE_TYPE_RENDERING_INFO,
+					.flags = VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT,
+					.renderArea{.extent{.width = renderExtent.width, .height = renderExtent.height }},
+					.layerCount = 1,
+					.colorAttachmentCount = 1,
+					.pColorAttachments = &colorAttachmentInfo,
+					.pDepthAttachment = &depthAttachmentInfo
+				};
+				vkCmdBeginRendering(cb, &renderingInfo);
+				vkCmdExecuteCommands(cb, static_cast<uint32_t>(drawCbs.size()), drawCbs.data());
+				vkCmdEndRendering(cb);
+			}) };
+			renderGraph.write(scenePass, colorTarget, rgColorAttachment);
+			renderGraph.write(scenePass, depthTarget, rgDepthAttachment);
+			// Culled unless the next frame's cull pass reads the pyramid
+			const RGPass pyramidPass{ renderGraph.addPass("Depth pyramid", [](VkCommandBuffer cb) { culling.buildDepthPyramid(cb); }) };
+			renderGraph.read(pyramidPass, depthTarget, rgComputeSampledDepth);
+			renderGraph.write(pyramidPass, depthPyramid, rgComputeStorage);
+			renderGraph.compile(deletionQueue, frameIndex);
+			// A new depth buffer needs a new pyramid
+			if (renderGraph.view(depthTarget) != pyramidDepthView) {
+				pyramidDepthView = renderGraph.view(depthTarget);
+				culling.resize(pyramidDepthView, renderExtent, deletionQueue, frameIndex);
+				renderGraph.setHistory(depthPyramid, culling.pyramidImage(), culling.pyramidLevelCount(), culling.pyramidReady());
 			}
-			// Window resize
-			if (const auto* resized = event->getIf<sf::Event::Resized>()) {
-				vkDeviceWaitIdle(device);
-				chk(vkGetPhysicalDeviceSurfaceCapabilitiesKHR(devices[deviceIndex], surface, &surfaceCaps));
-				swapchainCI.oldSwapchain = swapchain;
-				swapchainCI.imageExtent = { .width = static_cast<uint32_t>(resized->size.x), .height = static_cast<uint32_t>(resized->size.y) };
-				chk(vkCreateSwapchainKHR(device, &swapchainCI, nullptr, &swapchain));
-				for (auto i = 0; i < imageCount; i++) {
-					vkDestroyImageView(device, swapchainImageViews[i], nullptr);
+			renderGraph.execute(cb);
+			profiler.endGpuFrame(cb);
+			vkEndCommandBuffer(cb);
+			frameArena.end();
+			PROFILE_ZONE_END(recordZone);
+			// Submit to graphics queue, signaling the frame's timeline value and for presentation the image's semaphore
+			// Headless has no swapchain, so there is nothing to wait on or signal for presentation
+			const VkSemaphoreSubmitInfo waitSemaphoreInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, .semaphore = presentSemaphores[frameIndex], .stageMask = VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT };
+			frameTimelineValues[frameIndex] = ++frameTimelineValue;
+			const std::array<VkSemaphoreSubmitInfo, 2> signalSemaphoreInfos{ {
+				{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, .semaphore = frameTimeline, .value = frameTimelineValue, .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT },
+				{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, .semaphore = headless ? VK_NULL_HANDLE : renderSemaphores[imageIndex], .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT }
+			} };
+			const VkCommandBufferSubmitInfo cbSubmitInfo{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO, .commandBuffer = cb };
+			const VkSubmitInfo2 submitInfo{
+				.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+				.waitSemaphoreInfoCount = headless ? 0u : 1u,
+				.pWaitSemaphoreInfos = &waitSemaphoreInfo,
+				.commandBufferInfoCount = 1,
+				.pCommandBufferInfos = &cbSubmitInfo,
+				.signalSemaphoreInfoCount = headless ? 1u : 2u,
+				.pSignalSemaphoreInfos = signalSemaphoreInfos.data()
+			};
+			{
+				PROFILE_ZONE("Submit");
+				chk(vkQueueSubmit2(queue, 1, &submitInfo, VK_NULL_HANDLE));
+			}
+			benchSubmitTimes[frameIndex] = BenchClock::now();
+			frameIndex = (frameIndex + 1) % framesInFlight;
+			frameCount++;
+			if (!headless) {
+				const uint64_t presentId{ presentPacer.nextId() };
+				VkPresentIdKHR presentIdInfo{ .sType = VK_STRUCTURE_TYPE_PRESENT_ID_KHR, .swapchainCount = 1, .pPresentIds = &presentId };
+				VkPresentInfoKHR presentInfo{
+					.sType = VK_STRUCTURE_TYPE_PRESENT_INFO_KHR,
+					.pNext = presentTiming ? &presentIdInfo : nullptr,
+					.waitSemaphoreCount = 1,
+					.pWaitSemaphores = &renderSemaphores[imageIndex],
+					.swapchainCount = 1,
+					.pSwapchains = &swapchain,
+					.pImageIndices = &imageIndex
+				};
+				{
+					PROFILE_ZONE("Present");
+					const VkResult result{ vkQueuePresentKHR(queue, &presentInfo) };
+					if (result == VK_ERROR_OUT_OF_DATE_KHR || result == VK_SUBOPTIMAL_KHR) {
+						swapchainDirty = true;
+					} else {
+						chk(result);
+					}
 				}
-				vkGetSwapchainImagesKHR(device, swapchain, &imageCount, nullptr);
-				swapchainImages.resize(imageCount);
-				vkGetSwapchainImagesKHR(device, swapchain, &imageCount, swapchainImages.data());
-				swapchainImageViews.resize(imageCount);
-				for (auto i = 0; i < imageCount; i++) {
-					VkImageViewCreateInfo viewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = swapchainImages[i], .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = imageFormat, .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = 1, .layerCount = 1}};
-					chk(vkCreateImageView(device, &viewCI, nullptr, &swapchainImageViews[i]));
+				if (presentTiming) {
+					presentPacer.presented(inputTime);
+					// Input for the next frame is sampled once older frames are on screen, so it doesn't sit behind a long present queue
+					if (presentWait > 0) {
+						PROFILE_ZONE("Present wait");
+						presentPacer.waitQueued(presentWait);
+					}
+					const std::vector<double> latencies{ presentPacer.takeLatencies() };
+					if (benchFrames > 0) {
+						benchInputLatencies.insert(benchInputLatencies.end(), latencies.begin(), latencies.end());
+					}
 				}
-				vkDestroySwapchainKHR(device, swapchainCI.oldSwapchain, nullptr);
-				vmaDestroyImage(allocator, depthImage, depthImageAllocation);
-				vkDestroyImageView(device, depthImageView, nullptr);
-				depthImageCI.extent = { .width = static_cast<uint32_t>(window.getSize().x), .height = static_cast<uint32_t>(window.getSize().y), .depth = 1 };
-				VmaAllocationCreateInfo allocCI{ .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, .usage = VMA_MEMORY_USAGE_AUTO };
-				chk(vmaCreateImage(allocator, &depthImageCI, &allocCI, &depthImage, &depthImageAllocation, nullptr));
-				VkImageViewCreateInfo viewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = depthImage, .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = depthFormat, .subresourceRange = {.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT, .levelCount = 1, .layerCount = 1 } };
-				chk(vkCreateImageView(device, &viewCI, nullptr, &depthImageView));
 			}
+			if (frameCount == 1) {
+				firstFrameMs = std::chrono::duration<double, std::milli>(BenchClock::now() - startupStart).count();
+				std::cout << "First frame submitted " << firstFrameMs << " ms after startup\n";
+			}
+			profiler.endFrame();
+			if (benchFrames > 0) {
+				benchFrameTimes.push_back(std::chrono::duration<double, std::milli>(BenchClock::now() - frameStart).count());
+			}
+		}
+		// Lets the main thread know once a benchmark has rendered all of its frames
+		running = false;
+	};
+	std::thread renderThread(renderLoop);
+	// Main thread: window events and input, a new snapshot is published after every batch of events or at least every input interval
+	auto lastPublish = BenchClock::now();
+	while (running) {
+		if (headless) {
+			std::this_thread::sleep_for(inputInterval);
+		} else if (const std::optional event = window.waitEvent(inputInterval)) {
+			processEvent(*event);
+			while (const std::optional event = window.pollEvent()) {
+				processEvent(*event);
+			}
+		}
+		publishInput();
+		if (benchFrames > 0) {
+			const auto now = BenchClock::now();
+			benchInputIntervals.push_back(std::chrono::duration<double, std::milli>(now - lastPublish).count());
+			lastPublish = now;
+		}
+	}
+	renderThread.join();
+	textureStreamer.destroy();
+	if (!profileTrace.empty() && !profiler.writeTrace(profileTrace)) {
+		std::cerr << "Could not write profiler trace " << profileTrace << "\n";
+	}
+	// Benchmark results
+	if (benchFrames > 0) {
+		const double totalSeconds = std::chrono::duration<double>(BenchClock::now() - benchStart).count();
+		std::ofstream benchFile(benchOutput);
+		benchFile << "{\n";
+		benchFile << "\t\"device\": \"" << deviceProperties.properties.deviceName << "\",\n";
+		benchFile << "\t\"headless\": " << (headless ? "true" : "false") << ",\n";
+		benchFile << "\t\"width\": " << renderExtent.width << ",\n";
+		benchFile << "\t\"height\": " << renderExtent.height << ",\n";
+		benchFile << "\t\"frames\": " << frameCount << ",\n";
+		benchFile << "\t\"instances\": " << instanceCount << ",\n";
+		benchFile << "\t\"fps\": " << (double)frameCount / totalSeconds << ",\n";
+		benchFile << "\t\"meshSource\": \"" << (meshFromCache ? "cache" : "obj") << "\",\n";
+		benchFile << "\t\"meshLoadMs\": " << meshLoadMs << ",\n";
+		benchFile << "\t\"textureSetupMs\": " << textureSetupMs << ",\n";
+		benchFile << "\t\"shaderSource\": \"" << (shaderFromCache ? "cache" : "slang") << "\",\n";
+		benchFile << "\t\"shaderMs\": " << shaderMs << ",\n";
+		benchFile << "\t\"pipelineCache\": " << (pipelineFromCache ? "true" : "false") << ",\n";
+		benchFile << "\t\"pipelineMs\": " << pipelineMs << ",\n";
+		benchFile << "\t\"firstFrameMs\": " << firstFrameMs << ",\n";
+		benchFile << "\t\"texturesResidentMs\": " << textureStreamer.fullyResidentMs() << ",\n";
+		benchFile << "\t\"textureFiles\": [";
+		for (size_t i = 0; i < textureFiles.size(); i++) {
+			benchFile << (i > 0 ? ", " : "") << "{ \"file\": \"" << textureFiles[i] << "\", \"diskBytes\": " << std::filesystem::file_size(textureFiles[i]) << " }";
+		}
+		benchFile << "],\n";
+		benchFile << "\t\"bindless\": { \"capacity\": " << bindless.maxTextures() << ", \"textures\": " << bindless.textureCount() << ", \"slots\": " << bindless.slots()
+			<< ", \"samplers\": " << bindless.samplerCount() << ", \"churnPerFrame\": " << textureChurn << ", \"descriptorWrites\": " << bindless.descriptorWrites() << " },\n";
+		CullCounters cullSum{};
+		double triangleSum{ 0.0 };
+		for (auto& stats : benchCullStats) {
+			triangleSum += stats.triangles;
+			cullSum.tested += stats.tested;
+			cullSum.frustumCulled += stats.frustumCulled;
+			cullSum.occlusionCulled += stats.occlusionCulled;
+			cullSum.visible += stats.visible;
+			cullSum.drawCount += stats.drawCount;
+		}
+		const double cullFrames = std::max<double>(1.0, (double)benchCullStats.size());
+		benchFile << "\t\"culling\": { \"frustum\": " << ((cullFlags & cullFlagFrustum) ? "true" : "false")
+			<< ", \"occlusion\": " << ((cullFlags & cullFlagOcclusion) ? "true" : "false")
+			<< ", \"tested\": " << cullSum.tested / cullFrames
+			<< ", \"frustumCulled\": " << cullSum.frustumCulled / cullFrames
+			<< ", \"occlusionCulled\": " << cullSum.occlusionCulled / cullFrames
+			<< ", \"visible\": " << cullSum.visible / cullFrames
+			<< ", \"drawCalls\": " << cullSum.drawCount / cullFrames << " },\n";
+		benchFile << "\t\"directDraws\": " << (directDraws ? "true" : "false") << ",\n";
+		benchFile << "\t\"meshShading\": " << (meshShading ? "true" : "false") << ",\n";
+		// Vertex fetch estimate assumes every vertex of a drawn LOD is fetched once per instance, so it scales with the stride like the real traffic
+		const double verticesPerTriangle{ (double)meshHeader.vertexCount / (double)(indexCount / 3) };
+		benchFile << "\t\"vertexFormat\": { \"format\": \"" << vertexFormatName(vertexEncoding.format) << "\", \"stride\": " << vertexBinding.stride
+			<< ", \"vertexBufferBytes\": " << meshHeader.vertexCount * vertexBinding.stride << ", \"floatVertexBufferBytes\": " << sizeof(Vertex) * meshHeader.vertexCount
+			<< ", \"vertexFetchBytesPerFrame\": " << triangleSum / cullFrames * verticesPerTriangle * vertexBinding.stride
+			<< ", \"positionError\": " << vertexEncoding.positionError << ", \"normalErrorDegrees\": " << vertexEncoding.normalErrorDegrees << ", \"uvError\": " << vertexEncoding.uvError << " },\n";
+		// LOD chain of the first mesh
+		benchFile << "\t\"lods\": [";
+		for (uint32_t i = 0; i < meshDraws[0].lodCount; i++) {
+			benchFile << (i > 0 ? ", " : "") << "{ \"triangles\": " << meshDraws[i].indexCount / 3 << ", \"error\": " << meshDraws[i].lodError << " }";
+		}
+		benchFile << "],\n";
+		benchFile << "\t\"geometry\": { \"meshes\": " << meshCount << ", \"materials\": " << materialColors.size()
+			<< ", \"vertexCapacity\": " << geometryPool.vertexCapacityCount() << ", \"verticesUsed\": " << geometryPool.verticesUsed()
+			<< ", \"indexCapacity\": " << geometryPool.indexCapacityCount() << ", \"indicesUsed\": " << geometryPool.indicesUsed()
+			<< ", \"allocations\": " << geometryPool.allocationCount() << ", \"indexSize\": " << geometryPool.indexBytes() << " },\n";
+		benchFile << "\t\"meshlets\": { \"count\": " << meshletStats.meshletCount << ", \"vertices\": " << meshletStats.vertexCount << ", \"triangles\": " << meshletStats.triangleCount << ", \"usableCones\": " << meshletStats.coneCount << " },\n";
+		// Triangles of all visible instances at their LOD before meshlet culling, so both render paths are measured against the same workload
+		const double trianglesPerFrame{ triangleSum / cullFrames };
+		const double meanGpuMs{ benchGpuTimes.empty() ? 0.0 : std::accumulate(benchGpuTimes.begin(), benchGpuTimes.end(), 0.0) / benchGpuTimes.size() };
+		benchFile << "\t\"trianglesPerFrame\": " << trianglesPerFrame << ",\n";
+		benchFile << "\t\"trianglesPerSecond\": " << (meanGpuMs > 0.0 ? trianglesPerFrame / meanGpuMs * 1000.0 : 0.0) << ",\n";
+		benchFile << "\t\"recordThreads\": " << recorder.threadCount() << ",\n";
+		benchFile << "\t\"framesInFlight\": " << framesInFlight << ",\n";
+		benchFile << "\t\"presentation\": { \"presentMode\": \"" << (headless ? "none" : presentModeName(presentMode)) << "\", \"swapchainImages\": " << (headless ? 0 : imageCount)
+			<< ", \"presentTiming\": " << (presentTiming ? "true" : "false") << ", \"presentWait\": " << presentWait << ", \"swapchainRecreations\": " << swapchainRecreations << " },\n";
+		benchFile << "\t\"memory\": { \"budgetExtension\": " << (memoryBudget ? "true" : "false") << ", \"budgetLimit\": " << gpuMemory.limit() << ", \"peakDeviceUsage\": " << gpuMemory.peakUsage();
+		for (uint32_t i = 0; i < memoryCategoryCount; i++) {
+			benchFile << ", \"" << memoryCategoryName(static_cast<MemoryCategory>(i)) << "\": " << gpuMemory.bytes(static_cast<MemoryCategory>(i));
+		}
+		benchFile << ", \"heaps\": [";
+		for (uint32_t i = 0; i < gpuMemory.heaps(); i++) {
+			benchFile << (i > 0 ? ", " : "") << "{ \"deviceLocal\": " << (gpuMemory.heapDeviceLocal(i) ? "true" : "false") << ", \"usage\": " << gpuMemory.heapUsage(i) << ", \"budget\": " << gpuMemory.heapBudget(i) << " }";
+		}
+		const DefragmentationStats& defragStats{ gpuMemory.defragmentationStats() };
+		benchFile << "], \"budgetWarnings\": " << gpuMemory.warnings() << ", \"evictedBytes\": " << gpuMemory.evicted()
+			<< ", \"defragmentation\": { \"runs\": " << defragStats.runs << ", \"passes\": " << defragStats.passes << ", \"allocationsMoved\": " << defragStats.allocationsMoved
+			<< ", \"bytesMoved\": " << defragStats.bytesMoved << ", \"bytesFreed\": " << defragStats.bytesFreed << " } },\n";
+		benchFile << "\t\"renderGraph\": { \"passes\": " << renderGraph.passCount() << ", \"culledPasses\": " << renderGraph.culledPassCount() << ", \"barrierCalls\": " << renderGraph.barrierCalls()
+			<< ", \"imageBarriers\": " << renderGraph.imageBarriers() << ", \"transientBytes\": " << renderGraph.transientBytes() << ", \"transientAllocatedBytes\": " << renderGraph.transientAllocatedBytes()
+			<< ", \"compilations\": " << renderGraph.compilations() << " },\n";
+		benchFile << "\t\"frameArena\": { \"capacity\": " << frameArena.capacity() << ", \"highWaterMark\": " << frameArena.highWaterMark() << ", \"overflows\": " << frameArena.overflows() << " },\n";
+		writeTimings(benchFile, "recordMs", benchRecordTimes, false);
+		writeTimings(benchFile, "transformMs", benchTransformTimes, false);
+		writeTimings(benchFile, "cpuFrameTimeMs", benchFrameTimes, false);
+		writeTimings(benchFile, "gpuFrameTimeMs", benchGpuTimes, false);
+		// Submit to frame timeline completion, the key keeps its name from before the timeline replaced the fences so results stay comparable
+		writeTimings(benchFile, "submitToFenceMs", benchSubmitLatencies, false);
+		benchFile << "\t\"inputSnapshots\": { \"published\": " << benchInputIntervals.size() << ", \"consumed\": " << benchInputAges.size() << ", \"replaced\": " << benchInputsReplaced << " },\n";
+		writeTimings(benchFile, "inputIntervalMs", benchInputIntervals, false);
+		writeTimings(benchFile, "inputAgeMs", benchInputAges, false);
+		writeTimings(benchFile, "inputToPresentMs", benchInputLatencies, true);
+		benchFile << "}\n";
+		std::cout << "Benchmark: " << frameCount << " frames, " << (double)frameCount / totalSeconds << " fps, p50 " << percentile(benchFrameTimes, 0.5) << " ms, results written to " << benchOutput << "\n";
+		if (!benchInputLatencies.empty()) {
+			std::cout << "Input to present latency: p50 " << percentile(benchInputLatencies, 0.5) << " ms, p99 " << percentile(benchInputLatencies, 0.99) << " ms\n";
 		}
 	}
 	// Tear down
 	chk(vkDeviceWaitIdle(device));
-	for (auto i = 0; i < maxFramesInFlight; i++) {
-		vkDestroyFence(device, fences[i], nullptr);
+	presentPacer.stop();
+	deletionQueue.flushAll();
+	if (!memoryStatsFile.empty() && !gpuMemory.writeStats(memoryStatsFile)) {
+		std::cerr << "Could not write memory stats " << memoryStatsFile << "\n";
+	}
+	gpuMemory.destroy();
+	vkDestroySemaphore(device, frameTimeline, nullptr);
+	for (auto i = 0; i < framesInFlight; i++) {
 		vkDestroySemaphore(device, presentSemaphores[i], nullptr);
-		vkDestroySemaphore(device, renderSemaphores[i], nullptr);
-		vmaUnmapMemory(allocator, shaderDataBuffers[i].allocation);
-		vmaDestroyBuffer(allocator, shaderDataBuffers[i].buffer, shaderDataBuffers[i].allocation);
 	}
-	vmaDestroyImage(allocator, depthImage, depthImageAllocation);
-	vkDestroyImageView(device, depthImageView, nullptr);
+	for (auto& semaphore : renderSemaphores) {
+		vkDestroySemaphore(device, semaphore, nullptr);
+	}
+	renderGraph.destroy();
 	for (auto i = 0; i < swapchainImageViews.size(); i++) {
 		vkDestroyImageView(device, swapchainImageViews[i], nullptr);
 	}
-	vmaDestroyBuffer(allocator, vBuffer, vBufferAllocation);
+	for (auto i = 0; i < offscreenImageAllocations.size(); i++) {
+		gpuMemory.destroyImage(swapchainImages[i], offscreenImageAllocations[i]);
+	}
+	geometryPool.destroy();
+	instanceBuffer.destroy();
+	gpuMemory.untrack(frameArena.memory());
+	frameArena.destroy();
+	culling.destroy();
+	profiler.destroy();
 	for (auto i = 0; i < textures.size(); i++) {
 		vkDestroyImageView(device, textures[i].view, nullptr);
-		vkDestroySampler(device, textures[i].sampler, nullptr);
-		vmaDestroyImage(allocator, textures[i].image, textures[i].allocation);
+		gpuMemory.destroyImage(textures[i].image, textures[i].allocation);
 	}
-	vkDestroyDescriptorSetLayout(device, descriptorSetLayoutTex, nullptr);
-	vkDestroyDescriptorPool(device, descriptorPool, nullptr);
+	bindless.destroy();
 	vkDestroyPipelineLayout(device, pipelineLayout, nullptr);
 	vkDestroyPipeline(device, pipeline, nullptr);
-	vkDestroySwapchainKHR(device, swapchain, nullptr);
-	vkDestroySurfaceKHR(instance, surface, nullptr);
-	vkDestroyCommandPool(device, commandPool, nullptr);
+	vkDestroyPipelineLayout(device, meshPipelineLayout, nullptr);
+	vkDestroyPipeline(device, meshPipeline, nullptr);
+	gpuMemory.destroyBuffer(meshletBuffer, meshletBufferAllocation);
+	if (pipelineCache != VK_NULL_HANDLE) {
+		vkDestroyPipelineCache(device, pipelineCache, nullptr);
+	}
+	if (!headless) {
+		vkDestroySwapchainKHR(device, swapchain, nullptr);
+		vkDestroySurfaceKHR(instance, surface, nullptr);
+	}
+	recorder.destroy();
+	jobs.stop();
+	for (auto i = 0; i < framesInFlight; i++) {
+		vkDestroyCommandPool(device, commandPools[i], nullptr);
+	}
 	vkDestroyShaderModule(device, shaderModule, nullptr);
+	vkDestroyShaderModule(device, meshletShaderModule, nullptr);
+	gpuMemory.untrack(uploads.ringMemory());
+	uploads.destroy();
 	vmaDestroyAllocator(allocator);
 	vkDestroyDevice(device, nullptr);
 	vkDestroyInstance(instance, nullptr);
@@ -0,0 +1,110 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Read-only memory mapped file, lets the OS page file contents in on demand instead of copying them through a stream
+
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+class MappedFile {
+public:
+	MappedFile() = default;
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+	~MappedFile() { close(); }
+
+	bool open(const std::string& path) {
+		close();
+#if defined(_WIN32)
+		file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_FLAG_SEQUENTIAL_SCAN, nullptr);
+		if (file == INVALID_HANDLE_VALUE) {
+			return false;
+		}
+		LARGE_INTEGER fileSize{};
+		GetFileSizeEx(file, &fileSize);
+		length = static_cast<size_t>(fileSize.QuadPart);
+		if (length == 0) {
+			return true;
+		}
+		mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if (mapping == nullptr) {
+			close();
+			return false;
+		}
+		ptr = static_cast<const uint8_t*>(MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0));
+#else
+		fd = ::open(path.c_str(), O_RDONLY);
+		if (fd < 0) {
+			return false;
+		}
+		struct stat fileStat{};
+		fstat(fd, &fileStat);
+		length = static_cast<size_t>(fileStat.st_size);
+		if (length == 0) {
+			return true;
+		}
+		void* mapped = mmap(nullptr, length, PROT_READ, MAP_PRIVATE, fd, 0);
+		ptr = (mapped == MAP_FAILED) ? nullptr : static_cast<const uint8_t*>(mapped);
+		if (ptr != nullptr) {
+			madvise(mapped, length, MADV_SEQUENTIAL);
+		}
+#endif
+		if (ptr == nullptr) {
+			close();
+			return false;
+		}
+		return true;
+	}
+
+	void close() {
+#if defined(_WIN32)
+		if (ptr != nullptr) {
+			UnmapViewOfFile(ptr);
+		}
+		if (mapping != nullptr) {
+			CloseHandle(mapping);
+		}
+		if (file != INVALID_HANDLE_VALUE) {
+			CloseHandle(file);
+		}
+		mapping = nullptr;
+		file = INVALID_HANDLE_VALUE;
+#else
+		if (ptr != nullptr) {
+			munmap(const_cast<uint8_t*>(ptr), length);
+		}
+		if (fd >= 0) {
+			::close(fd);
+		}
+		fd = -1;
+#endif
+		ptr = nullptr;
+		length = 0;
+	}
+
+	const uint8_t* data() const { return ptr; }
+	size_t size() const { return length; }
+
+private:
+#if defined(_WIN32)
+	HANDLE file{ INVALID_HANDLE_VALUE };
+	HANDLE mapping{ nullptr };
+#else
+	int fd{ -1 };
+#endif
+	const uint8_t* ptr{ nullptr };
+	size_t length{ 0 };
+};
@@ -0,0 +1,292 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// GPU memory budget and telemetry: Allocations are made within the heap budgets VMA reports (VK_EXT_memory_budget if
+// available) and accounted per category. Going over budget is reported instead of failing, and an eviction hook is called
+// so the application can release memory. Fragmented default pools are compacted with incremental defragmentation passes,
+// each one ends once the frame timeline has reached the value of the frame that recorded its copies.
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <functional>
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstdint>
+#include <iostream>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+#include "common.h"
+#include "deletionqueue.h"
+
+enum class MemoryCategory : uint32_t {
+	Textures,
+	Geometry,
+	Attachments,
+	// Per frame and staging memory
+	Transient,
+};
+constexpr uint32_t memoryCategoryCount{ 4 };
+
+inline const char* memoryCategoryName(MemoryCategory category) {
+	switch (category) {
+	case MemoryCategory::Textures:
+		return "textures";
+	case MemoryCategory::Geometry:
+		return "geometry";
+	case MemoryCategory::Attachments:
+		return "attachments";
+	default:
+		return "transient";
+	}
+}
+
+struct DefragmentationStats {
+	uint32_t runs{ 0 };
+	uint32_t passes{ 0 };
+	uint32_t allocationsMoved{ 0 };
+	VkDeviceSize bytesMoved{ 0 };
+	VkDeviceSize bytesFreed{ 0 };
+};
+
+// Not thread safe, all calls must come from the thread that records the frame
+class GpuMemory {
+public:
+	// Eviction hook, called with the number of bytes over budget. Returns the number of bytes that will be released
+	using EvictFunction = std::function<VkDeviceSize(VkDeviceSize overBudget)>;
+	// Defragmentation move, the callee either places the resource at the destination and returns true or keeps it where it is
+	using MoveFunction = std::function<bool(VmaAllocation source, VmaAllocation destination)>;
+
+	// A non-zero limit caps the budget of every device local heap, which simulates a smaller GPU
+	void create(VmaAllocator allocator, VkDeviceSize budgetLimit = 0) {
+		this->allocator = allocator;
+		this->budgetLimit = budgetLimit;
+		const VkPhysicalDeviceMemoryProperties* memoryProperties{ nullptr };
+		vmaGetMemoryProperties(allocator, &memoryProperties);
+		heapCount = memoryProperties->memoryHeapCount;
+		for (uint32_t i = 0; i < heapCount; i++) {
+			deviceLocal[i] = (memoryProperties->memoryHeaps[i].flags & VK_MEMORY_HEAP_DEVICE_LOCAL_BIT) != 0;
+		}
+		updateBudgets();
+	}
+
+	// Tries to stay within budget first, if that fails the allocation is made anyway and reported
+	VkResult createImage(MemoryCategory category, const VkImageCreateInfo& imageCI, const VmaAllocationCreateInfo& allocCI, VkImage& image, VmaAllocation& allocation) {
+		VmaAllocationCreateInfo budgetAllocCI{ allocCI };
+		budgetAllocCI.flags |= VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+		VkResult result{ vmaCreateImage(allocator, &imageCI, &budgetAllocCI, &image, &allocation, nullptr) };
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+			result = vmaCreateImage(allocator, &imageCI, &allocCI, &image, &allocation, nullptr);
+		}
+		if (result == VK_SUCCESS) {
+			track(category, allocation);
+		}
+		return result;
+	}
+
+	VkResult createBuffer(MemoryCategory category, const VkBufferCreateInfo& bufferCI, const VmaAllocationCreateInfo& allocCI, VkBuffer& buffer, VmaAllocation& allocation, VmaAllocationInfo* allocInfo = nullptr) {
+		VmaAllocationCreateInfo budgetAllocCI{ allocCI };
+		budgetAllocCI.flags |= VMA_ALLOCATION_CREATE_WITHIN_BUDGET_BIT;
+		VkResult result{ vmaCreateBuffer(allocator, &bufferCI, &budgetAllocCI, &buffer, &allocation, allocInfo) };
+		if (result == VK_ERROR_OUT_OF_DEVICE_MEMORY) {
+			result = vmaCreateBuffer(allocator, &bufferCI, &allocCI, &buffer, &allocation, allocInfo);
+		}
+		if (result == VK_SUCCESS) {
+			track(category, allocation);
+		}
+		return result;
+	}
+
+	void destroyImage(VkImage image, VmaAllocation allocation) {
+		untrack(allocation);
+		vmaDestroyImage(allocator, image, allocation);
+	}
+
+	void destroyBuffer(VkBuffer buffer, VmaAllocation allocation) {
+		untrack(allocation);
+		vmaDestroyBuffer(allocator, buffer, allocation);
+	}
+
+	// For allocations made by other modules, they must be untracked before they're freed
+	void track(MemoryCategory category, VmaAllocation allocation) {
+		VmaAllocationInfo allocInfo{};
+		vmaGetAllocationInfo(allocator, allocation, &allocInfo);
+		allocations[allocation] = { .category = category, .size = allocInfo.size };
+		categoryBytes[static_cast<uint32_t>(category)] += allocInfo.size;
+		updateBudgets();
+		const VkDeviceSize over{ overBudget() };
+		if (over > 0) {
+			budgetWarnings++;
+			std::cerr << "Warning: " << memoryCategoryName(category) << " allocation of " << allocInfo.size / 1024 << " KB exceeds the device memory budget by " << over / 1024 << " KB\n";
+		}
+	}
+
+	void untrack(VmaAllocation allocation) {
+		auto it = allocations.find(allocation);
+		if (it != allocations.end()) {
+			categoryBytes[static_cast<uint32_t>(it->second.category)] -= it->second.size;
+			allocations.erase(it);
+		}
+	}
+
+	void setEvictionHook(EvictFunction&& evict) {
+		this->evict = std::move(evict);
+	}
+
+	// Call once per frame after the frame timeline wait. Asks the eviction hook for memory when over budget, memory it releases only
+	// shows up in the budget once the frames using it have retired, so it isn't asked again until then. Eviction also waits
+	// for a running defragmentation, which may be moving the allocations it would free
+	void update(uint32_t frameNumber, uint32_t framesInFlight) {
+		vmaSetCurrentFrameIndex(allocator, frameNumber);
+		updateBudgets();
+		if (evictionCooldown > 0) {
+			evictionCooldown--;
+			return;
+		}
+		const VkDeviceSize over{ overBudget() };
+		if (over > 0 && evict && defragContext == VK_NULL_HANDLE) {
+			const VkDeviceSize released{ evict(over) };
+			if (released > 0) {
+				evictedBytes += released;
+				evictionCooldown = framesInFlight + 1;
+			}
+		}
+	}
+
+	// Sum over all device local heaps of the usage above their budget
+	VkDeviceSize overBudget() const {
+		VkDeviceSize over{ 0 };
+		for (uint32_t i = 0; i < heapCount; i++) {
+			if (deviceLocal[i] && budgets[i].usage > heapBudget(i)) {
+				over += budgets[i].usage - heapBudget(i);
+			}
+		}
+		return over;
+	}
+
+	// Budget of a heap with the limit applied
+	VkDeviceSize heapBudget(uint32_t heap) const {
+		return (budgetLimit > 0 && deviceLocal[heap]) ? std::min(budgets[heap].budget, budgetLimit) : budgets[heap].budget;
+	}
+
+	// Share of the free memory in VMA's blocks that isn't part of the largest free range, 0 if all of it is contiguous
+	float fragmentation() const {
+		VmaTotalStatistics stats{};
+		vmaCalculateStatistics(allocator, &stats);
+		const VmaDetailedStatistics& total{ stats.total };
+		const VkDeviceSize unused{ total.statistics.blockBytes - total.statistics.allocationBytes };
+		return (unused > 0 && total.unusedRangeCount > 1) ? 1.0f - static_cast<float>(total.unusedRangeSizeMax) / static_cast<float>(unused) : 0.0f;
+	}
+
+	// Writes VMA's detailed JSON dump of all heaps, blocks and allocations
+	bool writeStats(const std::string& path) const {
+		char* statsString{ nullptr };
+		vmaBuildStatsString(allocator, &statsString, VK_TRUE);
+		std::ofstream file(path, std::ios::binary);
+		file << statsString;
+		vmaFreeStatsString(allocator, statsString);
+		return file.good();
+	}
+
+	// Moves at most this much per pass, so the copies of one pass don't cause a frame time spike
+	void beginDefragmentation(VkDeviceSize maxBytesPerPass = 64 * 1024 * 1024, uint32_t maxAllocationsPerPass = 16) {
+		if (defragContext != VK_NULL_HANDLE) {
+			return;
+		}
+		VmaDefragmentationInfo defragInfo{ .flags = VMA_DEFRAGMENTATION_FLAG_ALGORITHM_FAST_BIT, .maxBytesPerPass = maxBytesPerPass, .maxAllocationsPerPass = maxAllocationsPerPass };
+		chk(vmaBeginDefragmentation(allocator, &defragInfo, &defragContext));
+		defragStats.runs++;
+	}
+
+	bool defragmenting() const { return defragContext != VK_NULL_HANDLE; }
+
+	// Starts the next pass if the previous one has ended. The callee records the copies for every move into the current frame
+	// and retires the source resources into the deletion queue, the pass ends after them through the same queue
+	void defragmentStep(DeletionQueue& deletions, uint32_t frameIndex, const MoveFunction& move) {
+		if (defragContext == VK_NULL_HANDLE || passPending) {
+			return;
+		}
+		if (vmaBeginDefragmentationPass(allocator, defragContext, &passInfo) == VK_SUCCESS) {
+			endDefragmentation();
+			return;
+		}
+		for (uint32_t i = 0; i < passInfo.moveCount; i++) {
+			VmaDefragmentationMove& defragMove{ passInfo.pMoves[i] };
+			if (!move(defragMove.srcAllocation, defragMove.dstTmpAllocation)) {
+				defragMove.operation = VMA_DEFRAGMENTATION_MOVE_OPERATION_IGNORE;
+			}
+		}
+		passPending = true;
+		defragStats.passes++;
+		deletions.push(frameIndex, [this]() {
+			passPending = false;
+			if (vmaEndDefragmentationPass(allocator, defragContext, &passInfo) == VK_SUCCESS) {
+				endDefragmentation();
+			}
+		});
+	}
+
+	// The device must be idle
+	void destroy() {
+		if (defragContext != VK_NULL_HANDLE) {
+			endDefragmentation();
+		}
+	}
+
+	VkDeviceSize bytes(MemoryCategory category) const { return categoryBytes[static_cast<uint32_t>(category)]; }
+	uint32_t heaps() const { return heapCount; }
+	bool heapDeviceLocal(uint32_t heap) const { return deviceLocal[heap]; }
+	VkDeviceSize heapUsage(uint32_t heap) const { return budgets[heap].usage; }
+	// Peak usage of the device local heaps over all frames
+	VkDeviceSize peakUsage() const { return peakDeviceUsage; }
+	VkDeviceSize limit() const { return budgetLimit; }
+	uint32_t warnings() const { return budgetWarnings; }
+	VkDeviceSize evicted() const { return evictedBytes; }
+	const DefragmentationStats& defragmentationStats() const { return defragStats; }
+
+private:
+	struct TrackedAllocation {
+		MemoryCategory category{ MemoryCategory::Transient };
+		VkDeviceSize size{ 0 };
+	};
+
+	VmaAllocator allocator{ VK_NULL_HANDLE };
+	VkDeviceSize budgetLimit{ 0 };
+	uint32_t heapCount{ 0 };
+	std::array<bool, VK_MAX_MEMORY_HEAPS> deviceLocal{};
+	std::array<VmaBudget, VK_MAX_MEMORY_HEAPS> budgets{};
+	VkDeviceSize peakDeviceUsage{ 0 };
+	std::unordered_map<VmaAllocation, TrackedAllocation> allocations;
+	std::array<VkDeviceSize, memoryCategoryCount> categoryBytes{};
+	uint32_t budgetWarnings{ 0 };
+	EvictFunction evict;
+	uint32_t evictionCooldown{ 0 };
+	VkDeviceSize evictedBytes{ 0 };
+	VmaDefragmentationContext defragContext{ VK_NULL_HANDLE };
+	VmaDefragmentationPassMoveInfo passInfo{};
+	bool passPending{ false };
+	DefragmentationStats defragStats{};
+
+	void updateBudgets() {
+		vmaGetHeapBudgets(allocator, budgets.data());
+		VkDeviceSize deviceUsage{ 0 };
+		for (uint32_t i = 0; i < heapCount; i++) {
+			deviceUsage += deviceLocal[i] ? budgets[i].usage : 0;
+		}
+		peakDeviceUsage = std::max(peakDeviceUsage, deviceUsage);
+	}
+
+	void endDefragmentation() {
+		VmaDefragmentationStats stats{};
+		vmaEndDefragmentation(allocator, defragContext, &stats);
+		defragContext = VK_NULL_HANDLE;
+		defragStats.allocationsMoved += stats.allocationsMoved;
+		defragStats.bytesMoved += stats.bytesMoved;
+		defragStats.bytesFreed += stats.bytesFreed;
+		std::cout << "Defragmentation moved " << stats.allocationsMoved << " allocations (" << stats.bytesMoved / 1024 << " KB) and freed " << stats.bytesFreed / 1024 << " KB\n";
+	}
+};
@@ -0,0 +1,283 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Mesh processing done at load time: vertex welding, post-transform vertex cache optimization (Tipsify),
+// overdraw aware cluster ordering and vertex fetch reordering
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <numeric>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <glm/glm.hpp>
+
+struct Vertex {
+	glm::vec3 pos;
+	glm::vec3 normal;
+	glm::vec2 uv;
+};
+
+// Size of the simulated post-transform cache, small enough to be a lower bound for current GPUs
+constexpr uint32_t vertexCacheSize{ 16 };
+
+struct MeshStats {
+	size_t vertexCountIn{ 0 };
+	size_t vertexCountOut{ 0 };
+	float acmrIn{ 0.0f };
+	float acmrOut{ 0.0f };
+};
+
+// Average cache miss ratio: vertex shader invocations per triangle for a FIFO cache, 0.5 is optimal and 3.0 is worst case
+inline float calculateACMR(const std::vector<uint32_t>& indices, size_t vertexCount, uint32_t cacheSize = vertexCacheSize) {
+	if (indices.empty()) {
+		return 0.0f;
+	}
+	std::vector<uint32_t> timestamps(vertexCount, 0);
+	uint32_t time{ cacheSize + 1 };
+	uint32_t misses{ 0 };
+	for (auto index : indices) {
+		if (time - timestamps[index] > cacheSize) {
+			timestamps[index] = time++;
+			misses++;
+		}
+	}
+	return (float)misses / (float)(indices.size() / 3);
+}
+
+// Merges vertices with identical position, normal and uv and rewrites the indices accordingly
+inline void weldVertices(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	struct VertexHash {
+		size_t operator()(const Vertex& v) const {
+			// FNV-1a over the raw bytes, Vertex has no padding so this is stable
+			const uint8_t* bytes = reinterpret_cast<const uint8_t*>(&v);
+			uint64_t hash{ 14695981039346656037ull };
+			for (size_t i = 0; i < sizeof(Vertex); i++) {
+				hash = (hash ^ bytes[i]) * 1099511628211ull;
+			}
+			return static_cast<size_t>(hash);
+		}
+	};
+	struct VertexEqual {
+		bool operator()(const Vertex& a, const Vertex& b) const { return memcmp(&a, &b, sizeof(Vertex)) == 0; }
+	};
+	std::unordered_map<Vertex, uint32_t, VertexHash, VertexEqual> uniqueVertices;
+	uniqueVertices.reserve(vertices.size());
+	std::vector<Vertex> welded;
+	welded.reserve(vertices.size());
+	for (auto& index : indices) {
+		const auto [it, inserted] = uniqueVertices.try_emplace(vertices[index], static_cast<uint32_t>(welded.size()));
+		if (inserted) {
+			welded.push_back(vertices[index]);
+		}
+		index = it->second;
+	}
+	vertices = std::move(welded);
+}
+
+// Tipsify (Sander et al., "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw", 2007)
+// Returns the reordered indices and the first triangle of each cluster, clusters start wherever the fanning hits a dead end
+inline std::vector<uint32_t> tipsify(const std::vector<uint32_t>& indices, size_t vertexCount, std::vector<uint32_t>& clusters, uint32_t cacheSize = vertexCacheSize) {
+	const size_t triangleCount{ indices.size() / 3 };
+	// Vertex to triangle adjacency in compressed row layout
+	std::vector<uint32_t> live(vertexCount, 0);
+	for (auto index : indices) {
+		live[index]++;
+	}
+	std::vector<uint32_t> offsets(vertexCount + 1, 0);
+	for (size_t i = 0; i < vertexCount; i++) {
+		offsets[i + 1] = offsets[i] + live[i];
+	}
+	std::vector<uint32_t> adjacency(indices.size());
+	std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+	for (size_t i = 0; i < indices.size(); i++) {
+		adjacency[fill[indices[i]]++] = static_cast<uint32_t>(i / 3);
+	}
+	std::vector<uint32_t> cacheTime(vertexCount, 0);
+	std::vector<bool> emitted(triangleCount, false);
+	std::vector<uint32_t> deadEnd;
+	std::vector<uint32_t> candidates;
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	clusters.clear();
+	uint32_t time{ cacheSize + 1 };
+	uint32_t cursor{ 0 };
+	int64_t fanning{ vertexCount > 0 ? 0 : -1 };
+	bool newCluster{ true };
+	while (fanning >= 0) {
+		candidates.clear();
+		for (uint32_t a = offsets[fanning]; a < offsets[fanning + 1]; a++) {
+			const uint32_t triangle{ adjacency[a] };
+			if (emitted[triangle]) {
+				continue;
+			}
+			if (newCluster) {
+				clusters.push_back(static_cast<uint32_t>(result.size() / 3));
+				newCluster = false;
+			}
+			for (uint32_t k = 0; k < 3; k++) {
+				const uint32_t v{ indices[triangle * 3 + k] };
+				result.push_back(v);
+				deadEnd.push_back(v);
+				candidates.push_back(v);
+				live[v]--;
+				if (time - cacheTime[v] > cacheSize) {
+					cacheTime[v] = time++;
+				}
+			}
+			emitted[triangle] = true;
+		}
+		// Pick the candidate that will still be in the cache after emitting all of its remaining triangles, preferring the oldest
+		int64_t best{ -1 };
+		int64_t bestPriority{ -1 };
+		for (auto v : candidates) {
+			if (live[v] == 0) {
+				continue;
+			}
+			int64_t priority{ 0 };
+			if (time - cacheTime[v] + 2 * live[v] <= cacheSize) {
+				priority = time - cacheTime[v];
+			}
+			if (priority > bestPriority) {
+				best = v;
+				bestPriority = priority;
+			}
+		}
+		if (best == -1) {
+			// Dead end: Fall back to recently used vertices, then to the next vertex in input order
+			newCluster = true;
+			while (!deadEnd.empty() && best == -1) {
+				const uint32_t v{ deadEnd.back() };
+				deadEnd.pop_back();
+				if (live[v] > 0) {
+					best = v;
+				}
+			}
+			while (best == -1 && cursor < vertexCount) {
+				if (live[cursor] > 0) {
+					best = cursor;
+				}
+				cursor++;
+			}
+		}
+		fanning = best;
+	}
+	return result;
+}
+
+// Sorts the Tipsify clusters so that clusters facing away from the mesh center (likely occluders) are drawn first
+inline void optimizeOverdraw(std::vector<uint32_t>& indices, const std::vector<Vertex>& vertices, const std::vector<uint32_t>& clusters) {
+	const size_t triangleCount{ indices.size() / 3 };
+	if (clusters.size() < 2) {
+		return;
+	}
+	glm::vec3 meshCenter{ 0.0f };
+	float meshArea{ 0.0f };
+	struct Cluster {
+		uint32_t first;
+		uint32_t count;
+		float sortKey;
+	};
+	std::vector<Cluster> sorted(clusters.size());
+	std::vector<glm::vec3> clusterCenters(clusters.size(), glm::vec3(0.0f));
+	std::vector<glm::vec3> clusterNormals(clusters.size(), glm::vec3(0.0f));
+	std::vector<float> clusterAreas(clusters.size(), 0.0f);
+	for (size_t c = 0; c < clusters.size(); c++) {
+		const uint32_t first{ clusters[c] };
+		const uint32_t last{ c + 1 < clusters.size() ? clusters[c + 1] : static_cast<uint32_t>(triangleCount) };
+		sorted[c] = { .first = first, .count = last - first };
+		for (uint32_t t = first; t < last; t++) {
+			const glm::vec3& p0 = vertices[indices[t * 3]].pos;
+			const glm::vec3& p1 = vertices[indices[t * 3 + 1]].pos;
+			const glm::vec3& p2 = vertices[indices[t * 3 + 2]].pos;
+			const glm::vec3 normal{ glm::cross(p1 - p0, p2 - p0) };
+			const float area{ glm::length(normal) * 0.5f };
+			const glm::vec3 centroid{ (p0 + p1 + p2) / 3.0f };
+			clusterCenters[c] += centroid * area;
+			clusterNormals[c] += normal;
+			clusterAreas[c] += area;
+			meshCenter += centroid * area;
+			meshArea += area;
+		}
+	}
+	if (meshArea > 0.0f) {
+		meshCenter /= meshArea;
+	}
+	for (size_t c = 0; c < clusters.size(); c++) {
+		const glm::vec3 center{ clusterAreas[c] > 0.0f ? clusterCenters[c] / clusterAreas[c] : meshCenter };
+		const float normalLength{ glm::length(clusterNormals[c]) };
+		sorted[c].sortKey = normalLength > 0.0f ? glm::dot(center - meshCenter, clusterNormals[c] / normalLength) : 0.0f;
+	}
+	std::stable_sort(sorted.begin(), sorted.end(), [](const Cluster& a, const Cluster& b) { return a.sortKey > b.sortKey; });
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (auto& cluster : sorted) {
+		result.insert(result.end(), indices.begin() + cluster.first * 3, indices.begin() + (cluster.first + cluster.count) * 3);
+	}
+	indices = std::move(result);
+}
+
+// Reorders vertices in order of first use so vertex fetches walk memory linearly
+inline void optimizeVertexFetch(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	constexpr uint32_t unused{ ~0u };
+	std::vector<uint32_t> remap(vertices.size(), unused);
+	std::vector<Vertex> reordered;
+	reordered.reserve(vertices.size());
+	for (auto& index : indices) {
+		if (remap[index] == unused) {
+			remap[index] = static_cast<uint32_t>(reordered.size());
+			reordered.push_back(vertices[index]);
+		}
+		index = remap[index];
+	}
+	vertices = std::move(reordered);
+}
+
+// Runs all processing steps on a triangle list with one vertex per corner
+inline MeshStats optimizeMesh(std::vector<Vertex>& vertices, std::vector<uint32_t>& indices) {
+	MeshStats stats{ .vertexCountIn = vertices.size(), .acmrIn = calculateACMR(indices, vertices.size()) };
+	weldVertices(vertices, indices);
+	std::vector<uint32_t> clusters;
+	indices = tipsify(indices, vertices.size(), clusters);
+	optimizeOverdraw(indices, vertices, clusters);
+	optimizeVertexFetch(vertices, indices);
+	stats.vertexCountOut = vertices.size();
+	stats.acmrOut = calculateACMR(indices, vertices.size());
+	return stats;
+}
+
+inline void printMeshStats(const MeshStats& stats, size_t indexCount) {
+	std::cout << "Mesh: " << indexCount / 3 << " triangles, vertices " << stats.vertexCountIn << " -> " << stats.vertexCountOut
+		<< ", ACMR " << stats.acmrIn << " -> " << stats.acmrOut << " (cache size " << vertexCacheSize << ")\n";
+}
+
+// Bounding sphere around the center of the bounding box, positions are read as the first three floats of each vertex
+inline glm::vec4 calculateBoundingSphere(const void* vertexData, size_t vertexCount, size_t stride) {
+	if (vertexCount == 0) {
+		return glm::vec4(0.0f);
+	}
+	const uint8_t* bytes = static_cast<const uint8_t*>(vertexData);
+	glm::vec3 minPos{ std::numeric_limits<float>::max() };
+	glm::vec3 maxPos{ std::numeric_limits<float>::lowest() };
+	for (size_t i = 0; i < vertexCount; i++) {
+		glm::vec3 pos;
+		memcpy(&pos, bytes + i * stride, sizeof(pos));
+		minPos = glm::min(minPos, pos);
+		maxPos = glm::max(maxPos, pos);
+	}
+	const glm::vec3 center{ (minPos + maxPos) * 0.5f };
+	float radiusSq{ 0.0f };
+	for (size_t i = 0; i < vertexCount; i++) {
+		glm::vec3 pos;
+		memcpy(&pos, bytes + i * stride, sizeof(pos));
+		const glm::vec3 d{ pos - center };
+		radiusSq = std::max(radiusSq, glm::dot(d, d));
+	}
+	return glm::vec4(center, std::sqrt(radiusSq));
+}
@@ -0,0 +1,171 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Binary mesh cache: Stores processed vertex and index data in the exact layout uploaded to the GPU,
+// so later runs can memory map the file and copy it to the buffer without parsing the OBJ.
+// A cache holds all meshes of the source file, their vertices and indices are stored back to back. The index data of every
+// mesh contains all its LODs, the mesh table stores their ranges so simplification also only runs once.
+
+#pragma once
+
+#include <string>
+#include <fstream>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include "common.h"
+#include "mappedfile.h"
+#include "vertexformat.h"
+
+constexpr uint32_t meshCacheMagic{ 0x4D565448 }; // "HTVM"
+// Bump whenever mesh processing changes, so caches written by older builds are rebuilt
+constexpr uint32_t meshCacheVersion{ 4 };
+constexpr uint32_t meshCacheMaxAttributes{ 8 };
+constexpr uint32_t meshCacheMaxLods{ 8 };
+constexpr uint32_t meshCacheMaxName{ 64 };
+
+// Vertex layout descriptor, format is a VkFormat so a cache written for another layout is never used
+struct MeshCacheAttribute {
+	uint32_t location{ 0 };
+	uint32_t format{ 0 };
+	uint32_t offset{ 0 };
+};
+struct MeshCacheLayout {
+	uint32_t stride{ 0 };
+	uint32_t attributeCount{ 0 };
+	MeshCacheAttribute attributes[meshCacheMaxAttributes]{};
+};
+
+// Index range and simplification error of one LOD
+struct MeshCacheLod {
+	uint32_t firstIndex{ 0 };
+	uint32_t indexCount{ 0 };
+	float error{ 0.0f };
+	uint32_t reserved{ 0 };
+};
+
+// One mesh, indices are relative to its first vertex. Materials are stored by name and resolved when loading, so editing
+// the material library doesn't need a new cache
+struct MeshCacheMesh {
+	uint64_t firstVertex{ 0 };
+	uint64_t vertexCount{ 0 };
+	uint64_t firstIndex{ 0 };
+	uint64_t indexCount{ 0 };
+	// Dequantization of packed vertices, also used to decode positions on the CPU
+	VertexEncoding encoding{};
+	uint32_t lodCount{ 0 };
+	uint32_t reserved{ 0 };
+	MeshCacheLod lods[meshCacheMaxLods]{};
+	char material[meshCacheMaxName]{};
+};
+
+struct MeshCacheHeader {
+	uint32_t magic{ meshCacheMagic };
+	uint32_t version{ meshCacheVersion };
+	uint64_t sourceHash{ 0 };
+	uint64_t sourceSize{ 0 };
+	MeshCacheLayout layout{};
+	uint64_t vertexCount{ 0 };
+	uint64_t indexCount{ 0 };
+	// Shared by all meshes
+	uint32_t indexSize{ 0 };
+	uint32_t meshCount{ 0 };
+	uint64_t meshOffset{ 0 };
+	uint64_t vertexOffset{ 0 };
+	uint64_t indexOffset{ 0 };
+	char materialLibrary[meshCacheMaxName * 4]{};
+};
+	uint32_t version{ meshCacheVersion };
+	uint64_t sourceHash{ 0 };
+	uint64_t sourceSize{ 0 };
+	MeshCacheLayout layout{};
+	// Dequantization of packed vertices, also used to decode positions on the CPU
+	VertexEncoding encoding{};
+	uint64_t vertexCount{ 0 };
+	uint64_t indexCount{ 0 };
+	uint32_t indexSize{ 0 };
+	uint32_t reserved{ 0 };
+	uint64_t vertexOffset{ 0 };
+	uint64_t indexOffset{ 0 };
+	uint32_t lodCount{ 0 };
+	uint32_t reserved2{ 0 };
+	MeshCacheLod lods[meshCacheMaxLods]{};
+};
+
+inline bool hashFile(const std::string& path, uint64_t& hash, uint64_t& size) {
+	MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+	hash = hashBytes(file.data(), file.size());
+	size = file.size();
+	return true;
+}
+
+// Mesh table of a mapped cache
+inline const MeshCacheMesh* meshCacheMeshes(const MappedFile& mapping, const MeshCacheHeader& header) {
+	return reinterpret_cast<const MeshCacheMesh*>(mapping.data() + header.meshOffset);
+}
+
+// Maps the cache and validates it against the source file and the expected vertex layout, returns false if it's missing or stale
+inline bool loadMeshCache(const std::string& cachePath, const std::string& sourcePath, const MeshCacheLayout& layout, MappedFile& mapping, MeshCacheHeader& header) {
+	uint64_t sourceHash{ 0 };
+	uint64_t sourceSize{ 0 };
+	if (!hashFile(sourcePath, sourceHash, sourceSize) || !mapping.open(cachePath) || mapping.size() < sizeof(MeshCacheHeader)) {
+		mapping.close();
+		return false;
+	}
+	memcpy(&header, mapping.data(), sizeof(MeshCacheHeader));
+	bool valid = header.magic == meshCacheMagic
+		&& header.version == meshCacheVersion
+		&& header.sourceHash == sourceHash
+		&& header.sourceSize == sourceSize
+		&& memcmp(&header.layout, &layout, sizeof(MeshCacheLayout)) == 0
+		&& (header.indexSize == 2 || header.indexSize == 4)
+		&& header.vertexOffset + header.vertexCount * layout.stride <= mapping.size()
+		&& header.indexOffset + header.indexCount * header.indexSize <= mapping.size()
+		&& header.meshCount > 0 && header.meshOffset % alignof(MeshCacheMesh) == 0 && header.meshOffset + header.meshCount * sizeof(MeshCacheMesh) <= mapping.size();
+	const MeshCacheMesh* meshes{ valid ? meshCacheMeshes(mapping, header) : nullptr };
+	for (uint32_t m = 0; valid && m < header.meshCount; m++) {
+		const MeshCacheMesh& mesh = meshes[m];
+		valid = mesh.firstVertex + mesh.vertexCount <= header.vertexCount && mesh.firstIndex + mesh.indexCount <= header.indexCount && mesh.lodCount > 0 && mesh.lodCount <= meshCacheMaxLods;
+		for (uint32_t i = 0; valid && i < mesh.lodCount; i++) {
+			valid = (uint64_t)mesh.lods[i].firstIndex + mesh.lods[i].indexCount <= mesh.indexCount;
+		}
+	}
+	if (!valid) {
+		mapping.close();
+	}
+	return valid;
+}
+
+inline bool writeMeshCache(const std::string& cachePath, const std::string& sourcePath, const MeshCacheLayout& layout, const std::string& materialLibrary, const MeshCacheMesh* meshes, uint32_t meshCount, const void* vertexData, uint64_t vertexCount, const void* indexData, uint64_t indexCount, uint32_t indexSize) {
+	MeshCacheHeader header{ .layout = layout, .vertexCount = vertexCount, .indexCount = indexCount, .indexSize = indexSize, .meshCount = meshCount };
+	if (meshCount == 0 || materialLibrary.size() >= sizeof(header.materialLibrary) || !hashFile(sourcePath, header.sourceHash, header.sourceSize)) {
+		return false;
+	}
+	for (uint32_t m = 0; m < meshCount; m++) {
+		if (meshes[m].lodCount == 0 || meshes[m].lodCount > meshCacheMaxLods) {
+			return false;
+		}
+	}
+	std::copy(materialLibrary.begin(), materialLibrary.end(), header.materialLibrary);
+	const uint64_t meshBytes{ meshCount * sizeof(MeshCacheMesh) };
+	const uint64_t vertexBytes{ vertexCount * layout.stride };
+	header.meshOffset = sizeof(MeshCacheHeader);
+	header.vertexOffset = header.meshOffset + meshBytes;
+	// Keep the index blob aligned to its element size
+	header.indexOffset = (header.vertexOffset + vertexBytes + 3) & ~3ull;
+	std::ofstream file(cachePath, std::ios::binary | std::ios::trunc);
+	if (!file) {
+		return false;
+	}
+	const char padding[4]{};
+	file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	file.write(reinterpret_cast<const char*>(meshes), meshBytes);
+	file.write(static_cast<const char*>(vertexData), vertexBytes);
+	file.write(padding, header.indexOffset - header.vertexOffset - vertexBytes);
+	file.write(static_cast<const char*>(indexData), indexCount * indexSize);
+	return file.good();
+}
@@ -0,0 +1,163 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Meshlet builder for the mesh shader path: Splits an indexed triangle list into small clusters with their own
+// vertex list and 8 bit local indices, plus a bounding sphere and a normal cone for per cluster culling.
+// Clusters are filled greedily in index order, which keeps the locality of the vertex cache optimized indices.
+
+#pragma once
+
+#include <vector>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <glm/glm.hpp>
+
+// Fits the output limits of all mesh shader implementations and keeps the index count a multiple of the 4 byte packing
+constexpr uint32_t meshletMaxVertices{ 64 };
+constexpr uint32_t meshletMaxTriangles{ 124 };
+
+// Matches Meshlet in the shader
+struct Meshlet {
+	// Bounding sphere in model space, xyz = center, w = radius
+	glm::vec4 bounds{ 0.0f };
+	// Normal cone, xyz = axis, w = sine of the cone's half angle, 1 if the cone is too wide to ever cull the meshlet
+	glm::vec4 cone{ 0.0f, 0.0f, 0.0f, 1.0f };
+	uint32_t vertexOffset{ 0 };
+	uint32_t triangleOffset{ 0 };
+	uint32_t vertexCount{ 0 };
+	uint32_t triangleCount{ 0 };
+};
+static_assert(sizeof(Meshlet) == 48);
+
+struct MeshletData {
+	std::vector<Meshlet> meshlets;
+	// Mesh vertex index for every meshlet vertex
+	std::vector<uint32_t> vertices;
+	// Three meshlet local vertex indices per triangle, packed into the lower 24 bits
+	std::vector<uint32_t> triangles;
+};
+
+struct MeshletStats {
+	size_t meshletCount{ 0 };
+	size_t triangleCount{ 0 };
+	size_t vertexCount{ 0 };
+	// Meshlets whose normal cone allows backface culling
+	size_t coneCount{ 0 };
+};
+
+// Appends the meshlets of one index range, positions are read as the first three floats of each vertex, indices are 16 or 32 bit
+inline void buildMeshlets(MeshletData& result, const void* vertexData, size_t vertexCount, size_t stride, const void* indexData, size_t indexCount, uint32_t indexSize) {
+	const uint8_t* vertexBytes = static_cast<const uint8_t*>(vertexData);
+	const auto position = [&](uint32_t index) {
+		glm::vec3 pos;
+		memcpy(&pos, vertexBytes + index * stride, sizeof(pos));
+		return pos;
+	};
+	const auto index = [&](size_t i) -> uint32_t {
+		if (indexSize == sizeof(uint16_t)) {
+			return static_cast<const uint16_t*>(indexData)[i];
+		}
+		return static_cast<const uint32_t*>(indexData)[i];
+	};
+	// Local index of each mesh vertex in the current meshlet, only valid if its stamp matches the meshlet
+	std::vector<uint8_t> localIndex(vertexCount, 0);
+	std::vector<uint32_t> stamp(vertexCount, UINT32_MAX);
+	Meshlet current{ .vertexOffset = static_cast<uint32_t>(result.vertices.size()), .triangleOffset = static_cast<uint32_t>(result.triangles.size()) };
+	const auto finish = [&]() {
+		if (current.triangleCount == 0) {
+			return;
+		}
+		// Sphere around the center of the bounding box
+		glm::vec3 minPos{ std::numeric_limits<float>::max() };
+		glm::vec3 maxPos{ std::numeric_limits<float>::lowest() };
+		for (uint32_t i = 0; i < current.vertexCount; i++) {
+			const glm::vec3 pos{ position(result.vertices[current.vertexOffset + i]) };
+			minPos = glm::min(minPos, pos);
+			maxPos = glm::max(maxPos, pos);
+		}
+		const glm::vec3 center{ (minPos + maxPos) * 0.5f };
+		float radius{ 0.0f };
+		for (uint32_t i = 0; i < current.vertexCount; i++) {
+			radius = std::max(radius, glm::length(position(result.vertices[current.vertexOffset + i]) - center));
+		}
+		current.bounds = glm::vec4(center, radius);
+		// Cone around the average face normal, its half angle is the largest deviation of any face from the axis
+		std::vector<glm::vec3> normals;
+		normals.reserve(current.triangleCount);
+		glm::vec3 axis{ 0.0f };
+		for (uint32_t t = 0; t < current.triangleCount; t++) {
+			const uint32_t packed{ result.triangles[current.triangleOffset + t] };
+			const glm::vec3 p0{ position(result.vertices[current.vertexOffset + (packed & 0xFF)]) };
+			const glm::vec3 p1{ position(result.vertices[current.vertexOffset + ((packed >> 8) & 0xFF)]) };
+			const glm::vec3 p2{ position(result.vertices[current.vertexOffset + ((packed >> 16) & 0xFF)]) };
+			const glm::vec3 normal{ glm::cross(p1 - p0, p2 - p0) };
+			const float length{ glm::length(normal) };
+			// Degenerate triangles are never visible and don't restrict the cone
+			if (length > 0.0f) {
+				normals.push_back(normal / length);
+				axis += normals.back();
+			}
+		}
+		const float axisLength{ glm::length(axis) };
+		if (axisLength > 0.0f) {
+			axis /= axisLength;
+			float minDot{ 1.0f };
+			for (auto& normal : normals) {
+				minDot = std::min(minDot, glm::dot(axis, normal));
+			}
+			// Cones wider than ~84 degrees hardly ever cull anything, so they are marked as unusable
+			current.cone = glm::vec4(axis, minDot <= 0.1f ? 1.0f : std::sqrt(1.0f - minDot * minDot));
+		}
+		result.meshlets.push_back(current);
+		current = { .vertexOffset = static_cast<uint32_t>(result.vertices.size()), .triangleOffset = static_cast<uint32_t>(result.triangles.size()) };
+	};
+	for (size_t i = 0; i + 2 < indexCount; i += 3) {
+		const uint32_t corners[3]{ index(i), index(i + 1), index(i + 2) };
+		const uint32_t meshletIndex{ static_cast<uint32_t>(result.meshlets.size()) };
+		uint32_t newVertices{ 0 };
+		for (uint32_t k = 0; k < 3; k++) {
+			if (stamp[corners[k]] != meshletIndex && (k == 0 || corners[k] != corners[0]) && (k < 2 || corners[k] != corners[1])) {
+				newVertices++;
+			}
+		}
+		if (current.vertexCount + newVertices > meshletMaxVertices || current.triangleCount + 1 > meshletMaxTriangles) {
+			finish();
+		}
+		uint32_t packed{ 0 };
+		for (uint32_t k = 0; k < 3; k++) {
+			const uint32_t vertex{ corners[k] };
+			if (stamp[vertex] != result.meshlets.size()) {
+				stamp[vertex] = static_cast<uint32_t>(result.meshlets.size());
+				localIndex[vertex] = static_cast<uint8_t>(current.vertexCount++);
+				result.vertices.push_back(vertex);
+			}
+			packed |= static_cast<uint32_t>(localIndex[vertex]) << (k * 8);
+		}
+		result.triangles.push_back(packed);
+		current.triangleCount++;
+	}
+	finish();
+}
+
+inline MeshletStats calculateMeshletStats(const MeshletData& data) {
+	MeshletStats stats{ .meshletCount = data.meshlets.size(), .triangleCount = data.triangles.size(), .vertexCount = data.vertices.size() };
+	for (auto& meshlet : data.meshlets) {
+		if (meshlet.cone.w < 1.0f) {
+			stats.coneCount++;
+		}
+	}
+	return stats;
+}
+
+inline void printMeshletStats(const MeshletStats& stats, size_t meshVertexCount) {
+	const double meshlets{ (double)std::max<size_t>(stats.meshletCount, 1) };
+	std::cout << "Meshlets: " << stats.meshletCount << ", " << stats.vertexCount / meshlets << " vertices (" << 100.0 * stats.vertexCount / (meshlets * meshletMaxVertices) << "% full)"
+		<< " and " << stats.triangleCount / meshlets << " triangles (" << 100.0 * stats.triangleCount / (meshlets * meshletMaxTriangles) << "% full) on average"
+		<< ", vertex duplication " << (double)stats.vertexCount / (double)std::max<size_t>(meshVertexCount, 1)
+		<< ", " << stats.coneCount << " with a usable normal cone\n";
+}
@@ -0,0 +1,469 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Multithreaded OBJ loader: The memory mapped file is split into line aligned chunks that are parsed concurrently,
+// per chunk results are then merged using prefix sums over the element counts.
+// Objects, groups and material changes split the faces into ranges, so every shape/material combination becomes its own mesh
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <thread>
+#include <charconv>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <algorithm>
+#include <numeric>
+#include <cmath>
+#include <unordered_map>
+#include "mappedfile.h"
+#include "mesh.h"
+#include <tiny_obj_loader.h>
+
+struct ObjCorner {
+	int32_t v{ 0 };
+	int32_t vt{ 0 };
+	int32_t vn{ 0 };
+	// Which of the indices are present, and which are relative (negative in the file) and still need the chunk's base offset
+	uint8_t flags{ 0 };
+};
+enum ObjCornerFlags : uint8_t {
+	objHasTexcoord = 1,
+	objHasNormal = 2,
+	objRelativePos = 4,
+	objRelativeTexcoord = 8,
+	objRelativeNormal = 16,
+};
+
+// Object, group or material statement, corner is the chunk local position in the triangulated corner list it applies from
+struct ObjGroupStart {
+	size_t corner{ 0 };
+	bool material{ false };
+	std::string name;
+};
+
+// Consecutive triangles of one object (or group) with one material, indices into the loaded corner list
+struct ObjGroup {
+	std::string name;
+	std::string material;
+	uint32_t firstIndex{ 0 };
+	uint32_t indexCount{ 0 };
+};
+
+struct ObjScene {
+	std::vector<ObjGroup> groups;
+	// Relative to the OBJ file, empty if there is none
+	std::string materialLibrary;
+};
+
+struct ObjChunk {
+	std::vector<float> positions;
+	std::vector<float> normals;
+	std::vector<float> texcoords;
+	// Polygon corners and the corner count of each face, triangulation needs positions and is done after merging
+	std::vector<ObjCorner> corners;
+	std::vector<uint32_t> faceSizes;
+	size_t triangleCount{ 0 };
+	std::vector<ObjGroupStart> groupStarts;
+	std::string materialLibrary;
+	bool valid{ true };
+};
+
+inline const char* objSkipSpace(const char* p, const char* end) {
+	while (p < end && (*p == ' ' || *p == '\t')) {
+		p++;
+	}
+	return p;
+}
+
+inline const char* objParseFloat(const char* p, const char* end, float& value) {
+	p = objSkipSpace(p, end);
+	if (p < end && *p == '+') {
+		p++;
+	}
+	const auto result = std::from_chars(p, end, value);
+	return result.ec == std::errc() ? result.ptr : nullptr;
+}
+
+// Rest of the line without surrounding whitespace
+inline std::string objParseName(const char* p, const char* end) {
+	p = objSkipSpace(p, end);
+	while (end > p && (end[-1] == ' ' || end[-1] == '\t' || end[-1] == '\r')) {
+		end--;
+	}
+	return std::string(p, end);
+}
+
+// Parses an index and turns it into a zero based index, negative (relative) indices are stored relative to the chunk's local element count
+inline const char* objParseIndex(const char* p, const char* end, size_t localCount, int32_t& index, bool& relative) {
+	int32_t value{ 0 };
+	const auto result = std::from_chars(p, end, value);
+	if (result.ec != std::errc() || value == 0) {
+		return nullptr;
+	}
+	relative = value < 0;
+	index = relative ? static_cast<int32_t>(localCount) + value : value - 1;
+	return result.ptr;
+}
+
+inline void parseObjChunk(const char* p, const char* end, ObjChunk& chunk) {
+	while (p < end) {
+		const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+		if (lineEnd == nullptr) {
+			lineEnd = end;
+		}
+		p = objSkipSpace(p, lineEnd);
+		if (lineEnd - p >= 2 && p[0] == 'v' && (p[1] == ' ' || p[1] == '\t')) {
+			float xyz[3]{};
+			const char* q = p + 1;
+			for (auto i = 0; i < 3 && q; i++) {
+				q = objParseFloat(q, lineEnd, xyz[i]);
+			}
+			if (!q) {
+				chunk.valid = false;
+				return;
+			}
+			chunk.positions.insert(chunk.positions.end(), xyz, xyz + 3);
+		} else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 'n') {
+			float xyz[3]{};
+			const char* q = p + 2;
+			for (auto i = 0; i < 3 && q; i++) {
+				q = objParseFloat(q, lineEnd, xyz[i]);
+			}
+			if (!q) {
+				chunk.valid = false;
+				return;
+			}
+			chunk.normals.insert(chunk.normals.end(), xyz, xyz + 3);
+		} else if (lineEnd - p >= 3 && p[0] == 'v' && p[1] == 't') {
+			float uv[2]{};
+			const char* q = p + 2;
+			for (auto i = 0; i < 2 && q; i++) {
+				q = objParseFloat(q, lineEnd, uv[i]);
+			}
+			if (!q) {
+				chunk.valid = false;
+				return;
+			}
+			chunk.texcoords.insert(chunk.texcoords.end(), uv, uv + 2);
+		} else if (lineEnd - p >= 2 && p[0] == 'f' && (p[1] == ' ' || p[1] == '\t')) {
+			const size_t firstCorner{ chunk.corners.size() };
+			const char* q = objSkipSpace(p + 1, lineEnd);
+			while (q < lineEnd && *q != '\r' && *q != '#') {
+				ObjCorner corner{};
+				bool relative{ false };
+				q = objParseIndex(q, lineEnd, chunk.positions.size() / 3, corner.v, relative);
+				if (!q) {
+					chunk.valid = false;
+					return;
+				}
+				corner.flags |= relative ? objRelativePos : 0;
+				if (q < lineEnd && *q == '/') {
+					q++;
+					if (q < lineEnd && *q != '/') {
+						q = objParseIndex(q, lineEnd, chunk.texcoords.size() / 2, corner.vt, relative);
+						if (!q) {
+							chunk.valid = false;
+							return;
+						}
+						corner.flags |= objHasTexcoord | (relative ? objRelativeTexcoord : 0);
+					}
+					if (q < lineEnd && *q == '/') {
+						q = objParseIndex(q + 1, lineEnd, chunk.normals.size() / 3, corner.vn, relative);
+						if (!q) {
+							chunk.valid = false;
+							return;
+						}
+						corner.flags |= objHasNormal | (relative ? objRelativeNormal : 0);
+					}
+				}
+				chunk.corners.push_back(corner);
+				q = objSkipSpace(q, lineEnd);
+			}
+			const size_t faceSize{ chunk.corners.size() - firstCorner };
+			if (faceSize < 3) {
+				chunk.corners.resize(firstCorner);
+			} else {
+				chunk.faceSizes.push_back(static_cast<uint32_t>(faceSize));
+				chunk.triangleCount += faceSize - 2;
+			}
+		} else if (lineEnd - p >= 2 && (p[0] == 'o' || p[0] == 'g') && (p[1] == ' ' || p[1] == '\t')) {
+			chunk.groupStarts.push_back({ .corner = chunk.triangleCount * 3, .material = false, .name = objParseName(p + 1, lineEnd) });
+		} else if (lineEnd - p >= 7 && strncmp(p, "usemtl", 6) == 0 && (p[6] == ' ' || p[6] == '\t')) {
+			chunk.groupStarts.push_back({ .corner = chunk.triangleCount * 3, .material = true, .name = objParseName(p + 6, lineEnd) });
+		} else if (lineEnd - p >= 7 && strncmp(p, "mtllib", 6) == 0 && (p[6] == ' ' || p[6] == '\t') && chunk.materialLibrary.empty()) {
+			chunk.materialLibrary = objParseName(p + 6, lineEnd);
+		}
+		p = lineEnd + 1;
+	}
+}
+
+// Loads all faces of an OBJ file as a triangle list with one vertex per corner (welding is done by the mesh processing afterwards)
+// The groups of the scene cover all corners in file order
+inline bool loadObjParallel(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, ObjScene& scene, uint32_t threadCount = 0) {
+	MappedFile file;
+	if (!file.open(path)) {
+		return false;
+	}
+	if (threadCount == 0) {
+		threadCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	const char* data = reinterpret_cast<const char*>(file.data());
+	const size_t size{ file.size() };
+	// Small files aren't worth the thread overhead
+	threadCount = static_cast<uint32_t>(std::clamp<size_t>(size / (256 * 1024), 1, threadCount));
+	// Split into chunks that start at the beginning of a line
+	std::vector<size_t> bounds(threadCount + 1, size);
+	bounds[0] = 0;
+	for (uint32_t i = 1; i < threadCount; i++) {
+		size_t pos{ std::max(bounds[i - 1], size * i / threadCount) };
+		const void* newline = pos < size ? memchr(data + pos, '\n', size - pos) : nullptr;
+		bounds[i] = newline ? static_cast<const char*>(newline) - data + 1 : size;
+	}
+	std::vector<ObjChunk> chunks(threadCount);
+	auto parallelFor = [threadCount](auto&& func) {
+		std::vector<std::thread> threads;
+		for (uint32_t i = 1; i < threadCount; i++) {
+			threads.emplace_back(func, i);
+		}
+		func(0);
+		for (auto& thread : threads) {
+			thread.join();
+		}
+	};
+	parallelFor([&](uint32_t i) { parseObjChunk(data + bounds[i], data + bounds[i + 1], chunks[i]); });
+	// Prefix sums give each chunk its base offset into the merged attribute and corner arrays
+	std::vector<size_t> posBase(threadCount + 1, 0), normalBase(threadCount + 1, 0), uvBase(threadCount + 1, 0), cornerBase(threadCount + 1, 0);
+	for (uint32_t i = 0; i < threadCount; i++) {
+		if (!chunks[i].valid) {
+			return false;
+		}
+		posBase[i + 1] = posBase[i] + chunks[i].positions.size() / 3;
+		normalBase[i + 1] = normalBase[i] + chunks[i].normals.size() / 3;
+		uvBase[i + 1] = uvBase[i] + chunks[i].texcoords.size() / 2;
+		cornerBase[i + 1] = cornerBase[i] + chunks[i].triangleCount * 3;
+	}
+	std::vector<float> positions(posBase[threadCount] * 3), normals(normalBase[threadCount] * 3), texcoords(uvBase[threadCount] * 2);
+	parallelFor([&](uint32_t i) {
+		std::copy(chunks[i].positions.begin(), chunks[i].positions.end(), positions.begin() + posBase[i] * 3);
+		std::copy(chunks[i].normals.begin(), chunks[i].normals.end(), normals.begin() + normalBase[i] * 3);
+		std::copy(chunks[i].texcoords.begin(), chunks[i].texcoords.end(), texcoords.begin() + uvBase[i] * 2);
+	});
+	vertices.resize(cornerBase[threadCount]);
+	indices.resize(cornerBase[threadCount]);
+	std::vector<uint8_t> chunkValid(threadCount, 1);
+	parallelFor([&](uint32_t i) {
+		const size_t posCount{ posBase[threadCount] }, uvCount{ uvBase[threadCount] }, normalCount{ normalBase[threadCount] };
+		auto resolve = [](int32_t index, bool relative, size_t base, size_t count, size_t& out) {
+			const int64_t absolute{ relative ? static_cast<int64_t>(base) + index : index };
+			out = static_cast<size_t>(absolute);
+			return absolute >= 0 && static_cast<size_t>(absolute) < count;
+		};
+		// Same conventions as the tinyobj based loader: Flip Y for Vulkan's coordinate system and V for KTX images
+		std::vector<Vertex> face;
+		size_t out{ cornerBase[i] };
+		size_t cornerIndex{ 0 };
+		for (auto faceSize : chunks[i].faceSizes) {
+			face.resize(faceSize);
+			for (uint32_t c = 0; c < faceSize; c++) {
+				const ObjCorner& corner = chunks[i].corners[cornerIndex++];
+				size_t v{ 0 }, vt{ 0 }, vn{ 0 };
+				if (!resolve(corner.v, corner.flags & objRelativePos, posBase[i], posCount, v)
+					|| ((corner.flags & objHasTexcoord) && !resolve(corner.vt, corner.flags & objRelativeTexcoord, uvBase[i], uvCount, vt))
+					|| ((corner.flags & objHasNormal) && !resolve(corner.vn, corner.flags & objRelativeNormal, normalBase[i], normalCount, vn))) {
+					chunkValid[i] = 0;
+					return;
+				}
+				face[c].pos = { positions[v * 3], -positions[v * 3 + 1], positions[v * 3 + 2] };
+				face[c].normal = (corner.flags & objHasNormal) ? glm::vec3(normals[vn * 3], -normals[vn * 3 + 1], normals[vn * 3 + 2]) : glm::vec3(0.0f);
+				face[c].uv = (corner.flags & objHasTexcoord) ? glm::vec2(texcoords[vt * 2], 1.0f - texcoords[vt * 2 + 1]) : glm::vec2(0.0f);
+			}
+			auto emit = [&](uint32_t a, uint32_t b, uint32_t c) {
+				for (auto k : { a, b, c }) {
+					vertices[out] = face[k];
+					indices[out] = static_cast<uint32_t>(out);
+					out++;
+				}
+			};
+			if (faceSize == 4) {
+				// Quads are split along the shorter diagonal, matching tinyobj
+				const glm::vec3 e02{ face[2].pos - face[0].pos }, e13{ face[3].pos - face[1].pos };
+				if (glm::dot(e02, e02) < glm::dot(e13, e13)) {
+					emit(0, 1, 2);
+					emit(0, 2, 3);
+				} else {
+					emit(0, 1, 3);
+					emit(1, 2, 3);
+				}
+			} else {
+				for (uint32_t c = 2; c < faceSize; c++) {
+					emit(0, c - 1, c);
+				}
+			}
+		}
+	});
+	// A statement only starts a new range if faces were emitted since the last one, consecutive ones (o followed by usemtl) are merged
+	scene = {};
+	ObjGroup current{};
+	for (uint32_t i = 0; i < threadCount; i++) {
+		if (scene.materialLibrary.empty()) {
+			scene.materialLibrary = chunks[i].materialLibrary;
+		}
+		for (auto& start : chunks[i].groupStarts) {
+			const uint32_t corner{ static_cast<uint32_t>(cornerBase[i] + start.corner) };
+			if (corner > current.firstIndex) {
+				current.indexCount = corner - current.firstIndex;
+				scene.groups.push_back(current);
+				current.firstIndex = corner;
+			}
+			(start.material ? current.material : current.name) = start.name;
+		}
+	}
+	if (indices.size() > current.firstIndex) {
+		current.indexCount = static_cast<uint32_t>(indices.size()) - current.firstIndex;
+		scene.groups.push_back(current);
+	}
+	return std::all_of(chunkValid.begin(), chunkValid.end(), [](uint8_t valid) { return valid != 0; });
+}
+
+inline bool loadObjParallel(const std::string& path, std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, uint32_t threadCount = 0) {
+	ObjScene scene;
+	return loadObjParallel(path, vertices, indices, scene, threadCount);
+}
+
+// Diffuse color (Kd) of every material in an MTL file, the rest of the material model isn't used by the renderer
+inline bool loadObjMaterials(const std::string& path, std::unordered_map<std::string, glm::vec3>& diffuse) {
+	std::ifstream file(path);
+	if (!file) {
+		return false;
+	}
+	std::string line;
+	std::string material;
+	while (std::getline(file, line)) {
+		const char* p{ objSkipSpace(line.data(), line.data() + line.size()) };
+		const char* end{ line.data() + line.size() };
+		if (end - p >= 7 && strncmp(p, "newmtl", 6) == 0) {
+			material = objParseName(p + 6, end);
+			diffuse[material] = glm::vec3(1.0f);
+		} else if (end - p >= 3 && p[0] == 'K' && p[1] == 'd' && !material.empty()) {
+			glm::vec3 kd{ 1.0f };
+			const char* q{ p + 2 };
+			for (auto i = 0; i < 3 && q; i++) {
+				q = objParseFloat(q, end, kd[i]);
+			}
+			if (q) {
+				diffuse[material] = kd;
+			}
+		}
+	}
+	return true;
+}
+
+// Appends a UV sphere with positions, normals and texcoords, base is the number of vertices written before it
+inline void writeObjSphere(std::ofstream& file, uint32_t rings, float radius, uint32_t base) {
+	const uint32_t segments{ rings * 2 };
+	for (uint32_t r = 0; r <= rings; r++) {
+		for (uint32_t s = 0; s <= segments; s++) {
+			const float theta{ (float)r / rings * (float)M_PI };
+			const float phi{ (float)s / segments * 2.0f * (float)M_PI };
+			const float x{ sinf(theta) * cosf(phi) }, y{ cosf(theta) }, z{ sinf(theta) * sinf(phi) };
+			file << "v " << x * radius << " " << y * radius << " " << z * radius << "\n";
+			file << "vn " << x << " " << y << " " << z << "\n";
+			file << "vt " << (float)s / segments << " " << (float)r / rings << "\n";
+		}
+	}
+	for (uint32_t r = 0; r < rings; r++) {
+		for (uint32_t s = 0; s < segments; s++) {
+			const uint32_t a{ base + r * (segments + 1) + s + 1 }, b{ a + segments + 1 };
+			file << "f " << a << "/" << a << "/" << a << " " << b << "/" << b << "/" << b << " " << b + 1 << "/" << b + 1 << "/" << b + 1 << "\n";
+			file << "f " << a << "/" << a << "/" << a << " " << b + 1 << "/" << b + 1 << "/" << b + 1 << " " << a + 1 << "/" << a + 1 << "/" << a + 1 << "\n";
+		}
+	}
+}
+
+// Writes a synthetic UV sphere, used to benchmark loaders on large files
+inline void writeSyntheticObj(const std::string& path, uint32_t triangleCount) {
+	std::ofstream file(path);
+	file.precision(6);
+	writeObjSphere(file, std::max(4u, static_cast<uint32_t>(std::sqrt(triangleCount / 4.0))), 1.0f, 0);
+}
+
+// Writes a scene of distinct spheres that only differ in tessellation and size, each one its own object with one of a few
+// materials, plus the material library next to it. Used to test scenes with many meshes
+inline void writeSyntheticScene(const std::string& path, uint32_t meshCount) {
+	const std::string materialLibrary{ path.substr(0, path.find_last_of('.')) + ".mtl" };
+	const glm::vec3 colors[4]{ { 1.0f, 1.0f, 1.0f }, { 1.0f, 0.4f, 0.4f }, { 0.4f, 1.0f, 0.4f }, { 0.4f, 0.6f, 1.0f } };
+	std::ofstream mtl(materialLibrary);
+	for (uint32_t i = 0; i < 4; i++) {
+		mtl << "newmtl Synthetic" << i << "\nKd " << colors[i].x << " " << colors[i].y << " " << colors[i].z << "\n\n";
+	}
+	std::ofstream file(path);
+	file.precision(6);
+	file << "mtllib " << materialLibrary.substr(materialLibrary.find_last_of("/\\") + 1) << "\n";
+	uint32_t base{ 0 };
+	for (uint32_t i = 0; i < meshCount; i++) {
+		const uint32_t rings{ 4 + i % 29 };
+		file << "o Sphere" << i << "\nusemtl Synthetic" << i % 4 << "\n";
+		writeObjSphere(file, rings, 0.6f + 0.4f * static_cast<float>(i % 7) / 6.0f, base);
+		base += (rings + 1) * (rings * 2 + 1);
+	}
+}
+
+// Compares tinyobj against the parallel loader for increasing thread counts. Every corner of the parallel loader's output
+// is checked against tinyobj's, the synthetic file only has triangles, so the two triangulate alike (faces with more than
+// four corners are fanned here and ear clipped by tinyobj)
+inline void benchmarkObjLoader(uint32_t triangleCount, const std::string& outputPath) {
+	using Clock = std::chrono::steady_clock;
+	const std::string objPath{ "objloader_bench.obj" };
+	writeSyntheticObj(objPath, triangleCount);
+	std::vector<Vertex> reference;
+	std::vector<Vertex> vertices;
+	std::vector<uint32_t> indices;
+	auto start = Clock::now();
+	tinyobj::attrib_t attrib;
+	std::vector<tinyobj::shape_t> shapes;
+	std::vector<tinyobj::material_t> materials;
+	tinyobj::LoadObj(&attrib, &shapes, &materials, nullptr, nullptr, objPath.c_str());
+	for (auto& index : shapes[0].mesh.indices) {
+		reference.push_back({
+			.pos = { attrib.vertices[index.vertex_index * 3], -attrib.vertices[index.vertex_index * 3 + 1], attrib.vertices[index.vertex_index * 3 + 2] },
+			.normal = { attrib.normals[index.normal_index * 3], -attrib.normals[index.normal_index * 3 + 1], attrib.normals[index.normal_index * 3 + 2] },
+			.uv = { attrib.texcoords[index.texcoord_index * 2], 1.0f - attrib.texcoords[index.texcoord_index * 2 + 1] }
+		});
+	}
+	const double tinyobjMs{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+	const size_t cornerCount{ reference.size() };
+	std::ofstream out(outputPath);
+	out << "{\n\t\"triangles\": " << cornerCount / 3 << ",\n\t\"tinyobjMs\": " << tinyobjMs << ",\n\t\"parallel\": [\n";
+	std::cout << "OBJ loader benchmark, " << cornerCount / 3 << " triangles\n" << "  tinyobj: " << tinyobjMs << " ms\n";
+	const uint32_t maxThreads{ std::max(1u, std::thread::hardware_concurrency()) };
+	for (uint32_t threads = 1; threads <= maxThreads; threads = (threads == maxThreads) ? threads + 1 : std::min(threads * 2, maxThreads)) {
+		vertices.clear();
+		start = Clock::now();
+		const bool loaded{ loadObjParallel(objPath, vertices, indices, threads) };
+		const double ms{ std::chrono::duration<double, std::milli>(Clock::now() - start).count() };
+		// Both parse the same text, only float parsing may differ in the last bits
+		size_t mismatches{ 0 };
+		if (!loaded || vertices.size() != cornerCount) {
+			mismatches = cornerCount;
+		} else {
+			for (size_t i = 0; i < cornerCount; i++) {
+				const Vertex& a = vertices[i];
+				const Vertex& b = reference[i];
+				if (std::max({ glm::length(a.pos - b.pos), glm::length(a.normal - b.normal), glm::length(a.uv - b.uv) }) > 1e-5f) {
+					mismatches++;
+				}
+			}
+		}
+		if (mismatches > 0) {
+			std::cerr << "Parallel OBJ loader result does not match tinyobj for " << mismatches << " of " << cornerCount << " corners\n";
+		}
+		std::cout << "  parallel, " << threads << " thread(s): " << ms << " ms (" << tinyobjMs / ms << "x)\n";
+		out << "\t\t{ \"threads\": " << threads << ", \"ms\": " << ms << ", \"speedup\": " << tinyobjMs / ms << ", \"mismatches\": " << mismatches << " }" << (threads == maxThreads ? "\n" : ",\n");
+	}
+	out << "\t]\n}\n";
+	std::remove(objPath.c_str());
+}
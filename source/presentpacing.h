@@ -0,0 +1,141 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Present mode selection and present timing: With VK_KHR_present_id and VK_KHR_present_wait every present gets an
+// increasing id and the render thread checks after each present which of them have been displayed, which gives the
+// latency from the input a frame was built from to its presentation. Presents are only checked once per frame, so a
+// sample can be late by up to a frame unless the render loop waits for older presents to limit how many frames are
+// queued for display, trading throughput for latency. The waits happen on the render thread as the swapchain can't be
+// used by vkWaitForPresentKHR and acquire or present at the same time.
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <cstdint>
+#include <volk.h>
+
+inline const char* presentModeName(VkPresentModeKHR mode) {
+	switch (mode) {
+	case VK_PRESENT_MODE_IMMEDIATE_KHR:
+		return "immediate";
+	case VK_PRESENT_MODE_MAILBOX_KHR:
+		return "mailbox";
+	case VK_PRESENT_MODE_FIFO_RELAXED_KHR:
+		return "fifo-relaxed";
+	default:
+		return "fifo";
+	}
+}
+
+inline bool parsePresentMode(const std::string& name, VkPresentModeKHR& mode) {
+	for (auto candidate : { VK_PRESENT_MODE_FIFO_KHR, VK_PRESENT_MODE_FIFO_RELAXED_KHR, VK_PRESENT_MODE_MAILBOX_KHR, VK_PRESENT_MODE_IMMEDIATE_KHR }) {
+		if (name == presentModeName(candidate)) {
+			mode = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+// Falls back to the closest supported mode: mailbox and immediate both avoid blocking on vsync, so they replace each other
+// FIFO is the last resort as it's the only mode every implementation has to support
+inline VkPresentModeKHR choosePresentMode(VkPresentModeKHR requested, const std::vector<VkPresentModeKHR>& supported) {
+	std::vector<VkPresentModeKHR> candidates{ requested };
+	if (requested == VK_PRESENT_MODE_MAILBOX_KHR) {
+		candidates.push_back(VK_PRESENT_MODE_IMMEDIATE_KHR);
+	} else if (requested == VK_PRESENT_MODE_IMMEDIATE_KHR) {
+		candidates.push_back(VK_PRESENT_MODE_MAILBOX_KHR);
+	}
+	for (auto mode : candidates) {
+		if (std::find(supported.begin(), supported.end(), mode) != supported.end()) {
+			return mode;
+		}
+	}
+	return VK_PRESENT_MODE_FIFO_KHR;
+}
+
+class PresentPacer {
+public:
+	using Clock = std::chrono::steady_clock;
+
+	// Must be restarted for a new swapchain, present ids keep counting up across swapchains
+	void start(VkDevice device, VkSwapchainKHR swapchain) {
+		stop();
+		this->device = device;
+		this->swapchain = swapchain;
+	}
+
+	// Presents that haven't been waited for yet are dropped, they don't produce a latency sample
+	void stop() {
+		pending.clear();
+		completedId = lastId;
+		swapchain = VK_NULL_HANDLE;
+	}
+
+	bool active() const { return swapchain != VK_NULL_HANDLE; }
+
+	// Id to chain into the next present with VkPresentIdKHR
+	uint64_t nextId() const { return lastId + 1; }
+
+	// Call after presenting the id returned by nextId(), inputTime is when the input used by the frame was sampled
+	void presented(Clock::time_point inputTime) {
+		lastId++;
+		pending.push_back({ .id = lastId, .inputTime = inputTime });
+	}
+
+	// Blocks until at most maxQueued presents are still waiting to be displayed
+	void waitQueued(uint32_t maxQueued) {
+		while (!pending.empty() && lastId - completedId > maxQueued) {
+			if (!complete(timeout)) {
+				break;
+			}
+		}
+	}
+
+	// Input to present latencies in milliseconds collected since the last call
+	std::vector<double> takeLatencies() {
+		while (!pending.empty() && complete(0)) {
+		}
+		std::vector<double> result;
+		result.swap(latencies);
+		return result;
+	}
+
+private:
+	struct Present {
+		uint64_t id{ 0 };
+		Clock::time_point inputTime{};
+	};
+
+	// A present that isn't displayed within this time (e.g. minimized window) no longer holds up the render loop
+	static constexpr uint64_t timeout{ 100'000'000 };
+
+	VkDevice device{ VK_NULL_HANDLE };
+	VkSwapchainKHR swapchain{ VK_NULL_HANDLE };
+	std::deque<Present> pending;
+	std::vector<double> latencies;
+	uint64_t lastId{ 0 };
+	uint64_t completedId{ 0 };
+
+	// Waits for the oldest pending present, returns false if it wasn't displayed within the timeout. Has to be called on
+	// the thread that acquires and presents, the swapchain must not be used concurrently with vkWaitForPresentKHR
+	bool complete(uint64_t waitTimeout) {
+		const Present present{ pending.front() };
+		const VkResult result{ vkWaitForPresentKHR(device, swapchain, present.id, waitTimeout) };
+		if (result == VK_TIMEOUT) {
+			return false;
+		}
+		pending.pop_front();
+		completedId = present.id;
+		// An out of date swapchain never displays the image, which is not a latency sample
+		if (result == VK_SUCCESS) {
+			latencies.push_back(std::chrono::duration<double, std::milli>(Clock::now() - present.inputTime).count());
+		}
+		return true;
+	}
+};
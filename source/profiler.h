@@ -0,0 +1,332 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// CPU and GPU profiler: Scoped CPU zones are written to a lock free buffer owned by the recording thread and collected
+// once per frame, GPU zones are timestamp queries in the frame's command buffer that are read back once the frame timeline
+// reached its value. Results are summarized on stdout and can be exported as a Chrome trace (chrome://tracing, Perfetto).
+// Zones cost a single branch when profiling is disabled at runtime, and nothing if ENABLE_PROFILER isn't defined.
+// The GPU frame time (first to last command of the frame) is always measured, as the benchmark reports it.
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <fstream>
+#include <iostream>
+#include <unordered_map>
+#include <algorithm>
+#include <cstdint>
+#include <volk.h>
+#include "common.h"
+
+#define PROFILE_CONCAT_INNER(a, b) a##b
+#define PROFILE_CONCAT(a, b) PROFILE_CONCAT_INNER(a, b)
+// PROFILE_ZONE covers the rest of the scope, PROFILE_ZONE_BEGIN/END cover code that can't be put in its own scope
+#ifdef ENABLE_PROFILER
+#define PROFILE_ZONE(name) ProfileZone PROFILE_CONCAT(profileZone, __LINE__){ name }
+#define PROFILE_ZONE_BEGIN(zone, name) ProfileZone zone{ name }
+#define PROFILE_ZONE_END(zone) zone.end()
+#define PROFILE_GPU_ZONE(cb, name) GpuProfileZone PROFILE_CONCAT(gpuProfileZone, __LINE__){ cb, name }
+#else
+#define PROFILE_ZONE(name)
+#define PROFILE_ZONE_BEGIN(zone, name)
+#define PROFILE_ZONE_END(zone)
+#define PROFILE_GPU_ZONE(cb, name)
+#endif
+
+class Profiler {
+public:
+	// Timestamps are only written if the queue family supports them (timestampValidBits > 0)
+	void create(VkDevice device, float timestampPeriod, uint32_t timestampValidBits, uint32_t framesInFlight) {
+		this->device = device;
+		this->timestampPeriod = timestampPeriod;
+		startTime = std::chrono::steady_clock::now();
+		gpuFrames.resize(framesInFlight);
+		if (timestampValidBits > 0) {
+			VkQueryPoolCreateInfo queryPoolCI{ .sType = VK_STRUCTURE_TYPE_QUERY_POOL_CREATE_INFO, .queryType = VK_QUERY_TYPE_TIMESTAMP, .queryCount = framesInFlight * queriesPerFrame };
+			chk(vkCreateQueryPool(device, &queryPoolCI, nullptr, &queryPool));
+		}
+	}
+
+	void destroy() {
+		if (queryPool != VK_NULL_HANDLE) {
+			vkDestroyQueryPool(device, queryPool, nullptr);
+		}
+	}
+
+	void setEnabled(bool enabled) { active.store(enabled, std::memory_order_relaxed); }
+	bool enabled() const { return active.load(std::memory_order_relaxed); }
+	// Prints averages of all zones every interval frames, zero disables the summary
+	void setSummaryInterval(uint32_t frames) { summaryInterval = frames; }
+	// Keeps all events from now on for writeTrace
+	void startCapture() { capturing = true; }
+
+	// Names the calling thread in traces
+	void setThreadName(const std::string& name) { threadEvents().name = name; }
+
+	int64_t now() const { return std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - startTime).count(); }
+
+	// Called by zones on any thread, never blocks. Events are dropped if the thread's buffer is full
+	void record(const char* name, int64_t begin, int64_t end) {
+		ThreadEvents& events = threadEvents();
+		const uint32_t head{ events.head.load(std::memory_order_relaxed) };
+		if (head - events.tail.load(std::memory_order_acquire) >= eventCapacity) {
+			events.dropped.fetch_add(1, std::memory_order_relaxed);
+			return;
+		}
+		events.events[head % eventCapacity] = { .name = name, .begin = begin, .end = end };
+		events.head.store(head + 1, std::memory_order_release);
+	}
+
+	// Reads back the GPU zones of the frame that last used this frame index and starts a new one, records the frame's first timestamp
+	// The frame timeline must have been waited on for the frame's value, must be recorded outside of a render pass
+	void beginGpuFrame(VkCommandBuffer cb, uint32_t frameIndex) {
+		currentFrame = frameIndex;
+		lastGpuFrame = -1.0;
+		if (queryPool == VK_NULL_HANDLE) {
+			return;
+		}
+		GpuFrame& frame = gpuFrames[currentFrame];
+		if (frame.queryCount > 0) {
+			std::array<uint64_t, queriesPerFrame> timestamps{};
+			if (vkGetQueryPoolResults(device, queryPool, currentFrame * queriesPerFrame, frame.queryCount, frame.queryCount * sizeof(uint64_t), timestamps.data(), sizeof(uint64_t), VK_QUERY_RESULT_64_BIT) == VK_SUCCESS) {
+				lastGpuFrame = ticksToMs(timestamps[1] - timestamps[0]);
+				for (uint32_t zone = 0; zone < frame.zoneCount; zone++) {
+					const uint64_t begin{ timestamps[2 + zone * 2] };
+					const uint64_t end{ timestamps[3 + zone * 2] };
+					addSample(gpuStats, frame.names[zone], ticksToMs(end - begin));
+					if (capturing) {
+						// GPU and CPU clocks aren't calibrated, GPU zones are placed relative to the time the frame was recorded
+						const int64_t offset{ frame.cpuTime + static_cast<int64_t>(ticksToMs(begin - timestamps[0]) * 1000000.0) };
+						addTraceEvent({ .name = frame.names[zone], .begin = offset, .end = offset + static_cast<int64_t>(ticksToMs(end - begin) * 1000000.0) }, gpuTrack);
+					}
+				}
+			}
+		}
+		frame.queryCount = 2;
+		frame.zoneCount = 0;
+		frame.cpuTime = now();
+		vkCmdResetQueryPool(cb, queryPool, currentFrame * queriesPerFrame, queriesPerFrame);
+		vkCmdWriteTimestamp2(cb, VK_PIPELINE_STAGE_2_NONE, queryPool, currentFrame * queriesPerFrame);
+	}
+
+	// Records the frame's last timestamp, call before ending the command buffer
+	void endGpuFrame(VkCommandBuffer cb) {
+		if (queryPool != VK_NULL_HANDLE) {
+			vkCmdWriteTimestamp2(cb, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, currentFrame * queriesPerFrame + 1);
+		}
+	}
+
+	// Returns the zone's index, or UINT32_MAX if it isn't recorded
+	uint32_t beginGpuZone(VkCommandBuffer cb, const char* name) {
+		GpuFrame& frame = gpuFrames[currentFrame];
+		if (queryPool == VK_NULL_HANDLE || !enabled() || frame.queryCount + 2 > queriesPerFrame) {
+			return UINT32_MAX;
+		}
+		const uint32_t zone{ frame.zoneCount++ };
+		frame.names[zone] = name;
+		frame.queryCount += 2;
+		vkCmdWriteTimestamp2(cb, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, currentFrame * queriesPerFrame + 2 + zone * 2);
+		return zone;
+	}
+
+	void endGpuZone(VkCommandBuffer cb, uint32_t zone) {
+		if (zone != UINT32_MAX) {
+			vkCmdWriteTimestamp2(cb, VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT, queryPool, currentFrame * queriesPerFrame + 3 + zone * 2);
+		}
+	}
+
+	// GPU time of the frame resolved by the last beginGpuFrame, negative if none was available
+	double gpuFrameMs() const { return lastGpuFrame; }
+
+	// Collects the CPU events of all threads, call once per frame from the render loop
+	void endFrame() {
+		std::vector<ThreadEvents*> threads;
+		{
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			for (auto& events : allThreadEvents) {
+				threads.push_back(events.get());
+			}
+		}
+		for (auto* events : threads) {
+			const uint32_t tail{ events->tail.load(std::memory_order_relaxed) };
+			const uint32_t head{ events->head.load(std::memory_order_acquire) };
+			for (uint32_t i = tail; i != head; i++) {
+				const ProfileEvent& event = events->events[i % eventCapacity];
+				addSample(cpuStats, event.name, (double)(event.end - event.begin) / 1000000.0);
+				if (capturing) {
+					addTraceEvent(event, events->track);
+				}
+			}
+			events->tail.store(head, std::memory_order_release);
+		}
+		summaryFrames++;
+		if (summaryInterval > 0 && summaryFrames >= summaryInterval) {
+			printSummary();
+		}
+	}
+
+	// Chrome trace event format, loads in chrome://tracing and ui.perfetto.dev
+	bool writeTrace(const std::string& path) {
+		std::ofstream file(path);
+		if (!file) {
+			return false;
+		}
+		file << "{\"traceEvents\":[\n";
+		{
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			for (auto& events : allThreadEvents) {
+				file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << events->track << ",\"args\":{\"name\":\"" << events->name << "\"}},\n";
+			}
+		}
+		file << "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" << gpuTrack << ",\"args\":{\"name\":\"GPU\"}}";
+		for (auto& event : trace) {
+			file << ",\n{\"name\":\"" << event.name << "\",\"ph\":\"X\",\"pid\":1,\"tid\":" << event.track << ",\"ts\":" << (double)event.begin / 1000.0 << ",\"dur\":" << (double)(event.end - event.begin) / 1000.0 << "}";
+		}
+		file << "\n]}\n";
+		uint32_t dropped{ 0 };
+		for (auto& events : allThreadEvents) {
+			dropped += events->dropped.load(std::memory_order_relaxed);
+		}
+		std::cout << "Profiler trace with " << trace.size() << " events written to " << path << (dropped > 0 ? ", " + std::to_string(dropped) + " events were dropped" : "") << "\n";
+		return file.good();
+	}
+
+private:
+	static constexpr uint32_t eventCapacity{ 16384 };
+	static constexpr uint32_t maxGpuZones{ 31 };
+	// Frame begin and end, plus a begin and end for each zone
+	static constexpr uint32_t queriesPerFrame{ 2 + maxGpuZones * 2 };
+	static constexpr uint32_t gpuTrack{ 0 };
+	static constexpr size_t maxTraceEvents{ 4 * 1024 * 1024 };
+
+	struct ProfileEvent {
+		const char* name{ nullptr };
+		int64_t begin{ 0 };
+		int64_t end{ 0 };
+	};
+	struct TraceEvent {
+		const char* name{ nullptr };
+		int64_t begin{ 0 };
+		int64_t end{ 0 };
+		uint32_t track{ 0 };
+	};
+	// Single producer (the owning thread), single consumer (endFrame) ring
+	struct ThreadEvents {
+		std::array<ProfileEvent, eventCapacity> events;
+		std::atomic<uint32_t> head{ 0 };
+		std::atomic<uint32_t> tail{ 0 };
+		std::atomic<uint32_t> dropped{ 0 };
+		uint32_t track{ 0 };
+		std::string name;
+	};
+	struct GpuFrame {
+		std::array<const char*, maxGpuZones> names{};
+		uint32_t zoneCount{ 0 };
+		uint32_t queryCount{ 0 };
+		int64_t cpuTime{ 0 };
+	};
+	struct ZoneStats {
+		double totalMs{ 0.0 };
+		uint32_t count{ 0 };
+	};
+
+	VkDevice device{ VK_NULL_HANDLE };
+	VkQueryPool queryPool{ VK_NULL_HANDLE };
+	float timestampPeriod{ 1.0f };
+	std::chrono::steady_clock::time_point startTime{ std::chrono::steady_clock::now() };
+	std::atomic<bool> active{ false };
+	bool capturing{ false };
+	std::vector<GpuFrame> gpuFrames;
+	uint32_t currentFrame{ 0 };
+	double lastGpuFrame{ -1.0 };
+	std::mutex threadsMutex;
+	std::vector<std::unique_ptr<ThreadEvents>> allThreadEvents;
+	std::vector<TraceEvent> trace;
+	// Keyed by the name pointer, zone names are string literals
+	std::unordered_map<const char*, ZoneStats> cpuStats;
+	std::unordered_map<const char*, ZoneStats> gpuStats;
+	uint32_t summaryInterval{ 0 };
+	uint32_t summaryFrames{ 0 };
+
+	// Registers the thread on first use, later calls only read a thread local pointer
+	ThreadEvents& threadEvents() {
+		thread_local ThreadEvents* events{ nullptr };
+		if (events == nullptr) {
+			std::lock_guard<std::mutex> lock(threadsMutex);
+			auto& entry = allThreadEvents.emplace_back(std::make_unique<ThreadEvents>());
+			entry->track = static_cast<uint32_t>(allThreadEvents.size());
+			entry->name = "Thread " + std::to_string(entry->track);
+			events = entry.get();
+		}
+		return *events;
+	}
+
+	double ticksToMs(uint64_t ticks) const { return (double)ticks * timestampPeriod / 1000000.0; }
+
+	static void addSample(std::unordered_map<const char*, ZoneStats>& stats, const char* name, double ms) {
+		ZoneStats& zone = stats[name];
+		zone.totalMs += ms;
+		zone.count++;
+	}
+
+	void addTraceEvent(const ProfileEvent& event, uint32_t track) {
+		if (trace.size() < maxTraceEvents) {
+			trace.push_back({ .name = event.name, .begin = event.begin, .end = event.end, .track = track });
+		}
+	}
+
+	// Average time per frame spent in each zone, zones that run several times per frame are summed up
+	void printSummary() {
+		const auto print = [this](const char* label, std::unordered_map<const char*, ZoneStats>& stats) {
+			std::vector<std::pair<const char*, ZoneStats>> sorted(stats.begin(), stats.end());
+			std::sort(sorted.begin(), sorted.end(), [](const auto& a, const auto& b) { return a.second.totalMs > b.second.totalMs; });
+			std::cout << label;
+			for (auto& [name, zone] : sorted) {
+				std::cout << " " << name << " " << zone.totalMs / summaryFrames << " ms";
+				if (zone.count > summaryFrames) {
+					std::cout << " (" << zone.count / summaryFrames << "x)";
+				}
+				std::cout << ",";
+			}
+			std::cout << "\n";
+			stats.clear();
+		};
+		std::cout << "Profile, average over " << summaryFrames << " frames\n";
+		print("  CPU:", cpuStats);
+		print("  GPU:", gpuStats);
+		summaryFrames = 0;
+	}
+};
+
+inline Profiler profiler;
+
+class ProfileZone {
+public:
+	explicit ProfileZone(const char* name) : name(name), begin(profiler.enabled() ? profiler.now() : -1) {}
+	~ProfileZone() { end(); }
+	void end() {
+		if (begin >= 0) {
+			profiler.record(name, begin, profiler.now());
+			begin = -1;
+		}
+	}
+private:
+	const char* name;
+	int64_t begin;
+};
+
+class GpuProfileZone {
+public:
+	GpuProfileZone(VkCommandBuffer cb, const char* name) : cb(cb), zone(profiler.beginGpuZone(cb, name)) {}
+	~GpuProfileZone() { profiler.endGpuZone(cb, zone); }
+private:
+	VkCommandBuffer cb;
+	uint32_t zone;
+};
@@ -0,0 +1,94 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Parallel recording of the draws inside a dynamic rendering pass: Every thread of the job system records the batches
+// it picks up into its own secondary command buffer, which the primary command buffer then executes. Each thread has
+// one command pool per frame in flight, so pools are reset as a whole once the frame timeline reached the frame's value
+// and no pool is ever touched by two threads.
+
+#pragma once
+
+#include <vector>
+#include <span>
+#include <cstdint>
+#include <volk.h>
+#include "common.h"
+#include "jobsystem.h"
+
+class ParallelRecorder {
+public:
+	void create(VkDevice device, uint32_t queueFamily, uint32_t framesInFlight, JobSystem& jobs) {
+		this->device = device;
+		this->jobs = &jobs;
+		frames.resize(framesInFlight);
+		for (auto& frame : frames) {
+			frame.threads.resize(jobs.threadCount());
+			for (auto& thread : frame.threads) {
+				VkCommandPoolCreateInfo poolCI{ .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, .flags = VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, .queueFamilyIndex = queueFamily };
+				chk(vkCreateCommandPool(device, &poolCI, nullptr, &thread.pool));
+				VkCommandBufferAllocateInfo cbAI{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, .commandPool = thread.pool, .level = VK_COMMAND_BUFFER_LEVEL_SECONDARY, .commandBufferCount = 1 };
+				chk(vkAllocateCommandBuffers(device, &cbAI, &thread.cb));
+			}
+		}
+	}
+
+	void destroy() {
+		for (auto& frame : frames) {
+			for (auto& thread : frame.threads) {
+				vkDestroyCommandPool(device, thread.pool, nullptr);
+			}
+		}
+		frames.clear();
+	}
+
+	// Records count items in batches, calling setup(cb) once for every secondary command buffer that gets begun and
+	// draw(cb, begin, end) for every batch. Returns the secondary command buffers to execute in the rendering pass
+	// started with VK_RENDERING_CONTENTS_SECONDARY_COMMAND_BUFFERS_BIT, the frame timeline must have been waited on for the frame's value
+	template<typename Setup, typename Draw>
+	std::span<const VkCommandBuffer> record(uint32_t frameIndex, const VkCommandBufferInheritanceRenderingInfo& renderingInfo, uint32_t count, uint32_t batchSize, Setup&& setup, Draw&& draw) {
+		Frame& frame = frames[frameIndex];
+		for (auto& thread : frame.threads) {
+			chk(vkResetCommandPool(device, thread.pool, 0));
+			thread.recording = false;
+		}
+		const VkCommandBufferInheritanceInfo inheritanceInfo{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_INHERITANCE_INFO, .pNext = &renderingInfo };
+		jobs->parallelFor(count, batchSize, [&](uint32_t begin, uint32_t end, uint32_t threadIndex) {
+			Thread& thread = frame.threads[threadIndex];
+			if (!thread.recording) {
+				VkCommandBufferBeginInfo cbBI{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT | VK_COMMAND_BUFFER_USAGE_RENDER_PASS_CONTINUE_BIT, .pInheritanceInfo = &inheritanceInfo };
+				chk(vkBeginCommandBuffer(thread.cb, &cbBI));
+				setup(thread.cb);
+				thread.recording = true;
+			}
+			draw(thread.cb, begin, end);
+		});
+		// Threads that didn't get any batch have nothing to execute
+		frame.recorded.clear();
+		for (auto& thread : frame.threads) {
+			if (thread.recording) {
+				chk(vkEndCommandBuffer(thread.cb));
+				frame.recorded.push_back(thread.cb);
+			}
+		}
+		return frame.recorded;
+	}
+
+	uint32_t threadCount() const { return jobs->threadCount(); }
+
+private:
+	// Own cache line, threads update their entry while recording
+	struct alignas(64) Thread {
+		VkCommandPool pool{ VK_NULL_HANDLE };
+		VkCommandBuffer cb{ VK_NULL_HANDLE };
+		bool recording{ false };
+	};
+	struct Frame {
+		std::vector<Thread> threads;
+		std::vector<VkCommandBuffer> recorded;
+	};
+
+	VkDevice device{ VK_NULL_HANDLE };
+	JobSystem* jobs{ nullptr };
+	std::vector<Frame> frames;
+};
@@ -0,0 +1,583 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Frame graph: Passes are declared every frame in execution order, together with the images they read and write and in
+// which state. The declarations are hashed and compiled into a plan once per structure, later frames with the same
+// structure reuse it. A plan drops passes whose results are never used, gives transient images with non-overlapping
+// lifetimes the same memory and places all layout transitions and hazards of a pass into a single barrier call. Images
+// that outlive a frame (history) and transient memory also get the barriers between the last use in one frame and the
+// first use in the next, as frames are recorded into the same queue one after another.
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <functional>
+#include <string>
+#include <ostream>
+#include <iostream>
+#include <cstring>
+#include <algorithm>
+#include <cstdint>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+#include "common.h"
+#include "deletionqueue.h"
+#include "memory.h"
+#include "profiler.h"
+
+using RGResource = uint32_t;
+using RGPass = uint32_t;
+
+// Stages, accesses and layout of one use of an image
+struct RGState {
+	VkPipelineStageFlags2 stage{ VK_PIPELINE_STAGE_2_NONE };
+	VkAccessFlags2 access{ VK_ACCESS_2_NONE };
+	VkImageLayout layout{ VK_IMAGE_LAYOUT_UNDEFINED };
+};
+
+constexpr RGState rgColorAttachment{ VK_PIPELINE_STAGE_2_COLOR_ATTACHMENT_OUTPUT_BIT, VK_ACCESS_2_COLOR_ATTACHMENT_READ_BIT | VK_ACCESS_2_COLOR_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL };
+constexpr RGState rgDepthAttachment{ VK_PIPELINE_STAGE_2_EARLY_FRAGMENT_TESTS_BIT | VK_PIPELINE_STAGE_2_LATE_FRAGMENT_TESTS_BIT, VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_READ_BIT | VK_ACCESS_2_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT, VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL };
+constexpr RGState rgComputeSampledDepth{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL };
+constexpr RGState rgComputeSampled{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT, VK_IMAGE_LAYOUT_GENERAL };
+constexpr RGState rgComputeStorage{ VK_PIPELINE_STAGE_2_COMPUTE_SHADER_BIT, VK_ACCESS_2_SHADER_SAMPLED_READ_BIT | VK_ACCESS_2_SHADER_STORAGE_WRITE_BIT, VK_IMAGE_LAYOUT_GENERAL };
+
+// Transient images have a single level and layer
+struct RGImageDesc {
+	VkFormat format{ VK_FORMAT_UNDEFINED };
+	VkExtent2D extent{};
+	VkImageUsageFlags usage{ 0 };
+	VkImageAspectFlags aspect{ VK_IMAGE_ASPECT_COLOR_BIT };
+};
+
+inline const char* rgLayoutName(VkImageLayout layout) {
+	switch (layout) {
+	case VK_IMAGE_LAYOUT_UNDEFINED:
+		return "undefined";
+	case VK_IMAGE_LAYOUT_GENERAL:
+		return "general";
+	case VK_IMAGE_LAYOUT_ATTACHMENT_OPTIMAL:
+		return "attachment";
+	case VK_IMAGE_LAYOUT_DEPTH_STENCIL_READ_ONLY_OPTIMAL:
+		return "depth read only";
+	case VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL:
+		return "read only";
+	case VK_IMAGE_LAYOUT_TRANSFER_SRC_OPTIMAL:
+		return "transfer source";
+	case VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL:
+		return "transfer destination";
+	case VK_IMAGE_LAYOUT_PRESENT_SRC_KHR:
+		return "present";
+	default:
+		return "other";
+	}
+}
+
+// Not thread safe, all calls must come from the thread that records the frame
+class RenderGraph {
+public:
+	void create(VkDevice device, VmaAllocator allocator, GpuMemory& memory) {
+		this->device = device;
+		this->allocator = allocator;
+		this->memory = &memory;
+	}
+
+	// The device must be idle
+	void destroy() {
+		releaseTransients();
+		plans.clear();
+		plan = nullptr;
+	}
+
+	// Prints every newly compiled plan
+	void setDump(bool dump) { dumpPlans = dump; }
+
+	// Starts the declarations of a frame
+	void begin() {
+		resources.clear();
+		passes.clear();
+	}
+
+	// Image owned outside of the graph whose contents leave the frame, like the swapchain image. Passes writing it are always kept
+	RGResource importImage(const char* name, VkImage image, VkImageAspectFlags aspect, const RGState& initial, const RGState& final) {
+		resources.push_back({ .name = name, .kind = Kind::External, .image = image, .aspect = aspect, .initial = initial, .final = final });
+		return static_cast<RGResource>(resources.size() - 1);
+	}
+
+	// Image owned outside of the graph that carries data from one frame to the next. It starts in the state the previous
+	// frame left it in, its contents are discarded on first use if they're not valid
+	RGResource importHistory(const char* name, VkImage image, VkImageAspectFlags aspect, uint32_t levels, bool valid) {
+		resources.push_back({ .name = name, .kind = Kind::History, .image = image, .aspect = aspect, .levels = levels, .valid = valid });
+		return static_cast<RGResource>(resources.size() - 1);
+	}
+
+	// Only affects the handle and the contents, so it can be changed after compiling, e.g. when the image was recreated
+	void setHistory(RGResource resource, VkImage image, uint32_t levels, bool valid) {
+		resources[resource].image = image;
+		resources[resource].levels = levels;
+		resources[resource].valid = valid;
+	}
+
+	// Image owned by the graph that only lives within the frame, its memory may be shared with other transient images
+	RGResource createImage(const char* name, const RGImageDesc& desc) {
+		resources.push_back({ .name = name, .kind = Kind::Transient, .aspect = desc.aspect, .desc = desc });
+		return static_cast<RGResource>(resources.size() - 1);
+	}
+
+	// Passes run in the order they were added
+	RGPass addPass(const char* name, std::function<void(VkCommandBuffer)>&& execute) {
+		passes.push_back({ .name = name, .execute = std::move(execute) });
+		return static_cast<RGPass>(passes.size() - 1);
+	}
+
+	void read(RGPass pass, RGResource resource, const RGState& state) {
+		passes[pass].accesses.push_back({ .resource = resource, .state = state, .write = false });
+	}
+
+	void write(RGPass pass, RGResource resource, const RGState& state) {
+		passes[pass].accesses.push_back({ .resource = resource, .state = state, .write = true });
+	}
+
+	// The pass has effects the graph can't see (buffer writes, readbacks), so it's never culled
+	void sideEffects(RGPass pass) {
+		passes[pass].sideEffects = true;
+	}
+
+	// Looks up or compiles the plan for the declared structure and creates its transient images. Transient images of a plan
+	// with a different memory layout are retired for the current frame
+	void compile(DeletionQueue& deletions, uint32_t frameIndex) {
+		const uint64_t key{ structureKey() };
+		auto it = plans.find(key);
+		const bool compiled{ it == plans.end() };
+		if (compiled) {
+			it = plans.emplace(key, buildPlan()).first;
+			compileCount++;
+		}
+		plan = &it->second;
+		if (compiled && dumpPlans) {
+			dump(std::cout);
+		}
+		if (plan->transientKey != transients.key) {
+			deletions.push(frameIndex, [this, old = transients]() { destroyTransients(old); });
+			transients = {};
+			createTransients();
+		}
+	}
+
+	// Records all passes of the compiled plan with their barriers
+	void execute(VkCommandBuffer cb) {
+		for (uint32_t i = 0; i <= plan->passes.size(); i++) {
+			recordBarriers(cb, plan->batches[i]);
+			if (i < plan->passes.size()) {
+				Pass& pass = passes[plan->passes[i]];
+				PROFILE_GPU_ZONE(cb, pass.name);
+				pass.execute(cb);
+			}
+		}
+	}
+
+	VkImage image(RGResource resource) const { return resources[resource].kind == Kind::Transient ? transients.images[resource] : resources[resource].image; }
+	// Only for transient images
+	VkImageView view(RGResource resource) const { return transients.views[resource]; }
+
+	// Statistics of the current plan
+	uint32_t passCount() const { return static_cast<uint32_t>(plan->passes.size()); }
+	uint32_t culledPassCount() const { return static_cast<uint32_t>(plan->culled.size()); }
+	// Barrier calls and image barriers recorded per frame
+	uint32_t barrierCalls() const { return plan->barrierCalls; }
+	uint32_t imageBarriers() const { return plan->imageBarriers; }
+	// Memory the transient images would need without aliasing and the memory actually allocated
+	VkDeviceSize transientBytes() const { return plan->transientBytes; }
+	VkDeviceSize transientAllocatedBytes() const { return plan->allocatedBytes; }
+	uint32_t compilations() const { return compileCount; }
+
+	void dump(std::ostream& out) const {
+		out << "Render graph: " << plan->passes.size() << " passes (" << plan->culled.size() << " culled), " << plan->barrierCalls << " barrier calls with " << plan->imageBarriers << " image barriers, "
+			<< plan->allocatedBytes / 1024 << " KB transient memory in " << plan->slots.size() << " allocations (" << plan->transientBytes / 1024 << " KB without aliasing)\n";
+		for (RGResource r = 0; r < resources.size(); r++) {
+			out << "  Resource " << resources[r].name << ": " << (resources[r].kind == Kind::External ? "external" : resources[r].kind == Kind::History ? "history" : "transient");
+			if (resources[r].kind == Kind::Transient && plan->slotOf[r] >= 0) {
+				out << " " << resources[r].desc.extent.width << "x" << resources[r].desc.extent.height << ", passes " << plan->lifetimes[r].first << " to " << plan->lifetimes[r].second << ", memory " << plan->slotOf[r];
+			}
+			out << "\n";
+		}
+		for (uint32_t i = 0; i <= plan->passes.size(); i++) {
+			for (auto& barrier : plan->batches[i]) {
+				out << "    Barrier " << resources[barrier.resource].name << ": " << (barrier.discard ? "undefined" : rgLayoutName(barrier.src.layout)) << " -> " << rgLayoutName(barrier.dst.layout) << (barrier.srcWrite ? " after write" : "") << "\n";
+			}
+			if (i < plan->passes.size()) {
+				out << "  Pass " << i << ": " << passes[plan->passes[i]].name << "\n";
+			}
+		}
+		for (auto pass : plan->culled) {
+			out << "  Culled pass: " << passes[pass].name << "\n";
+		}
+	}
+
+private:
+	enum class Kind : uint32_t { External, History, Transient };
+	struct Resource {
+		const char* name{ nullptr };
+		Kind kind{ Kind::External };
+		VkImage image{ VK_NULL_HANDLE };
+		VkImageAspectFlags aspect{ 0 };
+		uint32_t levels{ 1 };
+		bool valid{ true };
+		RGImageDesc desc{};
+		RGState initial{};
+		RGState final{};
+	};
+	struct Access {
+		RGResource resource{ 0 };
+		RGState state{};
+		bool write{ false };
+	};
+	struct Pass {
+		const char* name{ nullptr };
+		std::function<void(VkCommandBuffer)> execute;
+		std::vector<Access> accesses;
+		bool sideEffects{ false };
+	};
+	struct Barrier {
+		RGResource resource{ 0 };
+		RGState src{};
+		RGState dst{};
+		// Transient contents are discarded on first use, history contents only if they're not valid
+		bool discard{ false };
+		bool firstUse{ false };
+		bool srcWrite{ false };
+	};
+	// Transient images sharing one allocation
+	struct Slot {
+		VkMemoryRequirements requirements{};
+		std::vector<RGResource> members;
+	};
+	struct Plan {
+		std::vector<RGPass> passes;
+		std::vector<RGPass> culled;
+		// Barriers recorded before each pass, the last batch after all passes
+		std::vector<std::vector<Barrier>> batches;
+		// First and last pass (index into passes) using each resource
+		std::vector<std::pair<uint32_t, uint32_t>> lifetimes;
+		std::vector<int32_t> slotOf;
+		std::vector<Slot> slots;
+		uint64_t transientKey{ 0 };
+		VkDeviceSize transientBytes{ 0 };
+		VkDeviceSize allocatedBytes{ 0 };
+		uint32_t barrierCalls{ 0 };
+		uint32_t imageBarriers{ 0 };
+	};
+	struct Transients {
+		uint64_t key{ 0 };
+		std::vector<VmaAllocation> allocations;
+		std::vector<VkImage> images;
+		std::vector<VkImageView> views;
+	};
+	// State of a resource (or of the memory shared by transient images) while simulating a frame
+	struct Tracked {
+		// Everything that accessed the image since the last write or layout change, a following barrier waits for all of it
+		RGState state{};
+		bool write{ false };
+		// What the last barrier waited for, and what it made the image available to
+		RGState source{};
+		bool sourceWrite{ false };
+		RGState covered{};
+	};
+
+	VkDevice device{ VK_NULL_HANDLE };
+	VmaAllocator allocator{ VK_NULL_HANDLE };
+	GpuMemory* memory{ nullptr };
+	bool dumpPlans{ false };
+	std::vector<Resource> resources;
+	std::vector<Pass> passes;
+	// Elements of an unordered map keep their address, so the current plan can be pointed to
+	std::unordered_map<uint64_t, Plan> plans;
+	const Plan* plan{ nullptr };
+	Transients transients;
+	uint32_t compileCount{ 0 };
+
+	template <typename T>
+	static void append(std::vector<uint8_t>& bytes, const T& value) {
+		const uint8_t* data{ reinterpret_cast<const uint8_t*>(&value) };
+		bytes.insert(bytes.end(), data, data + sizeof(T));
+	}
+
+	static void appendState(std::vector<uint8_t>& bytes, const RGState& state) {
+		append(bytes, state.stage);
+		append(bytes, state.access);
+		append(bytes, state.layout);
+	}
+
+	// Everything a plan depends on, image handles and history validity are resolved when recording
+	uint64_t structureKey() const {
+		std::vector<uint8_t> bytes;
+		for (auto& resource : resources) {
+			bytes.insert(bytes.end(), resource.name, resource.name + strlen(resource.name));
+			append(bytes, resource.kind);
+			append(bytes, resource.aspect);
+			if (resource.kind == Kind::External) {
+				appendState(bytes, resource.initial);
+				appendState(bytes, resource.final);
+			}
+			if (resource.kind == Kind::Transient) {
+				append(bytes, resource.desc.format);
+				append(bytes, resource.desc.extent.width);
+				append(bytes, resource.desc.extent.height);
+				append(bytes, resource.desc.usage);
+			}
+		}
+		for (auto& pass : passes) {
+			bytes.insert(bytes.end(), pass.name, pass.name + strlen(pass.name));
+			append(bytes, pass.sideEffects);
+			for (auto& access : pass.accesses) {
+				append(bytes, access.resource);
+				appendState(bytes, access.state);
+				append(bytes, access.write);
+			}
+		}
+		return hashBytes(bytes.data(), bytes.size());
+	}
+
+	VkImageCreateInfo transientCreateInfo(const RGImageDesc& desc) const {
+		return {
+			.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO,
+			.imageType = VK_IMAGE_TYPE_2D,
+			.format = desc.format,
+			.extent{.width = desc.extent.width, .height = desc.extent.height, .depth = 1 },
+			.mipLevels = 1,
+			.arrayLayers = 1,
+			.samples = VK_SAMPLE_COUNT_1_BIT,
+			.tiling = VK_IMAGE_TILING_OPTIMAL,
+			.usage = desc.usage,
+			.initialLayout = VK_IMAGE_LAYOUT_UNDEFINED
+		};
+	}
+
+	Plan buildPlan() const {
+		Plan result;
+		// A pass is needed if it has side effects, writes an external image or writes something a needed pass reads. History
+		// is read by the next frame, so readers anywhere in the graph count and this is repeated until nothing changes
+		std::vector<bool> needed(passes.size(), false);
+		for (RGPass p = 0; p < passes.size(); p++) {
+			needed[p] = passes[p].sideEffects || std::any_of(passes[p].accesses.begin(), passes[p].accesses.end(), [&](const Access& access) { return access.write && resources[access.resource].kind == Kind::External; });
+		}
+		bool changed{ true };
+		while (changed) {
+			changed = false;
+			for (RGPass p = static_cast<RGPass>(passes.size()); p-- > 0;) {
+				if (needed[p]) {
+					continue;
+				}
+				for (auto& access : passes[p].accesses) {
+					const bool read{ access.write && std::any_of(passes.begin(), passes.end(), [&](const Pass& other) {
+						return needed[&other - passes.data()] && std::any_of(other.accesses.begin(), other.accesses.end(), [&](const Access& otherAccess) { return !otherAccess.write && otherAccess.resource == access.resource; });
+					}) };
+					if (read) {
+						needed[p] = true;
+						changed = true;
+						break;
+					}
+				}
+			}
+		}
+		for (RGPass p = 0; p < passes.size(); p++) {
+			(needed[p] ? result.passes : result.culled).push_back(p);
+		}
+		result.lifetimes.assign(resources.size(), { UINT32_MAX, 0 });
+		for (uint32_t i = 0; i < result.passes.size(); i++) {
+			for (auto& access : passes[result.passes[i]].accesses) {
+				auto& lifetime = result.lifetimes[access.resource];
+				lifetime = { std::min(lifetime.first, i), std::max(lifetime.second, i) };
+			}
+		}
+		assignMemory(result);
+		// The first run only finds the state everything is left in at the end of a frame, which is where the next frame starts
+		std::vector<Tracked> endStates{ simulate(result, nullptr, false) };
+		result.batches.resize(result.passes.size() + 1);
+		simulate(result, &endStates, true);
+		for (auto& batch : result.batches) {
+			result.barrierCalls += batch.empty() ? 0 : 1;
+			result.imageBarriers += static_cast<uint32_t>(batch.size());
+		}
+		return result;
+	}
+
+	// Largest images first, each one goes into the first allocation whose images are all used by other passes
+	void assignMemory(Plan& result) const {
+		result.slotOf.assign(resources.size(), -1);
+		std::vector<std::pair<RGResource, VkMemoryRequirements>> candidates;
+		for (RGResource r = 0; r < resources.size(); r++) {
+			if (resources[r].kind != Kind::Transient || result.lifetimes[r].first == UINT32_MAX) {
+				continue;
+			}
+			const VkImageCreateInfo imageCI{ transientCreateInfo(resources[r].desc) };
+			VkDeviceImageMemoryRequirements requirementsInfo{ .sType = VK_STRUCTURE_TYPE_DEVICE_IMAGE_MEMORY_REQUIREMENTS, .pCreateInfo = &imageCI };
+			VkMemoryRequirements2 requirements{ .sType = VK_STRUCTURE_TYPE_MEMORY_REQUIREMENTS_2 };
+			vkGetDeviceImageMemoryRequirements(device, &requirementsInfo, &requirements);
+			candidates.push_back({ r, requirements.memoryRequirements });
+			result.transientBytes += requirements.memoryRequirements.size;
+		}
+		std::sort(candidates.begin(), candidates.end(), [](const auto& a, const auto& b) { return a.second.size > b.second.size; });
+		const auto overlaps = [&](RGResource a, RGResource b) {
+			return result.lifetimes[a].first <= result.lifetimes[b].second && result.lifetimes[b].first <= result.lifetimes[a].second;
+		};
+		std::vector<uint8_t> keyBytes;
+		for (auto& [r, requirements] : candidates) {
+			Slot* target{ nullptr };
+			for (auto& slot : result.slots) {
+				if ((slot.requirements.memoryTypeBits & requirements.memoryTypeBits) != 0 && std::none_of(slot.members.begin(), slot.members.end(), [&](RGResource member) { return overlaps(member, r); })) {
+					target = &slot;
+					break;
+				}
+			}
+			if (!target) {
+				target = &result.slots.emplace_back(Slot{ .requirements = requirements });
+			}
+			target->requirements.size = std::max(target->requirements.size, requirements.size);
+			target->requirements.alignment = std::max(target->requirements.alignment, requirements.alignment);
+			target->requirements.memoryTypeBits &= requirements.memoryTypeBits;
+			target->members.push_back(r);
+			result.slotOf[r] = static_cast<int32_t>(target - result.slots.data());
+		}
+		for (auto& slot : result.slots) {
+			result.allocatedBytes += slot.requirements.size;
+			append(keyBytes, slot.requirements);
+			for (auto member : slot.members) {
+				append(keyBytes, member);
+				append(keyBytes, resources[member].desc);
+			}
+		}
+		// Plans with the same images in the same memory share them, no transients at all matches the initial empty set
+		result.transientKey = keyBytes.empty() ? 0 : hashBytes(keyBytes.data(), keyBytes.size());
+	}
+
+	// Walks the passes and records a barrier wherever the layout changes or a write is involved. Reads in the same layout
+	// are merged, so a following write waits for all of them. A read at a stage or access the last barrier didn't cover gets
+	// its own barrier from what that barrier waited for. Final transitions of external images are placed right after their
+	// last use, where they share the barrier call of the next pass
+	std::vector<Tracked> simulate(Plan& result, const std::vector<Tracked>* startStates, bool recordBarriers) const {
+		// Transient images are tracked per allocation, the next image in the same memory has to wait for the previous one
+		const auto tracker = [&](RGResource r) {
+			return (resources[r].kind == Kind::Transient) ? resources.size() + result.slotOf[r] : r;
+		};
+		std::vector<Tracked> tracked(resources.size() + result.slots.size());
+		if (startStates) {
+			tracked = *startStates;
+		}
+		for (RGResource r = 0; r < resources.size(); r++) {
+			if (resources[r].kind == Kind::External) {
+				tracked[r] = { .state = resources[r].initial, .source = resources[r].initial, .covered = resources[r].initial };
+			}
+		}
+		std::vector<bool> used(resources.size(), false);
+		for (uint32_t i = 0; i < result.passes.size(); i++) {
+			for (auto& access : passes[result.passes[i]].accesses) {
+				Tracked& current = tracked[tracker(access.resource)];
+				const bool firstUse{ !used[access.resource] };
+				used[access.resource] = true;
+				const bool discard{ firstUse && resources[access.resource].kind == Kind::Transient };
+				if (!discard && current.state.layout == access.state.layout && !current.write && !access.write) {
+					const bool covered{ (access.state.stage & ~current.covered.stage) == 0 && (access.state.access & ~current.covered.access) == 0 };
+					if (!covered) {
+						// Chains to the last barrier, so the read also waits for its layout transition
+						if (recordBarriers) {
+							const RGState src{ .stage = current.source.stage | current.covered.stage, .access = current.source.access, .layout = access.state.layout };
+							result.batches[i].push_back({ .resource = access.resource, .src = src, .dst = access.state, .firstUse = firstUse, .srcWrite = current.sourceWrite });
+						}
+						current.covered.stage |= access.state.stage;
+						current.covered.access |= access.state.access;
+					}
+					current.state.stage |= access.state.stage;
+					current.state.access |= access.state.access;
+					continue;
+				}
+				if (recordBarriers) {
+					result.batches[i].push_back({ .resource = access.resource, .src = current.state, .dst = access.state, .discard = discard, .firstUse = firstUse, .srcWrite = current.write });
+				}
+				current = { .state = access.state, .write = access.write, .source = current.state, .sourceWrite = current.write, .covered = access.state };
+			}
+		}
+		for (RGResource r = 0; r < resources.size(); r++) {
+			if (resources[r].kind != Kind::External || result.lifetimes[r].first == UINT32_MAX) {
+				continue;
+			}
+			Tracked& current = tracked[r];
+			if (recordBarriers && (current.state.layout != resources[r].final.layout || current.write)) {
+				result.batches[result.lifetimes[r].second + 1].push_back({ .resource = r, .src = current.state, .dst = resources[r].final, .srcWrite = current.write });
+			}
+			current = { .state = resources[r].final, .source = current.state, .sourceWrite = current.write, .covered = resources[r].final };
+		}
+		return tracked;
+	}
+
+	void recordBarriers(VkCommandBuffer cb, const std::vector<Barrier>& batch) const {
+		if (batch.empty()) {
+			return;
+		}
+		std::vector<VkImageMemoryBarrier2> barriers;
+		barriers.reserve(batch.size());
+		for (auto& barrier : batch) {
+			const Resource& resource = resources[barrier.resource];
+			const bool discard{ barrier.discard || (barrier.firstUse && resource.kind == Kind::History && !resource.valid) };
+			barriers.push_back({
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				.srcStageMask = barrier.src.stage,
+				// Reads only need an execution dependency
+				.srcAccessMask = barrier.srcWrite ? barrier.src.access : VK_ACCESS_2_NONE,
+				.dstStageMask = barrier.dst.stage,
+				.dstAccessMask = barrier.dst.access,
+				.oldLayout = discard ? VK_IMAGE_LAYOUT_UNDEFINED : barrier.src.layout,
+				.newLayout = barrier.dst.layout,
+				.image = image(barrier.resource),
+				.subresourceRange{.aspectMask = resource.aspect, .levelCount = resource.levels, .layerCount = 1 }
+			});
+		}
+		VkDependencyInfo dependencyInfo{ .sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO, .imageMemoryBarrierCount = static_cast<uint32_t>(barriers.size()), .pImageMemoryBarriers = barriers.data() };
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+	}
+
+	// All images of a slot are bound to the same allocation
+	void createTransients() {
+		transients.key = plan->transientKey;
+		transients.images.assign(resources.size(), VK_NULL_HANDLE);
+		transients.views.assign(resources.size(), VK_NULL_HANDLE);
+		for (auto& slot : plan->slots) {
+			VmaAllocationCreateInfo allocCI{ .flags = VMA_ALLOCATION_CREATE_DEDICATED_MEMORY_BIT, .requiredFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT };
+			VmaAllocation allocation{ VK_NULL_HANDLE };
+			chk(vmaAllocateMemory(allocator, &slot.requirements, &allocCI, &allocation, nullptr));
+			memory->track(MemoryCategory::Attachments, allocation);
+			transients.allocations.push_back(allocation);
+			for (auto r : slot.members) {
+				const VkImageCreateInfo imageCI{ transientCreateInfo(resources[r].desc) };
+				chk(vmaCreateAliasingImage(allocator, allocation, &imageCI, &transients.images[r]));
+				// Depth/stencil images are sampled through their depth aspect
+				const VkImageAspectFlags viewAspect{ (resources[r].aspect & VK_IMAGE_ASPECT_DEPTH_BIT) ? VK_IMAGE_ASPECT_DEPTH_BIT : resources[r].aspect };
+				VkImageViewCreateInfo viewCI{ .sType = VK_STRUCTURE_TYPE_IMAGE_VIEW_CREATE_INFO, .image = transients.images[r], .viewType = VK_IMAGE_VIEW_TYPE_2D, .format = imageCI.format, .subresourceRange{.aspectMask = viewAspect, .levelCount = 1, .layerCount = 1 } };
+				chk(vkCreateImageView(device, &viewCI, nullptr, &transients.views[r]));
+			}
+		}
+	}
+
+	void destroyTransients(const Transients& old) {
+		for (auto view : old.views) {
+			if (view != VK_NULL_HANDLE) {
+				vkDestroyImageView(device, view, nullptr);
+			}
+		}
+		for (auto image : old.images) {
+			if (image != VK_NULL_HANDLE) {
+				vkDestroyImage(device, image, nullptr);
+			}
+		}
+		for (auto allocation : old.allocations) {
+			memory->untrack(allocation);
+			vmaFreeMemory(allocator, allocation);
+		}
+	}
+
+	void releaseTransients() {
+		destroyTransients(transients);
+		transients = {};
+	}
+};
@@ -0,0 +1,139 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Startup caches: SPIR-V generated by Slang, keyed by everything that affects code generation, and the driver's
+// pipeline cache blob, which is only handed back to the same device and driver version that produced it
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <fstream>
+#include <filesystem>
+#include <cstring>
+#include <cstdint>
+#include <volk.h>
+#include "common.h"
+#include "mappedfile.h"
+
+constexpr uint32_t spirvCacheMagic{ 0x56505348 }; // "HSPV"
+constexpr uint32_t pipelineCacheMagic{ 0x4C505048 }; // "HPPL"
+constexpr uint32_t shaderCacheVersion{ 1 };
+
+struct SpirvCacheHeader {
+	uint32_t magic{ spirvCacheMagic };
+	uint32_t version{ shaderCacheVersion };
+	uint64_t key{ 0 };
+	uint64_t size{ 0 };
+	uint64_t hash{ 0 };
+};
+
+struct PipelineCacheHeader {
+	uint32_t magic{ pipelineCacheMagic };
+	uint32_t version{ shaderCacheVersion };
+	uint32_t vendorID{ 0 };
+	uint32_t deviceID{ 0 };
+	uint32_t driverVersion{ 0 };
+	uint8_t pipelineCacheUUID[VK_UUID_SIZE]{};
+	uint32_t reserved{ 0 };
+	uint64_t size{ 0 };
+	uint64_t hash{ 0 };
+};
+
+// Writes to a temporary file first, so an interrupted run never leaves a truncated cache behind
+inline bool writeCacheFile(const std::string& path, const void* header, size_t headerSize, const void* data, size_t size) {
+	const std::string tempPath{ path + ".tmp" };
+	{
+		std::ofstream file(tempPath, std::ios::binary | std::ios::trunc);
+		if (!file) {
+			return false;
+		}
+		file.write(static_cast<const char*>(header), headerSize);
+		file.write(static_cast<const char*>(data), size);
+		if (!file.good()) {
+			return false;
+		}
+	}
+	std::error_code error;
+	std::filesystem::rename(tempPath, path, error);
+	return !error;
+}
+
+// Key for the SPIR-V cache: Shader sources, including all files they include, plus a description of the compiler, its version and all options
+inline bool spirvCacheKey(const std::vector<std::string>& sourcePaths, const std::string& compilerDesc, uint64_t& key) {
+	key = hashBytes(reinterpret_cast<const uint8_t*>(compilerDesc.data()), compilerDesc.size()) * 31;
+	for (auto& sourcePath : sourcePaths) {
+		MappedFile source;
+		if (!source.open(sourcePath)) {
+			return false;
+		}
+		key = (key * 31) ^ hashBytes(source.data(), source.size());
+	}
+	return true;
+}
+
+inline bool loadSpirvCache(const std::string& cachePath, uint64_t key, std::vector<uint32_t>& spirv) {
+	MappedFile file;
+	if (!file.open(cachePath) || file.size() < sizeof(SpirvCacheHeader)) {
+		return false;
+	}
+	SpirvCacheHeader header{};
+	memcpy(&header, file.data(), sizeof(header));
+	const uint8_t* code{ file.data() + sizeof(header) };
+	if (header.magic != spirvCacheMagic || header.version != shaderCacheVersion || header.key != key || header.size == 0 || header.size % sizeof(uint32_t) != 0
+		|| sizeof(header) + header.size > file.size() || hashBytes(code, header.size) != header.hash) {
+		return false;
+	}
+	spirv.resize(header.size / sizeof(uint32_t));
+	memcpy(spirv.data(), code, header.size);
+	return true;
+}
+
+inline bool writeSpirvCache(const std::string& cachePath, uint64_t key, const void* code, size_t size) {
+	const SpirvCacheHeader header{ .key = key, .size = size, .hash = hashBytes(static_cast<const uint8_t*>(code), size) };
+	return writeCacheFile(cachePath, &header, sizeof(header), code, size);
+}
+
+// Creates a pipeline cache, seeded from disk if the file was written by the same device and driver. cacheSize is the size of the seed data
+inline VkPipelineCache loadPipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, const std::string& cachePath, bool& cacheHit, size_t& cacheSize) {
+	cacheHit = false;
+	cacheSize = 0;
+	MappedFile file;
+	VkPipelineCacheCreateInfo pipelineCacheCI{ .sType = VK_STRUCTURE_TYPE_PIPELINE_CACHE_CREATE_INFO };
+	if (file.open(cachePath) && file.size() >= sizeof(PipelineCacheHeader)) {
+		PipelineCacheHeader header{};
+		memcpy(&header, file.data(), sizeof(header));
+		const uint8_t* data{ file.data() + sizeof(header) };
+		cacheHit = header.magic == pipelineCacheMagic
+			&& header.version == shaderCacheVersion
+			&& header.vendorID == properties.vendorID
+			&& header.deviceID == properties.deviceID
+			&& header.driverVersion == properties.driverVersion
+			&& memcmp(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE) == 0
+			&& sizeof(header) + header.size <= file.size()
+			&& hashBytes(data, header.size) == header.hash;
+		if (cacheHit) {
+			pipelineCacheCI.initialDataSize = header.size;
+			pipelineCacheCI.pInitialData = data;
+			cacheSize = header.size;
+		}
+	}
+	VkPipelineCache pipelineCache{ VK_NULL_HANDLE };
+	chk(vkCreatePipelineCache(device, &pipelineCacheCI, nullptr, &pipelineCache));
+	return pipelineCache;
+}
+
+// Only written if the cache grew past the size it was seeded with, i.e. pipelines were added that weren't in the file
+inline bool writePipelineCache(VkDevice device, const VkPhysicalDeviceProperties& properties, VkPipelineCache pipelineCache, const std::string& cachePath, size_t seedSize = 0) {
+	size_t size{ 0 };
+	chk(vkGetPipelineCacheData(device, pipelineCache, &size, nullptr));
+	if (size <= seedSize) {
+		return true;
+	}
+	std::vector<uint8_t> data(size);
+	chk(vkGetPipelineCacheData(device, pipelineCache, &size, data.data()));
+	PipelineCacheHeader header{ .vendorID = properties.vendorID, .deviceID = properties.deviceID, .driverVersion = properties.driverVersion, .size = size, .hash = hashBytes(data.data(), size) };
+	memcpy(header.pipelineCacheUUID, properties.pipelineCacheUUID, VK_UUID_SIZE);
+	return writeCacheFile(cachePath, &header, sizeof(header), data.data(), size);
+}
@@ -0,0 +1,395 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// LOD generation: Quadric error metric simplification (Garland and Heckbert, "Surface Simplification Using Quadric Error
+// Metrics", 1997) with half edge collapses, so every LOD only has new indices and shares the vertices of the full mesh.
+// Borders and attribute seams may only collapse along themselves, vertices where they meet or branch are locked.
+
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <glm/glm.hpp>
+#include "mesh.h"
+#include "jobsystem.h"
+
+// Triangle ratios of the LODs after the full mesh
+constexpr float lodRatios[]{ 0.5f, 0.25f, 0.125f, 0.0625f };
+constexpr uint32_t maxLodCount{ 1 + sizeof(lodRatios) / sizeof(lodRatios[0]) };
+
+// Index range of one LOD in the shared index buffer, error is the largest collapse error in model space units
+struct MeshLod {
+	uint32_t firstIndex{ 0 };
+	uint32_t indexCount{ 0 };
+	float error{ 0.0f };
+};
+
+// Symmetric 4x4 matrix of the summed squared plane distances, weight is the summed area the planes were weighted with
+struct Quadric {
+	double a00{ 0 }, a01{ 0 }, a02{ 0 }, a03{ 0 };
+	double a11{ 0 }, a12{ 0 }, a13{ 0 };
+	double a22{ 0 }, a23{ 0 };
+	double a33{ 0 };
+	double weight{ 0 };
+
+	Quadric& operator+=(const Quadric& q) {
+		a00 += q.a00; a01 += q.a01; a02 += q.a02; a03 += q.a03;
+		a11 += q.a11; a12 += q.a12; a13 += q.a13;
+		a22 += q.a22; a23 += q.a23;
+		a33 += q.a33;
+		weight += q.weight;
+		return *this;
+	}
+
+	static Quadric plane(const glm::vec3& normal, float distance, float weight) {
+		const double a{ normal.x }, b{ normal.y }, c{ normal.z }, d{ distance };
+		return { a * a * weight, a * b * weight, a * c * weight, a * d * weight, b * b * weight, b * c * weight, b * d * weight, c * c * weight, c * d * weight, d * d * weight, weight };
+	}
+
+	// Mean squared distance of p to all planes
+	double error(const glm::vec3& p) const {
+		const double x{ p.x }, y{ p.y }, z{ p.z };
+		const double sum{ a00 * x * x + 2 * a01 * x * y + 2 * a02 * x * z + 2 * a03 * x + a11 * y * y + 2 * a12 * y * z + 2 * a13 * y + a22 * z * z + 2 * a23 * z + a33 };
+		return weight > 0.0 ? std::abs(sum) / weight : 0.0;
+	}
+};
+
+// Simplifies to at most targetIndexCount indices or until no valid collapse is left, the result references the input vertices
+inline std::vector<uint32_t> simplifyMesh(const std::vector<Vertex>& vertices, const std::vector<uint32_t>& indices, size_t targetIndexCount, float& error) {
+	error = 0.0f;
+	// Vertices with the same position but different attributes are wedges of one position, collapses operate on positions
+	struct PositionHash {
+		size_t operator()(const glm::vec3& p) const {
+			uint32_t bits[3];
+			memcpy(bits, &p, sizeof(bits));
+			return (size_t)bits[0] * 73856093u ^ (size_t)bits[1] * 19349663u ^ (size_t)bits[2] * 83492791u;
+		}
+	};
+	std::unordered_map<glm::vec3, uint32_t, PositionHash> uniquePositions;
+	std::vector<uint32_t> position(vertices.size());
+	std::vector<glm::vec3> positions;
+	std::vector<uint32_t> wedgeCount;
+	for (size_t i = 0; i < vertices.size(); i++) {
+		const auto [it, inserted] = uniquePositions.try_emplace(vertices[i].pos, static_cast<uint32_t>(positions.size()));
+		if (inserted) {
+			positions.push_back(vertices[i].pos);
+			wedgeCount.push_back(0);
+		}
+		position[i] = it->second;
+		wedgeCount[it->second]++;
+	}
+	const size_t positionCount{ positions.size() };
+	const auto edgeKey = [](uint32_t a, uint32_t b) { return (uint64_t)a << 32 | b; };
+	// Triangles collapsed to a line or point on the position level never contribute
+	std::vector<uint32_t> result;
+	result.reserve(indices.size());
+	for (size_t i = 0; i + 2 < indices.size(); i += 3) {
+		const uint32_t p0{ position[indices[i]] }, p1{ position[indices[i + 1]] }, p2{ position[indices[i + 2]] };
+		if (p0 != p1 && p1 != p2 && p2 != p0) {
+			result.insert(result.end(), { indices[i], indices[i + 1], indices[i + 2] });
+		}
+	}
+	// Directed edges of the attribute mesh, an edge without a twin is a border or one side of a seam
+	std::unordered_map<uint64_t, uint32_t> edges;
+	const auto buildEdges = [&]() {
+		edges.clear();
+		for (size_t i = 0; i < result.size(); i++) {
+			edges[edgeKey(result[i], result[i - i % 3 + (i + 1) % 3])]++;
+		}
+	};
+	const auto openEdge = [&](uint32_t a, uint32_t b) { return edges.find(edgeKey(b, a)) == edges.end(); };
+	// Plane quadrics of all triangles, plus planes perpendicular to open edges that keep borders and seams in place
+	constexpr float openEdgeWeight{ 10.0f };
+	std::vector<Quadric> quadrics(positionCount);
+	buildEdges();
+	for (size_t t = 0; t < result.size(); t += 3) {
+		const glm::vec3 p[3]{ vertices[result[t]].pos, vertices[result[t + 1]].pos, vertices[result[t + 2]].pos };
+		const glm::vec3 cross{ glm::cross(p[1] - p[0], p[2] - p[0]) };
+		const float length{ glm::length(cross) };
+		if (length == 0.0f) {
+			continue;
+		}
+		const glm::vec3 normal{ cross / length };
+		const Quadric quadric{ Quadric::plane(normal, -glm::dot(normal, p[0]), length * 0.5f) };
+		for (uint32_t k = 0; k < 3; k++) {
+			quadrics[position[result[t + k]]] += quadric;
+			const uint32_t a{ result[t + k] }, b{ result[t + (k + 1) % 3] };
+			if (openEdge(a, b)) {
+				const glm::vec3 edge{ p[(k + 1) % 3] - p[k] };
+				const float edgeLength{ glm::length(edge) };
+				if (edgeLength > 0.0f) {
+					const glm::vec3 edgeNormal{ glm::normalize(glm::cross(edge, normal)) };
+					const Quadric edgeQuadric{ Quadric::plane(edgeNormal, -glm::dot(edgeNormal, p[k]), edgeLength * edgeLength * openEdgeWeight) };
+					quadrics[position[a]] += edgeQuadric;
+					quadrics[position[b]] += edgeQuadric;
+				}
+			}
+		}
+	}
+	enum class Kind : uint8_t { Manifold, Edge, Locked };
+	std::vector<Kind> kinds(positionCount);
+	std::vector<uint32_t> openNeighbors(positionCount * 2);
+	std::vector<uint32_t> offsets(positionCount + 1);
+	std::vector<uint32_t> adjacency;
+	std::vector<bool> locked(positionCount);
+	std::vector<uint32_t> neighbors;
+	std::vector<uint32_t> targetNeighbors;
+	std::vector<uint32_t> opposite;
+	std::vector<uint32_t> wedgeRemap;
+	struct Collapse {
+		uint32_t from;
+		uint32_t to;
+		double cost;
+	};
+	std::vector<Collapse> collapses;
+	// Each pass collapses the cheapest edges whose neighborhoods don't overlap, then rebuilds the adjacency
+	while (result.size() > targetIndexCount) {
+		const size_t triangleCount{ result.size() / 3 };
+		buildEdges();
+		// Position to triangle adjacency in compressed row layout
+		std::fill(offsets.begin(), offsets.end(), 0);
+		for (auto index : result) {
+			offsets[position[index] + 1]++;
+		}
+		for (size_t i = 0; i < positionCount; i++) {
+			offsets[i + 1] += offsets[i];
+		}
+		adjacency.resize(result.size());
+		std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+		for (size_t i = 0; i < result.size(); i++) {
+			adjacency[fill[position[result[i]]]++] = static_cast<uint32_t>(i / 3);
+		}
+		// Interior vertices with a single wedge collapse freely, vertices on exactly one border or seam only along it
+		for (uint32_t p = 0; p < positionCount; p++) {
+			uint32_t openCount{ 0 };
+			bool complex{ false };
+			for (uint32_t a = offsets[p]; a < offsets[p + 1]; a++) {
+				const uint32_t t{ adjacency[a] * 3 };
+				for (uint32_t k = 0; k < 3; k++) {
+					const uint32_t from{ result[t + k] }, to{ result[t + (k + 1) % 3] };
+					if ((position[from] != p && position[to] != p) || !openEdge(from, to)) {
+						continue;
+					}
+					const uint32_t other{ position[from] == p ? position[to] : position[from] };
+					if ((openCount > 0 && openNeighbors[p * 2] == other) || (openCount > 1 && openNeighbors[p * 2 + 1] == other)) {
+						continue;
+					}
+					if (openCount == 2) {
+						complex = true;
+						break;
+					}
+					openNeighbors[p * 2 + openCount++] = other;
+				}
+			}
+			if (openCount == 0 && wedgeCount[p] == 1) {
+				kinds[p] = Kind::Manifold;
+			} else if (openCount == 2 && !complex) {
+				kinds[p] = Kind::Edge;
+			} else {
+				kinds[p] = Kind::Locked;
+			}
+		}
+		// Cheapest valid collapse of every position
+		const auto triangleHas = [&](uint32_t t, uint32_t p) { return position[result[t * 3]] == p || position[result[t * 3 + 1]] == p || position[result[t * 3 + 2]] == p; };
+		const auto validCollapse = [&](uint32_t from, uint32_t to) {
+			// Link condition: the only shared neighbors are the opposite corners of the triangles on the edge, anything else pinches the surface
+			const auto collectNeighbors = [&](uint32_t p, std::vector<uint32_t>& out) {
+				out.clear();
+				for (uint32_t a = offsets[p]; a < offsets[p + 1]; a++) {
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t neighbor{ position[result[adjacency[a] * 3 + k]] };
+						if (neighbor != from && neighbor != to) {
+							out.push_back(neighbor);
+						}
+					}
+				}
+				std::sort(out.begin(), out.end());
+				out.erase(std::unique(out.begin(), out.end()), out.end());
+			};
+			collectNeighbors(from, neighbors);
+			collectNeighbors(to, targetNeighbors);
+			opposite.clear();
+			for (uint32_t a = offsets[from]; a < offsets[from + 1]; a++) {
+				const uint32_t t{ adjacency[a] };
+				if (triangleHas(t, to)) {
+					for (uint32_t k = 0; k < 3; k++) {
+						const uint32_t p{ position[result[t * 3 + k]] };
+						if (p != from && p != to) {
+							opposite.push_back(p);
+						}
+					}
+				}
+			}
+			std::sort(opposite.begin(), opposite.end());
+			opposite.erase(std::unique(opposite.begin(), opposite.end()), opposite.end());
+			size_t sharedNeighbors{ 0 };
+			for (auto neighbor : targetNeighbors) {
+				sharedNeighbors += std::binary_search(neighbors.begin(), neighbors.end(), neighbor) ? 1 : 0;
+			}
+			if (opposite.empty() || sharedNeighbors != opposite.size()) {
+				return false;
+			}
+			// Triangles that remain must not flip or degenerate into slivers
+			for (uint32_t a = offsets[from]; a < offsets[from + 1]; a++) {
+				const uint32_t t{ adjacency[a] };
+				if (triangleHas(t, to)) {
+					continue;
+				}
+				glm::vec3 before[3], after[3];
+				for (uint32_t k = 0; k < 3; k++) {
+					before[k] = positions[position[result[t * 3 + k]]];
+					after[k] = position[result[t * 3 + k]] == from ? positions[to] : before[k];
+				}
+				const glm::vec3 normalBefore{ glm::cross(before[1] - before[0], before[2] - before[0]) };
+				const glm::vec3 normalAfter{ glm::cross(after[1] - after[0], after[2] - after[0]) };
+				if (glm::dot(normalBefore, normalAfter) < 0.25f * glm::length(normalBefore) * glm::length(normalAfter)) {
+					return false;
+				}
+			}
+			return true;
+		};
+		collapses.clear();
+		for (uint32_t p = 0; p < positionCount; p++) {
+			if (kinds[p] == Kind::Locked) {
+				continue;
+			}
+			Collapse best{ .from = p, .to = p, .cost = std::numeric_limits<double>::max() };
+			const auto consider = [&](uint32_t to) {
+				if (to == p || (kinds[p] == Kind::Edge && to != openNeighbors[p * 2] && to != openNeighbors[p * 2 + 1])) {
+					return;
+				}
+				Quadric merged{ quadrics[p] };
+				merged += quadrics[to];
+				const double cost{ merged.error(positions[to]) };
+				if (cost < best.cost && validCollapse(p, to)) {
+					best = { .from = p, .to = to, .cost = cost };
+				}
+			};
+			for (uint32_t a = offsets[p]; a < offsets[p + 1]; a++) {
+				for (uint32_t k = 0; k < 3; k++) {
+					consider(position[result[adjacency[a] * 3 + k]]);
+				}
+			}
+			if (best.to != p) {
+				collapses.push_back(best);
+			}
+		}
+		std::sort(collapses.begin(), collapses.end(), [](const Collapse& a, const Collapse& b) { return a.cost < b.cost; });
+		// Collapses within one pass must not touch each other's triangles, so the whole one ring of a collapse is locked
+		std::fill(locked.begin(), locked.end(), false);
+		size_t remaining{ triangleCount };
+		size_t collapsed{ 0 };
+		wedgeRemap.resize(vertices.size());
+		for (auto& collapse : collapses) {
+			if (remaining * 3 <= targetIndexCount) {
+				break;
+			}
+			if (locked[collapse.from] || locked[collapse.to]) {
+				continue;
+			}
+			// Every wedge of the removed position moves to the wedge of the target on the same side of the seam
+			bool mapped{ true };
+			for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++) {
+				const uint32_t t{ adjacency[a] * 3 };
+				for (uint32_t k = 0; k < 3; k++) {
+					if (position[result[t + k]] == collapse.from) {
+						wedgeRemap[result[t + k]] = UINT32_MAX;
+					}
+				}
+			}
+			for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++) {
+				const uint32_t t{ adjacency[a] * 3 };
+				for (uint32_t k = 0; k < 3; k++) {
+					for (uint32_t j = 0; j < 3; j++) {
+						if (position[result[t + k]] == collapse.from && position[result[t + j]] == collapse.to) {
+							wedgeRemap[result[t + k]] = result[t + j];
+						}
+					}
+				}
+			}
+			for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1] && mapped; a++) {
+				const uint32_t t{ adjacency[a] * 3 };
+				for (uint32_t k = 0; k < 3; k++) {
+					mapped = mapped && (position[result[t + k]] != collapse.from || wedgeRemap[result[t + k]] != UINT32_MAX);
+				}
+			}
+			if (!mapped) {
+				continue;
+			}
+			for (uint32_t a = offsets[collapse.from]; a < offsets[collapse.from + 1]; a++) {
+				const uint32_t t{ adjacency[a] * 3 };
+				const bool degenerate{ triangleHas(adjacency[a], collapse.to) };
+				for (uint32_t k = 0; k < 3; k++) {
+					locked[position[result[t + k]]] = true;
+					if (position[result[t + k]] == collapse.from) {
+						result[t + k] = wedgeRemap[result[t + k]];
+					}
+				}
+				remaining -= degenerate ? 1 : 0;
+			}
+			quadrics[collapse.to] += quadrics[collapse.from];
+			error = std::max(error, static_cast<float>(std::sqrt(collapse.cost)));
+			collapsed++;
+		}
+		if (collapsed == 0) {
+			break;
+		}
+		// Drop the triangles that collapsed on the position level
+		size_t write{ 0 };
+		for (size_t t = 0; t < result.size(); t += 3) {
+			const uint32_t p0{ position[result[t]] }, p1{ position[result[t + 1]] }, p2{ position[result[t + 2]] };
+			if (p0 != p1 && p1 != p2 && p2 != p0) {
+				std::copy(result.begin() + t, result.begin() + t + 3, result.begin() + write);
+				write += 3;
+			}
+		}
+		result.resize(write);
+	}
+	return result;
+}
+
+// Appends the LODs of the mesh to its indices, the first LOD is the mesh itself. Levels are simplified from the full mesh
+// independently, so they are built in parallel, and reordered for the vertex cache afterwards. Without a job system the
+// levels are built on the calling thread, for callers that already run one mesh per job
+inline std::vector<MeshLod> buildLods(const std::vector<Vertex>& vertices, std::vector<uint32_t>& indices, JobSystem* jobs) {
+	const uint32_t levelCount{ maxLodCount - 1 };
+	std::vector<std::vector<uint32_t>> levels(levelCount);
+	std::vector<float> errors(levelCount, 0.0f);
+	const auto buildLevels = [&](uint32_t begin, uint32_t end, uint32_t) {
+		for (uint32_t i = begin; i < end; i++) {
+			const size_t target{ static_cast<size_t>(indices.size() / 3 * lodRatios[i]) * 3 };
+			levels[i] = simplifyMesh(vertices, indices, target, errors[i]);
+			std::vector<uint32_t> clusters;
+			levels[i] = tipsify(levels[i], vertices.size(), clusters);
+		}
+	};
+	if (jobs) {
+		jobs->parallelFor(levelCount, 1, buildLevels);
+	} else {
+		buildLevels(0, levelCount, 0);
+	}
+	std::vector<MeshLod> lods{ { .firstIndex = 0, .indexCount = static_cast<uint32_t>(indices.size()) } };
+	for (uint32_t i = 0; i < levelCount; i++) {
+		// A level that didn't get below the previous one (e.g. when everything is locked) would never be selected
+		if (levels[i].empty() || levels[i].size() >= lods.back().indexCount) {
+			continue;
+		}
+		// Selection expects the error to grow along the chain
+		lods.push_back({ .firstIndex = static_cast<uint32_t>(indices.size()), .indexCount = static_cast<uint32_t>(levels[i].size()), .error = std::max(errors[i], lods.back().error) });
+		indices.insert(indices.end(), levels[i].begin(), levels[i].end());
+	}
+	return lods;
+}
+
+inline void printLods(const std::vector<MeshLod>& lods) {
+	for (size_t i = 1; i < lods.size(); i++) {
+		std::cout << "LOD " << i << ": " << lods[i].indexCount / 3 << " triangles (" << 100.0 * lods[i].indexCount / lods[0].indexCount << "%), error " << lods[i].error << "\n";
+	}
+}
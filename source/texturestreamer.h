@@ -0,0 +1,259 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Background texture streaming: Worker threads copy mip levels of KTX files from a memory mapped file straight into
+// staging memory. The smallest levels are uploaded first and finer levels follow over later frames. A level becomes
+// visible to shaders (through a per texture minimum LOD) once the upload's timeline value has been reached. Supercompressed
+// KTX 2 levels are decoded by the same workers before they are copied to staging memory.
+
+#pragma once
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <ktx.h>
+#include "mappedfile.h"
+#include "threadpool.h"
+#include "upload.h"
+#include "ktx2.h"
+
+// Minimum LOD of a texture without any resident level, shaders use a constant color instead of sampling it
+constexpr float textureNotResident{ 1000.0f };
+constexpr uint32_t maxStreamedLevels{ 16 };
+// All levels up to this size are streamed with a single upload, they're too small to be worth separate jobs
+constexpr uint32_t streamTailSize{ 64 };
+// Timeline value of levels that couldn't be decoded, they never become resident but don't hold up streaming from completing
+constexpr uint64_t streamLevelFailed{ UINT64_MAX - 1 };
+
+class TextureStreamer {
+public:
+	void create(UploadManager& uploads, uint32_t threadCount = 0) {
+		this->uploads = &uploads;
+		pool.start(threadCount);
+	}
+
+	void destroy() {
+		pool.stop();
+		textures.clear();
+	}
+
+	// Locates the mip levels in the file, the image must have been created with all levels of the KTX texture
+	bool add(const std::string& filename, const ktxTexture* ktxTexture, VkImage image) {
+		auto texture = std::make_unique<StreamedTexture>();
+		if (ktxTexture->numFaces != 1 || ktxTexture->isArray || ktxTexture->numLevels > maxStreamedLevels || !texture->file.open(filename)) {
+			return false;
+		}
+		// KTX 1 layout: 64 byte header and key/value data, followed by a 32 bit image size and the (4 byte padded) image of each level
+		constexpr size_t headerSize{ 64 };
+		const uint8_t* data{ texture->file.data() };
+		const size_t fileSize{ texture->file.size() };
+		if (fileSize < headerSize) {
+			return false;
+		}
+		uint32_t endianness{ 0 };
+		uint32_t keyValueBytes{ 0 };
+		memcpy(&endianness, data + 12, sizeof(uint32_t));
+		memcpy(&keyValueBytes, data + 60, sizeof(uint32_t));
+		// Files with the other byte order would need swapping, which rules out copying them straight to the GPU
+		if (endianness != 0x04030201) {
+			return false;
+		}
+		size_t offset{ headerSize + keyValueBytes };
+		for (uint32_t level = 0; level < ktxTexture->numLevels; level++) {
+			uint32_t imageSize{ 0 };
+			if (offset + sizeof(uint32_t) > fileSize) {
+				return false;
+			}
+			memcpy(&imageSize, data + offset, sizeof(uint32_t));
+			offset += sizeof(uint32_t);
+			if (offset + imageSize > fileSize) {
+				return false;
+			}
+			texture->levels.push_back({ .offset = offset, .size = imageSize, .uncompressedSize = imageSize, .width = std::max(1u, ktxTexture->baseWidth >> level), .height = std::max(1u, ktxTexture->baseHeight >> level) });
+			offset += (imageSize + 3) & ~3u;
+		}
+		texture->image = image;
+		textures.push_back(std::move(texture));
+		return true;
+	}
+
+	// KTX 2 version, the file must have been parsed with parseKtx2 and the image created with all of its levels
+	bool add(const std::string& filename, const Ktx2File& file, VkImage image) {
+		auto texture = std::make_unique<StreamedTexture>();
+		if (file.levels.size() > maxStreamedLevels || !texture->file.open(filename)) {
+			return false;
+		}
+		for (uint32_t level = 0; level < file.levels.size(); level++) {
+			texture->levels.push_back({ .offset = file.levels[level].offset, .size = file.levels[level].size, .uncompressedSize = file.levels[level].uncompressedSize, .width = std::max(1u, file.width >> level), .height = std::max(1u, file.height >> level) });
+		}
+		texture->container = file;
+		texture->image = image;
+		textures.push_back(std::move(texture));
+		return true;
+	}
+
+	// Binds all images with undefined contents and queues the jobs, tails of all textures first and then level by level from coarse to fine
+	void start() {
+		startTime = std::chrono::steady_clock::now();
+		for (auto& texture : textures) {
+			uploads->initializeImage(texture->image, { .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .levelCount = static_cast<uint32_t>(texture->levels.size()), .layerCount = 1 });
+		}
+		// The layout initialization must be submitted before any level is uploaded
+		uploads->flush();
+		uint32_t maxLevel{ 0 };
+		for (auto& texture : textures) {
+			StreamedTexture* ptr{ texture.get() };
+			const uint32_t levelCount{ static_cast<uint32_t>(ptr->levels.size()) };
+			ptr->tailLevel = levelCount - 1;
+			while (ptr->tailLevel > 0 && std::max(ptr->levels[ptr->tailLevel - 1].width, ptr->levels[ptr->tailLevel - 1].height) <= streamTailSize) {
+				ptr->tailLevel--;
+			}
+			pool.enqueue([this, ptr, levelCount] { streamLevels(*ptr, ptr->tailLevel, levelCount - 1); });
+			maxLevel = std::max(maxLevel, ptr->tailLevel);
+		}
+		for (uint32_t level = maxLevel; level-- > 0;) {
+			for (auto& texture : textures) {
+				StreamedTexture* ptr{ texture.get() };
+				if (level < ptr->tailLevel) {
+					pool.enqueue([this, ptr, level] { streamLevels(*ptr, level, level); });
+				}
+			}
+		}
+	}
+
+	// Called once per frame by the thread that owns the graphics queue: Submits what the workers wrote and advances the minimum LOD of all textures
+	void update() {
+		uploads->tryFlush();
+		const uint64_t completed{ uploads->completedValue() };
+		bool allDone{ true };
+		for (auto& texture : textures) {
+			uint32_t resident{ static_cast<uint32_t>(texture->levels.size()) };
+			while (resident > 0 && texture->levelValues[resident - 1].load(std::memory_order_acquire) <= completed) {
+				resident--;
+			}
+			texture->minLod = resident < texture->levels.size() ? static_cast<float>(resident) : textureNotResident;
+			// Levels finer than a failed one are uploaded but stay hidden, sampling can't skip the failed level
+			for (uint32_t level = 0; level < resident && allDone; level++) {
+				const uint64_t value{ texture->levelValues[level].load(std::memory_order_acquire) };
+				allDone = value <= completed || value == streamLevelFailed;
+			}
+		}
+		if (allDone && residentMs < 0.0) {
+			residentMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - startTime).count();
+			const uint32_t failed{ failedLevels.load() };
+			if (failed > 0) {
+				std::cout << "Texture streaming finished after " << residentMs << " ms, " << failed << " levels could not be loaded\n";
+			} else {
+				std::cout << "Textures fully resident after " << residentMs << " ms\n";
+			}
+		}
+	}
+
+	float minLod(size_t index) const { return textures[index]->minLod; }
+	// Time from start until all levels of all textures were uploaded or failed, negative while streaming
+	double fullyResidentMs() const { return residentMs; }
+
+private:
+	struct Level {
+		size_t offset{ 0 };
+		// Size in the file and after supercompression has been undone
+		size_t size{ 0 };
+		size_t uncompressedSize{ 0 };
+		uint32_t width{ 0 };
+		uint32_t height{ 0 };
+	};
+	struct StreamedTexture {
+		MappedFile file;
+		VkImage image{ VK_NULL_HANDLE };
+		std::vector<Level> levels;
+		// Only set for KTX 2 files, used to decode supercompressed levels
+		Ktx2File container;
+		uint32_t tailLevel{ 0 };
+		// Timeline value of the upload of each level, written by the workers
+		std::array<std::atomic<uint64_t>, maxStreamedLevels> levelValues{};
+		float minLod{ textureNotResident };
+		StreamedTexture() {
+			for (auto& value : levelValues) {
+				value = UINT64_MAX;
+			}
+		}
+	};
+
+	UploadManager* uploads{ nullptr };
+	ThreadPool pool;
+	std::vector<std::unique_ptr<StreamedTexture>> textures;
+	std::chrono::steady_clock::time_point startTime;
+	double residentMs{ -1.0 };
+	std::atomic<uint32_t> failedLevels{ 0 };
+
+	void streamLevels(StreamedTexture& texture, uint32_t firstLevel, uint32_t lastLevel) {
+		std::vector<VkBufferImageCopy> regions;
+		VkDeviceSize size{ 0 };
+		for (uint32_t level = firstLevel; level <= lastLevel; level++) {
+			size = (size + 15) & ~VkDeviceSize(15);
+			regions.push_back({
+				.bufferOffset = size,
+				.imageSubresource{.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .mipLevel = level, .layerCount = 1 },
+				.imageExtent{.width = texture.levels[level].width, .height = texture.levels[level].height, .depth = 1 }
+			});
+			size += texture.levels[level].uncompressedSize;
+		}
+		// Touch every page first so the actual disk reads happen here and not while the upload batch is locked
+		const uint8_t* source{ texture.file.data() };
+		// KTX 2 stores the levels from small to large, so the range is taken over all of them
+		size_t sourceBegin{ SIZE_MAX };
+		size_t sourceEnd{ 0 };
+		for (uint32_t level = firstLevel; level <= lastLevel; level++) {
+			sourceBegin = std::min(sourceBegin, texture.levels[level].offset);
+			sourceEnd = std::max(sourceEnd, texture.levels[level].offset + texture.levels[level].size);
+		}
+		for (size_t offset = sourceBegin; offset < sourceEnd; offset += 4096) {
+			(void)*static_cast<const volatile uint8_t*>(source + offset);
+		}
+		// Supercompressed levels are decoded up front with the staging layout, so the batch is only locked for a copy
+		std::vector<uint8_t> decoded;
+		if (texture.container.supercompression != ktx2SupercompressionNone) {
+			decoded.resize(size);
+			for (uint32_t level = firstLevel; level <= lastLevel; level++) {
+				if (!decodeKtx2Level(source, texture.container, level, decoded.data() + regions[level - firstLevel].bufferOffset)) {
+					std::cerr << "Could not decode level " << level << " of a KTX 2 texture\n";
+					// The whole range is dropped, it's uploaded as one batch. Counted first so update() sees the count with the levels
+					failedLevels += lastLevel - firstLevel + 1;
+					for (uint32_t failed = firstLevel; failed <= lastLevel; failed++) {
+						texture.levelValues[failed].store(streamLevelFailed, std::memory_order_release);
+					}
+					return;
+				}
+			}
+		}
+		const auto fill = [&](void* staging) {
+			if (!decoded.empty()) {
+				memcpy(staging, decoded.data(), size);
+				return;
+			}
+			for (uint32_t level = firstLevel; level <= lastLevel; level++) {
+				memcpy(static_cast<uint8_t*>(staging) + regions[level - firstLevel].bufferOffset, source + texture.levels[level].offset, texture.levels[level].size);
+			}
+		};
+		const VkImageSubresourceRange range{ .aspectMask = VK_IMAGE_ASPECT_COLOR_BIT, .baseMipLevel = firstLevel, .levelCount = lastLevel - firstLevel + 1, .layerCount = 1 };
+		uint64_t batchValue{ 0 };
+		while (!uploads->tryUploadImage(texture.image, range, regions, size, fill, batchValue)) {
+			// Ring is full, wait for the render loop to submit and the GPU to finish a batch
+			if (pool.stopRequested()) {
+				return;
+			}
+			uploads->waitForProgress(1000000);
+		}
+		for (uint32_t level = firstLevel; level <= lastLevel; level++) {
+			texture.levelValues[level].store(batchValue, std::memory_order_release);
+		}
+	}
+};
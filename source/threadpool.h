@@ -0,0 +1,84 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Fixed size pool of worker threads that run jobs from a shared FIFO queue
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <atomic>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <algorithm>
+#include <cstdint>
+
+class ThreadPool {
+public:
+	ThreadPool() = default;
+	ThreadPool(const ThreadPool&) = delete;
+	ThreadPool& operator=(const ThreadPool&) = delete;
+	~ThreadPool() { stop(); }
+
+	// A thread count of zero uses all hardware threads but one, which is left to the render loop
+	void start(uint32_t threadCount = 0) {
+		if (threadCount == 0) {
+			threadCount = std::max(1u, std::thread::hardware_concurrency() - 1);
+		}
+		stopping = false;
+		for (uint32_t i = 0; i < threadCount; i++) {
+			threads.emplace_back([this] { run(); });
+		}
+	}
+
+	// Jobs that haven't started yet are dropped, running jobs are finished
+	void stop() {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			stopping = true;
+			jobs.clear();
+		}
+		wake.notify_all();
+		for (auto& thread : threads) {
+			thread.join();
+		}
+		threads.clear();
+	}
+
+	void enqueue(std::function<void()> job) {
+		{
+			std::lock_guard<std::mutex> lock(mutex);
+			jobs.push_back(std::move(job));
+		}
+		wake.notify_one();
+	}
+
+	bool stopRequested() const { return stopping; }
+	uint32_t threadCount() const { return static_cast<uint32_t>(threads.size()); }
+
+private:
+	std::vector<std::thread> threads;
+	std::deque<std::function<void()>> jobs;
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::atomic<bool> stopping{ false };
+
+	void run() {
+		while (true) {
+			std::function<void()> job;
+			{
+				std::unique_lock<std::mutex> lock(mutex);
+				wake.wait(lock, [this] { return stopping || !jobs.empty(); });
+				if (stopping) {
+					return;
+				}
+				job = std::move(jobs.front());
+				jobs.pop_front();
+			}
+			job();
+		}
+	}
+};
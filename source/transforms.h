@@ -0,0 +1,549 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Scene node transforms: Local position, rotation and scale are kept in structure of arrays layout, so a batch of nodes
+// fills SIMD registers with one load per component. Nodes are stored in topological order, a parent always comes before
+// its children, and an update only recomputes the nodes marked dirty and everything below them. World matrices are
+// composed one hierarchy level at a time with AVX2 or SSE, whichever the CPU supports, and their rows are written straight
+// into the instance data that is uploaded to the GPU.
+
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <fstream>
+#include <iostream>
+#include <chrono>
+#include <random>
+#include <cmath>
+#include <algorithm>
+#include <cstring>
+#include <cstdint>
+#include <glm/glm.hpp>
+#include <glm/gtc/matrix_transform.hpp>
+#include <glm/gtc/quaternion.hpp>
+#include "common.h"
+#include "instances.h"
+#include "jobsystem.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define TRANSFORMS_SIMD 1
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+#endif
+
+// MSVC allows AVX2 intrinsics anywhere, GCC and Clang only in functions compiled for it, which are only called if the CPU has it
+#if defined(_MSC_VER) && !defined(__clang__)
+#define TRANSFORMS_AVX2
+#else
+#define TRANSFORMS_AVX2 __attribute__((target("avx2,fma")))
+#endif
+
+enum class TransformKernel { Scalar, Sse, Avx2 };
+
+inline const char* transformKernelName(TransformKernel kernel) {
+	switch (kernel) {
+	case TransformKernel::Avx2:
+		return "avx2";
+	case TransformKernel::Sse:
+		return "sse";
+	default:
+		return "scalar";
+	}
+}
+
+inline TransformKernel bestTransformKernel() {
+#if defined(TRANSFORMS_SIMD)
+#if defined(_MSC_VER) && !defined(__clang__)
+	int info[4];
+	__cpuid(info, 1);
+	const bool fma{ (info[2] & (1 << 12)) != 0 };
+	const bool osxsave{ (info[2] & (1 << 27)) != 0 };
+	__cpuidex(info, 7, 0);
+	const bool avx2{ (info[1] & (1 << 5)) != 0 };
+	// The OS has to save the upper halves of the AVX registers
+	if (avx2 && fma && osxsave && (_xgetbv(0) & 6) == 6) {
+		return TransformKernel::Avx2;
+	}
+#else
+	if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma")) {
+		return TransformKernel::Avx2;
+	}
+#endif
+	// Part of the x86-64 baseline
+	return TransformKernel::Sse;
+#else
+	return TransformKernel::Scalar;
+#endif
+}
+
+class TransformSystem {
+public:
+	static constexpr uint32_t noParent{ UINT32_MAX };
+
+	void reserve(uint32_t nodeCount) {
+		for (auto* component : { &posX, &posY, &posZ, &rotX, &rotY, &rotZ, &rotW, &scaleX, &scaleY, &scaleZ }) {
+			component->reserve(nodeCount);
+		}
+		for (auto& component : world) {
+			component.reserve(nodeCount);
+		}
+		parents.reserve(nodeCount);
+		depths.reserve(nodeCount);
+		dirty.reserve(nodeCount);
+	}
+
+	// Parents have to be added before their children, which keeps the nodes topologically sorted
+	uint32_t add(uint32_t parent, const glm::vec3& position, const glm::quat& rotation = glm::quat(1.0f, 0.0f, 0.0f, 0.0f), const glm::vec3& scale = glm::vec3(1.0f)) {
+		const uint32_t node{ count() };
+		chk(parent == noParent || parent < node);
+		hierarchical |= parent != noParent;
+		parents.push_back(parent);
+		depths.push_back(parent == noParent ? 0 : depths[parent] + 1);
+		posX.push_back(position.x);
+		posY.push_back(position.y);
+		posZ.push_back(position.z);
+		rotX.push_back(rotation.x);
+		rotY.push_back(rotation.y);
+		rotZ.push_back(rotation.z);
+		rotW.push_back(rotation.w);
+		scaleX.push_back(scale.x);
+		scaleY.push_back(scale.y);
+		scaleZ.push_back(scale.z);
+		for (auto& component : world) {
+			component.push_back(0.0f);
+		}
+		dirty.push_back(0);
+		markDirty(node);
+		return node;
+	}
+
+	void setPosition(uint32_t node, const glm::vec3& position) {
+		posX[node] = position.x;
+		posY[node] = position.y;
+		posZ[node] = position.z;
+		markDirty(node);
+	}
+
+	void setRotation(uint32_t node, const glm::quat& rotation) {
+		rotX[node] = rotation.x;
+		rotY[node] = rotation.y;
+		rotZ[node] = rotation.z;
+		rotW[node] = rotation.w;
+		markDirty(node);
+	}
+
+	void setScale(uint32_t node, const glm::vec3& scale) {
+		scaleX[node] = scale.x;
+		scaleY[node] = scale.y;
+		scaleZ[node] = scale.z;
+		markDirty(node);
+	}
+
+	// Forces a full update, e.g. when the rows were written somewhere else
+	void invalidate() {
+		for (uint32_t node = 0; node < count(); node++) {
+			markDirty(node);
+		}
+	}
+
+	uint32_t count() const { return static_cast<uint32_t>(parents.size()); }
+	TransformKernel kernel() const { return activeKernel; }
+
+	// Kernels the CPU doesn't support fall back to the best supported one
+	void setKernel(TransformKernel kernel) {
+		activeKernel = static_cast<TransformKernel>(std::min(static_cast<int>(kernel), static_cast<int>(bestTransformKernel())));
+	}
+
+	// Row of the world matrix, valid after the node's last update
+	glm::vec4 worldRow(uint32_t node, uint32_t row) const {
+		return glm::vec4(world[row * 4][node], world[row * 4 + 1][node], world[row * 4 + 2][node], world[row * 4 + 3][node]);
+	}
+
+	// Recomputes the world matrices of all dirty nodes and their descendants and writes the three rows of each as
+	// consecutive vec4s to rows + node * stride bytes. Levels with many dirty nodes are split across the job system's
+	// threads. Returns the nodes that were written, ordered by level and index
+	const std::vector<uint32_t>& update(void* rows, size_t stride, JobSystem* jobs = nullptr) {
+		updated.clear();
+		if (firstDirty == noParent) {
+			return updated;
+		}
+		for (auto& level : levels) {
+			level.clear();
+		}
+		if (!hierarchical) {
+			// Without children only the marked nodes change, which saves the pass over all nodes
+			levels.resize(1);
+			levels[0].swap(dirtyNodes);
+			if (!std::is_sorted(levels[0].begin(), levels[0].end())) {
+				std::sort(levels[0].begin(), levels[0].end());
+			}
+		}
+		// Dirty flags are pushed down in one pass, a parent is always visited before its children
+		for (uint32_t node = firstDirty; hierarchical && node < count(); node++) {
+			if (!dirty[node] && (parents[node] == noParent || !dirty[parents[node]])) {
+				continue;
+			}
+			dirty[node] = 1;
+			if (levels.size() <= depths[node]) {
+				levels.resize(depths[node] + 1);
+			}
+			levels[depths[node]].push_back(node);
+		}
+		// Nodes within a level don't depend on each other, their parents are all done
+		uint8_t* destination{ static_cast<uint8_t*>(rows) };
+		for (auto& level : levels) {
+			const auto compose = [&](uint32_t begin, uint32_t end, uint32_t) {
+				composeRange(level.data() + begin, end - begin, destination, stride);
+			};
+			const uint32_t levelCount{ static_cast<uint32_t>(level.size()) };
+			if (jobs != nullptr && jobs->threadCount() > 1 && levelCount >= parallelThreshold) {
+				jobs->parallelFor(levelCount, parallelBatchSize, compose);
+			} else {
+				compose(0, levelCount, 0);
+			}
+			updated.insert(updated.end(), level.begin(), level.end());
+		}
+		for (uint32_t node : updated) {
+			dirty[node] = 0;
+		}
+		dirtyNodes.clear();
+		firstDirty = noParent;
+		return updated;
+	}
+
+private:
+	// Below this many dirty nodes per level the job system's overhead outweighs the gain, batches are a multiple of the SIMD width
+	static constexpr uint32_t parallelThreshold{ 16384 };
+	static constexpr uint32_t parallelBatchSize{ 4096 };
+	TransformKernel activeKernel{ bestTransformKernel() };
+	// Local transforms, one array per component
+	std::vector<float> posX, posY, posZ;
+	std::vector<float> rotX, rotY, rotZ, rotW;
+	std::vector<float> scaleX, scaleY, scaleZ;
+	// World matrices as 3x4 rows, one array per element, read back by the children
+	std::array<std::vector<float>, 12> world;
+	std::vector<uint32_t> parents;
+	std::vector<uint32_t> depths;
+	std::vector<uint8_t> dirty;
+	uint32_t firstDirty{ noParent };
+	// Nodes marked since the last update, only used while no node has a parent
+	std::vector<uint32_t> dirtyNodes;
+	bool hierarchical{ false };
+	// Dirty nodes per hierarchy level, reused between updates
+	std::vector<std::vector<uint32_t>> levels;
+	std::vector<uint32_t> updated;
+
+	void markDirty(uint32_t node) {
+		if (dirty[node]) {
+			return;
+		}
+		dirty[node] = 1;
+		firstDirty = std::min(firstDirty, node);
+		if (!hierarchical) {
+			dirtyNodes.push_back(node);
+		}
+	}
+
+	void composeRange(const uint32_t* nodes, uint32_t nodeCount, uint8_t* rows, size_t stride) {
+		uint32_t done{ 0 };
+#if defined(TRANSFORMS_SIMD)
+		if (activeKernel == TransformKernel::Avx2) {
+			done = composeAvx2(nodes, nodeCount, rows, stride);
+		} else if (activeKernel == TransformKernel::Sse) {
+			done = composeSse(nodes, nodeCount, rows, stride);
+		}
+#endif
+		for (uint32_t i = done; i < nodeCount; i++) {
+			composeScalar(nodes[i], rows, stride);
+		}
+	}
+
+	// Reference for the SIMD kernels, also handles the nodes left over at the end of a batch
+	void composeScalar(uint32_t node, uint8_t* rows, size_t stride) {
+		const float x{ rotX[node] }, y{ rotY[node] }, z{ rotZ[node] }, w{ rotW[node] };
+		const float local[12]{
+			(1.0f - 2.0f * (y * y + z * z)) * scaleX[node], 2.0f * (x * y - w * z) * scaleY[node], 2.0f * (x * z + w * y) * scaleZ[node], posX[node],
+			2.0f * (x * y + w * z) * scaleX[node], (1.0f - 2.0f * (x * x + z * z)) * scaleY[node], 2.0f * (y * z - w * x) * scaleZ[node], posY[node],
+			2.0f * (x * z - w * y) * scaleX[node], 2.0f * (y * z + w * x) * scaleY[node], (1.0f - 2.0f * (x * x + y * y)) * scaleZ[node], posZ[node]
+		};
+		float result[12];
+		const uint32_t parent{ parents[node] };
+		for (uint32_t row = 0; row < 3; row++) {
+			for (uint32_t column = 0; column < 4; column++) {
+				if (parent == noParent) {
+					result[row * 4 + column] = local[row * 4 + column];
+					continue;
+				}
+				result[row * 4 + column] = world[row * 4][parent] * local[column] + world[row * 4 + 1][parent] * local[4 + column] + world[row * 4 + 2][parent] * local[8 + column] + (column == 3 ? world[row * 4 + 3][parent] : 0.0f);
+			}
+		}
+		for (uint32_t i = 0; i < 12; i++) {
+			world[i][node] = result[i];
+		}
+		memcpy(rows + node * stride, result, sizeof(result));
+	}
+
+#if defined(TRANSFORMS_SIMD)
+	// Four nodes per iteration, their rows are transposed from the lanes into the output
+	uint32_t composeSse(const uint32_t* nodes, uint32_t nodeCount, uint8_t* rows, size_t stride) {
+		const uint32_t end{ nodeCount & ~3u };
+		for (uint32_t i = 0; i < end; i += 4) {
+			const uint32_t* lanes{ nodes + i };
+			// Level lists are sorted, so nodes that are next to each other can be loaded directly instead of lane by lane
+			const bool contiguous{ lanes[3] - lanes[0] == 3 };
+			const auto load = [&](const std::vector<float>& component) {
+				return contiguous ? _mm_loadu_ps(&component[lanes[0]]) : _mm_setr_ps(component[lanes[0]], component[lanes[1]], component[lanes[2]], component[lanes[3]]);
+			};
+			const __m128 x{ load(rotX) }, y{ load(rotY) }, z{ load(rotZ) }, w{ load(rotW) };
+			const __m128 sx{ load(scaleX) }, sy{ load(scaleY) }, sz{ load(scaleZ) };
+			const __m128 one{ _mm_set1_ps(1.0f) };
+			const __m128 x2{ _mm_add_ps(x, x) }, y2{ _mm_add_ps(y, y) }, z2{ _mm_add_ps(z, z) };
+			const __m128 xx{ _mm_mul_ps(x, x2) }, yy{ _mm_mul_ps(y, y2) }, zz{ _mm_mul_ps(z, z2) };
+			const __m128 xy{ _mm_mul_ps(x, y2) }, xz{ _mm_mul_ps(x, z2) }, yz{ _mm_mul_ps(y, z2) };
+			const __m128 wx{ _mm_mul_ps(w, x2) }, wy{ _mm_mul_ps(w, y2) }, wz{ _mm_mul_ps(w, z2) };
+			__m128 m[12]{
+				_mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(yy, zz)), sx), _mm_mul_ps(_mm_sub_ps(xy, wz), sy), _mm_mul_ps(_mm_add_ps(xz, wy), sz), load(posX),
+				_mm_mul_ps(_mm_add_ps(xy, wz), sx), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, zz)), sy), _mm_mul_ps(_mm_sub_ps(yz, wx), sz), load(posY),
+				_mm_mul_ps(_mm_sub_ps(xz, wy), sx), _mm_mul_ps(_mm_add_ps(yz, wx), sy), _mm_mul_ps(_mm_sub_ps(one, _mm_add_ps(xx, yy)), sz), load(posZ)
+			};
+			// All nodes of a level either have a parent or none
+			const uint32_t parent{ parents[lanes[0]] };
+			if (parent != noParent) {
+				const uint32_t p[4]{ parents[lanes[0]], parents[lanes[1]], parents[lanes[2]], parents[lanes[3]] };
+				const __m128 local[12]{ m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8], m[9], m[10], m[11] };
+				for (uint32_t row = 0; row < 3; row++) {
+					const __m128 p0{ _mm_setr_ps(world[row * 4][p[0]], world[row * 4][p[1]], world[row * 4][p[2]], world[row * 4][p[3]]) };
+					const __m128 p1{ _mm_setr_ps(world[row * 4 + 1][p[0]], world[row * 4 + 1][p[1]], world[row * 4 + 1][p[2]], world[row * 4 + 1][p[3]]) };
+					const __m128 p2{ _mm_setr_ps(world[row * 4 + 2][p[0]], world[row * 4 + 2][p[1]], world[row * 4 + 2][p[2]], world[row * 4 + 2][p[3]]) };
+					const __m128 p3{ _mm_setr_ps(world[row * 4 + 3][p[0]], world[row * 4 + 3][p[1]], world[row * 4 + 3][p[2]], world[row * 4 + 3][p[3]]) };
+					for (uint32_t column = 0; column < 4; column++) {
+						__m128 value{ _mm_add_ps(_mm_add_ps(_mm_mul_ps(p0, local[column]), _mm_mul_ps(p1, local[4 + column])), _mm_mul_ps(p2, local[8 + column])) };
+						m[row * 4 + column] = column == 3 ? _mm_add_ps(value, p3) : value;
+					}
+				}
+			}
+			for (uint32_t element = 0; element < 12; element++) {
+				if (contiguous) {
+					_mm_storeu_ps(&world[element][lanes[0]], m[element]);
+					continue;
+				}
+				alignas(16) float values[4];
+				_mm_store_ps(values, m[element]);
+				for (uint32_t lane = 0; lane < 4; lane++) {
+					world[element][lanes[lane]] = values[lane];
+				}
+			}
+			for (uint32_t row = 0; row < 3; row++) {
+				__m128 r0{ m[row * 4] }, r1{ m[row * 4 + 1] }, r2{ m[row * 4 + 2] }, r3{ m[row * 4 + 3] };
+				_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+				_mm_storeu_ps(reinterpret_cast<float*>(rows + lanes[0] * stride) + row * 4, r0);
+				_mm_storeu_ps(reinterpret_cast<float*>(rows + lanes[1] * stride) + row * 4, r1);
+				_mm_storeu_ps(reinterpret_cast<float*>(rows + lanes[2] * stride) + row * 4, r2);
+				_mm_storeu_ps(reinterpret_cast<float*>(rows + lanes[3] * stride) + row * 4, r3);
+			}
+		}
+		return end;
+	}
+
+	// Same as the SSE kernel with eight nodes per iteration, gathers for scattered nodes and parents, and fused multiply adds
+	TRANSFORMS_AVX2 uint32_t composeAvx2(const uint32_t* nodes, uint32_t nodeCount, uint8_t* rows, size_t stride) {
+		const uint32_t end{ nodeCount & ~7u };
+		const __m256 one{ _mm256_set1_ps(1.0f) };
+		for (uint32_t i = 0; i < end; i += 8) {
+			const uint32_t* lanes{ nodes + i };
+			const bool contiguous{ lanes[7] - lanes[0] == 7 };
+			const __m256i index{ _mm256_loadu_si256(reinterpret_cast<const __m256i*>(lanes)) };
+			const __m256 x{ load8(rotX, lanes[0], index, contiguous) }, y{ load8(rotY, lanes[0], index, contiguous) }, z{ load8(rotZ, lanes[0], index, contiguous) }, w{ load8(rotW, lanes[0], index, contiguous) };
+			const __m256 sx{ load8(scaleX, lanes[0], index, contiguous) }, sy{ load8(scaleY, lanes[0], index, contiguous) }, sz{ load8(scaleZ, lanes[0], index, contiguous) };
+			const __m256 x2{ _mm256_add_ps(x, x) }, y2{ _mm256_add_ps(y, y) }, z2{ _mm256_add_ps(z, z) };
+			const __m256 xx{ _mm256_mul_ps(x, x2) }, yy{ _mm256_mul_ps(y, y2) }, zz{ _mm256_mul_ps(z, z2) };
+			const __m256 xy{ _mm256_mul_ps(x, y2) }, xz{ _mm256_mul_ps(x, z2) }, yz{ _mm256_mul_ps(y, z2) };
+			const __m256 wx{ _mm256_mul_ps(w, x2) }, wy{ _mm256_mul_ps(w, y2) }, wz{ _mm256_mul_ps(w, z2) };
+			__m256 m[12]{
+				_mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(yy, zz)), sx), _mm256_mul_ps(_mm256_sub_ps(xy, wz), sy), _mm256_mul_ps(_mm256_add_ps(xz, wy), sz), load8(posX, lanes[0], index, contiguous),
+				_mm256_mul_ps(_mm256_add_ps(xy, wz), sx), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, zz)), sy), _mm256_mul_ps(_mm256_sub_ps(yz, wx), sz), load8(posY, lanes[0], index, contiguous),
+				_mm256_mul_ps(_mm256_sub_ps(xz, wy), sx), _mm256_mul_ps(_mm256_add_ps(yz, wx), sy), _mm256_mul_ps(_mm256_sub_ps(one, _mm256_add_ps(xx, yy)), sz), load8(posZ, lanes[0], index, contiguous)
+			};
+			if (parents[lanes[0]] != noParent) {
+				const __m256i parentIndex{ _mm256_i32gather_epi32(reinterpret_cast<const int*>(parents.data()), index, 4) };
+				const __m256 local[12]{ m[0], m[1], m[2], m[3], m[4], m[5], m[6], m[7], m[8], m[9], m[10], m[11] };
+				for (uint32_t row = 0; row < 3; row++) {
+					const __m256 p0{ _mm256_i32gather_ps(world[row * 4].data(), parentIndex, 4) };
+					const __m256 p1{ _mm256_i32gather_ps(world[row * 4 + 1].data(), parentIndex, 4) };
+					const __m256 p2{ _mm256_i32gather_ps(world[row * 4 + 2].data(), parentIndex, 4) };
+					const __m256 p3{ _mm256_i32gather_ps(world[row * 4 + 3].data(), parentIndex, 4) };
+					for (uint32_t column = 0; column < 4; column++) {
+						const __m256 value{ _mm256_fmadd_ps(p2, local[8 + column], _mm256_fmadd_ps(p1, local[4 + column], _mm256_mul_ps(p0, local[column]))) };
+						m[row * 4 + column] = column == 3 ? _mm256_add_ps(value, p3) : value;
+					}
+				}
+			}
+			for (uint32_t element = 0; element < 12; element++) {
+				if (contiguous) {
+					_mm256_storeu_ps(&world[element][lanes[0]], m[element]);
+					continue;
+				}
+				alignas(32) float values[8];
+				_mm256_store_ps(values, m[element]);
+				for (uint32_t lane = 0; lane < 8; lane++) {
+					world[element][lanes[lane]] = values[lane];
+				}
+			}
+			// Each half of the lanes is transposed on its own, which turns four element vectors into the rows of four nodes
+			for (uint32_t row = 0; row < 3; row++) {
+				for (uint32_t half = 0; half < 2; half++) {
+					__m128 r0{ half == 0 ? _mm256_castps256_ps128(m[row * 4]) : _mm256_extractf128_ps(m[row * 4], 1) };
+					__m128 r1{ half == 0 ? _mm256_castps256_ps128(m[row * 4 + 1]) : _mm256_extractf128_ps(m[row * 4 + 1], 1) };
+					__m128 r2{ half == 0 ? _mm256_castps256_ps128(m[row * 4 + 2]) : _mm256_extractf128_ps(m[row * 4 + 2], 1) };
+					__m128 r3{ half == 0 ? _mm256_castps256_ps128(m[row * 4 + 3]) : _mm256_extractf128_ps(m[row * 4 + 3], 1) };
+					_MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+					const uint32_t* quad{ lanes + half * 4 };
+					_mm_storeu_ps(reinterpret_cast<float*>(rows + quad[0] * stride) + row * 4, r0);
+					_mm_storeu_ps(reinterpret_cast<float*>(rows + quad[1] * stride) + row * 4, r1);
+					_mm_storeu_ps(reinterpret_cast<float*>(rows + quad[2] * stride) + row * 4, r2);
+					_mm_storeu_ps(reinterpret_cast<float*>(rows + quad[3] * stride) + row * 4, r3);
+				}
+			}
+		}
+		return end;
+	}
+
+	static TRANSFORMS_AVX2 inline __m256 load8(const std::vector<float>& component, uint32_t first, __m256i index, bool contiguous) {
+		return contiguous ? _mm256_loadu_ps(&component[first]) : _mm256_i32gather_ps(component.data(), index, 4);
+	}
+#endif
+};
+
+// Compares the per instance glm path (Euler angles to quaternion to matrix, every instance every frame) against the transform
+// system's kernels, with all nodes dirty, with a few of them dirty, and with a three level hierarchy. Returns false if a
+// kernel's result differs from glm by more than rounding
+inline bool benchmarkTransforms(uint32_t nodeCount, const std::string& outputPath) {
+	using Clock = std::chrono::steady_clock;
+	constexpr uint32_t iterations{ 20 };
+	// Positions are within a few units, the hierarchy multiplies up to three matrices
+	constexpr float maxAllowedError{ 1e-4f };
+	bool matches{ true };
+	std::mt19937 random{ 1 };
+	std::uniform_real_distribution<float> distribution{ -3.0f, 3.0f };
+	std::vector<glm::vec3> positions(nodeCount);
+	std::vector<glm::vec3> rotations(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		positions[i] = glm::vec3(distribution(random), distribution(random), distribution(random));
+		rotations[i] = glm::vec3(distribution(random), distribution(random), distribution(random));
+	}
+	std::vector<InstanceData> instances(nodeCount);
+	const auto timeMs = [&](const auto& func) {
+		func();
+		const auto start = Clock::now();
+		for (uint32_t i = 0; i < iterations; i++) {
+			func();
+		}
+		return std::chrono::duration<double, std::milli>(Clock::now() - start).count() / iterations;
+	};
+	const double glmMs{ timeMs([&]() {
+		for (uint32_t i = 0; i < nodeCount; i++) {
+			setTransform(instances[i], glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(glm::quat(rotations[i])));
+		}
+	}) };
+	const std::vector<InstanceData> reference{ instances };
+	// Largest difference to the glm result over all rows, the kernels only differ in rounding
+	const auto maxError = [&]() {
+		float error{ 0.0f };
+		for (uint32_t i = 0; i < nodeCount; i++) {
+			for (uint32_t row = 0; row < 3; row++) {
+				for (uint32_t column = 0; column < 4; column++) {
+					error = std::max(error, std::abs(instances[i].transform[row][column] - reference[i].transform[row][column]));
+				}
+			}
+		}
+		return error;
+	};
+	TransformSystem transforms;
+	transforms.reserve(nodeCount);
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		transforms.add(TransformSystem::noParent, positions[i], glm::quat(rotations[i]));
+	}
+	JobSystem jobs;
+	jobs.start();
+	std::ofstream out(outputPath);
+	out << "{\n\t\"nodes\": " << nodeCount << ",\n\t\"glmMs\": " << glmMs << ",\n\t\"kernels\": [\n";
+	std::cout << "Transform benchmark, " << nodeCount << " nodes\n" << "  glm: " << glmMs << " ms\n";
+	std::vector<std::pair<TransformKernel, JobSystem*>> runs{ { TransformKernel::Scalar, nullptr } };
+	if (bestTransformKernel() >= TransformKernel::Sse) {
+		runs.push_back({ TransformKernel::Sse, nullptr });
+	}
+	if (bestTransformKernel() >= TransformKernel::Avx2) {
+		runs.push_back({ TransformKernel::Avx2, nullptr });
+	}
+	runs.push_back({ bestTransformKernel(), &jobs });
+	for (size_t run = 0; run < runs.size(); run++) {
+		transforms.setKernel(runs[run].first);
+		std::fill(instances.begin(), instances.end(), InstanceData{});
+		const double ms{ timeMs([&]() {
+			transforms.invalidate();
+			transforms.update(instances[0].transform, sizeof(InstanceData), runs[run].second);
+		}) };
+		const uint32_t threads{ runs[run].second != nullptr ? jobs.threadCount() : 1 };
+		const float error{ maxError() };
+		if (error > maxAllowedError) {
+			std::cerr << "Transform kernel " << transformKernelName(runs[run].first) << " differs from glm by " << error << "\n";
+			matches = false;
+		}
+		std::cout << "  " << transformKernelName(runs[run].first) << ", " << threads << " thread(s): " << ms << " ms (" << glmMs / ms << "x), max error " << error << "\n";
+		out << "\t\t{ \"kernel\": \"" << transformKernelName(runs[run].first) << "\", \"threads\": " << threads << ", \"ms\": " << ms << ", \"speedup\": " << glmMs / ms << ", \"maxError\": " << error << " }" << (run + 1 == runs.size() ? "\n" : ",\n");
+	}
+	out << "\t],\n";
+	// Only a few nodes move, the glm path would still rebuild every matrix
+	transforms.setKernel(bestTransformKernel());
+	const uint32_t dirtyCount{ std::max(1u, nodeCount / 100) };
+	const uint32_t dirtyStride{ nodeCount / dirtyCount };
+	const double partialMs{ timeMs([&]() {
+		for (uint32_t i = 0; i < dirtyCount; i++) {
+			transforms.setRotation(i * dirtyStride, glm::quat(rotations[i * dirtyStride]));
+		}
+		transforms.update(instances[0].transform, sizeof(InstanceData), &jobs);
+	}) };
+	std::cout << "  " << dirtyCount << " dirty nodes: " << partialMs << " ms (" << glmMs / partialMs << "x)\n";
+	out << "\t\"partial\": { \"dirtyNodes\": " << dirtyCount << ", \"ms\": " << partialMs << ", \"speedup\": " << glmMs / partialMs << " },\n";
+	// Roots with children with children, the glm reference multiplies the parent's full matrix
+	TransformSystem hierarchy;
+	hierarchy.reserve(nodeCount);
+	std::vector<glm::mat4> worlds(nodeCount);
+	constexpr uint32_t branching{ 8 };
+	const uint32_t rootCount{ std::max(1u, nodeCount / (1 + branching + branching * branching)) };
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		// Roots first, then their children, then the grandchildren
+		const uint32_t parent{ i < rootCount ? TransformSystem::noParent : (i - rootCount) / branching };
+		hierarchy.add(parent, positions[i], glm::quat(rotations[i]));
+		const glm::mat4 local{ glm::translate(glm::mat4(1.0f), positions[i]) * glm::mat4_cast(glm::quat(rotations[i])) };
+		worlds[i] = parent == TransformSystem::noParent ? local : worlds[parent] * local;
+	}
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		setTransform(instances[i], worlds[i]);
+	}
+	const std::vector<InstanceData> hierarchyReference{ instances };
+	const double hierarchyMs{ timeMs([&]() {
+		hierarchy.invalidate();
+		hierarchy.update(instances[0].transform, sizeof(InstanceData), &jobs);
+	}) };
+	float hierarchyError{ 0.0f };
+	for (uint32_t i = 0; i < nodeCount; i++) {
+		for (uint32_t row = 0; row < 3; row++) {
+			for (uint32_t column = 0; column < 4; column++) {
+				hierarchyError = std::max(hierarchyError, std::abs(instances[i].transform[row][column] - hierarchyReference[i].transform[row][column]));
+			}
+		}
+	}
+	if (hierarchyError > maxAllowedError) {
+		std::cerr << "Transform hierarchy differs from glm by " << hierarchyError << "\n";
+		matches = false;
+	}
+	std::cout << "  hierarchy, " << rootCount << " roots: " << hierarchyMs << " ms, max error " << hierarchyError << "\n";
+	out << "\t\"hierarchy\": { \"roots\": " << rootCount << ", \"ms\": " << hierarchyMs << ", \"maxError\": " << hierarchyError << " }\n}\n";
+	return matches;
+}
@@ -0,0 +1,50 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Lock-free triple buffer for handing snapshots from one producer thread to one consumer thread. The producer fills its
+// back slot and publishes it by swapping it with the middle slot, the consumer picks up the middle slot by swapping it with
+// its front slot. Neither side ever waits for the other, a snapshot published before the previous one was consumed
+// replaces it, so the consumer always sees the latest one.
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+template<typename T>
+class TripleBuffer {
+public:
+	// Producer side: slot to write the next snapshot into, it stays untouched by the consumer until published
+	T& back() { return slots[backIndex]; }
+
+	// Returns false if the previously published snapshot was replaced before the consumer picked it up
+	bool publish() {
+		const uint32_t previous{ middle.exchange(backIndex | freshBit, std::memory_order_acq_rel) };
+		backIndex = previous & indexMask;
+		return (previous & freshBit) == 0;
+	}
+
+	// Consumer side: switches to the latest published snapshot, returns false if nothing was published since the last call
+	bool consume() {
+		if ((middle.load(std::memory_order_acquire) & freshBit) == 0) {
+			return false;
+		}
+		const uint32_t previous{ middle.exchange(frontIndex, std::memory_order_acq_rel) };
+		frontIndex = previous & indexMask;
+		return true;
+	}
+
+	const T& front() const { return slots[frontIndex]; }
+
+private:
+	static constexpr uint32_t indexMask{ 3 };
+	// Set on the middle slot index while it holds a snapshot the consumer hasn't seen yet
+	static constexpr uint32_t freshBit{ 4 };
+	std::array<T, 3> slots{};
+	// Only ever touched by their own thread, kept apart from the shared index so they don't share a cache line with it
+	alignas(64) uint32_t backIndex{ 0 };
+	alignas(64) std::atomic<uint32_t> middle{ 1 };
+	alignas(64) uint32_t frontIndex{ 2 };
+};
@@ -0,0 +1,480 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Batched GPU uploads: Data is written to a persistently mapped staging ring, copies are coalesced into a single
+// command buffer per batch and completion is tracked with a timeline semaphore so ring space is reused as soon as
+// the GPU is done with it. If a dedicated transfer queue is used, ownership of the destination resources is
+// released on the transfer queue and acquired on the graphics queue.
+// All public functions are thread safe, but only the thread that owns the graphics queue may call the ones that
+// submit (flush, tryFlush and the blocking uploads, which flush if the ring is full).
+
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <span>
+#include <cstring>
+#include <algorithm>
+#include <mutex>
+#include <volk.h>
+#include <vk_mem_alloc.h>
+#include "common.h"
+
+class UploadManager {
+public:
+	void create(VkDevice device, VmaAllocator allocator, VkQueue graphicsQueue, uint32_t graphicsFamily, VkQueue transferQueue, uint32_t transferFamily, VkDeviceSize ringSize = 64 * 1024 * 1024) {
+		this->device = device;
+		this->allocator = allocator;
+		this->graphicsQueue = graphicsQueue;
+		this->graphicsFamily = graphicsFamily;
+		this->transferQueue = transferQueue;
+		this->transferFamily = transferFamily;
+		this->ringSize = ringSize;
+		VkBufferCreateInfo ringCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = ringSize, .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT };
+		VmaAllocationCreateInfo ringAllocCI{ .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST };
+		VmaAllocationInfo ringAllocInfo{};
+		chk(vmaCreateBuffer(allocator, &ringCI, &ringAllocCI, &ringBuffer, &ringAllocation, &ringAllocInfo));
+		ringMapped = static_cast<uint8_t*>(ringAllocInfo.pMappedData);
+		VkSemaphoreTypeCreateInfo timelineCI{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_TYPE_CREATE_INFO, .semaphoreType = VK_SEMAPHORE_TYPE_TIMELINE, .initialValue = 0 };
+		VkSemaphoreCreateInfo semaphoreCI{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO, .pNext = &timelineCI };
+		chk(vkCreateSemaphore(device, &semaphoreCI, nullptr, &timeline));
+		VkCommandPoolCreateInfo poolCI{ .sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO, .flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT, .queueFamilyIndex = transferFamily };
+		chk(vkCreateCommandPool(device, &poolCI, nullptr, &transferPool));
+		if (ownershipTransfer()) {
+			poolCI.queueFamilyIndex = graphicsFamily;
+			chk(vkCreateCommandPool(device, &poolCI, nullptr, &graphicsPool));
+		}
+	}
+
+	void destroy() {
+		std::lock_guard<std::mutex> lock(mutex);
+		wait(timelineValue);
+		reclaim();
+		vkDestroyCommandPool(device, transferPool, nullptr);
+		if (graphicsPool != VK_NULL_HANDLE) {
+			vkDestroyCommandPool(device, graphicsPool, nullptr);
+		}
+		vkDestroySemaphore(device, timeline, nullptr);
+		vmaDestroyBuffer(allocator, ringBuffer, ringAllocation);
+	}
+
+	// True if uploads run on a queue from a different family than rendering
+	bool ownershipTransfer() const { return transferFamily != graphicsFamily; }
+	// The staging ring, for memory accounting
+	VmaAllocation ringMemory() const { return ringAllocation; }
+
+	// Returns staging memory for the caller to fill, the copy to the buffer is recorded into the current batch
+	void* uploadBuffer(VkBuffer buffer, VkDeviceSize dstOffset, VkDeviceSize size, VkPipelineStageFlags2 dstStage = VK_PIPELINE_STAGE_2_VERTEX_ATTRIBUTE_INPUT_BIT | VK_PIPELINE_STAGE_2_INDEX_INPUT_BIT, VkAccessFlags2 dstAccess = VK_ACCESS_2_VERTEX_ATTRIBUTE_READ_BIT | VK_ACCESS_2_INDEX_READ_BIT) {
+		std::lock_guard<std::mutex> lock(mutex);
+		const Staging staging{ allocateStaging(size) };
+		BufferCopies* copies{ nullptr };
+		for (auto& entry : pending.bufferCopies) {
+			if (entry.src == staging.buffer && entry.dst == buffer) {
+				copies = &entry;
+				break;
+			}
+		}
+		if (copies == nullptr) {
+			copies = &pending.bufferCopies.emplace_back(BufferCopies{ .src = staging.buffer, .dst = buffer });
+		}
+		copies->regions.push_back({ .srcOffset = staging.offset, .dstOffset = dstOffset, .size = size });
+		copies->dstStage |= dstStage;
+		copies->dstAccess |= dstAccess;
+		return staging.data;
+	}
+
+	// Same for images, the buffer offsets of the regions are relative to the returned staging memory
+	// The subresource range is transitioned from undefined and ends up in VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL
+	void* uploadImage(VkImage image, const VkImageSubresourceRange& range, std::span<const VkBufferImageCopy> regions, VkDeviceSize size, VkPipelineStageFlags2 dstStage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VkAccessFlags2 dstAccess = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT) {
+		std::lock_guard<std::mutex> lock(mutex);
+		const Staging staging{ allocateStaging(size) };
+		addImageCopies(staging, image, range, regions, dstStage, dstAccess);
+		return staging.data;
+	}
+
+	// Non-blocking variant for worker threads: Returns false instead of flushing or waiting if the ring is full.
+	// fill is called with the staging memory while the batch is locked, so the copy can't be submitted before it's written.
+	// batchValue receives the timeline value that signals completion of the copy.
+	template <typename Fill>
+	bool tryUploadImage(VkImage image, const VkImageSubresourceRange& range, std::span<const VkBufferImageCopy> regions, VkDeviceSize size, Fill&& fill, uint64_t& batchValue, VkPipelineStageFlags2 dstStage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VkAccessFlags2 dstAccess = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT) {
+		std::lock_guard<std::mutex> lock(mutex);
+		Staging staging{};
+		if (!tryAllocateStaging(size, staging)) {
+			return false;
+		}
+		fill(staging.data);
+		addImageCopies(staging, image, range, regions, dstStage, dstAccess);
+		batchValue = pendingValue();
+		return true;
+	}
+
+	// Transitions the subresource range from undefined to VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL without uploading anything,
+	// so an image can be bound before all of its contents have arrived
+	void initializeImage(VkImage image, const VkImageSubresourceRange& range, VkPipelineStageFlags2 dstStage = VK_PIPELINE_STAGE_2_FRAGMENT_SHADER_BIT, VkAccessFlags2 dstAccess = VK_ACCESS_2_SHADER_SAMPLED_READ_BIT) {
+		std::lock_guard<std::mutex> lock(mutex);
+		pending.imageInits.push_back({ .image = image, .range = range, .dstStage = dstStage, .dstAccess = dstAccess });
+	}
+
+	// Submits all pending copies as one batch, returns the timeline value signaled once they're visible to the graphics queue
+	uint64_t flush() {
+		std::lock_guard<std::mutex> lock(mutex);
+		return submitPending();
+	}
+
+	// Same, but returns false without blocking if a worker thread is currently writing to the batch
+	bool tryFlush() {
+		std::unique_lock<std::mutex> lock(mutex, std::try_to_lock);
+		if (!lock.owns_lock()) {
+			return false;
+		}
+		submitPending();
+		return true;
+	}
+
+	uint64_t completedValue() const {
+		uint64_t value{ 0 };
+		chk(vkGetSemaphoreCounterValue(device, timeline, &value));
+		return value;
+	}
+
+	void wait(uint64_t value) const {
+		VkSemaphoreWaitInfo waitInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, .semaphoreCount = 1, .pSemaphores = &timeline, .pValues = &value };
+		chk(vkWaitSemaphores(device, &waitInfo, UINT64_MAX));
+	}
+
+	// Waits until a batch finishes or the timeout (in nanoseconds) elapses, used by workers that ran out of ring space
+	void waitForProgress(uint64_t timeout) const {
+		const uint64_t value{ completedValue() + 1 };
+		VkSemaphoreWaitInfo waitInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_WAIT_INFO, .semaphoreCount = 1, .pSemaphores = &timeline, .pValues = &value };
+		vkWaitSemaphores(device, &waitInfo, timeout);
+	}
+
+	VkSemaphore timelineSemaphore() const { return timeline; }
+
+private:
+	// Records and submits the pending batch, the mutex must be held
+	uint64_t submitPending() {
+		if (pending.bufferCopies.empty() && pending.imageCopies.empty() && pending.imageInits.empty()) {
+			return timelineValue;
+		}
+		Batch batch{ .ringBegin = pending.ringBegin, .usesRing = pending.usesRing, .dedicatedStaging = std::move(pending.dedicatedStaging) };
+		batch.transferCb = getCommandBuffer(transferPool, freeTransferCbs);
+		VkCommandBufferBeginInfo cbBI{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO, .flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT };
+		chk(vkBeginCommandBuffer(batch.transferCb, &cbBI));
+		// All images go to transfer dst with a single barrier call
+		std::vector<VkImageMemoryBarrier2> imageBarriers;
+		std::vector<VkBufferMemoryBarrier2> bufferBarriers;
+		for (auto& copies : pending.imageCopies) {
+			imageBarriers.push_back({
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+				.srcAccessMask = VK_ACCESS_2_NONE,
+				.dstStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+				.dstAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.image = copies.image,
+				.subresourceRange = copies.range
+			});
+		}
+		recordBarriers(batch.transferCb, bufferBarriers, imageBarriers);
+		for (auto& copies : pending.bufferCopies) {
+			vkCmdCopyBuffer(batch.transferCb, copies.src, copies.dst, static_cast<uint32_t>(copies.regions.size()), copies.regions.data());
+		}
+		for (auto& copies : pending.imageCopies) {
+			vkCmdCopyBufferToImage(batch.transferCb, copies.src, copies.image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, static_cast<uint32_t>(copies.regions.size()), copies.regions.data());
+		}
+		// Make the copies visible to their consumers, or release them to the graphics queue family
+		const bool release{ ownershipTransfer() };
+		for (auto& copies : pending.bufferCopies) {
+			bufferBarriers.push_back({
+				.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+				.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				.dstStageMask = release ? VK_PIPELINE_STAGE_2_NONE : copies.dstStage,
+				.dstAccessMask = release ? VK_ACCESS_2_NONE : copies.dstAccess,
+				.srcQueueFamilyIndex = release ? transferFamily : VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = release ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED,
+				.buffer = copies.dst,
+				.size = VK_WHOLE_SIZE
+			});
+		}
+		imageBarriers.clear();
+		for (auto& copies : pending.imageCopies) {
+			imageBarriers.push_back({
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_COPY_BIT,
+				.srcAccessMask = VK_ACCESS_2_TRANSFER_WRITE_BIT,
+				.dstStageMask = release ? VK_PIPELINE_STAGE_2_NONE : copies.dstStage,
+				.dstAccessMask = release ? VK_ACCESS_2_NONE : copies.dstAccess,
+				.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
+				.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+				.srcQueueFamilyIndex = release ? transferFamily : VK_QUEUE_FAMILY_IGNORED,
+				.dstQueueFamilyIndex = release ? graphicsFamily : VK_QUEUE_FAMILY_IGNORED,
+				.image = copies.image,
+				.subresourceRange = copies.range
+			});
+		}
+		// Layout initializations don't need an ownership transfer, they're recorded on the queue that uses the image
+		std::vector<VkImageMemoryBarrier2> initBarriers;
+		for (auto& init : pending.imageInits) {
+			initBarriers.push_back({
+				.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER_2,
+				.srcStageMask = VK_PIPELINE_STAGE_2_NONE,
+				.srcAccessMask = VK_ACCESS_2_NONE,
+				.dstStageMask = init.dstStage,
+				.dstAccessMask = init.dstAccess,
+				.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED,
+				.newLayout = VK_IMAGE_LAYOUT_READ_ONLY_OPTIMAL,
+				.image = init.image,
+				.subresourceRange = init.range
+			});
+		}
+		if (!release) {
+			imageBarriers.insert(imageBarriers.end(), initBarriers.begin(), initBarriers.end());
+		}
+		recordBarriers(batch.transferCb, bufferBarriers, imageBarriers);
+		chk(vkEndCommandBuffer(batch.transferCb));
+		// Batches execute in order, so a later batch can fill levels of an image that an earlier one initialized on the other queue
+		submit(transferQueue, batch.transferCb, timelineValue);
+		if (release) {
+			// Matching acquire on the graphics queue, it waits for the transfer and turns the release barriers into acquire barriers
+			batch.acquireCb = getCommandBuffer(graphicsPool, freeAcquireCbs);
+			chk(vkBeginCommandBuffer(batch.acquireCb, &cbBI));
+			for (size_t i = 0; i < bufferBarriers.size(); i++) {
+				bufferBarriers[i].srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+				bufferBarriers[i].srcAccessMask = VK_ACCESS_2_NONE;
+				bufferBarriers[i].dstStageMask = pending.bufferCopies[i].dstStage;
+				bufferBarriers[i].dstAccessMask = pending.bufferCopies[i].dstAccess;
+			}
+			for (size_t i = 0; i < imageBarriers.size(); i++) {
+				imageBarriers[i].srcStageMask = VK_PIPELINE_STAGE_2_NONE;
+				imageBarriers[i].srcAccessMask = VK_ACCESS_2_NONE;
+				imageBarriers[i].dstStageMask = pending.imageCopies[i].dstStage;
+				imageBarriers[i].dstAccessMask = pending.imageCopies[i].dstAccess;
+			}
+			imageBarriers.insert(imageBarriers.end(), initBarriers.begin(), initBarriers.end());
+			recordBarriers(batch.acquireCb, bufferBarriers, imageBarriers);
+			chk(vkEndCommandBuffer(batch.acquireCb));
+			submit(graphicsQueue, batch.acquireCb, timelineValue);
+		}
+		batch.timelineValue = timelineValue;
+		inFlight.push_back(std::move(batch));
+		pending = {};
+		return timelineValue;
+	}
+
+	// Timeline value the pending batch will signal once it's flushed
+	uint64_t pendingValue() const {
+		return timelineValue + (ownershipTransfer() ? 2 : 1);
+	}
+
+	// Frees staging space and command buffers of all batches the GPU has finished
+	void reclaim() {
+		const uint64_t completed{ completedValue() };
+		while (!inFlight.empty() && inFlight.front().timelineValue <= completed) {
+			Batch& batch = inFlight.front();
+			freeTransferCbs.push_back(batch.transferCb);
+			if (batch.acquireCb != VK_NULL_HANDLE) {
+				freeAcquireCbs.push_back(batch.acquireCb);
+			}
+			for (auto& [buffer, allocation] : batch.dedicatedStaging) {
+				vmaDestroyBuffer(allocator, buffer, allocation);
+			}
+			inFlight.pop_front();
+		}
+	}
+
+	struct Staging {
+		VkBuffer buffer{ VK_NULL_HANDLE };
+		VkDeviceSize offset{ 0 };
+		void* data{ nullptr };
+	};
+	struct BufferCopies {
+		VkBuffer src{ VK_NULL_HANDLE };
+		VkBuffer dst{ VK_NULL_HANDLE };
+		std::vector<VkBufferCopy> regions;
+		VkPipelineStageFlags2 dstStage{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 dstAccess{ VK_ACCESS_2_NONE };
+	};
+	struct ImageCopies {
+		VkBuffer src{ VK_NULL_HANDLE };
+		VkImage image{ VK_NULL_HANDLE };
+		VkImageSubresourceRange range{};
+		std::vector<VkBufferImageCopy> regions;
+		VkPipelineStageFlags2 dstStage{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 dstAccess{ VK_ACCESS_2_NONE };
+	};
+	struct ImageInit {
+		VkImage image{ VK_NULL_HANDLE };
+		VkImageSubresourceRange range{};
+		VkPipelineStageFlags2 dstStage{ VK_PIPELINE_STAGE_2_NONE };
+		VkAccessFlags2 dstAccess{ VK_ACCESS_2_NONE };
+	};
+	struct PendingBatch {
+		std::vector<BufferCopies> bufferCopies;
+		std::vector<ImageCopies> imageCopies;
+		std::vector<ImageInit> imageInits;
+		VkDeviceSize ringBegin{ 0 };
+		bool usesRing{ false };
+		std::vector<std::pair<VkBuffer, VmaAllocation>> dedicatedStaging;
+	};
+	struct Batch {
+		VkCommandBuffer transferCb{ VK_NULL_HANDLE };
+		VkCommandBuffer acquireCb{ VK_NULL_HANDLE };
+		uint64_t timelineValue{ 0 };
+		VkDeviceSize ringBegin{ 0 };
+		bool usesRing{ false };
+		std::vector<std::pair<VkBuffer, VmaAllocation>> dedicatedStaging;
+	};
+	// Offsets are aligned for all copy types (texel blocks of compressed formats are at most 16 bytes)
+	static constexpr VkDeviceSize stagingAlignment{ 16 };
+
+	VkDevice device{ VK_NULL_HANDLE };
+	VmaAllocator allocator{ VK_NULL_HANDLE };
+	VkQueue graphicsQueue{ VK_NULL_HANDLE };
+	VkQueue transferQueue{ VK_NULL_HANDLE };
+	uint32_t graphicsFamily{ 0 };
+	uint32_t transferFamily{ 0 };
+	VkBuffer ringBuffer{ VK_NULL_HANDLE };
+	VmaAllocation ringAllocation{ VK_NULL_HANDLE };
+	uint8_t* ringMapped{ nullptr };
+	VkDeviceSize ringSize{ 0 };
+	VkDeviceSize ringHead{ 0 };
+	VkSemaphore timeline{ VK_NULL_HANDLE };
+	uint64_t timelineValue{ 0 };
+	VkCommandPool transferPool{ VK_NULL_HANDLE };
+	VkCommandPool graphicsPool{ VK_NULL_HANDLE };
+	std::vector<VkCommandBuffer> freeTransferCbs;
+	std::vector<VkCommandBuffer> freeAcquireCbs;
+	PendingBatch pending;
+	std::deque<Batch> inFlight;
+	std::mutex mutex;
+
+	// Finds space in the ring, the used part of the ring spans from the oldest unfinished batch to the head
+	bool ringFits(VkDeviceSize size, VkDeviceSize& offset) {
+		const Batch* oldest{ nullptr };
+		for (auto& batch : inFlight) {
+			if (batch.usesRing) {
+				oldest = &batch;
+				break;
+			}
+		}
+		if (oldest == nullptr && !pending.usesRing) {
+			ringHead = 0;
+			offset = 0;
+			return size <= ringSize;
+		}
+		const VkDeviceSize tail{ oldest ? oldest->ringBegin : pending.ringBegin };
+		const VkDeviceSize aligned{ (ringHead + stagingAlignment - 1) & ~(stagingAlignment - 1) };
+		if (ringHead >= tail) {
+			if (aligned + size <= ringSize) {
+				offset = aligned;
+				return true;
+			}
+			// Wrap around, the end of the ring stays unused until the head passes it again
+			if (size < tail) {
+				offset = 0;
+				return true;
+			}
+			return false;
+		}
+		if (aligned + size < tail) {
+			offset = aligned;
+			return true;
+		}
+		return false;
+	}
+
+	bool tryAllocateStaging(VkDeviceSize size, Staging& staging) {
+		// Uploads larger than the ring get their own staging buffer that's freed once the batch completes
+		if (size > ringSize / 2) {
+			VmaAllocation allocation{ VK_NULL_HANDLE };
+			VmaAllocationInfo allocInfo{};
+			VkBufferCreateInfo bufferCI{ .sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO, .size = size, .usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT };
+			VmaAllocationCreateInfo allocCI{ .flags = VMA_ALLOCATION_CREATE_HOST_ACCESS_SEQUENTIAL_WRITE_BIT | VMA_ALLOCATION_CREATE_MAPPED_BIT, .usage = VMA_MEMORY_USAGE_AUTO_PREFER_HOST };
+			chk(vmaCreateBuffer(allocator, &bufferCI, &allocCI, &staging.buffer, &allocation, &allocInfo));
+			staging.offset = 0;
+			staging.data = allocInfo.pMappedData;
+			pending.dedicatedStaging.push_back({ staging.buffer, allocation });
+			return true;
+		}
+		reclaim();
+		VkDeviceSize offset{ 0 };
+		if (!ringFits(size, offset)) {
+			return false;
+		}
+		if (!pending.usesRing) {
+			pending.usesRing = true;
+			pending.ringBegin = offset;
+		}
+		ringHead = offset + size;
+		staging = { .buffer = ringBuffer, .offset = offset, .data = ringMapped + offset };
+		return true;
+	}
+
+	Staging allocateStaging(VkDeviceSize size) {
+		Staging staging{};
+		while (!tryAllocateStaging(size, staging)) {
+			// Out of ring space: Submit what's pending and wait for the oldest batch to finish
+			if (inFlight.empty() || !std::any_of(inFlight.begin(), inFlight.end(), [](const Batch& batch) { return batch.usesRing; })) {
+				submitPending();
+			}
+			wait(inFlight.front().timelineValue);
+		}
+		return staging;
+	}
+
+	void addImageCopies(const Staging& staging, VkImage image, const VkImageSubresourceRange& range, std::span<const VkBufferImageCopy> regions, VkPipelineStageFlags2 dstStage, VkAccessFlags2 dstAccess) {
+		ImageCopies& copies = pending.imageCopies.emplace_back(ImageCopies{ .src = staging.buffer, .image = image, .range = range, .dstStage = dstStage, .dstAccess = dstAccess });
+		for (auto region : regions) {
+			region.bufferOffset += staging.offset;
+			copies.regions.push_back(region);
+		}
+	}
+
+	VkCommandBuffer getCommandBuffer(VkCommandPool pool, std::vector<VkCommandBuffer>& freeList) {
+		VkCommandBuffer cb{ VK_NULL_HANDLE };
+		if (!freeList.empty()) {
+			cb = freeList.back();
+			freeList.pop_back();
+			chk(vkResetCommandBuffer(cb, 0));
+			return cb;
+		}
+		VkCommandBufferAllocateInfo cbAI{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO, .commandPool = pool, .commandBufferCount = 1 };
+		chk(vkAllocateCommandBuffers(device, &cbAI, &cb));
+		return cb;
+	}
+
+	static void recordBarriers(VkCommandBuffer cb, const std::vector<VkBufferMemoryBarrier2>& bufferBarriers, const std::vector<VkImageMemoryBarrier2>& imageBarriers) {
+		if (bufferBarriers.empty() && imageBarriers.empty()) {
+			return;
+		}
+		VkDependencyInfo dependencyInfo{
+			.sType = VK_STRUCTURE_TYPE_DEPENDENCY_INFO,
+			.bufferMemoryBarrierCount = static_cast<uint32_t>(bufferBarriers.size()),
+			.pBufferMemoryBarriers = bufferBarriers.data(),
+			.imageMemoryBarrierCount = static_cast<uint32_t>(imageBarriers.size()),
+			.pImageMemoryBarriers = imageBarriers.data()
+		};
+		vkCmdPipelineBarrier2(cb, &dependencyInfo);
+	}
+
+	// Signals the next timeline value, optionally waiting for a previous one (used by the acquire submit)
+	void submit(VkQueue queue, VkCommandBuffer cb, uint64_t waitValue) {
+		VkSemaphoreSubmitInfo waitInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, .semaphore = timeline, .value = waitValue, .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT };
+		VkSemaphoreSubmitInfo signalInfo{ .sType = VK_STRUCTURE_TYPE_SEMAPHORE_SUBMIT_INFO, .semaphore = timeline, .value = ++timelineValue, .stageMask = VK_PIPELINE_STAGE_2_ALL_COMMANDS_BIT };
+		VkCommandBufferSubmitInfo cbInfo{ .sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_SUBMIT_INFO, .commandBuffer = cb };
+		VkSubmitInfo2 submitInfo{
+			.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO_2,
+			.waitSemaphoreInfoCount = waitValue > 0 ? 1u : 0u,
+			.pWaitSemaphoreInfos = &waitInfo,
+			.commandBufferInfoCount = 1,
+			.pCommandBufferInfos = &cbInfo,
+			.signalSemaphoreInfoCount = 1,
+			.pSignalSemaphoreInfos = &signalInfo
+		};
+		chk(vkQueueSubmit2(queue, 1, &submitInfo, VK_NULL_HANDLE));
+	}
+};
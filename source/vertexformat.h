@@ -0,0 +1,228 @@
+/* Copyright (c) 2025-2026, Sascha Willems
+ * SPDX-License-Identifier: MIT
+ */
+
+// Vertex encodings: Besides plain floats, vertices can be packed to 16 or 12 bytes at load time. Positions are quantized
+// to 16 bits within the mesh's bounding box, normals are octahedral encoded with 16 or 8 bits per component and uvs are
+// half floats. All packed attributes use formats with mandatory vertex buffer support, the shaders dequantize them.
+
+#pragma once
+
+#include <vector>
+#include <string>
+#include <algorithm>
+#include <limits>
+#include <cmath>
+#include <cstddef>
+#include <cstring>
+#include <cstdint>
+#include <iostream>
+#include <vulkan/vulkan.h>
+#include <glm/glm.hpp>
+#include <glm/gtc/packing.hpp>
+#include "mesh.h"
+
+// Stored in the mesh cache and passed to the shaders, so values must not change
+enum class VertexFormat : uint32_t {
+	Float = 0,
+	Packed16 = 1,
+	Packed12 = 2
+};
+
+// 16 bit position, w is padding
+struct PackedVertex16 {
+	uint16_t pos[4];
+	int16_t normal[2];
+	uint16_t uv[2];
+};
+static_assert(sizeof(PackedVertex16) == 16);
+
+// The position attribute reads four components and its w overlaps the normal, which the shader ignores
+struct PackedVertex12 {
+	uint16_t pos[3];
+	int8_t normal[2];
+	uint16_t uv[2];
+};
+static_assert(sizeof(PackedVertex12) == 12);
+
+// Dequantization of the positions (pos = normalized * scale + offset, as read by a unorm attribute) and the largest errors measured against the float data
+struct VertexEncoding {
+	VertexFormat format{ VertexFormat::Float };
+	glm::vec3 positionOffset{ 0.0f };
+	glm::vec3 positionScale{ 1.0f };
+	float positionError{ 0.0f };
+	float normalErrorDegrees{ 0.0f };
+	float uvError{ 0.0f };
+};
+
+inline const char* vertexFormatName(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::Packed16:
+		return "packed16";
+	case VertexFormat::Packed12:
+		return "packed12";
+	default:
+		return "float";
+	}
+}
+
+inline bool parseVertexFormat(const std::string& name, VertexFormat& format) {
+	for (auto candidate : { VertexFormat::Float, VertexFormat::Packed16, VertexFormat::Packed12 }) {
+		if (name == vertexFormatName(candidate)) {
+			format = candidate;
+			return true;
+		}
+	}
+	return false;
+}
+
+inline uint32_t vertexFormatStride(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::Packed16:
+		return sizeof(PackedVertex16);
+	case VertexFormat::Packed12:
+		return sizeof(PackedVertex12);
+	default:
+		return sizeof(Vertex);
+	}
+}
+
+// Locations 0 to 2 are position, normal and uv for every format, so the vertex shader's inputs stay the same
+inline std::vector<VkVertexInputAttributeDescription> vertexFormatAttributes(VertexFormat format) {
+	switch (format) {
+	case VertexFormat::Packed16:
+		return {
+			{ .location = 0, .binding = 0, .format = VK_FORMAT_R16G16B16A16_UNORM, .offset = offsetof(PackedVertex16, pos) },
+			{ .location = 1, .binding = 0, .format = VK_FORMAT_R16G16_SNORM, .offset = offsetof(PackedVertex16, normal) },
+			{ .location = 2, .binding = 0, .format = VK_FORMAT_R16G16_SFLOAT, .offset = offsetof(PackedVertex16, uv) },
+		};
+	case VertexFormat::Packed12:
+		return {
+			{ .location = 0, .binding = 0, .format = VK_FORMAT_R16G16B16A16_UNORM, .offset = offsetof(PackedVertex12, pos) },
+			{ .location = 1, .binding = 0, .format = VK_FORMAT_R8G8_SNORM, .offset = offsetof(PackedVertex12, normal) },
+			{ .location = 2, .binding = 0, .format = VK_FORMAT_R16G16_SFLOAT, .offset = offsetof(PackedVertex12, uv) },
+		};
+	default:
+		return {
+			{ .location = 0, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(Vertex, pos) },
+			{ .location = 1, .binding = 0, .format = VK_FORMAT_R32G32B32_SFLOAT, .offset = offsetof(Vertex, normal) },
+			{ .location = 2, .binding = 0, .format = VK_FORMAT_R32G32_SFLOAT, .offset = offsetof(Vertex, uv) },
+		};
+	}
+}
+
+// Maps the unit sphere onto the [-1, 1] square, the lower hemisphere is folded over the diagonals
+inline glm::vec2 octEncode(const glm::vec3& n) {
+	const float sum{ std::abs(n.x) + std::abs(n.y) + std::abs(n.z) };
+	if (sum == 0.0f) {
+		return glm::vec2(0.0f);
+	}
+	const glm::vec2 e{ n.x / sum, n.y / sum };
+	if (n.z >= 0.0f) {
+		return e;
+	}
+	return glm::vec2((1.0f - std::abs(e.y)) * (e.x >= 0.0f ? 1.0f : -1.0f), (1.0f - std::abs(e.x)) * (e.y >= 0.0f ? 1.0f : -1.0f));
+}
+
+// Same as octDecode in the shader
+inline glm::vec3 octDecode(const glm::vec2& e) {
+	glm::vec3 n{ e.x, e.y, 1.0f - std::abs(e.x) - std::abs(e.y) };
+	const float t{ std::max(-n.z, 0.0f) };
+	n.x += n.x >= 0.0f ? -t : t;
+	n.y += n.y >= 0.0f ? -t : t;
+	return glm::normalize(n);
+}
+
+// Octahedral normal as snorm integers, tries all four roundings of the two components and keeps the closest one
+template <typename T>
+inline void encodeNormal(const glm::vec3& normal, T out[2], float& errorDegrees) {
+	const float maxValue{ static_cast<float>((1 << (sizeof(T) * 8 - 1)) - 1) };
+	const glm::vec2 e{ octEncode(normal) * maxValue };
+	const float normalLength{ glm::length(normal) };
+	float bestDot{ -2.0f };
+	for (uint32_t i = 0; i < 4; i++) {
+		const float x{ (i & 1) ? std::ceil(e.x) : std::floor(e.x) };
+		const float y{ (i & 2) ? std::ceil(e.y) : std::floor(e.y) };
+		const glm::vec3 decoded{ octDecode(glm::vec2(std::max(x / maxValue, -1.0f), std::max(y / maxValue, -1.0f))) };
+		const float d{ normalLength > 0.0f ? glm::dot(decoded, normal / normalLength) : 1.0f };
+		if (d > bestDot) {
+			bestDot = d;
+			out[0] = static_cast<T>(std::clamp(x, -maxValue, maxValue));
+			out[1] = static_cast<T>(std::clamp(y, -maxValue, maxValue));
+		}
+	}
+	errorDegrees = std::max(errorDegrees, std::acos(std::clamp(bestDot, -1.0f, 1.0f)) * 57.2957795f);
+}
+
+// Packs the vertices into the given format and fills the encoding with the dequantization and the measured errors
+inline std::vector<uint8_t> encodeVertices(const std::vector<Vertex>& vertices, VertexFormat format, VertexEncoding& encoding) {
+	encoding = { .format = format };
+	std::vector<uint8_t> result(vertices.size() * vertexFormatStride(format));
+	if (format == VertexFormat::Float) {
+		memcpy(result.data(), vertices.data(), result.size());
+		return result;
+	}
+	glm::vec3 minPos{ std::numeric_limits<float>::max() };
+	glm::vec3 maxPos{ std::numeric_limits<float>::lowest() };
+	for (auto& vertex : vertices) {
+		minPos = glm::min(minPos, vertex.pos);
+		maxPos = glm::max(maxPos, vertex.pos);
+	}
+	if (vertices.empty()) {
+		minPos = maxPos = glm::vec3(0.0f);
+	}
+	encoding.positionOffset = minPos;
+	encoding.positionScale = maxPos - minPos;
+	const auto quantize = [&](const glm::vec3& pos, uint16_t out[3]) {
+		for (uint32_t k = 0; k < 3; k++) {
+			out[k] = encoding.positionScale[k] > 0.0f ? static_cast<uint16_t>(std::clamp(std::round((pos[k] - minPos[k]) / encoding.positionScale[k] * 65535.0f), 0.0f, 65535.0f)) : 0;
+			encoding.positionError = std::max(encoding.positionError, std::abs(out[k] / 65535.0f * encoding.positionScale[k] + minPos[k] - pos[k]));
+		}
+	};
+	const auto packUv = [&](const glm::vec2& uv, uint16_t out[2]) {
+		for (uint32_t k = 0; k < 2; k++) {
+			out[k] = static_cast<uint16_t>(glm::packHalf1x16(uv[k]));
+			encoding.uvError = std::max(encoding.uvError, std::abs(glm::unpackHalf1x16(out[k]) - uv[k]));
+		}
+	};
+	for (size_t i = 0; i < vertices.size(); i++) {
+		if (format == VertexFormat::Packed16) {
+			PackedVertex16 packed{};
+			quantize(vertices[i].pos, packed.pos);
+			encodeNormal(vertices[i].normal, packed.normal, encoding.normalErrorDegrees);
+			packUv(vertices[i].uv, packed.uv);
+			memcpy(result.data() + i * sizeof(PackedVertex16), &packed, sizeof(PackedVertex16));
+		} else {
+			PackedVertex12 packed{};
+			quantize(vertices[i].pos, packed.pos);
+			encodeNormal(vertices[i].normal, packed.normal, encoding.normalErrorDegrees);
+			packUv(vertices[i].uv, packed.uv);
+			memcpy(result.data() + i * sizeof(PackedVertex12), &packed, sizeof(PackedVertex12));
+		}
+	}
+	return result;
+}
+
+// Dequantized positions of encoded vertices, for processing that runs on cached vertex data
+inline std::vector<glm::vec3> decodePositions(const void* vertexData, size_t vertexCount, const VertexEncoding& encoding) {
+	const uint8_t* bytes = static_cast<const uint8_t*>(vertexData);
+	const uint32_t stride{ vertexFormatStride(encoding.format) };
+	std::vector<glm::vec3> positions(vertexCount);
+	for (size_t i = 0; i < vertexCount; i++) {
+		if (encoding.format == VertexFormat::Float) {
+			memcpy(&positions[i], bytes + i * stride, sizeof(glm::vec3));
+			continue;
+		}
+		uint16_t pos[3];
+		memcpy(pos, bytes + i * stride, sizeof(pos));
+		positions[i] = glm::vec3(pos[0], pos[1], pos[2]) / 65535.0f * encoding.positionScale + encoding.positionOffset;
+	}
+	return positions;
+}
+
+inline void printVertexEncoding(const VertexEncoding& encoding, size_t vertexCount) {
+	const uint32_t stride{ vertexFormatStride(encoding.format) };
+	std::cout << "Vertex format " << vertexFormatName(encoding.format) << ": " << stride << " bytes per vertex, " << vertexCount * stride / 1024.0 << " KB ("
+		<< 100.0 * (1.0 - (double)stride / sizeof(Vertex)) << "% less than float), max error position " << encoding.positionError
+		<< ", normal " << encoding.normalErrorDegrees << " degrees, uv " << encoding.uvError << "\n";
+}